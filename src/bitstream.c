@@ -27,17 +27,11 @@
 #include "kvz_math.h"
 
 
-const uint32_t kvz_bit_set_mask[] =
-{
-0x00000001,0x00000002,0x00000004,0x00000008,
-0x00000010,0x00000020,0x00000040,0x00000080,
-0x00000100,0x00000200,0x00000400,0x00000800,
-0x00001000,0x00002000,0x00004000,0x00008000,
-0x00010000,0x00020000,0x00040000,0x00080000,
-0x00100000,0x00200000,0x00400000,0x00800000,
-0x01000000,0x02000000,0x04000000,0x08000000,
-0x10000000,0x20000000,0x40000000,0x80000000
-};
+// True if any byte of the 64-bit word x is zero.
+#define HAS_ZERO_BYTE(x) \
+  ((((x) - 0x0101010101010101ull) & ~(x) & 0x8080808080808080ull) != 0)
+
+static void flush_bytes(bitstream_t *stream);
 
 
 //#define VERBOSE
@@ -71,6 +65,7 @@ void kvz_bitstream_init(bitstream_t *const stream)
  */
 kvz_data_chunk * kvz_bitstream_take_chunks(bitstream_t *const stream)
 {
+  flush_bytes(stream);
   assert(stream->cur_bit == 0);
   kvz_data_chunk *chunks = stream->first;
   stream->first = stream->last = NULL;
@@ -121,21 +116,27 @@ void kvz_bitstream_finalize(bitstream_t *const stream)
 uint64_t kvz_bitstream_tell(const bitstream_t *const stream)
 {
   uint64_t position = stream->len;
+
+  // Count the emulation prevention bytes the buffered bytes will get.
+  const uint64_t bytes = stream->data >> (stream->cur_bit & 7);
+  int zerocount = stream->zerocount;
+  for (int i = (stream->cur_bit >> 3) - 1; i >= 0; --i) {
+    const uint8_t byte = (uint8_t)(bytes >> (8 * i));
+    if (zerocount == 2 && byte < 4) {
+      position++;
+      zerocount = 0;
+    }
+    zerocount = byte == 0 ? zerocount + 1 : 0;
+  }
+
   return position * 8 + stream->cur_bit;
 }
 
 /**
- * \brief Write a byte to bitstream
- *
- * The stream must be byte-aligned.
- *
- * \param stream  pointer bitstream to put the data
- * \param byte    byte to write
+ * \brief Append a byte to the chunks.
  */
-void kvz_bitstream_writebyte(bitstream_t *const stream, const uint8_t byte)
+static void append_byte(bitstream_t *const stream, const uint8_t byte)
 {
-  assert(stream->cur_bit == 0);
-
   if (stream->last == NULL || stream->last->len == KVZ_DATA_CHUNK_SIZE) {
     // Need to allocate a new chunk.
     kvz_data_chunk *new_chunk = kvz_bitstream_alloc_chunk();
@@ -152,6 +153,86 @@ void kvz_bitstream_writebyte(bitstream_t *const stream, const uint8_t byte)
   stream->len += 1;
 }
 
+/**
+ * \brief Append a byte to the chunks, preceded by an emulation prevention
+ * byte if needed.
+ */
+static void append_byte_ep(bitstream_t *const stream, const uint8_t byte)
+{
+  const uint8_t emulation_prevention_three_byte = 0x03;
+
+  if ((stream->zerocount == 2) && (byte < 4)) {
+    append_byte(stream, emulation_prevention_three_byte);
+    stream->zerocount = 0;
+  }
+  stream->zerocount = byte == 0 ? stream->zerocount + 1 : 0;
+  append_byte(stream, byte);
+}
+
+/**
+ * \brief Write the complete bytes buffered in stream->data to the chunks.
+ *
+ * A full word without zero bytes cannot contain an emulated start code, so
+ * it is copied as is. Other words are checked byte by byte.
+ */
+static void flush_bytes(bitstream_t *const stream)
+{
+  const int num_bytes = stream->cur_bit >> 3;
+  const int num_bits = stream->cur_bit & 7;
+  const uint64_t bytes = stream->data >> num_bits;
+  kvz_data_chunk *const last = stream->last;
+
+  // At most one emulation prevention byte is inserted per two bytes.
+  if (last != NULL && last->len + 2 * 8 <= KVZ_DATA_CHUNK_SIZE) {
+    uint8_t *const start = &last->data[last->len];
+    uint8_t *dst = start;
+
+    if (num_bytes == 8 && stream->zerocount < 2 && !HAS_ZERO_BYTE(bytes)) {
+      for (int i = 0; i < 8; ++i) {
+        dst[i] = (uint8_t)(bytes >> (56 - 8 * i));
+      }
+      dst += 8;
+      stream->zerocount = 0;
+    } else {
+      for (int i = num_bytes - 1; i >= 0; --i) {
+        const uint8_t byte = (uint8_t)(bytes >> (8 * i));
+        if (stream->zerocount == 2 && byte < 4) {
+          *dst++ = 0x03;
+          stream->zerocount = 0;
+        }
+        stream->zerocount = byte == 0 ? stream->zerocount + 1 : 0;
+        *dst++ = byte;
+      }
+    }
+
+    last->len += (uint32_t)(dst - start);
+    stream->len += (uint32_t)(dst - start);
+  } else {
+    for (int i = num_bytes - 1; i >= 0; --i) {
+      append_byte_ep(stream, (uint8_t)(bytes >> (8 * i)));
+    }
+  }
+
+  stream->data &= (UINT64_C(1) << num_bits) - 1;
+  stream->cur_bit = num_bits;
+}
+
+/**
+ * \brief Write a byte to bitstream
+ *
+ * The byte is written without emulation prevention. The stream must be
+ * byte-aligned.
+ *
+ * \param stream  pointer bitstream to put the data
+ * \param byte    byte to write
+ */
+void kvz_bitstream_writebyte(bitstream_t *const stream, const uint8_t byte)
+{
+  flush_bytes(stream);
+  assert(stream->cur_bit == 0);
+  append_byte(stream, byte);
+}
+
 /**
  * \brief Move data from one stream to another.
  *
@@ -159,6 +240,8 @@ void kvz_bitstream_writebyte(bitstream_t *const stream, const uint8_t byte)
  */
 void kvz_bitstream_move(bitstream_t *const dst, bitstream_t *const src)
 {
+  flush_bytes(dst);
+  flush_bytes(src);
   assert(dst->cur_bit == 0);
 
   if (src->len > 0) {
@@ -198,40 +281,34 @@ void kvz_bitstream_clear(bitstream_t *const stream)
  */
 void kvz_bitstream_put_byte(bitstream_t *const stream, uint32_t data)
 {
-  assert(stream->cur_bit == 0);
-  const uint8_t emulation_prevention_three_byte = 0x03;
+  assert((stream->cur_bit & 7) == 0);
 
-  if ((stream->zerocount == 2) && (data < 4)) {
-    kvz_bitstream_writebyte(stream, emulation_prevention_three_byte);
-    stream->zerocount = 0;
+  if (stream->cur_bit > 64 - 8) {
+    flush_bytes(stream);
   }
-  stream->zerocount = data == 0 ? stream->zerocount + 1 : 0;
-  kvz_bitstream_writebyte(stream, data);
+  stream->data = (stream->data << 8) | (data & 0xff);
+  stream->cur_bit += 8;
 }
 
 /**
  * \brief Write bits to bitstream
- *        Buffers individual bits untill they make a full byte.
+ *        Buffers the bits until a whole word of bytes can be written.
  * \param stream  stream the data is to be appended to
  * \param data  input data
  * \param bits  number of bits to write from data to stream
  */
 void kvz_bitstream_put(bitstream_t *const stream, const uint32_t data, uint8_t bits)
 {
-  while (bits--) {
-    stream->data <<= 1;
-
-    if (data & kvz_bit_set_mask[bits]) {
-      stream->data |= 1;
-    }
-    stream->cur_bit++;
+  assert(bits <= 32);
+  if (bits == 0) return;
 
-    // write byte to output
-    if (stream->cur_bit == 8) {
-      stream->cur_bit = 0;
-      kvz_bitstream_put_byte(stream, stream->data);
-    }
+  if (stream->cur_bit + bits > 64) {
+    flush_bytes(stream);
   }
+
+  const uint32_t mask = 0xffffffffu >> (32 - bits);
+  stream->data = (stream->data << bits) | (data & mask);
+  stream->cur_bit += bits;
 }
 
 /**
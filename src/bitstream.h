@@ -45,10 +45,15 @@ typedef struct bitstream_t
   /// \brief Pointer to the last chunk, or NULL.
   kvz_data_chunk *last;
 
-  /// \brief The incomplete byte.
-  uint8_t data;
-
-  /// \brief Number of bits in the incomplete byte.
+  /// \brief Bits not yet written to the chunks, the last bit in the LSB.
+  ///
+  /// Complete bytes are collected here and written out with emulation
+  /// prevention a word at a time.
+  uint64_t data;
+
+  /// \brief Number of bits in data.
+  ///
+  /// The stream is byte-aligned when (cur_bit & 7) == 0.
   uint8_t cur_bit;
 
   uint8_t zerocount;
@@ -85,6 +85,30 @@ void kvz_cabac_start(cabac_data_t * const data)
   data->only_count = 0; // By default, write bits out
 }
 
+/**
+ * \brief Copy the state of the arithmetic coder without any contexts.
+ *
+ * Used together with CABAC_COPY_CTX to checkpoint only the contexts a bit
+ * count touches instead of the whole cabac_data_t.
+ */
+void kvz_cabac_copy_engine(cabac_data_t * const dst, const cabac_data_t * const src)
+{
+  memcpy(dst, src, offsetof(cabac_data_t, ctx));
+}
+
+/**
+ * \brief Copy the contexts used by kvz_encode_coeff_nxn.
+ */
+void kvz_cabac_copy_coeff_ctx(cabac_data_t * const dst, const cabac_data_t * const src)
+{
+  const size_t first = offsetof(cabac_data_t, ctx.cu_sig_coeff_group_model);
+  const size_t end = offsetof(cabac_data_t, ctx.cu_abs_model_chroma) +
+                     sizeof(src->ctx.cu_abs_model_chroma);
+  memcpy((uint8_t*)dst + first, (const uint8_t*)src + first, end - first);
+  CABAC_COPY_CTX(dst, src, transform_skip_model_luma);
+  CABAC_COPY_CTX(dst, src, transform_skip_model_chroma);
+}
+
 /**
  * \brief
  */
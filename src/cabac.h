@@ -62,6 +62,8 @@ typedef struct
     cabac_ctx_t qt_cbf_model_chroma[4];
     cabac_ctx_t cu_qp_delta_abs[4];
     cabac_ctx_t part_size_model[4];
+    // Contexts of transform coefficients, from cu_sig_coeff_group_model to
+    // cu_abs_model_chroma, are kept together for kvz_cabac_copy_coeff_ctx.
     cabac_ctx_t cu_sig_coeff_group_model[4];
     cabac_ctx_t cu_sig_model_luma[27];
     cabac_ctx_t cu_sig_model_chroma[15];
@@ -87,6 +89,28 @@ typedef struct
   } ctx;
 } cabac_data_t;
 
+/**
+ * \brief Bit costs of the contexts used by RDOQ, grouped per syntax element.
+ *
+ * Costs are in fractional bits and indexed by [context][bin]. Tables with
+ * a leading [2] are indexed by whether the block is chroma. The costs are
+ * computed from the contexts once per LCU by kvz_rdo_update_cabac_bits,
+ * since the contexts do not change during the search of an LCU.
+ */
+typedef struct {
+  int32_t sig_coeff_group[4][2];
+  int32_t sig[2][27][2];
+  int32_t one[2][16][2];
+  int32_t abs[2][4][2];
+  int32_t qt_cbf[2][4][2];
+  int32_t qt_root_cbf[2];
+
+  //! \brief Cost of last_sig_coeff_x/y_prefix up to and including each
+  //! group, indexed by [chroma][log2 of block size - 2][group].
+  int32_t last_x[2][4][10];
+  int32_t last_y[2][4][10];
+} cabac_bits_t;
+
 
 // Globals
 extern const uint8_t kvz_g_auc_next_state_mps[128];
@@ -97,6 +121,8 @@ extern const uint8_t kvz_g_auc_renorm_table[32];
 
 // Functions
 void kvz_cabac_start(cabac_data_t *data);
+void kvz_cabac_copy_engine(cabac_data_t *dst, const cabac_data_t *src);
+void kvz_cabac_copy_coeff_ctx(cabac_data_t *dst, const cabac_data_t *src);
 void kvz_cabac_encode_bin(cabac_data_t *data, uint32_t bin_value);
 void kvz_cabac_encode_bin_ep(cabac_data_t *data, uint32_t bin_value);
 void kvz_cabac_encode_bins_ep(cabac_data_t *data, uint32_t bin_values, int num_bins);
@@ -121,6 +147,10 @@ void kvz_cabac_write_unary_max_symbol_ep(cabac_data_t *data, unsigned int symbol
 #define CTX_UPDATE_LPS(ctx) { (ctx)->uc_state = kvz_g_auc_next_state_lps[ (ctx)->uc_state ]; }
 #define CTX_UPDATE_MPS(ctx) { (ctx)->uc_state = kvz_g_auc_next_state_mps[ (ctx)->uc_state ]; }
 
+// Copy the contexts of one syntax element from src to dst.
+#define CABAC_COPY_CTX(dst, src, model) \
+  memcpy(&(dst)->ctx.model, &(src)->ctx.model, sizeof((src)->ctx.model))
+
 #ifdef VERBOSE
   #define CABAC_BIN(data, value, name) { \
     uint32_t prev_state = (data)->ctx->uc_state; \
@@ -141,11 +141,19 @@ int kvz_config_init(kvz_config *cfg)
 
   cfg->max_merge = 5;
   cfg->early_skip = true;
+  cfg->me_pyramid = 0;
+  cfg->subpel_cache = false;
+  cfg->lookahead = 0;
+  cfg->lookahead_aq = false;
+  cfg->scene_cut = false;
 
   //*********************************************
   //For scalable extension. TODO: Move somewhere else?
   cfg->layer = 0;
   cfg->input_layer = -1;
+  cfg->downscaling_filter = 0;
+  cfg->ilr_fast_decision = 0;
+  cfg->ilr_mv_start = 0;
 
   cfg->ILR_frames = 0;
 
@@ -176,6 +184,8 @@ static void shared_init(kvz_config *cfg)
   cfg->shared->intra_period = cfg->intra_period;
   cfg->shared->wpp = cfg->wpp;
   cfg->shared->owf = cfg->owf;
+  cfg->shared->lookahead = cfg->lookahead;
+  cfg->shared->scene_cut = cfg->scene_cut;
   cfg->shared->threads = cfg->threads;
   cfg->shared->multiview = cfg->multiview;
 
@@ -192,6 +202,9 @@ static void shared_init(kvz_config *cfg)
   memcpy(&cfg->shared->gop_lp_definition, &cfg->gop_lp_definition, sizeof(cfg->gop_lp_definition));
 
   cfg->shared->print_es_hierarchy = 0;
+  cfg->shared->cascade_scaling = 0;
+
+  cfg->shared->threadqueue_log = NULL;
 }
 
 //Free allocated memory for the shared struct
@@ -201,6 +214,7 @@ static void shared_destroy(kvz_config *cfg)
 
     FREE_POINTER(cfg->shared->input_widths);
     FREE_POINTER(cfg->shared->input_heights);
+    FREE_POINTER(cfg->shared->threadqueue_log);
 
 
     FREE_POINTER(cfg->shared);
@@ -453,7 +467,7 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
   static const char * const colormatrix_names[] = { "GBR", "bt709", "undef", "", "fcc", "bt470bg", "smpte170m",
                                                     "smpte240m", "YCgCo", "bt2020nc", "bt2020c", NULL };
   static const char * const mv_constraint_names[] = { "none", "frame", "tile", "frametile", "frametilemargin", NULL };
-  static const char * const hash_names[] = { "none", "checksum", "md5", NULL };
+  static const char * const hash_names[] = { "none", "checksum", "md5", "crc", NULL };
 
   static const char * const cu_split_termination_names[] = { "zero", "off", NULL };
   static const char * const crypto_toggle_names[] = { "off", "on", NULL };
@@ -860,6 +874,18 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
   else if OPT("print-es-hierarchy"){
     cfg->shared->print_es_hierarchy = atobool(value);
   }
+  else if OPT("cascade-scaling"){
+    cfg->shared->cascade_scaling = atobool(value);
+  }
+  else if OPT("downscaling-filter"){
+    cfg->downscaling_filter = atoi(value);
+  }
+  else if OPT("ilr-fast-decision"){
+    cfg->ilr_fast_decision = atobool(value);
+  }
+  else if OPT("ilr-mv-start"){
+    cfg->ilr_mv_start = atobool(value);
+  }
   //*********************************************
   else if OPT("input-fps") {
     int32_t fps_num, fps_denom;
@@ -1094,6 +1120,15 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
     cfg->shared->threads = cfg->threads;
       //*********************************************
   }
+  else if OPT("threadqueue-log") {
+    char* threadqueue_log = strdup(value);
+    if (!threadqueue_log) {
+      fprintf(stderr, "Failed to allocate memory for threadqueue log filename.\n");
+      return 0;
+    }
+    FREE_POINTER(cfg->shared->threadqueue_log);
+    cfg->shared->threadqueue_log = threadqueue_log;
+  }
   else if OPT("cpuid")
     cfg->cpuid = atobool(value);
   else if OPT("multiview")
@@ -1545,6 +1580,33 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
   else if OPT("early-skip") {
   cfg->early_skip = (bool)atobool(value);
   }
+  else if OPT("me-pyramid") {
+    int levels = atoi(value);
+    if (levels < 0 || levels > 2) {
+      fprintf(stderr, "me-pyramid needs to be between 0 and 2\n");
+      return 0;
+    }
+    cfg->me_pyramid = (int8_t)levels;
+  }
+  else if OPT("subpel-cache") {
+    cfg->subpel_cache = (bool)atobool(value);
+  }
+  else if OPT("lookahead") {
+    int frames = atoi(value);
+    if (frames < 0 || frames > LOOKAHEAD_MAX_FRAMES) {
+      fprintf(stderr, "lookahead needs to be between 0 and %d\n", LOOKAHEAD_MAX_FRAMES);
+      return 0;
+    }
+    cfg->lookahead = frames;
+    cfg->shared->lookahead = cfg->lookahead;
+  }
+  else if OPT("lookahead-aq") {
+    cfg->lookahead_aq = (bool)atobool(value);
+  }
+  else if OPT("scene-cut") {
+    cfg->scene_cut = (bool)atobool(value);
+    cfg->shared->scene_cut = cfg->scene_cut;
+  }
   else {
     return 0;
   }
@@ -1896,6 +1958,17 @@ int kvz_config_validate(const kvz_config *const cfg)
     fprintf(stderr, "Input error: --owf must be nonnegative or -1\n");
     error = 1;
   }
+
+  if (cfg->lookahead_aq && (cfg->shared == NULL ? cfg->lookahead : cfg->shared->lookahead) == 0) {
+    fprintf(stderr, "Input error: --lookahead-aq requires --lookahead\n");
+    error = 1;
+  }
+
+  if ((cfg->shared == NULL ? cfg->scene_cut : cfg->shared->scene_cut) &&
+      (cfg->shared == NULL ? cfg->lookahead : cfg->shared->lookahead) == 0) {
+    fprintf(stderr, "Input error: --scene-cut requires --lookahead\n");
+    error = 1;
+  }
   //*********************************************
   
 
@@ -2000,6 +2073,11 @@ int kvz_config_validate(const kvz_config *const cfg)
     error = 1;
   }
 
+  if (cfg->downscaling_filter < 0 || cfg->downscaling_filter > 8) {
+    fprintf(stderr, "Input error: --downscaling-filter must be in range 0-8\n");
+    error = 1;
+  }
+
   if( cfg->ILR_frames > cfg->layer) {
     fprintf(stderr, "Input error: There are not enough layers with a smaller lid to have %d ILR for layer %d \n",cfg->ILR_frames,cfg->layer);
     error = 1;
@@ -86,6 +86,7 @@ static const struct option long_options[] = {
   { "owf",                required_argument, NULL, 0 },
   { "slices",             required_argument, NULL, 0 },
   { "threads",            required_argument, NULL, 0 },
+  { "threadqueue-log",    required_argument, NULL, 0 },
   { "cpuid",              optional_argument, NULL, 0 },
   { "no-cpuid",                 no_argument, NULL, 0 },
   { "pu-depth-inter",     required_argument, NULL, 0 },
@@ -104,6 +105,7 @@ static const struct option long_options[] = {
   { "version",                  no_argument, NULL, 0 },
   { "help",                     no_argument, NULL, 0 },
   { "loop-input",               no_argument, NULL, 0 },
+  { "mmap-input",               no_argument, NULL, 0 },
   { "mv-constraint",      required_argument, NULL, 0 },
   { "hash",               required_argument, NULL, 0 },
   {"cu-split-termination",required_argument, NULL, 0 },
@@ -137,6 +139,14 @@ static const struct option long_options[] = {
   { "max-merge",          required_argument, NULL, 0 },
   { "early-skip",               no_argument, NULL, 0 },
   { "no-early-skip",            no_argument, NULL, 0 },
+  { "me-pyramid",         required_argument, NULL, 0 },
+  { "subpel-cache",             no_argument, NULL, 0 },
+  { "no-subpel-cache",          no_argument, NULL, 0 },
+  { "lookahead",          required_argument, NULL, 0 },
+  { "lookahead-aq",             no_argument, NULL, 0 },
+  { "no-lookahead-aq",          no_argument, NULL, 0 },
+  { "scene-cut",                no_argument, NULL, 0 },
+  { "no-scene-cut",             no_argument, NULL, 0 },
   //*********************************************
   //For scalable extension.
   { "multiview",          required_argument, NULL, 0 },
@@ -145,6 +155,13 @@ static const struct option long_options[] = {
   { "input-layer",        required_argument, NULL, 0 }, //Manualy set the input layer the current layer uses
   { "ilr",                required_argument, NULL, 0 }, //Number of ILR
   { "print-es-hierarchy",       no_argument, NULL, 0 }, //Print encoder state hierarchy
+  { "cascade-scaling",          no_argument, NULL, 0 }, //Scale layers from larger layers
+  { "no-cascade-scaling",       no_argument, NULL, 0 },
+  { "downscaling-filter", required_argument, NULL, 0 }, //Anti-alias filter used in downscaling
+  { "ilr-fast-decision",        no_argument, NULL, 0 }, //Limit EL cu search using the ilr cus
+  { "no-ilr-fast-decision",     no_argument, NULL, 0 },
+  { "ilr-mv-start",             no_argument, NULL, 0 }, //Start the EL motion search from the BL mv
+  { "no-ilr-mv-start",          no_argument, NULL, 0 },
   //*********************************************
   {0, 0, 0, 0}
 };
@@ -296,6 +313,8 @@ cmdline_opts_t* cmdline_opts_parse(const kvz_api *const api, int argc, char *arg
       goto done;
     } else if (!strcmp(name, "loop-input")) {
       opts->loop_input = true;
+    } else if (!strcmp(name, "mmap-input")) {
+      opts->mmap_input = true;
     } else if (!api->config_parse(opts->config, name, optarg)) {
       fprintf(stderr, "invalid argument: %s=%s\n", name, optarg);
       ok = 0;
@@ -448,6 +467,8 @@ void print_help(void)
     "      --input-format <string> : P420 or P400 [P420]\n"
     "      --input-bitdepth <int> : 8-16 [8]\n"
     "      --loop-input           : Re-read input file forever.\n"
+    "      --mmap-input           : Map input file to memory and encode\n"
+    "                               8-bit frames without copying them.\n"
     "\n"
     /* Word wrap to this width to stay under 80 characters (including ") *************/
     "Options:\n"
@@ -460,6 +481,7 @@ void print_help(void)
     "                                   - none: 0 bytes\n"
     "                                   - checksum: 18 bytes\n"
     "                                   - md5: 56 bytes\n"
+    "                                   - crc: 12 bytes\n"
     "      --(no-)psnr            : Calculate PSNR for frames. [enabled]\n"
     "      --(no-)info            : Add encoder info SEI. [enabled]\n"
     "      --crypto <string>      : Selective encryption. Crypto support must be\n"
@@ -500,6 +522,14 @@ void print_help(void)
     "      --bitrate <integer>    : Target bitrate [0]\n"
     "                                   - 0: Disable rate control.\n"
     "                                   - N: Target N bits per second.\n"
+    "      --lookahead <integer>  : Number of frames analysed ahead of the\n"
+    "                               encoder. The estimated complexity is used in\n"
+    "                               rate control. [0]\n"
+    "      --(no-)lookahead-aq    : Adapt the QP of each LCU to its complexity\n"
+    "                               estimated by the lookahead. Not used with\n"
+    "                               --bitrate or --roi. [disabled]\n"
+    "      --(no-)scene-cut       : Start a new GOP with an IDR picture at scene\n"
+    "                               cuts detected by the lookahead. [disabled]\n"
     "      --(no-)lossless        : Use lossless coding. [disabled]\n"
     "      --mv-constraint <string> : Constrain movement vectors. [none]\n"
     "                                   - none: No constraint\n"
@@ -558,12 +588,22 @@ void print_help(void)
     "                                   - dia:   Diamond Search\n"
     "      --me-steps <integer>   : Motion estimation search step limit. Only\n"
     "                               affects 'hexbs' and 'dia'. [-1]\n"
+    "      --me-pyramid <integer> : Coarse motion search on downscaled pictures\n"
+    "                               before the full resolution search. [0]\n"
+    "                                   - 0: Disabled\n"
+    "                                   - 1: Half resolution\n"
+    "                                   - 2: Quarter and half resolution\n"
     "      --subme <integer>      : Fractional pixel motion estimation level [4]\n"
     "                                   - 0: Integer motion estimation only\n"
     "                                   - 1: + 1/2-pixel horizontal and vertical\n"
     "                                   - 2: + 1/2-pixel diagonal\n"
     "                                   - 3: + 1/4-pixel horizontal and vertical\n"
     "                                   - 4: + 1/4-pixel diagonal\n"
+    "      --(no-)subpel-cache    : Interpolate the fractional pixel positions of\n"
+    "                               reference frames once and reuse them in\n"
+    "                               motion estimation and inter prediction.\n"
+    "                               Needs 15 times the luma memory of each\n"
+    "                               reference frame. [disabled]\n"
     "      --pu-depth-inter <int>-<int> : Inter prediction units sizes [0-3]\n"
     "                                   - 0, 1, 2, 3: from 64x64 to 8x8\n"
     "      --pu-depth-intra <int>-<int> : Intra prediction units sizes [1-4]\n"
@@ -600,6 +640,10 @@ void print_help(void)
     "      --owf <integer>        : Frame-level parallelism [auto]\n"
     "                                   - N: Process N+1 frames at a time.\n"
     "                                   - auto: Select automatically.\n"
+    "      --threadqueue-log <string> : Write a trace of the jobs run by\n"
+    "                                   the worker threads to a file. The\n"
+    "                                   trace can be plotted with\n"
+    "                                   tools/plot-threadqueue-log.py.\n"
     "      --(no-)wpp             : Wavefront parallel processing. [enabled]\n"
     "                               Enabling tiles automatically disables WPP.\n"
     "                               To enable WPP with tiles, re-enable it after\n"
@@ -669,6 +713,21 @@ void print_help(void)
     "      --ilr <integer>        : Set the number of inter layer reference frames\n"
     "                               for the current layer. Currently only the value\n"
     "                               of 1 is supported. [1]\n"
+    "      --(no-)cascade-scaling : Downscale each layer from the closest larger\n"
+    "                               layer that uses the same input instead of the\n"
+    "                               input itself. [disabled]\n"
+    "      --downscaling-filter <integer> : Anti-alias filter used when\n"
+    "                               downscaling the input of the current layer.\n"
+    "                                   - 0: Select based on the scaling ratio.\n"
+    "                                   - 1-8: From the sharpest to the smoothest.\n"
+    "                               [0]\n"
+    "      --(no-)ilr-fast-decision : Limit the CU depths and modes searched in\n"
+    "                               the current layer based on the co-located CUs\n"
+    "                               of the inter layer reference. [disabled]\n"
+    "      --(no-)ilr-mv-start    : Start the integer motion search from the\n"
+    "                               scaled mv of the co-located CU of the inter\n"
+    "                               layer reference and only refine around it.\n"
+    "                               [disabled]\n"
     "      --debug <string>       : Specify the filename for reconstruction\n"
     "                               output. Each layer will have a debug file\n"
     "                               assosiated with it in order. See Options section\n"
@@ -53,6 +53,8 @@ typedef struct cmdline_opts_t {
   bool version;
   /** \brief Whether to loop input */
   bool loop_input;
+  /** \brief Whether to map input files to memory */
+  bool mmap_input;
 } cmdline_opts_t;
 // ***********************************************
 
@@ -329,6 +329,19 @@ void kvz_cu_array_upsampling_worker(void *opaque_param)
         //TODO: Need to do something for intra? Should not access inter data structures.
 
       }
+
+      //Keep the col depth (mapped to the el size) and skip flag so that the el search can use them to limit the cu search
+      cu->depth = 0;
+      cu->skipped = 0;
+      if (col != NULL) {
+        const int32_t el_size = cu_pos_scale[0] == POS_SCALE_FAC_1X ? (LCU_WIDTH >> col->depth) : ((LCU_WIDTH >> col->depth) << 16) / cu_pos_scale[0];
+        uint8_t depth = 0;
+        while (depth < MAX_DEPTH && (LCU_WIDTH >> depth) > el_size) {
+          depth++;
+        }
+        cu->depth = depth;
+        cu->skipped = cu->type == CU_INTER && col->skipped;
+      }
       
       //Set Partision size to 2Nx2N for all cu in the 16x16 block
       cu->part_size = SIZE_2Nx2N;
@@ -356,6 +369,8 @@ void kvz_cu_array_upsampling_worker(void *opaque_param)
         }
         sub_cu->part_size = SIZE_2Nx2N;
         sub_cu->type = cu->type;
+        sub_cu->depth = cu->depth;
+        sub_cu->skipped = cu->skipped;
       }
     }
   }
@@ -139,6 +139,7 @@ typedef struct {
 
   // Parameters passed from main thread to input thread.
   FILE* input;
+  const yuv_io_map_t *input_map;
   const kvz_api *api;
   const cmdline_opts_t *opts;
   const encoder_control_t *encoder;
@@ -194,7 +195,25 @@ static void* input_read_thread(void* in_args)
     // ***********************************************
   // Modified for SHVC
     enum kvz_chroma_format csp = KVZ_FORMAT2CSP(args->opts->config->input_format);
-    if (args->opts->config->shared != NULL) {
+
+    // Use the frame in the mapped file directly if it needs no conversion.
+    kvz_pixel *mapped_frame = NULL;
+    if (args->input_map->data && args->padding_x == 0 && args->padding_y == 0) {
+      mapped_frame = yuv_io_map_frame(args->input_map,
+                                      args->input,
+                                      args->opts->config->shared != NULL ? args->opts->config->shared->input_widths[args->input_layer] : args->opts->config->width,
+                                      args->opts->config->shared != NULL ? args->opts->config->shared->input_heights[args->input_layer] : args->opts->config->height,
+                                      args->encoder->cfg.input_bitdepth,
+                                      args->encoder->bitdepth,
+                                      csp);
+    }
+
+    if (mapped_frame) {
+      frame_in = args->api->picture_wrap_csp(csp,
+        args->opts->config->shared != NULL ? args->opts->config->shared->input_widths[args->input_layer] : args->opts->config->width,
+        args->opts->config->shared != NULL ? args->opts->config->shared->input_heights[args->input_layer] : args->opts->config->height,
+        mapped_frame);
+    } else if (args->opts->config->shared != NULL) {
       frame_in = args->api->picture_alloc_csp(csp,
         args->opts->config->shared->input_widths[args->input_layer] + args->padding_x,
         args->opts->config->shared->input_heights[args->input_layer] + args->padding_y);
@@ -213,7 +232,8 @@ static void* input_read_thread(void* in_args)
     // Set PTS to make sure we pass it on correctly.
     frame_in->pts = frames_read;
 
-    bool read_success = yuv_io_read(args->input,
+    bool read_success = mapped_frame != NULL ||
+                        yuv_io_read(args->input,
                                     args->opts->config->shared != NULL ? args->opts->config->shared->input_widths[args->input_layer] : args->opts->config->width,
                                     args->opts->config->shared != NULL ? args->opts->config->shared->input_heights[args->input_layer]: args->opts->config->height,
                                     args->encoder->cfg.input_bitdepth,
@@ -353,6 +373,7 @@ int main(int argc, char *argv[])
   cmdline_opts_t *opts = NULL; //!< Command line options
   kvz_encoder* enc = NULL;
   FILE **input  = NULL; //!< input files (YUV)
+  yuv_io_map_t *input_maps = NULL; //!< input files mapped to memory
   FILE *output = NULL; //!< output file (HEVC NAL stream)
   FILE **recout = NULL; //!< reconstructed YUV outputs, --debug
   clock_t start_time = clock();
@@ -434,6 +455,20 @@ int main(int argc, char *argv[])
     }
   }
 
+  input_maps = calloc(opts->num_inputs, sizeof(yuv_io_map_t));
+  if (input_maps == NULL) {
+    fprintf(stderr, "Failed to allocate the input maps, shutting down!\n");
+    goto exit_failure;
+  }
+  if (opts->mmap_input) {
+    for (int8_t i = 0; i < opts->num_inputs; i++) {
+      if (input[i] != stdin && !yuv_io_map(input[i], &input_maps[i])) {
+        fprintf(stderr, "Could not map input file %s, reading it instead.\n",
+                opts->input[i]);
+      }
+    }
+  }
+
   output = open_output_file(opts->output);
   if (output == NULL) {
     fprintf(stderr, "Could not open output file, shutting down!\n");
@@ -553,6 +588,7 @@ int main(int argc, char *argv[])
       in_args[i].filled_input_slots = filled_input_slots[i];
 
       in_args[i].input = input[i];
+      in_args[i].input_map = &input_maps[i];
       in_args[i].api = api;
       in_args[i].opts = opts;
       in_args[i].encoder = encoder; //TODO: Handle different encoders.
@@ -602,24 +638,24 @@ int main(int argc, char *argv[])
         }
       }
 
-      kvz_data_chunk* chunks_out = NULL;
+      const uint8_t *data_out = NULL;
       kvz_picture *img_rec = NULL;
       kvz_picture *img_src = NULL;
       
-      if (!api->encoder_encode(enc,
-                               cur_in_img,
-                               &chunks_out,
-                               len_out,
-                               &img_rec,
-                               &img_src,
-                               info_out)) {
+      if (!api->encoder_encode_buffer(enc,
+                                      cur_in_img,
+                                      &data_out,
+                                      len_out,
+                                      &img_rec,
+                                      &img_src,
+                                      info_out)) {
         fprintf(stderr, "Failed to encode image.\n");
         free_chained_img(api, cur_in_img);
         goto exit_failure;
       }
       // ***********************************************
 
-      if (chunks_out == NULL && cur_in_img == NULL) {
+      if (data_out == NULL && cur_in_img == NULL) {
         // We are done since there is no more input and output left.
         break;
       }
@@ -632,20 +668,12 @@ int main(int argc, char *argv[])
         substream_lengths[i] += len_out[i];
       }
 
-      if (chunks_out != NULL) {
-        uint64_t written = 0;
+      if (data_out != NULL) {
         // Write data into the output file.
-        for (kvz_data_chunk *chunk = chunks_out;
-             chunk != NULL;
-             chunk = chunk->next) {
-          assert(written + chunk->len <= tot_len_out);
-          if (fwrite(chunk->data, sizeof(uint8_t), chunk->len, output) != chunk->len) {
-            fprintf(stderr, "Failed to write data to file.\n");
-            free_chained_img(api, cur_in_img);
-            api->chunk_free(chunks_out);
-            goto exit_failure;
-          }
-          written += chunk->len;
+        if (fwrite(data_out, sizeof(uint8_t), tot_len_out, output) != tot_len_out) {
+          fprintf(stderr, "Failed to write data to file.\n");
+          free_chained_img(api, cur_in_img);
+          goto exit_failure;
         }
         fflush(output);
 
@@ -704,14 +732,13 @@ int main(int argc, char *argv[])
 
           //Write recout only for as many layers as rec outs were given
           if (layer_id < opts->num_debugs) {
-            // Since chunks_out was not NULL, img_rec should have been set.
+            // Since data_out was not NULL, img_rec should have been set.
             assert(cur_rec);
 
             //Check that recon file has been set
             if(!recout[layer_id]) {
               printf("Error: Recout file not set for layer %d.\n",layer_id);
               free_chained_img(api, cur_in_img);
-              api->chunk_free(chunks_out);
               free_chained_img(api, cur_rec);
               free_chained_img(api, img_src);
               goto exit_failure;
@@ -762,7 +789,6 @@ int main(int argc, char *argv[])
       }
 
       free_chained_img(api, cur_in_img); cur_in_img = NULL;
-      api->chunk_free(chunks_out);
       free_chained_img(api, img_rec); //img_rec should contain image not output. Others should be freed by output_recon_pictures.
       img_rec = NULL;  
       free_chained_img(api, img_src); img_src = NULL;
@@ -842,6 +868,13 @@ done:
       if (input[i])  fclose(input[i]);
     }
   }
+  if (opts != NULL && input_maps != NULL) {
+    // Pictures using the mapped data have been freed by encoder_close.
+    for (int8_t i = 0; i < opts->num_inputs; i++) {
+      yuv_io_unmap(&input_maps[i]);
+    }
+  }
+  FREE_POINTER(input_maps);
   if(opts != NULL && recout != NULL){
     for (int8_t i = 0; i < opts->num_debugs; i++) {
       if (recout[i]) fclose(recout[i]);
@@ -198,6 +198,58 @@ static void init_erp_aqp_roi(encoder_control_t* encoder,
 
 // ***********************************************
   // Modified for SHVC.
+/**
+ * \brief Downscale layers from the closest larger layer with the same input.
+ *
+ * Only layers with a greater layer id are used as the source so that
+ * the source is always scaled before the layers using it. Layers that
+ * are the same size as their input can't be used as a source since
+ * that would not reduce the work.
+ *
+ * \param first_enc   encoder control of the base layer
+ */
+static void set_cascaded_downscaling(encoder_control_t *const first_enc)
+{
+  for (encoder_control_t *enc = first_enc; enc != NULL; enc = (encoder_control_t*)enc->next_enc_ctrl) {
+    const encoder_control_t *src_enc = NULL;
+
+    for (const encoder_control_t *cand = enc->next_enc_ctrl; cand != NULL; cand = cand->next_enc_ctrl) {
+      const int32_t cand_width = cand->layer.downscaling.trgt_width;
+      const int32_t cand_height = cand->layer.downscaling.trgt_height;
+
+      if (cand->layer.input_layer != enc->layer.input_layer ||
+          cand_width < enc->in.real_width || cand_height < enc->in.real_height ||
+          (cand_width == enc->in.real_width && cand_height == enc->in.real_height) ||
+          (cand_width == cand->layer.input_width && cand_height == cand->layer.input_height)) {
+        continue;
+      }
+      if (src_enc == NULL || cand_width * cand_height < src_enc->layer.downscaling.trgt_width * src_enc->layer.downscaling.trgt_height) {
+        src_enc = cand;
+      }
+    }
+
+    if (src_enc == NULL) {
+      continue;
+    }
+
+    //The source picture is padded like the input of the source layer
+    scaling_parameter_t downscaling = kvz_newScalingParameters(src_enc->layer.downscaling.trgt_width,
+                                                               src_enc->layer.downscaling.trgt_height,
+                                                               enc->in.real_width,
+                                                               enc->in.real_height,
+                                                               enc->layer.downscaling.chroma, 1);
+    downscaling.src_padding_x = src_enc->layer.downscaling.trgt_padding_x;
+    downscaling.src_padding_y = src_enc->layer.downscaling.trgt_padding_y;
+    downscaling.trgt_padding_x = enc->layer.downscaling.trgt_padding_x;
+    downscaling.trgt_padding_y = enc->layer.downscaling.trgt_padding_y;
+    downscaling.down_filter = enc->layer.downscaling.down_filter;
+
+    kvz_freeScalingParameters(&enc->layer.downscaling);
+    enc->layer.downscaling = downscaling;
+    enc->layer.scaling_src_layer = src_enc->layer.layer_id;
+  }
+}
+
 /**
  * \brief Allocate and initialize an encoder control structure.
  *
@@ -218,6 +270,8 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *cfg)
     fprintf(stderr, "Config object must not be null!\n");
     goto init_failed;
   }
+
+  const uint8_t cascade_scaling = cfg->shared != NULL && cfg->shared->cascade_scaling;
   
   for (; cfg != NULL; cfg = cfg->next_cfg ) {
 
@@ -264,6 +318,8 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *cfg)
       encoder->cfg.wpp = cfg->shared->wpp;
       encoder->cfg.threads = cfg->shared->threads;
       encoder->cfg.owf = cfg->shared->owf;
+      encoder->cfg.lookahead = cfg->shared->lookahead;
+      encoder->cfg.scene_cut = cfg->shared->scene_cut;
       encoder->cfg.intra_period = cfg->shared->intra_period;
       encoder->cfg.multiview = cfg->shared->multiview;
 
@@ -368,6 +424,13 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *cfg)
       goto init_failed;
     }
 
+    //The threadqueue of the last layer ends up being shared by all layers, so only trace that one.
+    if (cfg->next_cfg == NULL && cfg->shared != NULL && cfg->shared->threadqueue_log != NULL) {
+      if (!kvz_threadqueue_trace_start(encoder->threadqueue, cfg->shared->threadqueue_log)) {
+        goto init_failed;
+      }
+    }
+
     //Propagate to prev enc. TODO: handle more complex ref structure
     if( prev_enc != NULL ){
       kvz_threadqueue_free(prev_enc->threadqueue);
@@ -423,6 +486,22 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *cfg)
     
     kvz_encoder_control_input_init(encoder, encoder->cfg.width, encoder->cfg.height);
 
+    // Each pyramid level halves the previous one. Only luma is used.
+    for (int level = 0; level < encoder->cfg.me_pyramid; ++level) {
+      encoder->me.pyramid_scaling[level] = kvz_newScalingParameters(encoder->in.width >> level,
+                                                                    encoder->in.height >> level,
+                                                                    encoder->in.width >> (level + 1),
+                                                                    encoder->in.height >> (level + 1),
+                                                                    CHROMA_400, 1);
+    }
+    if (encoder->cfg.lookahead > 0) {
+      encoder->lookahead_scaling = kvz_newScalingParameters(encoder->in.width,
+                                                            encoder->in.height,
+                                                            encoder->in.width >> 1,
+                                                            encoder->in.height >> 1,
+                                                            CHROMA_400, 1);
+    }
+
     if (encoder->cfg.framerate_num != 0) {
       double framerate = encoder->cfg.framerate_num / (double)encoder->cfg.framerate_denom;
       encoder->target_avg_bppic = encoder->cfg.target_bitrate / framerate;
@@ -451,7 +530,8 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *cfg)
              roi_size * sizeof(*cfg->roi.dqps));
     }
 
-  if (encoder->cfg.target_bitrate > 0 || encoder->cfg.roi.dqps || encoder->cfg.set_qp_in_cu) {
+  if (encoder->cfg.target_bitrate > 0 || encoder->cfg.roi.dqps || encoder->cfg.set_qp_in_cu ||
+      encoder->cfg.lookahead_aq) {
     encoder->max_qp_delta_depth = 0;
   } else {
     encoder->max_qp_delta_depth = -1;
@@ -768,6 +848,8 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *cfg)
                                                       csp, 1);
     encoder->layer.downscaling.trgt_padding_x = (CU_MIN_SIZE_PIXELS - encoder->layer.downscaling.trgt_width % CU_MIN_SIZE_PIXELS) % CU_MIN_SIZE_PIXELS;
     encoder->layer.downscaling.trgt_padding_y = (CU_MIN_SIZE_PIXELS - encoder->layer.downscaling.trgt_height % CU_MIN_SIZE_PIXELS) % CU_MIN_SIZE_PIXELS;
+    encoder->layer.downscaling.down_filter = encoder->cfg.downscaling_filter;
+    encoder->layer.scaling_src_layer = -1;
 
     if( prev_enc != NULL ){
       encoder->layer.upscaling = kvz_newScalingParameters(prev_enc->layer.upscaling.trgt_width,
@@ -800,6 +882,13 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *cfg)
     }
   }
 
+  // ***********************************************
+  // Modified for SHVC.
+  if (cascade_scaling) {
+    set_cascaded_downscaling(first_enc);
+  }
+  // ***********************************************
+
   return first_enc;
 
 init_failed:
@@ -841,6 +930,14 @@ void kvz_encoder_control_free(encoder_control_t *const encoder)
 
   kvz_scalinglist_destroy(&encoder->scaling_list);
 
+  // Modified for SHVC.
+  kvz_freeScalingParameters(&encoder->layer.upscaling);
+  kvz_freeScalingParameters(&encoder->layer.downscaling);
+  for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+    kvz_freeScalingParameters(&encoder->me.pyramid_scaling[level]);
+  }
+  kvz_freeScalingParameters(&encoder->lookahead_scaling);
+
   kvz_threadqueue_free(encoder->threadqueue);
   encoder->threadqueue = NULL;
 
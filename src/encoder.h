@@ -77,8 +77,13 @@ typedef struct encoder_control_t
     void(*IME)();
     void(*FME)();
     int range;
+    //! Scaling from the previous pyramid level, or the source, to each level.
+    scaling_parameter_t pyramid_scaling[ME_PYRAMID_MAX_LEVELS];
   } me;
 
+  //! Scaling from the source to the half resolution lookahead pictures.
+  scaling_parameter_t lookahead_scaling;
+
   int8_t bitdepth;
   enum kvz_chroma_format chroma_format;
 
@@ -166,6 +171,7 @@ typedef struct encoder_control_t
 
     scaling_parameter_t upscaling; //Reference to the upscaling parameters defined in the encoder. TODO: Find a better way?
     scaling_parameter_t downscaling; 
+    int8_t scaling_src_layer; //Layer whose scaled input is downscaled for this layer or -1 if the input is used
 
     //Copied from cfg. TODO: Move somewhere else?
     //Width and height of the input image. TODO: move to .in etc?
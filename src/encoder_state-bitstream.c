@@ -534,7 +534,7 @@ static void encoder_state_write_bitstream_vid_parameter_set(bitstream_t* stream,
   //TODO: a better way?
   if (state->encoder_control->layer.max_layers > 1){
     //while (stream->cur_bit != 0) {
-    if (stream->cur_bit != 0){
+    if ((stream->cur_bit & 7) != 0){
       //kvz_bitstream_align(stream);
       // while(!aligned) "vbs_extension_alignment_bit_equal_to_one"
       //WRITE_U(stream, 1, 1, "vps_extension_alignment_bit_equal_to_one");
@@ -1971,7 +1971,6 @@ void kvz_encoder_state_write_bitstream_slice_header(
 static void add_checksum(encoder_state_t * const state)
 {
   bitstream_t * const stream = &state->stream;
-  const videoframe_t * const frame = state->tile->frame;
   unsigned char checksum[3][SEI_HASH_MAX_LENGTH];
 
   // ***********************************************
@@ -1983,11 +1982,12 @@ static void add_checksum(encoder_state_t * const state)
 
   int num_colors = (state->encoder_control->chroma_format == KVZ_CSP_400 ? 1 : 3);
 
+  // The rows were hashed while encoding the LCUs.
+  kvz_picture_hash_digest(state->frame->hash, checksum);
+
   switch (state->encoder_control->cfg.hash)
   {
   case KVZ_HASH_CHECKSUM:
-    kvz_image_checksum(frame->rec, checksum, state->encoder_control->bitdepth);
-
     WRITE_U(stream, 1 + num_colors * 4, 8, "size");
     WRITE_U(stream, 2, 8, "hash_type");  // 2 = checksum
 
@@ -2001,9 +2001,17 @@ static void add_checksum(encoder_state_t * const state)
 
     break;
 
-  case KVZ_HASH_MD5:
-    kvz_image_md5(frame->rec, checksum, state->encoder_control->bitdepth);
+  case KVZ_HASH_CRC:
+    WRITE_U(stream, 1 + num_colors * 2, 8, "size");
+    WRITE_U(stream, 1, 8, "hash_type");  // 1 = crc
 
+    for (int i = 0; i < num_colors; ++i) {
+      WRITE_U(stream, (checksum[i][0] << 8) + checksum[i][1], 16, "picture_crc");
+    }
+
+    break;
+
+  case KVZ_HASH_MD5:
     WRITE_U(stream, 1 + num_colors * 16, 8, "size");
     WRITE_U(stream, 0, 8, "hash_type");  // 0 = md5
 
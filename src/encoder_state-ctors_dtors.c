@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "bitstream.h"
 #include "cabac.h"
@@ -32,6 +33,7 @@
 #include "image.h"
 #include "imagelist.h"
 #include "kvazaar.h"
+#include "picture_hash.h"
 #include "threadqueue.h"
 #include "videoframe.h"
 
@@ -45,17 +47,45 @@ static int encoder_state_config_frame_init(encoder_state_t * const state) {
   state->frame->ref_list = REF_PIC_LIST_0;
   state->frame->num = 0;
   state->frame->poc = 0;
+  state->frame->seq_start_num = 0;
   state->frame->total_bits_coded = 0;
   state->frame->cur_gop_bits_coded = 0;
   state->frame->prepared = 0;
   state->frame->done = 1;
   state->frame->rc_alpha = 3.2003;
   state->frame->rc_beta = -1.367;
+  state->frame->rc_complexity = 0.0;
+  state->frame->rc_bpp_scale = 1.0;
+  state->frame->tqj_source_scaling = NULL;
+  for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+    state->frame->me_pyramid[level] = NULL;
+    state->frame->tqj_me_pyramid[level] = NULL;
+    FILL(state->frame->me_pyramid_scaler[level], 0);
+  }
 
   const encoder_control_t * const encoder = state->encoder_control;
   const int num_lcus = encoder->in.width_in_lcu * encoder->in.height_in_lcu;
   state->frame->lcu_stats = MALLOC(lcu_stats_t, num_lcus);
 
+  FILL(state->frame->lookahead, 0);
+  if (encoder->cfg.lookahead > 0) {
+    state->frame->lookahead.lcu_costs = MALLOC(uint32_t, num_lcus);
+    state->frame->lookahead.lcu_intra_costs = MALLOC(uint32_t, num_lcus);
+    if (!state->frame->lookahead.lcu_costs || !state->frame->lookahead.lcu_intra_costs) {
+      fprintf(stderr, "Failed to allocate the lookahead stats!\n");
+      return 0;
+    }
+  }
+
+  state->frame->hash = NULL;
+  if (encoder->cfg.hash != KVZ_HASH_NONE) {
+    state->frame->hash = kvz_picture_hash_alloc(encoder->in.width, encoder->in.height);
+    if (!state->frame->hash) {
+      fprintf(stderr, "Failed to allocate the picture hash!\n");
+      return 0;
+    }
+  }
+
   return 1;
 }
 
@@ -64,6 +94,17 @@ static void encoder_state_config_frame_finalize(encoder_state_t * const state) {
 
   kvz_image_list_destroy(state->frame->ref);
   FREE_POINTER(state->frame->lcu_stats);
+  FREE_POINTER(state->frame->lookahead.lcu_costs);
+  FREE_POINTER(state->frame->lookahead.lcu_intra_costs);
+  kvz_picture_hash_free(state->frame->hash);
+  state->frame->hash = NULL;
+  kvz_image_scaling_jobs_free(&state->frame->tqj_source_scaling);
+  for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+    kvz_image_free(state->frame->me_pyramid[level]);
+    state->frame->me_pyramid[level] = NULL;
+    kvz_image_scaling_jobs_free(&state->frame->tqj_me_pyramid[level]);
+    kvz_image_row_scaler_free(&state->frame->me_pyramid_scaler[level]);
+  }
 }
 
 static int encoder_state_config_tile_init(encoder_state_t * const state, 
@@ -192,6 +233,7 @@ static int encoder_state_config_layer_init(const encoder_state_t * const state,
     state->layer->image_hor_scaling_jobs = MALLOC(threadqueue_job_t*, num_jobs_hor);
     state->layer->image_ver_scaling_jobs = MALLOC(threadqueue_job_t*, num_jobs_ver);
     state->layer->cua_scaling_jobs = MALLOC(threadqueue_job_t*, num_jobs_ver);
+    state->layer->ilr_block_buffers = MALLOC(opaque_yuv_buffer_t*, num_jobs_ver);
     if( state->layer->image_ver_scaling_jobs == NULL || state->layer->image_hor_scaling_jobs == NULL){
       printf("Error allocating image_scaling_jobs array!\n");
       return 0;
@@ -200,12 +242,17 @@ static int encoder_state_config_layer_init(const encoder_state_t * const state,
       printf("Error allocating cua_scaling_jobs array!\n");
       return 0;
     }
+    if( state->layer->ilr_block_buffers == NULL){
+      printf("Error allocating ilr_block_buffers array!\n");
+      return 0;
+    }
     for (int i = 0; i < num_jobs_hor; i++) {
       state->layer->image_hor_scaling_jobs[i] = NULL;
     }
     for(int i = 0; i < num_jobs_ver; i++){
       state->layer->image_ver_scaling_jobs[i] = NULL;
       state->layer->cua_scaling_jobs[i] = NULL;
+      state->layer->ilr_block_buffers[i] = NULL;
     }
 
     /*state->layer->img_job_param.src_buffer = kvz_newYuvBuffer(ctrl->layer.upscaling.src_width + ctrl->layer.upscaling.src_padding_x, ctrl->layer.upscaling.src_height + ctrl->layer.upscaling.src_padding_y, ctrl->chroma_format, 0);
@@ -216,6 +263,7 @@ static int encoder_state_config_layer_init(const encoder_state_t * const state,
     state->layer->image_ver_scaling_jobs = NULL;
     state->layer->image_hor_scaling_jobs = NULL;
     state->layer->cua_scaling_jobs = NULL;
+    state->layer->ilr_block_buffers = NULL;
   }
 
   //Allocate buffers for holding the intermediate results of scaling etc.
@@ -252,6 +300,7 @@ static int encoder_state_config_layer_init(const encoder_state_t * const state,
   state->layer->img_job_param.block_width = 0;
   state->layer->img_job_param.block_x = 0;
   state->layer->img_job_param.block_y = 0;
+  memset(&state->layer->ilr_pool, 0, sizeof(kvz_image_pool_t));
 
   state->layer->cua_job_param.out_cua = NULL;
   state->layer->cua_job_param.base_cua = NULL;
@@ -294,6 +343,7 @@ static int encoder_state_config_layer_finalize(encoder_state_t * const state)
     for (int i = 0; i < num_jobs_ver; ++i) {
       kvz_threadqueue_free_job(&state->layer->image_ver_scaling_jobs[i]);
       kvz_threadqueue_free_job(&state->layer->cua_scaling_jobs[i]);
+      kvz_deallocateOpaqueYuvBuffer(state->layer->ilr_block_buffers[i], 1);
     }  
   }
 
@@ -304,9 +354,11 @@ static int encoder_state_config_layer_finalize(encoder_state_t * const state)
   FREE_POINTER(state->layer->image_ver_scaling_jobs);
   FREE_POINTER(state->layer->image_hor_scaling_jobs);
   FREE_POINTER(state->layer->cua_scaling_jobs);
+  FREE_POINTER(state->layer->ilr_block_buffers);
 
   kvz_image_free(state->layer->img_job_param.pic_in);
   kvz_image_free(state->layer->img_job_param.pic_out);
+  kvz_image_pool_free(&state->layer->ilr_pool);
 
   kvz_cu_array_free(&state->layer->cua_job_param.base_cua);
   kvz_cu_array_free(&state->layer->cua_job_param.out_cua);
@@ -34,6 +34,7 @@
 #include "rate_control.h"
 #include "sao.h"
 #include "search.h"
+#include "subpel_planes.h"
 #include "tables.h"
 #include "threadqueue.h"
 
@@ -1119,6 +1120,7 @@ static void start_block_step_scaling_job(encoder_state_t * const state, const lc
     //First create job for vertical scaling
     kvz_threadqueue_free_job(&state->layer->image_ver_scaling_jobs[lcu->id]);
     state->layer->image_ver_scaling_jobs[lcu->id] = kvz_threadqueue_job_create(kvz_opaque_block_step_scaler_worker, (void*)param_ver);
+    kvz_threadqueue_job_set_priority(state->layer->image_ver_scaling_jobs[lcu->id], THREADQUEUE_JOB_PRIORITY_HIGH);
 
     //Add dependencies
     //  Create horizontal scaling jobs that the ver job depends on
@@ -1181,6 +1183,7 @@ static void start_block_step_scaling_job(encoder_state_t * const state, const lc
 
         kvz_threadqueue_free_job(&state->layer->image_hor_scaling_jobs[hor_ind]);
         state->layer->image_hor_scaling_jobs[hor_ind] = kvz_threadqueue_job_create(kvz_opaque_block_step_scaler_worker, (void*)param_hor);
+        kvz_threadqueue_job_set_priority(state->layer->image_hor_scaling_jobs[hor_ind], THREADQUEUE_JOB_PRIORITY_HIGH);
 
         //Add dependency to ILR jobs
         //Calculate vertical range of block scaling
@@ -1254,6 +1257,25 @@ static void start_block_step_scaling_job(encoder_state_t * const state, const lc
       tmp_lcu = tmp_lcu->below;
     }
 
+    //Do the hor step into a buffer owned by this job instead of the shared ver_tmp_buffer. The rows above and below the block needed by the ver step get recalculated by each job.
+    //The buffer is reused with the next frame, when the previous job on this lcu has already finished.
+    {
+      int ver_range[2];
+      kvz_blockScalingSrcHeightRange(ver_range, state_param->param, param->block_y, param->block_height);
+      
+      //Make sure sizes are divisible by 2 for chromas sake.
+      int buf_width = param->block_width + param->block_width % 2;
+      int buf_height = ver_range[1] - ver_range[0] + 1;
+      buf_height += buf_height % 2;
+
+      opaque_yuv_buffer_t **block_buffer = &state->layer->ilr_block_buffers[lcu->id];
+      if (*block_buffer == NULL || (*block_buffer)->y->width < buf_width || (*block_buffer)->y->height < buf_height) {
+        kvz_deallocateOpaqueYuvBuffer(*block_buffer, 1);
+        *block_buffer = kvz_newOpaqueYuvBuffer(NULL, NULL, NULL, buf_width, buf_height, buf_width, state_param->param->chroma, sizeof(int16_t));
+      }
+      param->ver_tmp_buffer = *block_buffer;
+    }
+
     //Create scaling job (async) else just run resampling
     if (is_async)
     {
@@ -1287,6 +1309,12 @@ static void start_block_step_scaling_job(encoder_state_t * const state, const lc
       //First create the job
       kvz_threadqueue_free_job(&state->layer->image_ver_scaling_jobs[lcu->id]);
       state->layer->image_ver_scaling_jobs[lcu->id] = kvz_threadqueue_job_create(kvz_opaque_block_step_scaler_worker, (void*)param);
+      //EL lcus wait on the scaled ILR block, so schedule it before other work
+      kvz_threadqueue_job_set_priority(state->layer->image_ver_scaling_jobs[lcu->id], THREADQUEUE_JOB_PRIORITY_HIGH);
+      kvz_threadqueue_job_describe(state->encoder_control->threadqueue, state->layer->image_ver_scaling_jobs[lcu->id],
+                                   "type=ilr_scaling,layer=%d,frame=%d,position_x=%d,position_y=%d",
+                                   state->encoder_control->layer.layer_id, state->frame->num,
+                                   lcu->position.x + state->tile->lcu_offset_x, lcu->position.y + state->tile->lcu_offset_y);
 
 
       //Calculate horizontal range
@@ -1319,25 +1347,7 @@ static void start_block_step_scaling_job(encoder_state_t * const state, const lc
       kvz_threadqueue_job_dep_add(state->layer->image_ver_scaling_jobs[lcu->id], ilr_state->tile->wf_jobs[ilr_state->lcu_order[k].id]);
       //} 
 
-
-    //Add dependency to left and above lcu so that copying to src_buffer is not an issue
-      tmp_lcu = lcu->left;
-      for (unsigned i = 1; i < job_width && tmp_lcu != NULL; i++)
-      {
-        tmp_lcu = tmp_lcu->left;
-      }
-      if (tmp_lcu != NULL) {
-        kvz_threadqueue_job_dep_add(state->layer->image_ver_scaling_jobs[lcu->id], state->layer->image_ver_scaling_jobs[tmp_lcu->id]);
-      }
-
-      tmp_lcu = lcu->above;
-      for (unsigned i = 1; i < job_height && tmp_lcu != NULL; i++)
-      {
-        tmp_lcu = tmp_lcu->above;
-      }
-      if (tmp_lcu != NULL) {
-        kvz_threadqueue_job_dep_add(state->layer->image_ver_scaling_jobs[lcu->id], state->layer->image_ver_scaling_jobs[tmp_lcu->id]);
-      }
+      //No dependency to the left and above scaling jobs is needed since each job does its hor step into its own buffer
 
       //Dependencies added so submit the ver job
       kvz_threadqueue_submit(state->encoder_control->threadqueue, state->layer->image_ver_scaling_jobs[lcu->id]);
@@ -1368,6 +1378,11 @@ static void start_block_step_scaling_job(encoder_state_t * const state, const lc
     {
       kvz_threadqueue_free_job(&state->tqj_ilr_rec_scaling_done); //Should have been set to NULL anyway
       state->tqj_ilr_rec_scaling_done = kvz_threadqueue_job_create(kvz_opaque_block_step_scaler_worker, (void*)param);
+      kvz_threadqueue_job_set_priority(state->tqj_ilr_rec_scaling_done, THREADQUEUE_JOB_PRIORITY_HIGH);
+      kvz_threadqueue_job_describe(state->encoder_control->threadqueue, state->tqj_ilr_rec_scaling_done,
+                                   "type=ilr_tile_scaling,layer=%d,frame=%d,position_x=%d,position_y=%d",
+                                   state->encoder_control->layer.layer_id, state->frame->num,
+                                   state->tile->lcu_offset_x, state->tile->lcu_offset_y);
     
       //Need to add dependency to all ilr tiles that that are within the src range
       int range[4];
@@ -1443,7 +1458,7 @@ static kvz_picture* prepare_deferred_block_step_scaling(kvz_picture* const pic_i
   state->layer->img_job_param.pic_in = kvz_image_copy_ref(pic_in);
 
   kvz_image_free(state->layer->img_job_param.pic_out); //Free prev pic
-  state->layer->img_job_param.pic_out = kvz_image_alloc(pic_in->chroma_format,
+  state->layer->img_job_param.pic_out = kvz_image_pool_get(&state->layer->ilr_pool, pic_in->chroma_format,
     param->trgt_width + param->trgt_padding_x,
     param->trgt_height + param->trgt_padding_y);
   kvz_picture *tmp = state->layer->img_job_param.pic_out;
@@ -1524,6 +1539,11 @@ static void start_cua_lcu_scaling_job(encoder_state_t * const state, const lcu_o
     if (is_async) {
       kvz_threadqueue_free_job(&state->tqj_ilr_cua_upsampling_done);
       state->tqj_ilr_cua_upsampling_done = kvz_threadqueue_job_create(tile_cu_array_upsampling_worker, (void*)state_param);
+      kvz_threadqueue_job_set_priority(state->tqj_ilr_cua_upsampling_done, THREADQUEUE_JOB_PRIORITY_HIGH);
+      kvz_threadqueue_job_describe(state->encoder_control->threadqueue, state->tqj_ilr_cua_upsampling_done,
+                                   "type=ilr_tile_cua_upsampling,layer=%d,frame=%d,position_x=%d,position_y=%d",
+                                   state->encoder_control->layer.layer_id, state->frame->num,
+                                   state->tile->lcu_offset_x, state->tile->lcu_offset_y);
 
       //Calculate (vertical/horizontal) range of scaling
       int range[4]; //Range of blocks needed for scaling
@@ -1621,6 +1641,12 @@ static void start_cua_lcu_scaling_job(encoder_state_t * const state, const lcu_o
         {
           kvz_threadqueue_free_job(&state->layer->cua_scaling_jobs[hor_lcu->id]);
           state->layer->cua_scaling_jobs[hor_lcu->id] = kvz_threadqueue_job_create(kvz_cu_array_upsampling_worker, (void*)param);
+          //Same as with the pixel scaling, EL lcus wait on this
+          kvz_threadqueue_job_set_priority(state->layer->cua_scaling_jobs[hor_lcu->id], THREADQUEUE_JOB_PRIORITY_HIGH);
+          kvz_threadqueue_job_describe(state->encoder_control->threadqueue, state->layer->cua_scaling_jobs[hor_lcu->id],
+                                       "type=ilr_cua_upsampling,layer=%d,frame=%d,position_x=%d,position_y=%d",
+                                       state->encoder_control->layer.layer_id, state->frame->num,
+                                       i + tile_x, j + tile_y);
 
           //Calculate (vertical/horizontal) range of scaling
           int range[4]; //Range of blocks needed for scaling
@@ -1870,8 +1896,69 @@ static void ilr_processing(encoder_state_t *state, const int is_async, const int
   }
 }
 
+/**
+*  Add dependencies to the jobs scaling the source picture.
+*
+* - If lcu is given, job depends on the scaled LCU row of lcu
+* - Otherwise job depends on the scaled LCU rows of the tile. If job is NULL, wait for the rows instead
+*/
+static void source_scaling_processing(encoder_state_t * const state, const lcu_order_element_t * const lcu, threadqueue_job_t * const job)
+{
+  threadqueue_job_t ** const scaling_jobs = state->frame->tqj_source_scaling;
+  if (scaling_jobs == NULL) {
+    return;
+  }
+
+  if (lcu != NULL) {
+    kvz_threadqueue_job_dep_add(job, scaling_jobs[state->tile->lcu_offset_y + lcu->position.y]);
+    return;
+  }
+
+  for (int y = 0; y < state->tile->frame->height_in_lcu; y++) {
+    threadqueue_job_t * const row_job = scaling_jobs[state->tile->lcu_offset_y + y];
+    if (job != NULL) {
+      kvz_threadqueue_job_dep_add(job, row_job);
+    } else {
+      kvz_threadqueue_waitfor(state->encoder_control->threadqueue, row_job);
+    }
+  }
+}
+
 // ***********************************************
 
+/**
+*  Add dependencies to the jobs scaling the motion estimation pyramid.
+*
+* Works like source_scaling_processing for the rows of each level covering
+* the LCU row or the tile.
+*/
+static void me_pyramid_processing(encoder_state_t * const state, const lcu_order_element_t * const lcu, threadqueue_job_t * const job)
+{
+  for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+    threadqueue_job_t ** const scaling_jobs = state->frame->tqj_me_pyramid[level];
+    if (scaling_jobs == NULL) {
+      continue;
+    }
+
+    // Rows of each level are LCU_WIDTH high, so each covers 2 << level LCU rows.
+    const int shift = level + 1;
+    if (lcu != NULL) {
+      kvz_threadqueue_job_dep_add(job, scaling_jobs[(state->tile->lcu_offset_y + lcu->position.y) >> shift]);
+      continue;
+    }
+
+    const int first_row = state->tile->lcu_offset_y >> shift;
+    const int last_row = (state->tile->lcu_offset_y + state->tile->frame->height_in_lcu - 1) >> shift;
+    for (int y = first_row; y <= last_row; y++) {
+      if (job != NULL) {
+        kvz_threadqueue_job_dep_add(job, scaling_jobs[y]);
+      } else {
+        kvz_threadqueue_waitfor(state->encoder_control->threadqueue, scaling_jobs[y]);
+      }
+    }
+  }
+}
+
 /**
  * \brief Save edge pixels before SAO to buffers.
  *
@@ -2456,8 +2543,14 @@ static void encoder_state_worker_encode_lcu(void * opaque)
   lcu_coeff_t coeff;
   state->coeff = &coeff;
 
+  // Coarse motion search results are only valid within the LCU.
+  me_pyramid_mvs_t pyramid_mvs;
+  FILL(pyramid_mvs.searched, 0);
+  state->me_pyramid_mvs = &pyramid_mvs;
+
   //This part doesn't write to bitstream, it's only search, deblock and sao
   kvz_search_lcu(state, lcu->position_px.x, lcu->position_px.y, state->tile->hor_buf_search, state->tile->ver_buf_search);
+  state->me_pyramid_mvs = NULL;
 
   encoder_state_recdata_to_bufs(state, lcu, state->tile->hor_buf_search, state->tile->ver_buf_search);
 
@@ -2482,6 +2575,11 @@ static void encoder_state_worker_encode_lcu(void * opaque)
     encoder_sao_reconstruct(state, lcu);
   }
 
+  if (state->frame->hash) {
+    kvz_picture_hash_lcu_done(state->frame->hash,
+                              lcu->position.y + state->tile->lcu_offset_y);
+  }
+
   //Now write data to bitstream (required to have a correct CABAC state)
   const uint64_t existing_bits = kvz_bitstream_tell(&state->stream);
 
@@ -2577,7 +2675,9 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
     //*********************************************
     //For scalable extension.
     ilr_processing(state, 0, 0, NULL, NULL);
+    source_scaling_processing(state, NULL, NULL);
     //*********************************************
+    me_pyramid_processing(state, NULL, NULL);
 
     // Encode every LCU in order and perform SAO reconstruction after every
     // frame is encoded. Deblocking and SAO search is done during LCU encoding.
@@ -2624,6 +2724,16 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
 
       // If job object was returned, add dependancies and allow it to run.
       if (job[0]) {
+        // The first LCU of a row gates the whole row, so run it first.
+        if (!lcu->left) {
+          kvz_threadqueue_job_set_priority(job[0], THREADQUEUE_JOB_PRIORITY_HIGH);
+        }
+        kvz_threadqueue_job_describe(ctrl->threadqueue, job[0],
+                                     "type=lcu,layer=%d,frame=%d,position_x=%d,position_y=%d",
+                                     ctrl->layer.layer_id, state->frame->num,
+                                     lcu->position.x + state->tile->lcu_offset_x,
+                                     lcu->position.y + state->tile->lcu_offset_y);
+
         // Add inter frame dependancies when ecoding more than one frame at
         // once. The added dependancy is for the first LCU of each wavefront
         // row to depend on the reconstruction status of the row below in the
@@ -2650,7 +2760,7 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
              state->encoder_control->cfg.gop_len != 0 &&
              state->encoder_control->cfg.owf > state->encoder_control->cfg.gop_len &&
              ref_state->frame->slicetype == KVZ_SLICE_I &&
-             ref_state->frame->num != 0){
+             ref_state->frame->num != ref_state->frame->seq_start_num){
 
             while (ref_state->frame->poc != state->frame->poc - state->encoder_control->cfg.gop_len){
               ref_state = ref_state->previous_encoder_state;
@@ -2676,6 +2786,8 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
         //For scalable extension.
         
         ilr_processing(state, 1, 1, lcu, job);
+        source_scaling_processing(state, lcu, job[0]);
+        me_pyramid_processing(state, lcu, job[0]);
         
         ////should be enough to add it to the first only?
         //if (i == 0) {
@@ -2829,6 +2941,11 @@ static void encoder_state_encode(encoder_state_t * const main_state) {
           kvz_threadqueue_free_job(&main_state->children[i].tqj_recon_done);
           main_state->children[i].tqj_recon_done =
             kvz_threadqueue_job_create(encoder_state_worker_encode_children, &main_state->children[i]);
+          kvz_threadqueue_job_describe(main_state->encoder_control->threadqueue, main_state->children[i].tqj_recon_done,
+                                       "type=state_%c,layer=%d,frame=%d,position_x=%d,position_y=%d",
+                                       (char)main_state->children[i].type,
+                                       main_state->encoder_control->layer.layer_id, main_state->frame->num,
+                                       main_state->children[i].tile->lcu_offset_x, main_state->children[i].tile->lcu_offset_y);
           if (main_state->children[i].previous_encoder_state != &main_state->children[i] &&
               main_state->children[i].previous_encoder_state->tqj_recon_done &&
               !main_state->children[i].frame->is_irap)
@@ -2852,7 +2969,9 @@ static void encoder_state_encode(encoder_state_t * const main_state) {
           //*********************************************
           //For scalable extension.
           ilr_processing(&main_state->children[i], 1, 0, NULL, NULL);
+          source_scaling_processing(&main_state->children[i], NULL, main_state->children[i].tqj_recon_done);
           //*********************************************
+          me_pyramid_processing(&main_state->children[i], NULL, main_state->children[i].tqj_recon_done);
 
           kvz_threadqueue_submit(main_state->encoder_control->threadqueue, main_state->children[i].tqj_recon_done);
         } else {
@@ -3118,6 +3237,24 @@ static void normalize_lcu_weights(encoder_state_t * const state)
   }
 }
 
+/**
+ * \brief Set the LCU weights from the lookahead costs of the current frame.
+ */
+static void lookahead_lcu_weights(encoder_state_t * const state)
+{
+  const uint32_t num_lcus = state->encoder_control->in.width_in_lcu *
+                            state->encoder_control->in.height_in_lcu;
+  const uint32_t *const costs = state->frame->lookahead.lcu_costs;
+  double sum = 0.0;
+  for (uint32_t i = 0; i < num_lcus; i++) {
+    sum += costs[i] + 1;
+  }
+
+  for (uint32_t i = 0; i < num_lcus; i++) {
+    state->frame->lcu_stats[i].weight = (costs[i] + 1) / sum;
+  }
+}
+
 static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_picture* frame) {
   assert(state->type == ENCODER_STATE_TYPE_MAIN);
 
@@ -3136,12 +3273,16 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_pict
   // setting it based on the intra period
   bool is_closed_normal_gop = false;
 
+  // Frames are numbered from the start of the sequence, which is restarted
+  // at scene cuts.
+  const int32_t num = state->frame->num - state->frame->seq_start_num;
+
   // Set POC.
-  if (state->frame->num == 0) {
+  if (num == 0) {
     state->frame->poc = 0;
   } else if (cfg->gop_len && !cfg->gop_lowdelay) {
 
-    int32_t framenum = state->frame->num - 1;
+    int32_t framenum = num - 1;
     // Handle closed GOP
     // Closed GOP structure has an extra IDR between the GOPs
     if (cfg->intra_period > 0 && !cfg->open_gop) {
@@ -3165,13 +3306,13 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_pict
     
     kvz_videoframe_set_poc(state->tile->frame, state->frame->poc);
   } else if (cfg->intra_period > 0) {
-    state->frame->poc = state->frame->num % cfg->intra_period;
+    state->frame->poc = num % cfg->intra_period;
   } else {
-    state->frame->poc = state->frame->num;
+    state->frame->poc = num;
   }
 
   // Check whether the frame is a keyframe or not.
-  if (state->frame->num == 0 || state->frame->poc == 0) {
+  if (num == 0 || state->frame->poc == 0) {
     state->frame->is_irap = true;
   } else if(!is_closed_normal_gop) { // In closed-GOP IDR frames are poc==0 so skip this check
     state->frame->is_irap =
@@ -3185,7 +3326,7 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_pict
 
   // Set pictype.
   if (state->frame->is_irap) {
-    if (state->frame->num == 0 ||
+    if (num == 0 ||
         cfg->intra_period == 1 ||
         cfg->gop_len == 0 ||
         cfg->gop_lowdelay ||
@@ -3218,7 +3359,9 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_pict
   
   //*********************************************
 
-  if (cfg->target_bitrate > 0 && state->frame->num > cfg->owf) {
+  if (cfg->target_bitrate > 0 && state->frame->lookahead.valid) {
+    lookahead_lcu_weights(state);
+  } else if (cfg->target_bitrate > 0 && state->frame->num > cfg->owf) {
     normalize_lcu_weights(state);
   }
   kvz_set_picture_lambda_and_qp(state);
@@ -3251,12 +3394,103 @@ void kvz_init_one_frame(encoder_state_t * const state, kvz_picture *frame)
   // ***********************************************
 }
 
+/**
+ * \brief Start scaling the source picture to the motion estimation pyramid.
+ *
+ * Levels are scaled in LCU rows after the source rows they use, so the
+ * scaling overlaps with encoding. The levels are also attached to the
+ * reconstructed picture for when it is used as a reference.
+ */
+static void encoder_state_start_me_pyramid(encoder_state_t * const state)
+{
+  const encoder_control_t * const ctrl = state->encoder_control;
+  kvz_picture *src = state->tile->frame->source;
+  threadqueue_job_t **src_jobs = state->frame->tqj_source_scaling;
+  kvz_picture *const rec = state->tile->frame->rec;
+
+  for (int level = 0; level < ctrl->cfg.me_pyramid; ++level) {
+    assert(!state->frame->me_pyramid[level]);
+    kvz_picture *const pic = kvz_image_deferred_row_scaling(src, src_jobs,
+                                                            &state->frame->me_pyramid_scaler[level],
+                                                            &ctrl->me.pyramid_scaling[level], 0,
+                                                            ctrl->threadqueue, LCU_WIDTH,
+                                                            &state->frame->tqj_me_pyramid[level]);
+    if (pic == NULL) {
+      // Motion estimation is done without the missing levels.
+      fprintf(stderr, "Failed to allocate the motion estimation pyramid.\n");
+      return;
+    }
+    state->frame->me_pyramid[level] = pic;
+
+    // A lossless rec is the source picture, which may have been used before.
+    kvz_image_free(rec->me_pyramid[level]);
+    rec->me_pyramid[level] = kvz_image_copy_ref(pic);
+
+    src = pic;
+    src_jobs = state->frame->tqj_me_pyramid[level];
+  }
+}
+
+/**
+ * \brief Attach interpolated planes to the reconstructed picture if it will
+ *        be used as a reference.
+ *
+ * The planes are filled during the search of the frames referring to it.
+ */
+static void encoder_state_init_subpel_planes(encoder_state_t * const state)
+{
+  const encoder_control_t * const ctrl = state->encoder_control;
+  kvz_picture *const rec = state->tile->frame->rec;
+
+  const bool is_ref = !ctrl->cfg.gop_len ||
+                      !state->frame->poc ||
+                      ctrl->cfg.gop[state->frame->gop_offset].is_ref;
+
+  if (!ctrl->cfg.subpel_cache) return;
+
+  // A lossless rec is the source picture, which may have been encoded
+  // before, e.g. when it comes from a picture pool. Fill the planes again
+  // from the new reconstruction, unless they belong to another layer
+  // encoding the same picture.
+  if (rec->subpel_planes) {
+    if (rec->subpel_planes->layer_id == ctrl->layer.layer_id) {
+      kvz_subpel_planes_reset(rec->subpel_planes);
+    }
+    return;
+  }
+
+  if (!is_ref) return;
+
+  rec->subpel_planes = kvz_subpel_planes_alloc(rec->width, rec->height, ctrl->layer.layer_id);
+  if (!rec->subpel_planes) {
+    // Inter prediction interpolates the blocks itself.
+    fprintf(stderr, "Failed to allocate the interpolated reference planes.\n");
+  }
+}
+
 void kvz_start_encode_one_frame(encoder_state_t * const state)
 {
+  encoder_state_start_me_pyramid(state);
+  encoder_state_init_subpel_planes(state);
+
+  if (state->frame->hash) {
+    kvz_picture_hash_start(state->frame->hash,
+                           state->encoder_control->cfg.hash,
+                           state->tile->frame->rec,
+                           state->encoder_control->bitdepth);
+  }
+
   encoder_state_encode(state);
 
   threadqueue_job_t *job =
     kvz_threadqueue_job_create(kvz_encoder_state_worker_write_bitstream, state);
+  // Bitstream jobs are chained, so when one is ready it belongs to the
+  // oldest frame in flight. Finishing it lets the frame be output and the
+  // next one started.
+  kvz_threadqueue_job_set_priority(job, THREADQUEUE_JOB_PRIORITY_HIGH);
+  kvz_threadqueue_job_describe(state->encoder_control->threadqueue, job,
+                               "type=bitstream,layer=%d,frame=%d",
+                               state->encoder_control->layer.layer_id, state->frame->num);
 
   _encode_one_frame_add_bitstream_deps(state, job);
   if (state->previous_encoder_state != state && state->previous_encoder_state->tqj_bitstream_written) {
@@ -3305,6 +3539,7 @@ void kvz_encoder_prepare(encoder_state_t *state)
     state->frame->num = 0;
     state->frame->poc = 0;
     state->frame->irap_poc = 0;
+    state->frame->seq_start_num = 0;
     assert(!state->tile->frame->source);
     assert(!state->tile->frame->rec);
     assert(!state->tile->frame->cu_array);
@@ -3369,6 +3604,12 @@ void kvz_encoder_prepare(encoder_state_t *state)
   // Remove source and reconstructed picture.
   kvz_image_free(state->tile->frame->source);
   state->tile->frame->source = NULL;
+  kvz_image_scaling_jobs_free(&state->frame->tqj_source_scaling);
+  for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+    kvz_image_free(state->frame->me_pyramid[level]);
+    state->frame->me_pyramid[level] = NULL;
+    kvz_image_scaling_jobs_free(&state->frame->tqj_me_pyramid[level]);
+  }
 
   kvz_image_free(state->tile->frame->rec);
   state->tile->frame->rec = NULL;
@@ -3379,6 +3620,7 @@ void kvz_encoder_prepare(encoder_state_t *state)
   state->frame->num = prev_state->frame->num + 1;
   state->frame->poc = prev_state->frame->poc + 1;
   state->frame->irap_poc = prev_state->frame->irap_poc;
+  state->frame->seq_start_num = prev_state->frame->seq_start_num;
 
   state->frame->prepared = 1;
 }
@@ -34,6 +34,8 @@
 #include "image.h"
 #include "imagelist.h"
 #include "kvazaar.h"
+#include "lookahead.h"
+#include "picture_hash.h"
 #include "tables.h"
 #include "threadqueue.h"
 #include "videoframe.h"
@@ -82,6 +84,7 @@ typedef struct encoder_state_config_frame_t {
   int32_t poc;       /*!< \brief Picture order count */
   int8_t gop_offset; /*!< \brief Offset in the gop structure */
   int32_t irap_poc;  /*!< \brief POC of the associated IRAP picture */
+  int32_t seq_start_num; /*!< \brief Frame number of the IDR picture starting the sequence */
 
   /**
    * \brief Frame-level quantization parameter
@@ -121,6 +124,16 @@ typedef struct encoder_state_config_frame_t {
   double rc_alpha;
   double rc_beta;
 
+  /**
+   * \brief Geometric running average of the lookahead cost per pixel.
+   *
+   * Includes the current frame. Zero before the first frame with stats.
+   */
+  double rc_complexity;
+
+  //! \brief Scale applied to the target bpp with the lookahead costs.
+  double rc_bpp_scale;
+
   /**
    * \brief Indicates that this encoder state is ready for encoding the
    * next frame i.e. kvz_encoder_prepare has been called.
@@ -141,11 +154,57 @@ typedef struct encoder_state_config_frame_t {
    */
   lcu_stats_t *lcu_stats;
 
+  /**
+   * \brief Complexity estimates of the current frame from the lookahead.
+   *
+   * The arrays are allocated only if the lookahead is enabled.
+   */
+  lookahead_stats_t lookahead;
+
+  //! \brief Mean of log2 of the lookahead intra cost per pixel of the LCUs.
+  double aq_log_cost;
+
   /**
    * \brief Whether next NAL is the first NAL in the access unit.
    */
   bool first_nal;
 
+  // ***********************************************
+  // Modified for SHVC.
+  /**
+   * \brief Jobs scaling the source picture, one per LCU row.
+   *
+   * NULL terminated. NULL if the source picture was not scaled.
+   */
+  threadqueue_job_t **tqj_source_scaling;
+  // ***********************************************
+
+  /**
+   * \brief Source picture downscaled for the coarse motion search.
+   *
+   * Level i is scaled from level i - 1, or the source, to half the size.
+   * The same pictures are referred to by the reconstructed picture so that
+   * they can be used when it is a reference.
+   */
+  kvz_picture *me_pyramid[ME_PYRAMID_MAX_LEVELS];
+
+  /**
+   * \brief Jobs scaling the pyramid levels, one per LCU row of the level.
+   *
+   * NULL terminated. NULL if the level is not used.
+   */
+  threadqueue_job_t **tqj_me_pyramid[ME_PYRAMID_MAX_LEVELS];
+
+  //! Pictures and buffers reused when scaling the pyramid levels.
+  kvz_image_row_scaler_t me_pyramid_scaler[ME_PYRAMID_MAX_LEVELS];
+
+  /**
+   * \brief Decoded picture hash of the reconstruction.
+   *
+   * Rows are hashed as the LCUs are encoded. NULL if hashes are disabled.
+   */
+  picture_hash_t *hash;
+
 } encoder_state_config_frame_t;
 
 typedef struct encoder_state_config_tile_t {
@@ -200,8 +259,10 @@ typedef struct encoder_state_config_layer_t {
   threadqueue_job_t **image_hor_scaling_jobs;
   threadqueue_job_t **image_ver_scaling_jobs;
   threadqueue_job_t **cua_scaling_jobs;
+  opaque_yuv_buffer_t **ilr_block_buffers; //Per job hor step results so block jobs do not share ver_tmp_buffer
   
   kvz_image_scaling_parameter_t img_job_param; //Hold parameters given to scaling jobs
+  kvz_image_pool_t ilr_pool; //Reused pictures for the scaled ILR
   kvz_cua_upsampling_parameter_t cua_job_param; //Hold parameters passed to cua upsampling jobs
   
   uint8_t scaling_started; //Flag for telling if scaling has been started
@@ -257,6 +318,22 @@ typedef struct lcu_order_element {
   struct lcu_order_element *right;
 } lcu_order_element_t;
 
+//! Size of the blocks searched at the coarse levels of motion estimation.
+#define ME_PYRAMID_BLOCK_SIZE 32
+#define ME_PYRAMID_BLOCKS ((LCU_WIDTH / ME_PYRAMID_BLOCK_SIZE) * (LCU_WIDTH / ME_PYRAMID_BLOCK_SIZE))
+
+/**
+ * \brief Results of the coarse motion search of an LCU.
+ *
+ * Blocks are searched for each reference when they are first needed.
+ */
+typedef struct {
+  bool searched[MAX_REF_PIC_COUNT][ME_PYRAMID_BLOCKS];
+  bool found[MAX_REF_PIC_COUNT][ME_PYRAMID_BLOCKS];
+  //! Full resolution integer mvs
+  vector2d_t mv[MAX_REF_PIC_COUNT][ME_PYRAMID_BLOCKS];
+} me_pyramid_mvs_t;
+
 typedef struct encoder_state_t {
   const encoder_control_t *encoder_control;
   encoder_state_type type;
@@ -290,6 +367,8 @@ typedef struct encoder_state_t {
   
   bitstream_t stream;
   cabac_data_t cabac;
+  //! \brief Bit costs of the contexts in cabac for RDOQ of the current LCU.
+  cabac_bits_t cabac_bits;
 
   // Crypto stuff
   crypto_handle_t *crypto_hdl;
@@ -327,6 +406,11 @@ typedef struct encoder_state_t {
    */
   lcu_coeff_t *coeff;
 
+  /**
+   * \brief Coarse motion search results for the LCU.
+   */
+  me_pyramid_mvs_t *me_pyramid_mvs;
+
   //Jobs to wait for
   threadqueue_job_t * tqj_recon_done; //Reconstruction is done
   threadqueue_job_t * tqj_bitstream_written; //Bitstream is written
@@ -373,11 +457,11 @@ int kvz_get_cu_ref_qp(const encoder_state_t *state, int x, int y, int last_qp);
  */
 static INLINE bool encoder_state_must_write_vps(const encoder_state_t *state)
 {
-  const int32_t frame = state->frame->num;
+  const int32_t frame = state->frame->num - state->frame->seq_start_num;
   const int32_t vps_period = state->encoder_control->cfg.vps_period;
 
   return (vps_period >  0 && frame % vps_period == 0) ||
-         (vps_period >= 0 && frame == 0);
+         (vps_period >= 0 && state->frame->num == 0);
 }
 
 
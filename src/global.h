@@ -176,6 +176,13 @@ typedef int16_t coeff_t;
 
 #define MAX_REF_PIC_COUNT 16
 
+//! Maximum number of downscaled levels used in motion estimation. Must match
+//! the size of kvz_picture::me_pyramid, which is checked in image.h.
+#define ME_PYRAMID_MAX_LEVELS 2
+
+//! Maximum number of frames analysed ahead of the encoder.
+#define LOOKAHEAD_MAX_FRAMES 32
+
 #define AMVP_MAX_NUM_CANDS 2
 #define AMVP_MAX_NUM_CANDS_MEM 3
 #define MRG_MAX_NUM_CANDS 5
@@ -346,6 +353,9 @@ typedef enum { COLOR_Y = 0, COLOR_U, COLOR_V } color_t;
 #  if defined(__AVX2__)
 #    define COMPILE_INTEL_AVX2 1
 #   endif
+#  if defined(__AVX512F__) && defined(__AVX512BW__)
+#    define COMPILE_INTEL_AVX512 1
+#   endif
 #endif
 
 #if defined (_M_PPC) || defined(__powerpc64__) || defined(__powerpc__)
@@ -23,6 +23,7 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#include "subpel_planes.h"
 #include "strategies/strategies-ipol.h"
 #include "strategies/strategies-picture.h"
 #include "threads.h"
@@ -40,33 +41,18 @@ kvz_picture * kvz_image_alloc_420(const int32_t width, const int32_t height)
 }
 
 /**
- * \brief Allocate a new image.
- * \return image pointer or NULL on failure
+ * \brief Set the fields of an image using the given pixel data.
  */
-kvz_picture * kvz_image_alloc(enum kvz_chroma_format chroma_format, const int32_t width, const int32_t height)
+static void image_init(kvz_picture *const im,
+                       enum kvz_chroma_format chroma_format,
+                       const int32_t width, const int32_t height,
+                       kvz_pixel *const data)
 {
-  //Assert that we have a well defined image
-  assert((width % 2) == 0);
-  assert((height % 2) == 0);
-
-  const size_t simd_padding_width = 64;
-
-  kvz_picture *im = MALLOC(kvz_picture, 1);
-  if (!im) return NULL;
-
   unsigned int luma_size = width * height;
   unsigned chroma_sizes[] = { 0, luma_size / 4, luma_size / 2, luma_size };
   unsigned chroma_size = chroma_sizes[chroma_format];
 
-  im->chroma_format = chroma_format;
-
-  //Allocate memory, pad the full data buffer from both ends
-  im->fulldata_buf = MALLOC_SIMD_PADDED(kvz_pixel, (luma_size + 2 * chroma_size), simd_padding_width * 2);
-  if (!im->fulldata_buf) {
-    free(im);
-    return NULL;
-  }
-  im->fulldata = im->fulldata_buf + simd_padding_width / sizeof(kvz_pixel);
+  im->fulldata = data;
 
   im->base_image = im;
   im->refcount = 1; //We give a reference to caller
@@ -90,6 +76,65 @@ kvz_picture * kvz_image_alloc(enum kvz_chroma_format chroma_format, const int32_
 
   im->interlacing = KVZ_INTERLACING_NONE;
 
+  for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+    im->me_pyramid[level] = NULL;
+  }
+  im->subpel_planes = NULL;
+}
+
+/**
+ * \brief Allocate a new image.
+ * \return image pointer or NULL on failure
+ */
+kvz_picture * kvz_image_alloc(enum kvz_chroma_format chroma_format, const int32_t width, const int32_t height)
+{
+  //Assert that we have a well defined image
+  assert((width % 2) == 0);
+  assert((height % 2) == 0);
+
+  const size_t simd_padding_width = KVZ_PICTURE_PADDING;
+
+  kvz_picture *im = MALLOC(kvz_picture, 1);
+  if (!im) return NULL;
+
+  unsigned int luma_size = width * height;
+  unsigned chroma_sizes[] = { 0, luma_size / 4, luma_size / 2, luma_size };
+  unsigned chroma_size = chroma_sizes[chroma_format];
+
+  //Allocate memory, pad the full data buffer from both ends
+  im->fulldata_buf = MALLOC_SIMD_PADDED(kvz_pixel, (luma_size + 2 * chroma_size), simd_padding_width * 2);
+  if (!im->fulldata_buf) {
+    free(im);
+    return NULL;
+  }
+
+  image_init(im, chroma_format, width, height,
+             im->fulldata_buf + simd_padding_width / sizeof(kvz_pixel));
+
+  return im;
+}
+
+/**
+ * \brief Allocate a new image for existing pixel data.
+ *
+ * The data is not freed with the image. KVZ_PICTURE_PADDING bytes
+ * before and after the data must be readable.
+ *
+ * \return image pointer or NULL on failure
+ */
+kvz_picture * kvz_image_wrap(enum kvz_chroma_format chroma_format,
+                             const int32_t width, const int32_t height,
+                             kvz_pixel *const data)
+{
+  assert((width % 2) == 0);
+  assert((height % 2) == 0);
+
+  kvz_picture *im = MALLOC(kvz_picture, 1);
+  if (!im) return NULL;
+
+  im->fulldata_buf = NULL;
+  image_init(im, chroma_format, width, height, data);
+
   return im;
 }
 
@@ -118,6 +163,13 @@ void kvz_image_free(kvz_picture *const im)
     free(im->fulldata_buf);
   }
 
+  for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+    kvz_image_free(im->me_pyramid[level]);
+    im->me_pyramid[level] = NULL;
+  }
+  kvz_subpel_planes_free(im->subpel_planes);
+  im->subpel_planes = NULL;
+
   // Make sure freed data won't be used.
   im->base_image = NULL;
   im->fulldata_buf = NULL;
@@ -176,6 +228,12 @@ kvz_picture *kvz_image_make_subimage(kvz_picture *const orig_image,
   im->pts = 0;
   im->dts = 0;
 
+  // The pyramid and the planes belong to the original image.
+  for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+    im->me_pyramid[level] = NULL;
+  }
+  im->subpel_planes = NULL;
+
   return im;
 }
 
@@ -229,6 +287,9 @@ void kvz_hi_prec_buf_t_free(hi_prec_buf_t * yuv)
   free(yuv);
 }
 
+// Number of blocks given to kvz_reg_sad_multi at a time.
+#define SAD_MULTI_MAX_BLOCKS 16
+
 static INLINE uint32_t reg_sad_maybe_optimized(const kvz_pixel * const data1, const kvz_pixel * const data2,
                                   const int32_t width, const int32_t height, const uint32_t stride1,
                                   const uint32_t stride2, optimized_sad_func_ptr_t optimized_sad)
@@ -446,6 +507,69 @@ unsigned kvz_image_calc_sad(const kvz_picture *pic,
 }
 
 
+/**
+* \brief Calculate interpolated SAD between a block and several blocks.
+*
+* Blocks that are completely inside the reference frame are done with a
+* single call to kvz_reg_sad_multi, the rest one at a time.
+*
+* \param pic        Image for the block we are trying to find.
+* \param ref        Image where we are trying to find the block.
+* \param ref_x      X coordinates of the blocks in ref.
+* \param ref_y      Y coordinates of the blocks in ref.
+* \param costs_out  Sum of absolute differences for each block.
+*/
+void kvz_image_calc_sad_multi(const kvz_picture *pic,
+                              const kvz_picture *ref,
+                              int pic_x,
+                              int pic_y,
+                              const int *ref_x,
+                              const int *ref_y,
+                              int num_blocks,
+                              int block_width,
+                              int block_height,
+                              optimized_sad_func_ptr_t optimized_sad,
+                              unsigned *costs_out)
+{
+  assert(pic_x >= 0 && pic_x <= pic->width - block_width);
+  assert(pic_y >= 0 && pic_y <= pic->height - block_height);
+
+  const kvz_pixel *pic_data = &pic->y[pic_y * pic->stride + pic_x];
+
+  for (int start = 0; start < num_blocks; start += SAD_MULTI_MAX_BLOCKS) {
+    const int end = MIN(start + SAD_MULTI_MAX_BLOCKS, num_blocks);
+    const kvz_pixel *ref_data[SAD_MULTI_MAX_BLOCKS];
+    int index[SAD_MULTI_MAX_BLOCKS];
+    unsigned sads[SAD_MULTI_MAX_BLOCKS];
+    int num_inside = 0;
+
+    for (int i = start; i < end; ++i) {
+      if (ref_x[i] >= 0 && ref_x[i] <= ref->width  - block_width &&
+          ref_y[i] >= 0 && ref_y[i] <= ref->height - block_height)
+      {
+        ref_data[num_inside] = &ref->y[ref_y[i] * ref->stride + ref_x[i]];
+        index[num_inside] = i;
+        num_inside++;
+      } else {
+        costs_out[i] = kvz_image_calc_sad(pic, ref, pic_x, pic_y, ref_x[i], ref_y[i],
+                                          block_width, block_height, optimized_sad);
+      }
+    }
+
+    if (num_inside == 1) {
+      sads[0] = reg_sad_maybe_optimized(pic_data, ref_data[0], block_width, block_height,
+                                        pic->stride, ref->stride, optimized_sad);
+    } else if (num_inside > 1) {
+      kvz_reg_sad_multi(pic_data, ref_data, num_inside, block_width, block_height,
+                        pic->stride, ref->stride, sads);
+    }
+    for (int i = 0; i < num_inside; ++i) {
+      costs_out[index[i]] = sads[i] >> (KVZ_BIT_DEPTH - 8);
+    }
+  }
+}
+
+
 /**
 * \brief Calculate interpolated SATD between two blocks.
 *
@@ -1156,6 +1280,319 @@ kvz_picture* kvz_image_scaling(kvz_picture* const pic_in, const scaling_paramete
   return pic_out;
 }
 
+kvz_picture* kvz_image_pool_get(kvz_image_pool_t *const pool, enum kvz_chroma_format chroma_format, const int32_t width, const int32_t height)
+{
+  //Pictures of a different size can't be reused so drop them
+  if (pool->chroma_format != chroma_format || pool->width != width || pool->height != height) {
+    kvz_image_pool_free(pool);
+    pool->chroma_format = chroma_format;
+    pool->width = width;
+    pool->height = height;
+  }
+
+  for (int i = 0; i < pool->num_pics; i++) {
+    kvz_picture *const pic = pool->pics[i];
+    if (KVZ_ATOMIC_LOAD(&pic->refcount) == 1) {
+      //Only the pool holds a reference so nobody else can get one until we return it
+      pic->pts = 0;
+      pic->dts = 0;
+      pic->interlacing = KVZ_INTERLACING_NONE;
+      //Drop data derived from the previous contents
+      for (int level = 0; level < ME_PYRAMID_MAX_LEVELS; ++level) {
+        kvz_image_free(pic->me_pyramid[level]);
+        pic->me_pyramid[level] = NULL;
+      }
+      kvz_subpel_planes_free(pic->subpel_planes);
+      pic->subpel_planes = NULL;
+      return kvz_image_copy_ref(pic);
+    }
+  }
+
+  kvz_picture *const pic = kvz_image_alloc(chroma_format, width, height);
+  if (pic == NULL) {
+    return NULL;
+  }
+
+  kvz_picture **pics = realloc(pool->pics, (pool->num_pics + 1) * sizeof(kvz_picture*));
+  if (pics == NULL) {
+    //Still usable, just not pooled
+    return pic;
+  }
+  pool->pics = pics;
+  pool->pics[pool->num_pics++] = pic;
+
+  return kvz_image_copy_ref(pic);
+}
+
+void kvz_image_pool_free(kvz_image_pool_t *const pool)
+{
+  for (int i = 0; i < pool->num_pics; i++) {
+    kvz_image_free(pool->pics[i]);
+  }
+  FREE_POINTER(pool->pics);
+  pool->num_pics = 0;
+  pool->width = 0;
+  pool->height = 0;
+}
+
+//Source rows needed for scaling a block row. The range is calculated for luma, but chroma filters
+//cover twice as many luma rows when subsampled vertically so extend the range by a filter length.
+static void row_block_src_range(int range[2], const scaling_parameter_t *const param, const int block_y, const int block_height)
+{
+  kvz_blockScalingSrcHeightRange(range, param, block_y, block_height);
+  if (param->chroma == CHROMA_420) {
+    range[0] = MAX(range[0] - SCALER_MAX_FILTER_SIZE, 0) & ~1;
+    range[1] = MIN(range[1] + SCALER_MAX_FILTER_SIZE, param->src_height + param->src_padding_y - 1);
+  }
+}
+
+/** \brief Scale one block row of pic_in to pic_out
+*  The block is taken to mean the (unpadded) pic_out rows that should be calculated.
+*  Hor and ver steps are done in the same job with an intermediate buffer owned by the block row, so block rows can be scaled in any order.
+*  Padding of pic_out on the block rows is filled by copying the last pixel/row.
+*/
+void kvz_row_block_scaler_worker(void *opaque_param)
+{
+  kvz_image_scaling_parameter_t *in_param = opaque_param;
+  kvz_picture * const pic_in = in_param->pic_in;
+  kvz_picture * const pic_out = in_param->pic_out;
+  const scaling_parameter_t *const param = in_param->param;
+
+  PRINT_TID_JOB_INFO(in_param->block_x, in_param->block_y, in_param->block_width, in_param->block_height, 2);
+
+  int range[2];
+  row_block_src_range(range, param, in_param->block_y, in_param->block_height);
+  const int hor_block_height = range[1] - range[0] + 1;
+  const int num_comp = param->chroma == CHROMA_400 ? 1 : 3;
+
+  //The row buffers are only used by this job until it is done
+  kvz_setOpaqueYuvBuffer(in_param->src_buffer, pic_in->y, pic_in->u, pic_in->v, sizeof(kvz_pixel));
+  kvz_setOpaqueYuvBuffer(in_param->trgt_buffer, pic_out->y, pic_out->u, pic_out->v, sizeof(kvz_pixel));
+
+  PRINT_JOB_EXTRA_INFO("Hor scaling", in_param->block_x, range[0], 0, 0, in_param->block_width, hor_block_height);
+
+  if (kvz_opaqueYuvBlockStepScaling_adapter(in_param->ver_tmp_buffer, in_param->src_buffer, param, in_param->block_x, range[0], in_param->block_width, hor_block_height, 0, kvz_opaque_resample_block_step)
+    && kvz_opaqueYuvBlockStepScaling_adapter(in_param->trgt_buffer, in_param->ver_tmp_buffer, param, in_param->block_x, in_param->block_y, in_param->block_width, in_param->block_height, 1, kvz_opaque_resample_block_step)) {
+
+    assert(sizeof(kvz_pixel) == sizeof(char)); //Padding (memset) only works if the pixels are the same size as char
+    const int is_last_block = in_param->block_y + in_param->block_height >= param->trgt_height;
+
+    for (int c = 0; c < num_comp; c++) {
+      const int w_shift = (c == 0 || param->chroma == CHROMA_444) ? 0 : 1;
+      const int h_shift = (c == 0 || param->chroma != CHROMA_420) ? 0 : 1;
+      const int stride = pic_out->stride >> w_shift;
+      const int width = param->trgt_width >> w_shift;
+      const int padding_x = param->trgt_padding_x >> w_shift;
+      const int end_y = (in_param->block_y + in_param->block_height) >> h_shift;
+
+      //Padd end of row by copying last pixel
+      if (padding_x != 0) {
+        for (int y = in_param->block_y >> h_shift; y < end_y; y++) {
+          kvz_pixel *row = &pic_out->data[c][y * stride];
+          memset(row + width, row[width - 1], padding_x);
+        }
+      }
+      //Padd image with lines copied from the prev row
+      if (is_last_block) {
+        for (int y = end_y; y < (pic_out->height >> h_shift); y++) {
+          memcpy(&pic_out->data[c][y * stride], &pic_out->data[c][(y - 1) * stride], stride);
+        }
+      }
+    }
+  }
+
+  //Do deallocation. Buffers belong to the row scaler.
+  kvz_image_free(pic_in);
+  kvz_image_free(pic_out);
+  free(in_param);
+}
+
+//Allocate the per row buffers of the scaler
+static int row_scaler_init(kvz_image_row_scaler_t *const scaler, const scaling_parameter_t *const param, const int src_stride, const int block_height)
+{
+  const int src_height = param->src_height + param->src_padding_y;
+  const int trgt_width = param->trgt_width + param->trgt_padding_x;
+  const int trgt_height = param->trgt_height + param->trgt_padding_y;
+  const int num_comp = param->chroma == CHROMA_400 ? 1 : 3;
+
+  scaler->param = param;
+  scaler->src_stride = src_stride;
+  scaler->block_height = block_height;
+  scaler->num_blocks = (trgt_height + block_height - 1) / block_height;
+
+  scaler->src_buffers = calloc(scaler->num_blocks, sizeof(opaque_yuv_buffer_t*));
+  scaler->ver_tmp_buffers = calloc(scaler->num_blocks, sizeof(opaque_yuv_buffer_t*));
+  scaler->trgt_buffers = calloc(scaler->num_blocks, sizeof(opaque_yuv_buffer_t*));
+  scaler->tmp_data = calloc(3 * scaler->num_blocks, sizeof(pic_data_t*));
+  scaler->prev_jobs = calloc(scaler->num_blocks, sizeof(threadqueue_job_t*));
+  if (scaler->src_buffers == NULL || scaler->ver_tmp_buffers == NULL || scaler->trgt_buffers == NULL
+      || scaler->tmp_data == NULL || scaler->prev_jobs == NULL) {
+    fprintf(stderr, "Failed to allocate row scaler.\n");
+    return 0;
+  }
+
+  for (int i = 0; i < scaler->num_blocks; i++) {
+    //This also calculates the scaling parameters here so that the workers don't need to
+    const int block_y = i * block_height;
+    int range[2];
+    row_block_src_range(range, param, block_y, MIN(block_height, param->trgt_height - block_y));
+
+    //Only rows in range are allocated for the intermediate result, but data pointers are set so that
+    //the buffer can be indexed like a full size buffer. Downscaling filters need the full precision of pic_data_t.
+    //Allocate one extra row since vector loads may read past the end of the last row.
+    pic_data_t **const tmp_data = &scaler->tmp_data[3 * i];
+    pic_data_t *tmp_origin[3] = { NULL, NULL, NULL };
+    for (int c = 0; c < num_comp; c++) {
+      const int w_shift = (c == 0 || param->chroma == CHROMA_444) ? 0 : 1;
+      const int h_shift = (c == 0 || param->chroma != CHROMA_420) ? 0 : 1;
+      const int width = param->trgt_width >> w_shift;
+      const int first_row = range[0] >> h_shift;
+      const int num_rows = (range[1] >> h_shift) - first_row + 2;
+      tmp_data[c] = MALLOC(pic_data_t, width * num_rows);
+      if (tmp_data[c] == NULL) {
+        fprintf(stderr, "Failed to allocate row scaler.\n");
+        return 0;
+      }
+      tmp_origin[c] = tmp_data[c] - first_row * width;
+    }
+
+    //Data pointers of the picture buffers are set by the worker (depth 0 means nothing is allocated here)
+    scaler->src_buffers[i] = kvz_newOpaqueYuvBuffer(NULL, NULL, NULL, param->src_width + param->src_padding_x, src_height, src_stride, param->chroma, 0);
+    scaler->trgt_buffers[i] = kvz_newOpaqueYuvBuffer(NULL, NULL, NULL, trgt_width, trgt_height, trgt_width, param->chroma, 0);
+    scaler->ver_tmp_buffers[i] = kvz_newOpaqueYuvBuffer(tmp_origin[0], tmp_origin[1], tmp_origin[2], param->trgt_width, src_height, param->trgt_width, param->chroma, sizeof(pic_data_t));
+    if (scaler->src_buffers[i] == NULL || scaler->trgt_buffers[i] == NULL || scaler->ver_tmp_buffers[i] == NULL) {
+      fprintf(stderr, "Failed to allocate row scaler.\n");
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+//Free buffers of the row scaler. Jobs using the buffers need to be done (or the threadqueue stopped).
+void kvz_image_row_scaler_free(kvz_image_row_scaler_t *const scaler)
+{
+  for (int i = 0; i < scaler->num_blocks; i++) {
+    if (scaler->prev_jobs != NULL) {
+      kvz_threadqueue_free_job(&scaler->prev_jobs[i]);
+    }
+    if (scaler->src_buffers != NULL) kvz_deallocateOpaqueYuvBuffer(scaler->src_buffers[i], 0);
+    if (scaler->trgt_buffers != NULL) kvz_deallocateOpaqueYuvBuffer(scaler->trgt_buffers[i], 0);
+    if (scaler->ver_tmp_buffers != NULL) kvz_deallocateOpaqueYuvBuffer(scaler->ver_tmp_buffers[i], 0);
+    if (scaler->tmp_data != NULL) {
+      for (int c = 0; c < 3; c++) {
+        FREE_POINTER(scaler->tmp_data[3 * i + c]);
+      }
+    }
+  }
+  FREE_POINTER(scaler->src_buffers);
+  FREE_POINTER(scaler->trgt_buffers);
+  FREE_POINTER(scaler->ver_tmp_buffers);
+  FREE_POINTER(scaler->tmp_data);
+  FREE_POINTER(scaler->prev_jobs);
+  kvz_image_pool_free(&scaler->pool);
+
+  scaler->param = NULL;
+  scaler->num_blocks = 0;
+}
+
+//Create a new kvz picture based on pic_in and start jobs for scaling it in block rows of block_height.
+//Pictures and buffers are taken from the scaler and reused once the previous user is done with them.
+//Row jobs are returned in a NULL terminated list in jobs_out (set to NULL if no scaling needs to be done)
+//and need to be freed with kvz_image_scaling_jobs_free. Pixels of a row should only be accessed after its job is done.
+//If pic_in is itself still being scaled, src_jobs gives its row jobs (with the same block_height), otherwise NULL.
+kvz_picture* kvz_image_deferred_row_scaling(kvz_picture* const pic_in, threadqueue_job_t *const *const src_jobs, kvz_image_row_scaler_t *const scaler, const scaling_parameter_t *const param, uint8_t skip_same, threadqueue_queue_t *const threadqueue, const int block_height, threadqueue_job_t ***const jobs_out)
+{
+  *jobs_out = NULL;
+
+  if (pic_in == NULL) {
+    return NULL;
+  }
+
+  //If no scaling needs to be done, just return pic_in
+  if (skip_same && param->src_height == param->trgt_height && param->src_width == param->trgt_width) {
+    return kvz_image_copy_ref(pic_in);
+  }
+
+  if (scaler->param != param || scaler->src_stride != pic_in->stride || scaler->block_height != block_height) {
+    //Row buffers may still be in use by the previous picture
+    for (int i = 0; i < scaler->num_blocks; i++) {
+      if (scaler->prev_jobs[i] != NULL) {
+        kvz_threadqueue_waitfor(threadqueue, scaler->prev_jobs[i]);
+      }
+    }
+    kvz_image_row_scaler_free(scaler);
+    if (!row_scaler_init(scaler, param, pic_in->stride, block_height)) {
+      kvz_image_row_scaler_free(scaler);
+      return NULL;
+    }
+  }
+
+  kvz_picture* pic_out = kvz_image_pool_get(&scaler->pool, pic_in->chroma_format,
+                                            param->trgt_width + param->trgt_padding_x,
+                                            param->trgt_height + param->trgt_padding_y);
+  if (pic_out == NULL) {
+    return NULL;
+  }
+
+  //Other information is needed before the scaling is done so copy it here
+  pic_out->dts = pic_in->dts;
+  pic_out->pts = pic_in->pts;
+  pic_out->interlacing = pic_in->interlacing;
+
+  threadqueue_job_t **jobs = calloc(scaler->num_blocks + 1, sizeof(threadqueue_job_t*));
+
+  for (int i = 0; i < scaler->num_blocks; i++) {
+    //Allocate scaling parameters to give to the worker. Worker should handle freeing.
+    kvz_image_scaling_parameter_t *scaling_param = calloc(1, sizeof(kvz_image_scaling_parameter_t));
+    scaling_param->pic_in = kvz_image_copy_ref(pic_in);
+    scaling_param->pic_out = kvz_image_copy_ref(pic_out);
+    scaling_param->src_buffer = scaler->src_buffers[i];
+    scaling_param->ver_tmp_buffer = scaler->ver_tmp_buffers[i];
+    scaling_param->trgt_buffer = scaler->trgt_buffers[i];
+    scaling_param->param = param;
+    scaling_param->block_x = 0;
+    scaling_param->block_y = i * block_height;
+    scaling_param->block_width = param->trgt_width;
+    scaling_param->block_height = MIN(block_height, param->trgt_height - scaling_param->block_y);
+
+    jobs[i] = kvz_threadqueue_job_create(kvz_row_block_scaler_worker, (void*)scaling_param);
+    kvz_threadqueue_job_describe(threadqueue, jobs[i], "type=input_scaling,position_y=%d", i);
+
+    //Wait for the source rows the block uses
+    if (src_jobs != NULL) {
+      int range[2];
+      row_block_src_range(range, param, scaling_param->block_y, scaling_param->block_height);
+      for (int src_row = range[0] / block_height; src_row <= range[1] / block_height && src_jobs[src_row] != NULL; src_row++) {
+        kvz_threadqueue_job_dep_add(jobs[i], src_jobs[src_row]);
+      }
+    }
+
+    //The row buffers are shared with the same row of the previous picture
+    if (scaler->prev_jobs[i] != NULL) {
+      kvz_threadqueue_job_dep_add(jobs[i], scaler->prev_jobs[i]);
+      kvz_threadqueue_free_job(&scaler->prev_jobs[i]);
+    }
+    scaler->prev_jobs[i] = kvz_threadqueue_copy_ref(jobs[i]);
+
+    kvz_threadqueue_submit(threadqueue, jobs[i]);
+  }
+
+  *jobs_out = jobs;
+  return pic_out;
+}
+
+void kvz_image_scaling_jobs_free(threadqueue_job_t ***const jobs)
+{
+  if (*jobs == NULL) {
+    return;
+  }
+  for (threadqueue_job_t **job = *jobs; *job != NULL; job++) {
+    kvz_threadqueue_free_job(job);
+  }
+  FREE_POINTER(*jobs);
+}
+
 void kvz_propagate_image_scaling_parameters(kvz_image_scaling_parameter_t * const dst, const kvz_image_scaling_parameter_t * const src)
 {
   //Make sure that if dst and src pics are the same, the pic is not deallocated.
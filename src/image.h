@@ -30,6 +30,7 @@
 
 #include "kvazaar.h"
 #include "strategies/optimized_sad_func_ptr_t.h"
+#include "threadqueue.h"
 
 // ***********************************************
   // Modified for SHVC
@@ -37,6 +38,11 @@
 // ***********************************************
 
 
+// Fail to compile if ME_PYRAMID_MAX_LEVELS and the size of
+// kvz_picture::me_pyramid in the public header differ.
+typedef char kvz_me_pyramid_levels_must_match[
+  sizeof(((kvz_picture *)0)->me_pyramid) / sizeof(kvz_picture *) == ME_PYRAMID_MAX_LEVELS ? 1 : -1];
+
 typedef struct {
   kvz_pixel y[LCU_LUMA_SIZE];
   kvz_pixel u[LCU_CHROMA_SIZE];
@@ -61,6 +67,9 @@ typedef struct {
 
 kvz_picture *kvz_image_alloc_420(const int32_t width, const int32_t height);
 kvz_picture *kvz_image_alloc(enum kvz_chroma_format chroma_format, const int32_t width, const int32_t height);
+kvz_picture *kvz_image_wrap(enum kvz_chroma_format chroma_format,
+                            const int32_t width, const int32_t height,
+                            kvz_pixel *const data);
 
 void kvz_image_free(kvz_picture *im);
 
@@ -90,6 +99,18 @@ unsigned kvz_image_calc_sad(const kvz_picture *pic,
                             int block_height,
                             optimized_sad_func_ptr_t optimized_sad);
 
+void kvz_image_calc_sad_multi(const kvz_picture *pic,
+                              const kvz_picture *ref,
+                              int pic_x,
+                              int pic_y,
+                              const int *ref_x,
+                              const int *ref_y,
+                              int num_blocks,
+                              int block_width,
+                              int block_height,
+                              optimized_sad_func_ptr_t optimized_sad,
+                              unsigned *costs_out);
+
 
 unsigned kvz_image_calc_satd(const kvz_picture *pic,
                              const kvz_picture *ref,
@@ -134,6 +155,42 @@ void kvz_block_scaler_worker( void *opaque_param );
 void kvz_opaque_block_step_scaler_worker(void * opaque_param);
 //void kvz_tile_step_scaler_worker(void * opaque_param);
 kvz_picture* kvz_image_scaling(kvz_picture* const pic_in, const scaling_parameter_t *const param, uint8_t skip_same);
+
+//Pool of same sized pictures. A picture is reused once the pool holds the only reference to it.
+typedef struct {
+  kvz_picture **pics;
+  int num_pics;
+
+  enum kvz_chroma_format chroma_format;
+  int32_t width;
+  int32_t height;
+} kvz_image_pool_t;
+
+kvz_picture* kvz_image_pool_get(kvz_image_pool_t *const pool, enum kvz_chroma_format chroma_format, const int32_t width, const int32_t height);
+void kvz_image_pool_free(kvz_image_pool_t *const pool);
+
+//Holds buffers reused between pictures when scaling in block rows.
+//Row i of a picture depends on row i of the previous picture, so each row's buffers are only used by one job at a time.
+typedef struct {
+  const scaling_parameter_t *param;
+  int src_stride;
+  int block_height;
+  int num_blocks;
+
+  kvz_image_pool_t pool;
+
+  opaque_yuv_buffer_t **src_buffers;
+  opaque_yuv_buffer_t **ver_tmp_buffers;
+  opaque_yuv_buffer_t **trgt_buffers;
+  pic_data_t **tmp_data; //Allocations behind ver_tmp_buffers, 3 per row
+
+  threadqueue_job_t **prev_jobs; //Row jobs of the previous picture
+} kvz_image_row_scaler_t;
+
+void kvz_row_block_scaler_worker(void *opaque_param);
+kvz_picture* kvz_image_deferred_row_scaling(kvz_picture* const pic_in, threadqueue_job_t *const *const src_jobs, kvz_image_row_scaler_t *const scaler, const scaling_parameter_t *const param, uint8_t skip_same, threadqueue_queue_t *const threadqueue, const int block_height, threadqueue_job_t ***const jobs_out);
+void kvz_image_scaling_jobs_free(threadqueue_job_t ***const jobs);
+void kvz_image_row_scaler_free(kvz_image_row_scaler_t *const scaler);
 void kvz_copy_image_scaling_parameters(kvz_image_scaling_parameter_t * const dst, const kvz_image_scaling_parameter_t * const src);
 void kvz_propagate_image_scaling_parameters(kvz_image_scaling_parameter_t * const dst, const kvz_image_scaling_parameter_t * const src);
 // ***********************************************
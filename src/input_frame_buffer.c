@@ -41,6 +41,10 @@ void kvz_init_input_frame_buffer(input_frame_buffer_t *input_buffer)
  * Returns the image that should be encoded next if there is a suitable
  * image available.
  *
+ * The buffer can be reinitialized with kvz_init_input_frame_buffer after
+ * all frames have been returned. The GOP structure then starts again from
+ * the next frame, which is coded as an IDR picture.
+ *
  * The caller must not modify img_in after calling this function.
  *
  * \param buf     an input frame buffer
@@ -78,6 +82,9 @@ kvz_picture* kvz_encoder_feed_frame(input_frame_buffer_t *buf,
       }
       state->frame->gop_offset = (frame_num + cfg->gop_len - 1) % cfg->gop_len;
     }
+    if (buf->num_out == 0) {
+      state->frame->seq_start_num = state->frame->num;
+    }
     buf->num_in++;
     buf->num_out++;
     return kvz_image_copy_ref(img_in);
@@ -135,10 +142,11 @@ kvz_picture* kvz_encoder_feed_frame(input_frame_buffer_t *buf,
   int gop_offset;
 
   if (buf->num_out == 0) {
-    // Output the first frame.
+    // Output the first frame. It starts a new sequence.
     idx_out = -1;
     dts_out = buf->pts_buffer[gop_buf_size - 1] + buf->delay;
     gop_offset = 0; // highest quality picture
+    state->frame->seq_start_num = state->frame->num;
 
   } else {
     gop_offset = (buf->num_out - 1) % cfg->gop_len;
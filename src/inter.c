@@ -28,6 +28,7 @@
 #include "imagelist.h"
 #include "strategies/generic/picture-generic.h"
 #include "strategies/strategies-ipol.h"
+#include "subpel_planes.h"
 #include "videoframe.h"
 #include "strategies/strategies-picture.h"
 
@@ -52,6 +53,21 @@ static void inter_recon_frac_luma(const encoder_state_t * const state,
   int mv_frac_x = (mv_param[0] & 3);
   int mv_frac_y = (mv_param[1] & 3);
 
+  kvz_pixel *const dst = lcu->rec.y + (ypos % LCU_WIDTH) * LCU_WIDTH + (xpos % LCU_WIDTH);
+
+  // Copy the block if the reference has been interpolated already.
+  const int frame_x = xpos + state->tile->offset_x;
+  const int frame_y = ypos + state->tile->offset_y;
+  const int block_x = frame_x + (mv_param[0] >> 2);
+  const int block_y = frame_y + (mv_param[1] >> 2);
+  if (kvz_subpel_planes_ready(state, ref, frame_x, frame_y, block_x, block_y, block_width, block_height)) {
+    kvz_pixels_blit(kvz_subpel_planes_block(ref->subpel_planes, block_x, block_y, mv_param),
+                    dst,
+                    block_width, block_height,
+                    ref->subpel_planes->stride, LCU_WIDTH);
+    return;
+  }
+
   // Fractional luma 1/4-pel
   kvz_extended_block src = {0, 0, 0, 0};
 
@@ -74,7 +90,7 @@ static void inter_recon_frac_luma(const encoder_state_t * const state,
                                      src.stride,
                                      block_width,
                                      block_height,
-                                     lcu->rec.y + (ypos % LCU_WIDTH) * LCU_WIDTH + (xpos % LCU_WIDTH),
+                                     dst,
                                      LCU_WIDTH,
                                      mv_frac_x,
                                      mv_frac_y,
@@ -23,7 +23,6 @@
 #include <stdlib.h>
 
 #include "image.h"
-#include "kvz_math.h"
 #include "strategies/strategies-intra.h"
 #include "tables.h"
 #include "transform.h"
@@ -278,13 +277,14 @@ static void intra_pred_filtered_dc(
 }
 
 
-void kvz_intra_predict(
+/**
+ * \brief Select the filtered or unfiltered reference for a mode.
+ */
+static const kvz_intra_ref *intra_select_ref(
   kvz_intra_references *refs,
   int_fast8_t log2_width,
   int_fast8_t mode,
-  color_t color,
-  kvz_pixel *dst,
-  bool filter_boundary)
+  color_t color)
 {
   const int_fast8_t width = 1 << log2_width;
 
@@ -298,7 +298,7 @@ void kvz_intra_predict(
     // Angular modes use smoothed reference pixels, unless the mode is close
     // to being either vertical or horizontal.
     static const int kvz_intra_hor_ver_dist_thres[5] = { 0, 7, 1, 0, 0 };
-    int filter_threshold = kvz_intra_hor_ver_dist_thres[kvz_math_floor_log2(width) - 2];
+    int filter_threshold = kvz_intra_hor_ver_dist_thres[log2_width - 2];
     int dist_from_vert_or_hor = MIN(abs(mode - 26), abs(mode - 10));
     if (dist_from_vert_or_hor > filter_threshold) {
       used_ref = &refs->filtered_ref;
@@ -309,6 +309,21 @@ void kvz_intra_predict(
     intra_filter_reference(log2_width, refs);
   }
 
+  return used_ref;
+}
+
+
+void kvz_intra_predict(
+  kvz_intra_references *refs,
+  int_fast8_t log2_width,
+  int_fast8_t mode,
+  color_t color,
+  kvz_pixel *dst,
+  bool filter_boundary)
+{
+  const int_fast8_t width = 1 << log2_width;
+  const kvz_intra_ref *used_ref = intra_select_ref(refs, log2_width, mode, color);
+
   if (mode == 0) {
     kvz_intra_pred_planar(log2_width, used_ref->top, used_ref->left, dst);
   } else if (mode == 1) {
@@ -331,6 +346,54 @@ void kvz_intra_predict(
 }
 
 
+void kvz_intra_predict_multi(
+  kvz_intra_references *refs,
+  int_fast8_t log2_width,
+  const int8_t *modes,
+  int num_modes,
+  kvz_pixel (*dst)[32 * 32],
+  bool filter_boundary)
+{
+  assert(num_modes <= 35);
+  const int_fast8_t width = 1 << log2_width;
+
+  // Predict the angular modes using each reference with one call.
+  int8_t group_modes[2][35];
+  kvz_pixel *group_dst[2][35];
+  int group_size[2] = { 0, 0 };
+  for (int i = 0; i < num_modes; ++i) {
+    if (modes[i] < 2) {
+      kvz_intra_predict(refs, log2_width, modes[i], COLOR_Y, dst[i], filter_boundary);
+      continue;
+    }
+    const int filtered = intra_select_ref(refs, log2_width, modes[i], COLOR_Y) == &refs->filtered_ref;
+    group_modes[filtered][group_size[filtered]] = modes[i];
+    group_dst[filtered][group_size[filtered]] = dst[i];
+    ++group_size[filtered];
+  }
+
+  const kvz_intra_ref *group_ref[2] = { &refs->ref, &refs->filtered_ref };
+  for (int group = 0; group < 2; ++group) {
+    if (group_size[group] > 0) {
+      kvz_angular_pred_multi(log2_width, group_modes[group], group_size[group],
+                             group_ref[group]->top, group_ref[group]->left,
+                             group_dst[group]);
+    }
+  }
+
+  // Modes 10 and 26 always use the unfiltered reference.
+  if (width < 32 && filter_boundary) {
+    for (int i = 0; i < num_modes; ++i) {
+      if (modes[i] == 10) {
+        intra_post_process_angular(width, 1, refs->ref.top, dst[i]);
+      } else if (modes[i] == 26) {
+        intra_post_process_angular(width, width, refs->ref.left, dst[i]);
+      }
+    }
+  }
+}
+
+
 void kvz_intra_build_reference_any(
   const int_fast8_t log2_width,
   const color_t color,
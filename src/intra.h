@@ -117,6 +117,27 @@ void kvz_intra_predict(
   kvz_pixel *dst,
   bool filter_boundary);
 
+/**
+ * \brief Generate luma predictions for several modes.
+ *
+ * The result is the same as calling kvz_intra_predict for each mode, but
+ * the angular modes using the same reference are predicted together.
+ *
+ * \param refs            Reference pixels used for the prediction.
+ * \param log2_width      Width of the predicted blocks.
+ * \param modes           Intra modes in range 0..34.
+ * \param num_modes       Number of modes, at most 35.
+ * \param dst             Buffer for each mode, in the same order as modes.
+ * \param filter_boundary Whether to filter the boundary on modes 10 and 26.
+ */
+void kvz_intra_predict_multi(
+  kvz_intra_references *refs,
+  int_fast8_t log2_width,
+  const int8_t *modes,
+  int num_modes,
+  kvz_pixel (*dst)[32 * 32],
+  bool filter_boundary);
+
 void kvz_intra_recon_cu(
   encoder_state_t *const state,
   int x,
@@ -35,6 +35,7 @@
 #include "image.h"
 #include "input_frame_buffer.h"
 #include "kvazaar_internal.h"
+#include "lookahead.h"
 #include "strategyselector.h"
 #include "threadqueue.h"
 #include "videoframe.h"
@@ -61,6 +62,15 @@ static void kvazaar_close(kvz_encoder *encoder)
       kvz_threadqueue_stop(encoder->control->threadqueue);
     }
 
+    // Free scaled inputs that were never encoded.
+    for (int i = 0; i < sizeof(encoder->scaled_input_pics) / sizeof(*encoder->scaled_input_pics); i++) {
+      kvz_image_free(encoder->scaled_input_pics[i]);
+      encoder->scaled_input_pics[i] = NULL;
+      kvz_image_scaling_jobs_free(&encoder->scaled_input_jobs[i]);
+    }
+    kvz_image_row_scaler_free(&encoder->input_scaler);
+    kvz_lookahead_free(&encoder->lookahead);
+
     if (encoder->states) {
       // Flush input frame buffer.
       kvz_picture *pic = NULL;
@@ -86,6 +96,8 @@ static void kvazaar_close(kvz_encoder *encoder)
     // Discard const from the pointer.
     kvz_encoder_control_free((void*) encoder->control);
     encoder->control = NULL;
+
+    FREE_POINTER(encoder->output_buffer);
   }
   else {
     return;
@@ -195,6 +207,7 @@ static kvz_encoder * kvazaar_open(const kvz_config *cfg)
     cur_enc->frames_done = 0;
 
     kvz_init_input_frame_buffer(&cur_enc->input_buffer);
+    kvz_lookahead_init(&cur_enc->lookahead);
 
     cur_enc->states = calloc(cur_enc->num_encoder_states, sizeof(encoder_state_t));
     if (!cur_enc->states) {
@@ -355,6 +368,80 @@ static int yuv_io_extract_field(const kvz_picture *frame_in, unsigned source_sca
 }
 
 
+/**
+ * \brief Pass an input frame through the lookahead to the input frame buffer.
+ *
+ * Sets the lookahead stats of the state if a frame is returned.
+ *
+ * With --scene-cut the frames before a cut are flushed from the input frame
+ * buffer and the GOP structure is restarted from the cut.
+ *
+ * \param enc           the encoder
+ * \param state         a main encoder state
+ * \param pic_in        input frame or NULL
+ * \param src_jobs      jobs scaling pic_in or NULL
+ * \param flush         whether the input has ended
+ * \param cut_lookahead lookahead deciding the scene cuts
+ * \return              the next picture to encode or NULL
+ */
+static kvz_picture * lookahead_feed_frame(kvz_encoder *enc,
+                                          encoder_state_t *const state,
+                                          kvz_picture *pic_in,
+                                          threadqueue_job_t *const *src_jobs,
+                                          int flush,
+                                          lookahead_t *cut_lookahead)
+{
+  const kvz_config *const cfg = &enc->control->cfg;
+  if (cfg->lookahead == 0) {
+    return kvz_encoder_feed_frame(&enc->input_buffer, state, pic_in);
+  }
+
+  if (pic_in != NULL) {
+    kvz_lookahead_feed(&enc->lookahead, enc->control, pic_in, src_jobs);
+  }
+
+  kvz_picture *frame = NULL;
+  int drain = pic_in == NULL;
+  for (;;) {
+    if (kvz_lookahead_empty(&enc->lookahead)) {
+      // The input frame buffer is flushed only after the lookahead.
+      frame = kvz_encoder_feed_frame(&enc->input_buffer, state, NULL);
+      break;
+    }
+    if (!drain && !kvz_lookahead_full(&enc->lookahead, enc->control)) {
+      // The lookahead is not full yet.
+      break;
+    }
+
+    if (cfg->scene_cut && kvz_lookahead_scene_cut(cut_lookahead, enc->lookahead.num_out)) {
+      if (enc->input_buffer.num_out < enc->input_buffer.num_in) {
+        // Encode the frames before the cut as if the sequence ended.
+        frame = kvz_encoder_feed_frame(&enc->input_buffer, state, NULL);
+        break;
+      }
+      kvz_init_input_frame_buffer(&enc->input_buffer);
+    }
+
+    kvz_picture *delayed = kvz_lookahead_get(&enc->lookahead);
+    frame = kvz_encoder_feed_frame(&enc->input_buffer, state, delayed);
+    kvz_image_free(delayed);
+
+    // Nothing is output after the input ends if the first frames are only
+    // buffered, so keep going until a frame is available. The lookahead may
+    // also hold extra frames after a scene cut.
+    if (frame != NULL || (!flush && !kvz_lookahead_full(&enc->lookahead, enc->control))) {
+      break;
+    }
+    drain |= flush;
+  }
+
+  if (frame != NULL) {
+    kvz_lookahead_take_stats(&enc->lookahead, enc->control, frame, &state->frame->lookahead);
+  }
+  return frame;
+}
+
+
 static int kvazaar_encode(kvz_encoder *enc,
                           kvz_picture *pic_in,
                           kvz_data_chunk **data_out,
@@ -381,7 +468,7 @@ static int kvazaar_encode(kvz_encoder *enc,
     CHECKPOINT_MARK("read source frame: %d", state->frame->num + enc->control->cfg.seek);
   }
 
-  kvz_picture* frame = kvz_encoder_feed_frame(&enc->input_buffer, state, pic_in);
+  kvz_picture* frame = lookahead_feed_frame(enc, state, pic_in, NULL, pic_in == NULL, &enc->lookahead);
   if (frame) {
     assert(state->frame->num == enc->frames_started);
     // Start encoding.
@@ -437,7 +524,7 @@ static void encode_delay(const int layer, kvz_picture **pic_in, kvz_data_chunk**
   static uint32_t d_len_out[MAX_LAYERS] = { 0 };
   static kvz_picture* d_pic_out[MAX_LAYERS] = { NULL };
   static kvz_picture* d_src_out[MAX_LAYERS] = { NULL };
-  static kvz_frame_info d_info_out[MAX_LAYERS] = { { 0, 0, 0, 0, {{0}}, {0}, 0, 0} };
+  static kvz_frame_info d_info_out[MAX_LAYERS] = { { 0, 0, 0, 0, {{0}}, {0}, 0, 0, 0 } };
 
   //Store new value and return the old one
   if (pic_in)
@@ -484,7 +571,6 @@ static void encode_delay(const int layer, kvz_picture **pic_in, kvz_data_chunk**
 }
 
 //TODO: make a note of this: Asume that info_out is an array with an element for each layer
-//TODO: Allow scaling "step-wise" instead of allways from the original, for a potentially reduced complexity?
 //TODO: Account for pic_in containing several input images for different layers
 //Use this function to aggregate the results etc. but otherwise just call kvazaar_encode with the correct encoder
 /*static int kvazaar_scalable_encode(kvz_encoder* enc, kvz_picture* pic_in, kvz_data_chunk** data_out, uint32_t* len_out, kvz_picture** pic_out, kvz_picture** src_out, kvz_frame_info* info_out)
@@ -606,6 +692,58 @@ static void encode_delay(const int layer, kvz_picture **pic_in, kvz_data_chunk**
   return 1;
 }*/
 
+//Keep the scaling jobs of pic until it is given to an encoder state
+static void add_scaled_input(kvz_encoder *enc, kvz_picture *pic, threadqueue_job_t **jobs)
+{
+  if (jobs == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < sizeof(enc->scaled_input_pics) / sizeof(*enc->scaled_input_pics); i++) {
+    if (enc->scaled_input_pics[i] == NULL) {
+      enc->scaled_input_pics[i] = kvz_image_copy_ref(pic);
+      enc->scaled_input_jobs[i] = jobs;
+      return;
+    }
+  }
+
+  //Should not happen, but if there is no room left just wait for the scaling to finish
+  for (int i = 0; jobs[i] != NULL; i++) {
+    kvz_threadqueue_waitfor(enc->control->threadqueue, jobs[i]);
+  }
+  kvz_image_scaling_jobs_free(&jobs);
+}
+
+//Return the scaling jobs of pic without taking them or NULL if pic was not scaled
+static threadqueue_job_t ** find_scaled_input_jobs(kvz_encoder *enc, const kvz_picture *pic)
+{
+  if (pic == NULL) {
+    return NULL;
+  }
+
+  for (int i = 0; i < sizeof(enc->scaled_input_pics) / sizeof(*enc->scaled_input_pics); i++) {
+    if (enc->scaled_input_pics[i] == pic) {
+      return enc->scaled_input_jobs[i];
+    }
+  }
+  return NULL;
+}
+
+//Return the scaling jobs of pic or NULL if pic was not scaled
+static threadqueue_job_t ** take_scaled_input_jobs(kvz_encoder *enc, const kvz_picture *pic)
+{
+  for (int i = 0; i < sizeof(enc->scaled_input_pics) / sizeof(*enc->scaled_input_pics); i++) {
+    if (enc->scaled_input_pics[i] == pic) {
+      threadqueue_job_t **jobs = enc->scaled_input_jobs[i];
+      kvz_image_free(enc->scaled_input_pics[i]);
+      enc->scaled_input_pics[i] = NULL;
+      enc->scaled_input_jobs[i] = NULL;
+      return jobs;
+    }
+  }
+  return NULL;
+}
+
 //Debug stuff for printing thread info
 #if 0 && defined(linux)
 #define PRINT_INFO(name,poc,lid) fprintf(stderr, "%s: poc: %d, lid: %d\n", name, poc, lid)
@@ -614,8 +752,37 @@ static void encode_delay(const int layer, kvz_picture **pic_in, kvz_data_chunk**
 #endif
 
 //TODO: make a note of this: Asume that info_out is an array with an element for each layer
-//TODO: Allow scaling "step-wise" instead of allways from the original, for a potentially reduced complexity?
 //Custom encoding loop for scalable encoding
+/**
+ * \brief Get the reconstruction of a layer for returning it.
+ *
+ * The returned pictures of the layers are chained together using
+ * base_image, so the reconstruction must not be the same picture as the
+ * returned source. In lossless mode they are the same, so a copy of the
+ * reconstruction is returned instead.
+ */
+static kvz_picture * output_rec(const encoder_state_t *const state, const bool chained)
+{
+  kvz_picture *const rec = state->tile->frame->rec;
+  if (!chained || rec != state->tile->frame->source) {
+    return kvz_image_copy_ref(rec);
+  }
+
+  kvz_picture *const copy = kvz_image_alloc(rec->chroma_format, rec->width, rec->height);
+  if (!copy) return kvz_image_copy_ref(rec);
+
+  const size_t luma_size = rec->width * rec->height;
+  const size_t chroma_size = rec->chroma_format == KVZ_CSP_400 ? 0 :
+    luma_size >> (rec->chroma_format == KVZ_CSP_420 ? 2 :
+                  rec->chroma_format == KVZ_CSP_422 ? 1 : 0);
+  memcpy(copy->fulldata, rec->fulldata, (luma_size + 2 * chroma_size) * sizeof(kvz_pixel));
+  copy->pts = rec->pts;
+  copy->dts = rec->dts;
+  copy->interlacing = rec->interlacing;
+
+  return copy;
+}
+
 static int kvazaar_scalable_encode(kvz_encoder *enc,
   kvz_picture *pic_in,
   kvz_data_chunk **data_out,
@@ -657,6 +824,23 @@ static int kvazaar_scalable_encode(kvz_encoder *enc,
   //For keeping track of states
   int frame_initialized[MAX_LAYERS] = { 0 };
   int pic_in_is_null[MAX_LAYERS] = { 0 };
+  int el_output = false;
+  const unsigned bl_frames_started = enc_list[0]->frames_started;
+  const unsigned bl_frames_done = enc_list[0]->frames_done;
+
+  //Scaling is done in LCU row jobs so that it overlaps with encoding. LCUs of the frame depend on the rows they use.
+  //With cascaded scaling a layer is scaled from a layer with a greater id, so start from the last layer.
+  kvz_picture *scaled_pics_in[MAX_LAYERS] = { NULL };
+  threadqueue_job_t **scaling_jobs[MAX_LAYERS] = { NULL };
+  for (int i = num_enc - 1; i >= 0; i--) {
+    const encoder_control_t *const ctrl = enc_list[i]->control;
+    const int src_layer = ctrl->layer.scaling_src_layer;
+    kvz_picture *const src_pic = src_layer >= 0 ? scaled_pics_in[src_layer] : pics_in[ctrl->layer.input_layer];
+    threadqueue_job_t **const src_jobs = src_layer >= 0 ? scaling_jobs[src_layer] : NULL;
+
+    scaled_pics_in[i] = kvz_image_deferred_row_scaling(src_pic, src_jobs, &enc_list[i]->input_scaler, &ctrl->layer.downscaling, 1,
+                                                       ctrl->threadqueue, LCU_WIDTH, &scaling_jobs[i]);
+  }
 
   //Prepare current states
   for (int i = 0; i < num_enc; i++){
@@ -669,7 +853,8 @@ static int kvazaar_scalable_encode(kvz_encoder *enc,
     }
 
     //Use these to store intermediate values of each encoder and aggregate the results into the actual output parameters
-    kvz_picture *cur_pic_in = kvz_image_scaling(pics_in[enc_list[i]->control->layer.input_layer], &enc_list[i]->control->layer.downscaling, 1);
+    kvz_picture *cur_pic_in = scaled_pics_in[i];
+    add_scaled_input(enc_list[i], cur_pic_in, scaling_jobs[i]);
     pic_in_is_null[i] = cur_pic_in == NULL;
 
     if (add_delay && i > 0) {
@@ -683,13 +868,22 @@ static int kvazaar_scalable_encode(kvz_encoder *enc,
       CHECKPOINT_MARK("read source frame: %d", state->frame->num + enc_list[i]->control->cfg.seek);
     }
 
-    kvz_picture* frame = kvz_encoder_feed_frame(&enc_list[i]->input_buffer, state, cur_pic_in);
+    //The delayed layers must stay one frame behind the base layer when the lookahead is flushed.
+    int flush = pic_in_is_null[i];
+    if (add_delay && i > 0) {
+      flush &= enc_list[i]->frames_started < bl_frames_started;
+    }
+
+    kvz_picture* frame = lookahead_feed_frame(enc_list[i], state, cur_pic_in,
+                                              find_scaled_input_jobs(enc_list[i], cur_pic_in),
+                                              flush, &enc_list[0]->lookahead);
     if (frame) {
       assert(state->frame->num == enc_list[i]->frames_started);
 
       kvz_scalability_prepare(state);
 
       kvz_init_one_frame(state, frame);
+      state->frame->tqj_source_scaling = take_scaled_input_jobs(enc_list[i], frame);
       frame_initialized[i] = true;
 
       //Set only_init parameter here since frame type has been set
@@ -727,9 +921,15 @@ static int kvazaar_scalable_encode(kvz_encoder *enc,
         enc_list[i]->cur_state_num = (enc_list[i]->cur_state_num + 1) % (enc_list[i]->num_encoder_states);
       }
 
+      //Likewise the delayed layers output a frame only after the base layer has output it.
+      int flush = pic_in_is_null[i];
+      if (add_delay && i > 0) {
+        flush &= enc_list[i]->frames_done < bl_frames_done;
+      }
+
       encoder_state_t *output_state = &enc_list[i]->states[enc_list[i]->out_state_num];
       if (!output_state->frame->done &&
-        (pic_in_is_null[i] || enc_list[i]->cur_state_num == enc_list[i]->out_state_num)) {
+        (flush || enc_list[i]->cur_state_num == enc_list[i]->out_state_num)) {
 
         kvz_threadqueue_waitfor(enc_list[i]->control->threadqueue, output_state->tqj_bitstream_written);
         // The job pointer must be set to NULL here since it won't be usable after
@@ -751,9 +951,9 @@ static int kvazaar_scalable_encode(kvz_encoder *enc,
         }
         if (pic_out) {
           if (*pic_out == NULL) {
-            *pic_out = kvz_image_copy_ref(output_state->tile->frame->rec);
+            *pic_out = output_rec(output_state, src_out && num_enc > 1);
           } else if (output_state->tile->frame->rec != *pic_out) {
-            (*pic_out)->base_image = kvz_image_copy_ref(output_state->tile->frame->rec);
+            (*pic_out)->base_image = output_rec(output_state, src_out && num_enc > 1);
             pic_out = &(*pic_out)->base_image;
           }
         }
@@ -770,6 +970,7 @@ static int kvazaar_scalable_encode(kvz_encoder *enc,
         output_state->frame->done = 1;
         output_state->frame->prepared = 0;
         enc_list[i]->frames_done += 1;
+        el_output |= i > 0;
 
         enc_list[i]->out_state_num = (enc_list[i]->out_state_num + 1) % (enc_list[i]->num_encoder_states);
       }
@@ -780,6 +981,13 @@ static int kvazaar_scalable_encode(kvz_encoder *enc,
     }
   }
 
+  //With the lookahead the first frames may be started only after the input has ended.
+  //The base layer output is delayed so nothing is returned yet, which would end the encoding.
+  if (add_delay && pic_in_is_null[0] && !el_output &&
+      enc_list[num_enc - 1]->frames_done < enc_list[0]->frames_done) {
+    return kvazaar_scalable_encode(enc_list[0], NULL, data_out, len_out, pic_out, src_out, info_out);
+  }
+
   return 1;
 }
 
@@ -876,6 +1084,65 @@ kvazaar_field_encoding_adapter_failure:
 }
 
 
+/**
+ * \brief Encode one frame and return the data in the output buffer of enc.
+ *
+ * The data is produced as a list of chunks like in encoder_encode and then
+ * copied to the buffer, which is kept for the next frames.
+ */
+static int kvazaar_encode_buffer(kvz_encoder *enc,
+                                 kvz_picture *pic_in,
+                                 const uint8_t **data_out,
+                                 uint32_t *len_out,
+                                 kvz_picture **pic_out,
+                                 kvz_picture **src_out,
+                                 kvz_frame_info *info_out)
+{
+  const int num_layers = enc->control->layer.max_layers;
+  uint32_t layer_len[MAX_LAYERS] = { 0 };
+  kvz_data_chunk *chunks = NULL;
+
+  if (data_out) *data_out = NULL;
+
+  if (!kvazaar_field_encoding_adapter(enc, pic_in, &chunks, layer_len,
+                                      pic_out, src_out, info_out)) {
+    return 0;
+  }
+
+  uint32_t total_len = 0;
+  for (int i = 0; i < num_layers; i++) {
+    if (info_out) info_out[i].data_offset = total_len;
+    total_len += layer_len[i];
+  }
+
+  if (total_len > enc->output_buffer_size) {
+    // Leave room for larger frames so that the buffer is rarely reallocated.
+    const uint32_t size = MAX(total_len, enc->output_buffer_size * 2);
+    uint8_t *buffer = realloc(enc->output_buffer, size);
+    if (!buffer) {
+      fprintf(stderr, "Failed to allocate output buffer.\n");
+      kvz_bitstream_free_chunks(chunks);
+      return 0;
+    }
+    enc->output_buffer = buffer;
+    enc->output_buffer_size = size;
+  }
+
+  uint32_t written = 0;
+  for (kvz_data_chunk *chunk = chunks; chunk != NULL; chunk = chunk->next) {
+    memcpy(enc->output_buffer + written, chunk->data, chunk->len);
+    written += chunk->len;
+  }
+  assert(written == total_len);
+
+  if (data_out && chunks) *data_out = enc->output_buffer;
+  if (len_out) memcpy(len_out, layer_len, num_layers * sizeof(*len_out));
+
+  kvz_bitstream_free_chunks(chunks);
+  return 1;
+}
+
+
 static const kvz_api kvz_8bit_api = {
   .config_alloc = kvz_config_alloc,
   .config_init = kvz_config_init,
@@ -893,6 +1160,9 @@ static const kvz_api kvz_8bit_api = {
   .encoder_encode = kvazaar_field_encoding_adapter,
 
   .picture_alloc_csp = kvz_image_alloc,
+
+  .encoder_encode_buffer = kvazaar_encode_buffer,
+  .picture_wrap_csp = kvz_image_wrap,
 };
 
 
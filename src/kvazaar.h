@@ -69,6 +69,12 @@ extern "C" {
  */
 #define KVZ_DATA_CHUNK_SIZE 4096
 
+/**
+ * Number of bytes before and after the pixel data of a picture that SIMD
+ * code may read.
+ */
+#define KVZ_PICTURE_PADDING 64
+
 #define KVZ_BIT_DEPTH 8
 #if KVZ_BIT_DEPTH == 8
 typedef uint8_t kvz_pixel;
@@ -128,6 +134,7 @@ enum kvz_hash
   KVZ_HASH_NONE = 0,
   KVZ_HASH_CHECKSUM = 1,
   KVZ_HASH_MD5 = 2,
+  KVZ_HASH_CRC = 3,
 };
 
 /**
@@ -418,11 +425,35 @@ typedef struct kvz_config
   /** \brief Enable Early Skip Mode Decision */
   uint8_t early_skip;
 
+  /**
+   * \brief Number of downscaled levels used for a coarse motion search
+   *        before the full resolution search. 0 to disable.
+   */
+  int8_t me_pyramid;
+
+  /**
+   * \brief Interpolate the quarter pixel positions of reference pictures
+   *        once for fractional motion estimation and inter prediction.
+   */
+  int8_t subpel_cache;
+
+  /** \brief Number of frames analysed ahead of the encoder. 0 to disable. */
+  int32_t lookahead;
+
+  /** \brief Adapt the QP of LCUs to the complexity given by the lookahead. */
+  int8_t lookahead_aq;
+
+  /** \brief Start a new sequence with an IDR picture at scene cuts. */
+  int8_t scene_cut;
+
 
 //*********************************************
   //For scalable extension. TODO: Move somewhere else?
   uint8_t layer;
   int8_t input_layer; //Which input layer this layer uses
+  int8_t downscaling_filter; //Filter used when downscaling the input. 0: select by scaling ratio, 1-8: sharpest to smoothest
+  int8_t ilr_fast_decision; //Limit the cu search based on the co-located cus of the ilr frame
+  int8_t ilr_mv_start; //Start the integer motion search from the scaled mv of the co-located ilr cu
 
   int32_t ILR_frames; //number of interlayer references. TODO: allow specifying the layers to use as ref
   
@@ -438,6 +469,8 @@ typedef struct kvz_config
     int wpp;
     int owf;
     int32_t threads;
+    int32_t lookahead; //Layers must be delayed by the same number of frames
+    int8_t scene_cut; //IRAP pictures need to be in the same access units in all layers
     int32_t multiview;
 
     uint8_t max_layers; //This needs to be shared between cfgs
@@ -458,6 +491,10 @@ typedef struct kvz_config
 
     uint8_t print_es_hierarchy; //Toggle encoder state hierarchy printing
 
+    uint8_t cascade_scaling; //Downscale layers from the closest larger layer instead of the input
+
+    char *threadqueue_log; //File for the threadqueue trace or NULL if disabled
+
   } *shared;
 
   //*********************************************
@@ -507,6 +544,9 @@ typedef struct kvz_picture {
   // Modified for SHVC.
   struct kvz_picture_info_t picture_info[16];
   // ***********************************************
+
+  struct kvz_picture *me_pyramid[2]; //!< \brief Source downscaled by 2 and 4 for hierarchical motion estimation. Set by the encoder.
+  struct subpel_planes_t *subpel_planes; //!< \brief Luma interpolated to quarter pixel positions for inter prediction. Set by the encoder.
 } kvz_picture;
 
 /**
@@ -629,6 +669,12 @@ typedef struct kvz_frame_info {
    */
   uint8_t tid;
   // ***********************************************
+
+  /**
+   * \brief Offset of the data of this frame in the buffer returned by
+   * encoder_encode_buffer, in bytes
+   */
+  uint32_t data_offset;
 } kvz_frame_info;
 
 /**
@@ -806,6 +852,57 @@ typedef struct kvz_api {
    * \return        allocated picture, or NULL if allocation failed.
    */
   kvz_picture * (*picture_alloc_csp)(enum kvz_chroma_format chroma_fomat, int32_t width, int32_t height);
+
+  /**
+   * \brief Allocate a kvz_picture using existing pixel data.
+   *
+   * The planes are laid out one after another like in pictures allocated
+   * with picture_alloc_csp. The data is not copied or freed by the
+   * encoder and it must stay valid until the picture has been freed,
+   * which may happen as late as encoder_close.
+   *
+   * KVZ_PICTURE_PADDING bytes before and after the data must be readable.
+   * The data must also be writable, since lossless coding may write the
+   * reconstruction into the input picture.
+   *
+   * \param chroma_format  Chroma subsampling of the data.
+   * \param width   width of luma pixel array
+   * \param height  height of luma pixel array
+   * \param data    pixel data of all planes
+   * \return        allocated picture, or NULL if allocation failed.
+   */
+  kvz_picture * (*picture_wrap_csp)(enum kvz_chroma_format chroma_format,
+                                    int32_t width,
+                                    int32_t height,
+                                    kvz_pixel *data);
+
+  /**
+   * \brief Encode one frame into a contiguous buffer.
+   *
+   * Works like encoder_encode, except that the encoded data is returned in
+   * a single buffer owned by the encoder instead of a list of chunks. The
+   * buffer is reused for the following frames, so the data is valid only
+   * until the next call to encoder_encode_buffer or encoder_close.
+   *
+   * The data of the layers follows each other in the order of the layers.
+   * The data of each layer starts at data_offset of its kvz_frame_info.
+   *
+   * \param encoder   encoder
+   * \param pic_in    input frame or NULL
+   * \param data_out  Returns a pointer to the encoded data, or NULL.
+   * \param len_out   Returns number of bytes in the encoded data.
+   * \param pic_out   Returns the reconstructed picture.
+   * \param src_out   Returns the original picture.
+   * \param info_out  Returns information about the encoded picture.
+   * \return          1 on success, 0 on error.
+   */
+  int           (*encoder_encode_buffer)(kvz_encoder *encoder,
+                                         kvz_picture *pic_in,
+                                         const uint8_t **data_out,
+                                         uint32_t *len_out,
+                                         kvz_picture **pic_out,
+                                         kvz_picture **src_out,
+                                         kvz_frame_info *info_out);
 } kvz_api;
 
 
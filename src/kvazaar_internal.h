@@ -29,7 +29,10 @@
 #include "global.h" // IWYU pragma: keep
 
 #include "kvazaar.h"
+#include "image.h"
 #include "input_frame_buffer.h"
+#include "lookahead.h"
+#include "threadqueue.h"
 
 // ***********************************************
   // Modified for SHVC
@@ -63,9 +66,20 @@ struct kvz_encoder {
    */
   input_frame_buffer_t input_buffer;
 
+  /**
+   * \brief Delays the input for analysing frames ahead of the encoder.
+   */
+  lookahead_t lookahead;
+
   unsigned frames_started;
   unsigned frames_done;
 
+  /**
+   * \brief Buffer for the data returned by encoder_encode_buffer.
+   */
+  uint8_t *output_buffer;
+  uint32_t output_buffer_size;
+
   // ***********************************************
   // Modified for SHVC
   //TODO: Add all the encoders as a list?
@@ -79,6 +93,13 @@ struct kvz_encoder {
   //scaling_parameter_t downscaling;
   //scaling_parameter_t upscaling;
 
+  //Scaled input pictures not yet given to an encoder state and the jobs scaling them.
+  //Lookahead and input buffer can hold LOOKAHEAD_MAX_FRAMES + 3 * KVZ_MAX_GOP_LENGTH pictures and one more can be delayed.
+  kvz_picture *scaled_input_pics[LOOKAHEAD_MAX_FRAMES + 3 * KVZ_MAX_GOP_LENGTH + 1];
+  threadqueue_job_t **scaled_input_jobs[LOOKAHEAD_MAX_FRAMES + 3 * KVZ_MAX_GOP_LENGTH + 1];
+  //Pictures and buffers reused when scaling the input
+  kvz_image_row_scaler_t input_scaler;
+
   // ***********************************************
   
 };
@@ -0,0 +1,433 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (C) 2013-2015 Tampere University of Technology and others (see
+ * COPYING file).
+ *
+ * Kvazaar is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * Kvazaar is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+#include "lookahead.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "encoder.h"
+#include "strategies/strategies-picture.h"
+
+
+//! Size of the analysed blocks at half resolution.
+#define LOOKAHEAD_BLOCK 8
+
+//! Maximum number of one pixel steps taken from the best predicted mv.
+#define LOOKAHEAD_SEARCH_STEPS 16
+
+//! Minimum ratio of the frame cost to the intra cost at a scene cut, in percent.
+#define SCENE_CUT_THRESHOLD 60
+
+//! Minimum number of frames between scene cuts.
+#define SCENE_CUT_MIN_DISTANCE 4
+
+
+/**
+ * \brief Cost of the best of DC, horizontal and vertical prediction.
+ *
+ * The prediction uses the neighbouring source pixels instead of the
+ * reconstruction.
+ */
+static uint32_t intra_cost(const kvz_picture *pic, int x, int y)
+{
+  const int stride = pic->stride;
+  const kvz_pixel *const block = &pic->y[x + y * stride];
+  kvz_pixel pred[LOOKAHEAD_BLOCK * LOOKAHEAD_BLOCK];
+
+  int sum = 0;
+  int count = 0;
+  if (y > 0) {
+    for (int i = 0; i < LOOKAHEAD_BLOCK; ++i) sum += block[i - stride];
+    count += LOOKAHEAD_BLOCK;
+  }
+  if (x > 0) {
+    for (int i = 0; i < LOOKAHEAD_BLOCK; ++i) sum += block[i * stride - 1];
+    count += LOOKAHEAD_BLOCK;
+  }
+  const kvz_pixel dc = count ? (sum + count / 2) / count : 1 << (KVZ_BIT_DEPTH - 1);
+
+  for (int i = 0; i < LOOKAHEAD_BLOCK * LOOKAHEAD_BLOCK; ++i) pred[i] = dc;
+  uint32_t cost = kvz_satd_any_size(LOOKAHEAD_BLOCK, LOOKAHEAD_BLOCK, block, stride, pred, LOOKAHEAD_BLOCK);
+
+  if (y > 0) {
+    for (int i = 0; i < LOOKAHEAD_BLOCK; ++i) {
+      memcpy(&pred[i * LOOKAHEAD_BLOCK], block - stride, LOOKAHEAD_BLOCK * sizeof(kvz_pixel));
+    }
+    cost = MIN(cost, kvz_satd_any_size(LOOKAHEAD_BLOCK, LOOKAHEAD_BLOCK, block, stride, pred, LOOKAHEAD_BLOCK));
+  }
+  if (x > 0) {
+    for (int i = 0; i < LOOKAHEAD_BLOCK * LOOKAHEAD_BLOCK; ++i) {
+      pred[i] = block[(i / LOOKAHEAD_BLOCK) * stride - 1];
+    }
+    cost = MIN(cost, kvz_satd_any_size(LOOKAHEAD_BLOCK, LOOKAHEAD_BLOCK, block, stride, pred, LOOKAHEAD_BLOCK));
+  }
+
+  return cost;
+}
+
+/**
+ * \brief Find a motion vector for the block.
+ *
+ * The best of the zero mv and the predictors is refined with a small
+ * diamond search using SAD.
+ */
+static vector2d_t motion_search(const kvz_picture *pic, const kvz_picture *ref, int x, int y,
+                                const vector2d_t *preds, int num_preds,
+                                optimized_sad_func_ptr_t optimized_sad)
+{
+  // Keep the reference block within one block of the picture.
+  const int min_x = -x - LOOKAHEAD_BLOCK;
+  const int max_x = ref->width - x;
+  const int min_y = -y - LOOKAHEAD_BLOCK;
+  const int max_y = ref->height - y;
+
+  vector2d_t best = { 0, 0 };
+  unsigned best_cost = kvz_image_calc_sad(pic, ref, x, y, x, y,
+                                          LOOKAHEAD_BLOCK, LOOKAHEAD_BLOCK, optimized_sad);
+
+  for (int i = 0; i < num_preds; ++i) {
+    const vector2d_t mv = { CLIP(min_x, max_x, preds[i].x), CLIP(min_y, max_y, preds[i].y) };
+    if (mv.x == best.x && mv.y == best.y) continue;
+    unsigned cost = kvz_image_calc_sad(pic, ref, x, y, x + mv.x, y + mv.y,
+                                       LOOKAHEAD_BLOCK, LOOKAHEAD_BLOCK, optimized_sad);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = mv;
+    }
+  }
+
+  static const vector2d_t diamond[4] = { { 0, -1 }, { -1, 0 }, { 1, 0 }, { 0, 1 } };
+  for (int step = 0; step < LOOKAHEAD_SEARCH_STEPS; ++step) {
+    vector2d_t center = best;
+    for (int i = 0; i < 4; ++i) {
+      const vector2d_t mv = { center.x + diamond[i].x, center.y + diamond[i].y };
+      if (mv.x < min_x || mv.x > max_x || mv.y < min_y || mv.y > max_y) continue;
+      unsigned cost = kvz_image_calc_sad(pic, ref, x, y, x + mv.x, y + mv.y,
+                                         LOOKAHEAD_BLOCK, LOOKAHEAD_BLOCK, optimized_sad);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best = mv;
+      }
+    }
+    if (best.x == center.x && best.y == center.y) break;
+  }
+
+  return best;
+}
+
+/**
+ * \brief Estimate the costs of a frame.
+ *
+ * Threadqueue worker. Blocks are processed in raster order so that the mvs
+ * of the left and upper blocks can be used as predictors.
+ */
+static void lookahead_analyse(void *arg)
+{
+  lookahead_frame_t *const frame = arg;
+  const encoder_control_t *const encoder = frame->encoder;
+  const kvz_picture *const pic = frame->half;
+  const kvz_picture *ref = frame->ref;
+  const int width_in_lcu = encoder->in.width_in_lcu;
+  const int num_lcus = width_in_lcu * encoder->in.height_in_lcu;
+
+  frame->cost = 0;
+  frame->intra_cost = 0;
+  memset(frame->lcu_costs, 0, num_lcus * sizeof(*frame->lcu_costs));
+  memset(frame->lcu_intra_costs, 0, num_lcus * sizeof(*frame->lcu_intra_costs));
+
+  if (pic->width < LOOKAHEAD_BLOCK || pic->height < LOOKAHEAD_BLOCK) {
+    kvz_image_free(frame->ref);
+    frame->ref = NULL;
+    return;
+  }
+
+  const int width_in_blocks = (pic->width + LOOKAHEAD_BLOCK - 1) / LOOKAHEAD_BLOCK;
+  const int height_in_blocks = (pic->height + LOOKAHEAD_BLOCK - 1) / LOOKAHEAD_BLOCK;
+  const optimized_sad_func_ptr_t optimized_sad = kvz_get_optimized_sad(LOOKAHEAD_BLOCK);
+
+  // Mvs of the current and the previous block row.
+  vector2d_t *mvs = MALLOC(vector2d_t, 2 * width_in_blocks);
+  if (mvs == NULL) {
+    // Only the intra costs are estimated.
+    fprintf(stderr, "Failed to allocate the lookahead mvs.\n");
+    ref = NULL;
+  }
+
+  for (int by = 0; by < height_in_blocks; ++by) {
+    vector2d_t *const cur_mvs = mvs ? &mvs[(by & 1) * width_in_blocks] : NULL;
+    const vector2d_t *const above_mvs = mvs ? &mvs[((by + 1) & 1) * width_in_blocks] : NULL;
+    // The last blocks overlap the previous ones if the size is not a multiple of the block size.
+    const int y = MIN(by * LOOKAHEAD_BLOCK, pic->height - LOOKAHEAD_BLOCK);
+
+    for (int bx = 0; bx < width_in_blocks; ++bx) {
+      const int x = MIN(bx * LOOKAHEAD_BLOCK, pic->width - LOOKAHEAD_BLOCK);
+
+      const uint32_t block_intra_cost = intra_cost(pic, x, y);
+      uint32_t block_cost = block_intra_cost;
+
+      if (ref != NULL) {
+        vector2d_t preds[3];
+        int num_preds = 0;
+        if (bx > 0) preds[num_preds++] = cur_mvs[bx - 1];
+        if (by > 0) preds[num_preds++] = above_mvs[bx];
+        if (by > 0 && bx + 1 < width_in_blocks) preds[num_preds++] = above_mvs[bx + 1];
+
+        const vector2d_t mv = motion_search(pic, ref, x, y, preds, num_preds, optimized_sad);
+        cur_mvs[bx] = mv;
+        block_cost = MIN(block_cost, kvz_image_calc_satd(pic, ref, x, y, x + mv.x, y + mv.y,
+                                                         LOOKAHEAD_BLOCK, LOOKAHEAD_BLOCK));
+      }
+
+      // Blocks are 2 * LOOKAHEAD_BLOCK pixels wide at full resolution.
+      const int lcu_x = MIN(bx * 2 * LOOKAHEAD_BLOCK / LCU_WIDTH, width_in_lcu - 1);
+      const int lcu_y = MIN(by * 2 * LOOKAHEAD_BLOCK / LCU_WIDTH, encoder->in.height_in_lcu - 1);
+      frame->lcu_costs[lcu_x + lcu_y * width_in_lcu] += block_cost;
+      frame->lcu_intra_costs[lcu_x + lcu_y * width_in_lcu] += block_intra_cost;
+      frame->cost += block_cost;
+      frame->intra_cost += block_intra_cost;
+    }
+  }
+
+  FREE_POINTER(mvs);
+  kvz_image_free(frame->ref);
+  frame->ref = NULL;
+}
+
+/**
+ * \brief Release the pictures and jobs of a frame.
+ *
+ * The costs are kept until the frame is reused.
+ */
+static void lookahead_frame_release(lookahead_frame_t *frame)
+{
+  kvz_image_free(frame->pic);
+  frame->pic = NULL;
+  kvz_image_free(frame->half);
+  frame->half = NULL;
+  kvz_image_scaling_jobs_free(&frame->tqj_scaling);
+}
+
+void kvz_lookahead_init(lookahead_t *lookahead)
+{
+  FILL(*lookahead, 0);
+}
+
+/**
+ * \brief Free the lookahead.
+ *
+ * The threadqueue must have been stopped.
+ */
+void kvz_lookahead_free(lookahead_t *lookahead)
+{
+  for (int i = 0; i < LOOKAHEAD_BUFFER_SIZE; ++i) {
+    lookahead_frame_t *const frame = &lookahead->frames[i];
+    lookahead_frame_release(frame);
+    // Set if the analysis was never run.
+    kvz_image_free(frame->ref);
+    frame->ref = NULL;
+    kvz_threadqueue_free_job(&frame->tqj_analysis);
+    FREE_POINTER(frame->lcu_costs);
+    FREE_POINTER(frame->lcu_intra_costs);
+  }
+  kvz_image_row_scaler_free(&lookahead->scaler);
+}
+
+/**
+ * \brief Pass an input frame to the lookahead.
+ *
+ * Starts the analysis of the frame.
+ *
+ * \param lookahead   the lookahead
+ * \param encoder     encoder control
+ * \param pic_in      input frame
+ * \param src_jobs    jobs scaling pic_in or NULL if it is ready
+ */
+void kvz_lookahead_feed(lookahead_t *lookahead,
+                        const encoder_control_t *encoder,
+                        kvz_picture *pic_in,
+                        threadqueue_job_t *const *src_jobs)
+{
+  const uint64_t num = lookahead->num_in;
+  lookahead_frame_t *const frame = &lookahead->frames[num % LOOKAHEAD_BUFFER_SIZE];
+  lookahead_frame_t *const prev = &lookahead->frames[(num + LOOKAHEAD_BUFFER_SIZE - 1) % LOOKAHEAD_BUFFER_SIZE];
+
+  // Normally the stats of the previous user have been taken already.
+  if (frame->tqj_analysis != NULL) {
+    kvz_threadqueue_waitfor(encoder->threadqueue, frame->tqj_analysis);
+    kvz_threadqueue_free_job(&frame->tqj_analysis);
+  }
+  lookahead_frame_release(frame);
+
+  const int num_lcus = encoder->in.width_in_lcu * encoder->in.height_in_lcu;
+  if (frame->lcu_costs == NULL) {
+    frame->lcu_costs = MALLOC(uint32_t, num_lcus);
+    frame->lcu_intra_costs = MALLOC(uint32_t, num_lcus);
+  }
+
+  frame->encoder = encoder;
+  frame->num = num;
+  frame->scene_cut = -1;
+  frame->pic = kvz_image_copy_ref(pic_in);
+  frame->half = kvz_image_deferred_row_scaling(pic_in, src_jobs, &lookahead->scaler,
+                                               &encoder->lookahead_scaling, 0,
+                                               encoder->threadqueue, LCU_WIDTH,
+                                               &frame->tqj_scaling);
+
+  if (frame->half == NULL || frame->lcu_costs == NULL || frame->lcu_intra_costs == NULL) {
+    // The frame is encoded without stats.
+    fprintf(stderr, "Failed to allocate a lookahead frame.\n");
+  } else {
+    frame->tqj_analysis = kvz_threadqueue_job_create(lookahead_analyse, frame);
+    kvz_threadqueue_job_describe(encoder->threadqueue, frame->tqj_analysis,
+                                 "type=lookahead,frame=%d", (int)num);
+    for (int i = 0; frame->tqj_scaling[i] != NULL; ++i) {
+      kvz_threadqueue_job_dep_add(frame->tqj_analysis, frame->tqj_scaling[i]);
+    }
+    if (num > 0 && prev->num == num - 1 && prev->half != NULL) {
+      frame->ref = kvz_image_copy_ref(prev->half);
+      for (int i = 0; prev->tqj_scaling[i] != NULL; ++i) {
+        kvz_threadqueue_job_dep_add(frame->tqj_analysis, prev->tqj_scaling[i]);
+      }
+    }
+    kvz_threadqueue_submit(encoder->threadqueue, frame->tqj_analysis);
+  }
+
+  lookahead->num_in++;
+}
+
+/**
+ * \brief Get the oldest frame in the lookahead.
+ *
+ * \param lookahead   the lookahead
+ * \return            reference to the next frame to encode or NULL if the
+ *                    lookahead is empty
+ */
+kvz_picture * kvz_lookahead_get(lookahead_t *lookahead)
+{
+  if (lookahead->num_out == lookahead->num_in) {
+    return NULL;
+  }
+
+  lookahead_frame_t *const frame = &lookahead->frames[lookahead->num_out % LOOKAHEAD_BUFFER_SIZE];
+  lookahead->num_out++;
+  return kvz_image_copy_ref(frame->pic);
+}
+
+/**
+ * \brief Whether all frames given to the lookahead have been output.
+ */
+bool kvz_lookahead_empty(const lookahead_t *lookahead)
+{
+  return lookahead->num_out == lookahead->num_in;
+}
+
+/**
+ * \brief Whether the lookahead holds more than cfg.lookahead frames.
+ */
+bool kvz_lookahead_full(const lookahead_t *lookahead, const encoder_control_t *encoder)
+{
+  return lookahead->num_in - lookahead->num_out > encoder->cfg.lookahead;
+}
+
+/**
+ * \brief Whether a frame starts a new scene.
+ *
+ * Waits for the analysis of the frame. The decisions must be made in input
+ * order since cuts closer than SCENE_CUT_MIN_DISTANCE frames to the previous
+ * one are ignored.
+ *
+ * \param lookahead   the lookahead
+ * \param num         number of a frame in the lookahead
+ * \return            true if the frame is a scene cut
+ */
+bool kvz_lookahead_scene_cut(lookahead_t *lookahead, uint64_t num)
+{
+  lookahead_frame_t *const frame = &lookahead->frames[num % LOOKAHEAD_BUFFER_SIZE];
+  if (frame->num != num || frame->encoder == NULL) return false;
+
+  if (frame->scene_cut < 0) {
+    frame->scene_cut = 0;
+    if (frame->tqj_analysis != NULL) {
+      kvz_threadqueue_waitfor(frame->encoder->threadqueue, frame->tqj_analysis);
+      // The first frame has no inter cost.
+      frame->scene_cut = num > 0 &&
+                         num >= lookahead->last_scene_cut + SCENE_CUT_MIN_DISTANCE &&
+                         frame->cost * 100 >= frame->intra_cost * SCENE_CUT_THRESHOLD;
+    }
+    if (frame->scene_cut) {
+      lookahead->last_scene_cut = num;
+    }
+  }
+  return frame->scene_cut;
+}
+
+/**
+ * \brief Get the stats of a frame output by the lookahead.
+ *
+ * Waits for the analysis of the frame and the following frames in the
+ * lookahead and releases the frame. The LCU costs are copied to the arrays
+ * of stats. stats->valid is set to false if the frame was not analysed.
+ *
+ * \param lookahead   the lookahead
+ * \param encoder     encoder control
+ * \param pic         picture returned by kvz_lookahead_get
+ * \param stats       returns the stats
+ */
+void kvz_lookahead_take_stats(lookahead_t *lookahead,
+                              const encoder_control_t *encoder,
+                              const kvz_picture *pic,
+                              lookahead_stats_t *stats)
+{
+  stats->valid = false;
+
+  lookahead_frame_t *frame = NULL;
+  for (int i = 0; i < LOOKAHEAD_BUFFER_SIZE; ++i) {
+    if (lookahead->frames[i].pic == pic) {
+      frame = &lookahead->frames[i];
+      break;
+    }
+  }
+  if (frame == NULL) return;
+
+  if (frame->tqj_analysis != NULL) {
+    // Average the costs over the frames analysed so far.
+    double window_cost = 0.0;
+    int window_size = 0;
+    for (uint64_t num = frame->num; num <= frame->num + encoder->cfg.lookahead && num < lookahead->num_in; ++num) {
+      lookahead_frame_t *const next = &lookahead->frames[num % LOOKAHEAD_BUFFER_SIZE];
+      if (next->num != num || next->tqj_analysis == NULL) break;
+      kvz_threadqueue_waitfor(encoder->threadqueue, next->tqj_analysis);
+      window_cost += next->cost;
+      window_size++;
+    }
+
+    const int num_lcus = encoder->in.width_in_lcu * encoder->in.height_in_lcu;
+    stats->valid = true;
+    stats->cost = frame->cost;
+    stats->intra_cost = frame->intra_cost;
+    stats->window_cost = window_cost / window_size;
+    memcpy(stats->lcu_costs, frame->lcu_costs, num_lcus * sizeof(*stats->lcu_costs));
+    memcpy(stats->lcu_intra_costs, frame->lcu_intra_costs, num_lcus * sizeof(*stats->lcu_intra_costs));
+  }
+
+  lookahead_frame_release(frame);
+}
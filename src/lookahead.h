@@ -0,0 +1,149 @@
+#ifndef LOOKAHEAD_H_
+#define LOOKAHEAD_H_
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (C) 2013-2015 Tampere University of Technology and others (see
+ * COPYING file).
+ *
+ * Kvazaar is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * Kvazaar is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+/**
+ * \ingroup Control
+ * \file
+ * Cheap analysis of input frames before they are encoded.
+ *
+ * Input frames are delayed by cfg.lookahead frames. Meanwhile each frame is
+ * scaled to half resolution and the cost of coding it with intra and inter
+ * prediction is estimated with SATD in 8x8 blocks, i.e. 16x16 blocks of the
+ * full resolution frame. The analysis is done in threadqueue jobs.
+ *
+ * A frame is a scene cut if inter prediction from the previous frame barely
+ * reduces its cost.
+ */
+
+#include "global.h" // IWYU pragma: keep
+#include "image.h"
+#include "kvazaar.h"
+#include "threadqueue.h"
+
+
+// Forward declaration.
+struct encoder_control_t;
+
+/**
+ * \brief Number of frames buffered in addition to the lookahead depth.
+ *
+ * Frames are kept until they are given to an encoder state, which can take
+ * as long as the GOP reordering buffer and the one frame delay of the
+ * enhancement layers.
+ */
+#define LOOKAHEAD_BUFFER_SIZE (LOOKAHEAD_MAX_FRAMES + 3 * KVZ_MAX_GOP_LENGTH + 2)
+
+/**
+ * \brief Complexity estimates of a frame.
+ *
+ * Costs are sums of SATD of the best prediction at half resolution.
+ */
+typedef struct lookahead_stats_t {
+  //! \brief Whether the estimates have been set for the current frame.
+  bool valid;
+
+  //! \brief Cost of the frame using the cheaper of intra and inter prediction.
+  uint64_t cost;
+
+  //! \brief Cost of the frame using intra prediction only.
+  uint64_t intra_cost;
+
+  //! \brief Average cost of the frames from this frame to the end of the lookahead.
+  double window_cost;
+
+  //! \brief Cost of each LCU in raster order.
+  uint32_t *lcu_costs;
+
+  //! \brief Intra cost of each LCU in raster order.
+  uint32_t *lcu_intra_costs;
+} lookahead_stats_t;
+
+typedef struct lookahead_frame_t {
+  const struct encoder_control_t *encoder;
+
+  //! \brief Frame number in input order.
+  uint64_t num;
+
+  //! \brief Input picture. The reference is held until the stats are taken.
+  kvz_picture *pic;
+
+  //! \brief Input picture scaled to half resolution, luma only.
+  kvz_picture *half;
+
+  //! \brief Half resolution picture of the previous frame or NULL.
+  kvz_picture *ref;
+
+  //! \brief Jobs scaling the half resolution picture.
+  threadqueue_job_t **tqj_scaling;
+
+  //! \brief Job doing the analysis.
+  threadqueue_job_t *tqj_analysis;
+
+  uint64_t cost;
+  uint64_t intra_cost;
+  uint32_t *lcu_costs;
+  uint32_t *lcu_intra_costs;
+
+  //! \brief 1 if the frame starts a new scene, 0 if not and -1 if not decided yet.
+  int8_t scene_cut;
+} lookahead_frame_t;
+
+typedef struct lookahead_t {
+  //! \brief Frames indexed by num % LOOKAHEAD_BUFFER_SIZE.
+  lookahead_frame_t frames[LOOKAHEAD_BUFFER_SIZE];
+
+  //! \brief Number of frames input.
+  uint64_t num_in;
+
+  //! \brief Number of frames output.
+  uint64_t num_out;
+
+  //! \brief Number of the last frame that started a new scene.
+  uint64_t last_scene_cut;
+
+  //! \brief Pictures and buffers reused when scaling to half resolution.
+  kvz_image_row_scaler_t scaler;
+} lookahead_t;
+
+void kvz_lookahead_init(lookahead_t *lookahead);
+void kvz_lookahead_free(lookahead_t *lookahead);
+
+void kvz_lookahead_feed(lookahead_t *lookahead,
+                        const struct encoder_control_t *encoder,
+                        kvz_picture *pic_in,
+                        threadqueue_job_t *const *src_jobs);
+
+kvz_picture * kvz_lookahead_get(lookahead_t *lookahead);
+
+bool kvz_lookahead_empty(const lookahead_t *lookahead);
+
+bool kvz_lookahead_full(const lookahead_t *lookahead,
+                        const struct encoder_control_t *encoder);
+
+bool kvz_lookahead_scene_cut(lookahead_t *lookahead, uint64_t num);
+
+void kvz_lookahead_take_stats(lookahead_t *lookahead,
+                              const struct encoder_control_t *encoder,
+                              const kvz_picture *pic,
+                              lookahead_stats_t *stats);
+
+#endif // LOOKAHEAD_H_
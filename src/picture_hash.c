@@ -0,0 +1,371 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (C) 2013-2015 Tampere University of Technology and others (see
+ * COPYING file).
+ *
+ * Kvazaar is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * Kvazaar is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+#include "picture_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "strategies/strategies-nal.h"
+#include "threads.h"
+
+
+enum {
+  ROW_NOT_FINAL = 0,
+  ROW_HASHING = 1,
+  ROW_HASHED = 2,
+};
+
+//! \brief CRC polynomial x^16 + x^12 + x^5 + 1 of the picture CRC.
+#define CRC_POLYNOMIAL 0x1021
+
+/**
+ * \brief Initial value of a table-driven CRC equal to the picture CRC.
+ *
+ * The picture CRC starts from 0xffff and shifts the bits of the data in
+ * from the bottom, followed by 16 zero bits. That is equal to shifting the
+ * data in from the top starting from 0xffff * x^16.
+ */
+#define CRC_INIT 0x1d0f
+
+static const uint16_t crc_table[256] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+  0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+  0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+  0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+  0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+  0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+  0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+  0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+  0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+  0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+  0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+  0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+  0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+  0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+  0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+  0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+  0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+  0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+  0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+  0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+  0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+  0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+  0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+
+/**
+ * \brief Multiply two polynomials modulo the CRC polynomial.
+ */
+static uint16_t crc_mul(uint16_t a, uint16_t b)
+{
+  uint32_t result = 0;
+  for (int i = 15; i >= 0; --i) {
+    result <<= 1;
+    if (result & 0x10000) result ^= 0x10000 | CRC_POLYNOMIAL;
+    if ((b >> i) & 1) result ^= a;
+  }
+  return result;
+}
+
+/**
+ * \brief Shift a CRC over data of the given length.
+ *
+ * The CRC of data following other data is the CRC of the data alone xored
+ * with the CRC of the preceding data shifted over it.
+ *
+ * \param crc     CRC of the preceding data
+ * \param bytes   length of the following data in bytes
+ */
+static uint16_t crc_shift(uint16_t crc, uint32_t bytes)
+{
+  // x^8
+  uint16_t power = 0x100;
+  for (; bytes; bytes >>= 1) {
+    if (bytes & 1) crc = crc_mul(crc, power);
+    power = crc_mul(power, power);
+  }
+  return crc;
+}
+
+static uint16_t array_crc(const kvz_pixel *data,
+                          int width, int height, int stride,
+                          uint8_t bitdepth)
+{
+  uint16_t crc = 0;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const kvz_pixel pixel = data[x + y * stride];
+      crc = (crc << 8) ^ crc_table[((crc >> 8) ^ pixel) & 0xff];
+      if (bitdepth > 8) {
+        crc = (crc << 8) ^ crc_table[((crc >> 8) ^ (pixel >> 8)) & 0xff];
+      }
+    }
+  }
+  return crc;
+}
+
+
+/**
+ * \brief Get the pixels of a color of an LCU row.
+ *
+ * \param hash    hash state
+ * \param color   color index
+ * \param row     LCU row
+ * \param y       returns the y of the first pixel row in the color plane
+ * \param width   returns the width in pixels
+ * \param height  returns the height in pixels
+ * \param stride  returns the stride in pixels
+ * \return pointer to the first pixel of the row
+ */
+static const kvz_pixel * row_pixels(const picture_hash_t *hash,
+                                    int color, int row,
+                                    int *y, int *width, int *height, int *stride)
+{
+  const kvz_picture *pic = hash->pic;
+  const int y_luma = row * LCU_WIDTH;
+  const int height_luma = MIN(LCU_WIDTH, pic->height - y_luma);
+
+  // The number of chroma pixels is half that of luma.
+  const int shift = color == COLOR_Y ? 0 : 1;
+
+  *y = y_luma >> shift;
+  *width = pic->width >> shift;
+  *height = height_luma >> shift;
+  *stride = pic->stride >> shift;
+
+  return &pic->data[color][*y * *stride];
+}
+
+static int num_colors(const picture_hash_t *hash)
+{
+  return hash->pic->chroma_format == KVZ_CSP_400 ? 1 : 3;
+}
+
+/**
+ * \brief Update the MD5 with the rows that are hashed.
+ *
+ * Only one thread updates the MD5 at a time. Others return immediately
+ * and the thread updating it continues with their rows.
+ */
+static void update_md5(picture_hash_t *hash)
+{
+  while (KVZ_ATOMIC_CAS(&hash->md5_busy, 0, 1)) {
+    int row = hash->md5_row;
+    for (; row < hash->height_in_lcu; ++row) {
+      if (KVZ_ATOMIC_LOAD(&hash->row_state[row]) != ROW_HASHED) break;
+
+      for (int color = 0; color < num_colors(hash); ++color) {
+        int y, width, height, stride;
+        const kvz_pixel *data = row_pixels(hash, color, row, &y, &width, &height, &stride);
+        for (int i = 0; i < height; ++i) {
+          kvz_md5_update(&hash->md5[color],
+                         (const unsigned char *)&data[i * stride],
+                         width * sizeof(kvz_pixel));
+        }
+      }
+    }
+    hash->md5_row = row;
+
+    KVZ_ATOMIC_STORE(&hash->md5_busy, 0);
+    KVZ_ATOMIC_FENCE();
+
+    // If the next row was hashed after it was checked, its thread may have
+    // seen the MD5 busy and left it to us.
+    if (row == hash->height_in_lcu ||
+        KVZ_ATOMIC_LOAD(&hash->row_state[row]) != ROW_HASHED) {
+      break;
+    }
+  }
+}
+
+static void hash_row(picture_hash_t *hash, int row)
+{
+  // MD5 is updated with the rows in order.
+  if (hash->type != KVZ_HASH_MD5) {
+    for (int color = 0; color < num_colors(hash); ++color) {
+      int y, width, height, stride;
+      const kvz_pixel *data = row_pixels(hash, color, row, &y, &width, &height, &stride);
+
+      if (hash->type == KVZ_HASH_CHECKSUM) {
+        unsigned char checksum[SEI_HASH_MAX_LENGTH];
+        kvz_array_checksum(data, y, height, width, stride, checksum, hash->bitdepth);
+        hash->row_hash[row][color] =
+          (checksum[0] << 24) + (checksum[1] << 16) + (checksum[2] << 8) + checksum[3];
+      } else {
+        hash->row_hash[row][color] = array_crc(data, width, height, stride, hash->bitdepth);
+      }
+    }
+  }
+
+  KVZ_ATOMIC_STORE(&hash->row_state[row], ROW_HASHED);
+
+  if (hash->type == KVZ_HASH_MD5) {
+    update_md5(hash);
+  }
+}
+
+static bool row_done(const picture_hash_t *hash, int row)
+{
+  return KVZ_ATOMIC_LOAD(&hash->lcus_done[row]) == hash->width_in_lcu;
+}
+
+/**
+ * \brief Hash a row if its pixels are final and no one else is hashing it.
+ */
+static void try_hash_row(picture_hash_t *hash, int row)
+{
+  // Deblocking and SAO of a row modify the bottom pixels of the row above.
+  if (!row_done(hash, row) ||
+      (row + 1 < hash->height_in_lcu && !row_done(hash, row + 1)) ||
+      !KVZ_ATOMIC_CAS(&hash->row_state[row], ROW_NOT_FINAL, ROW_HASHING))
+  {
+    return;
+  }
+  hash_row(hash, row);
+}
+
+
+/**
+ * \brief Allocate the hash state for pictures of the given size.
+ *
+ * \return hash state or NULL on failure
+ */
+picture_hash_t * kvz_picture_hash_alloc(int32_t width, int32_t height)
+{
+  picture_hash_t *hash = calloc(1, sizeof(picture_hash_t));
+  if (!hash) return NULL;
+
+  hash->width_in_lcu = CEILDIV(width, LCU_WIDTH);
+  hash->height_in_lcu = CEILDIV(height, LCU_WIDTH);
+  hash->lcus_done = MALLOC(int32_t, hash->height_in_lcu);
+  hash->row_state = MALLOC(int32_t, hash->height_in_lcu);
+  hash->row_hash = malloc(hash->height_in_lcu * sizeof(*hash->row_hash));
+  if (!hash->lcus_done || !hash->row_state || !hash->row_hash) {
+    kvz_picture_hash_free(hash);
+    return NULL;
+  }
+  return hash;
+}
+
+void kvz_picture_hash_free(picture_hash_t *hash)
+{
+  if (!hash) return;
+  FREE_POINTER(hash->lcus_done);
+  FREE_POINTER(hash->row_state);
+  FREE_POINTER(hash->row_hash);
+  free(hash);
+}
+
+/**
+ * \brief Start hashing a picture.
+ *
+ * Must be called before any LCU of the picture is encoded.
+ */
+void kvz_picture_hash_start(picture_hash_t *hash,
+                            enum kvz_hash type,
+                            const kvz_picture *pic,
+                            uint8_t bitdepth)
+{
+  assert(CEILDIV(pic->width, LCU_WIDTH) == hash->width_in_lcu);
+  assert(CEILDIV(pic->height, LCU_WIDTH) == hash->height_in_lcu);
+
+  hash->type = type;
+  hash->pic = pic;
+  hash->bitdepth = bitdepth;
+  memset(hash->lcus_done, 0, hash->height_in_lcu * sizeof(int32_t));
+  memset(hash->row_state, 0, hash->height_in_lcu * sizeof(int32_t));
+  for (int color = 0; color < 3; ++color) {
+    kvz_md5_init(&hash->md5[color]);
+  }
+  hash->md5_row = 0;
+  hash->md5_busy = 0;
+}
+
+/**
+ * \brief Mark an LCU as reconstructed, including deblocking and SAO.
+ *
+ * Hashes the rows whose pixels become final.
+ *
+ * \param hash    hash state
+ * \param lcu_y   row of the LCU in the picture
+ */
+void kvz_picture_hash_lcu_done(picture_hash_t *hash, int lcu_y)
+{
+  if (KVZ_ATOMIC_INC(&hash->lcus_done[lcu_y]) != hash->width_in_lcu) return;
+
+  if (lcu_y > 0) {
+    try_hash_row(hash, lcu_y - 1);
+  }
+  try_hash_row(hash, lcu_y);
+}
+
+/**
+ * \brief Get the hash of the picture.
+ *
+ * Must be called after every LCU of the picture has been marked done.
+ *
+ * \param hash    hash state
+ * \param digest  returns the checksum, CRC or MD5 of each color
+ */
+void kvz_picture_hash_digest(picture_hash_t *hash,
+                             unsigned char digest[3][SEI_HASH_MAX_LENGTH])
+{
+  assert(hash->md5_row == hash->height_in_lcu || hash->type != KVZ_HASH_MD5);
+
+  for (int color = 0; color < num_colors(hash); ++color) {
+    if (hash->type == KVZ_HASH_CHECKSUM) {
+      uint32_t checksum = 0;
+      for (int row = 0; row < hash->height_in_lcu; ++row) {
+        assert(hash->row_state[row] == ROW_HASHED);
+        checksum += hash->row_hash[row][color];
+      }
+      digest[color][0] = (checksum >> 24) & 0xff;
+      digest[color][1] = (checksum >> 16) & 0xff;
+      digest[color][2] = (checksum >> 8) & 0xff;
+      digest[color][3] = checksum & 0xff;
+
+    } else if (hash->type == KVZ_HASH_CRC) {
+      const int pixel_bytes = hash->bitdepth > 8 ? 2 : 1;
+      uint16_t crc = CRC_INIT;
+      for (int row = 0; row < hash->height_in_lcu; ++row) {
+        assert(hash->row_state[row] == ROW_HASHED);
+        int y, width, height, stride;
+        row_pixels(hash, color, row, &y, &width, &height, &stride);
+        crc = crc_shift(crc, width * height * pixel_bytes) ^ hash->row_hash[row][color];
+      }
+      digest[color][0] = crc >> 8;
+      digest[color][1] = crc & 0xff;
+
+    } else {
+      kvz_md5_final(digest[color], &hash->md5[color]);
+    }
+  }
+}
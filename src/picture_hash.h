@@ -0,0 +1,80 @@
+#ifndef PICTURE_HASH_H_
+#define PICTURE_HASH_H_
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (C) 2013-2015 Tampere University of Technology and others (see
+ * COPYING file).
+ *
+ * Kvazaar is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * Kvazaar is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+/**
+ * \ingroup Bitstream
+ * \file
+ * Decoded picture hash calculated one LCU row at a time.
+ *
+ * An LCU row is hashed by the thread finishing the last LCU that modifies
+ * its pixels, so the hash is ready when the reconstruction is. Checksums
+ * and CRCs of the rows are calculated in any order and combined at the
+ * end. MD5 is updated with the rows in order by whichever thread finishes
+ * the next row.
+ */
+
+#include "global.h" // IWYU pragma: keep
+#include "kvazaar.h"
+#include "extras/libmd5.h"
+#include "nal.h"
+
+
+typedef struct picture_hash_t {
+  enum kvz_hash type;
+
+  //! \brief Picture being hashed.
+  const kvz_picture *pic;
+  uint8_t bitdepth;
+
+  int32_t width_in_lcu;
+  int32_t height_in_lcu;
+
+  //! \brief Number of LCUs of each row that are reconstructed.
+  int32_t *lcus_done;
+
+  //! \brief State of each row, 0: not final, 1: being hashed, 2: hashed.
+  int32_t *row_state;
+
+  //! \brief Checksum or CRC of each row and color.
+  uint32_t (*row_hash)[3];
+
+  //! \brief MD5 of the rows before md5_row for each color.
+  context_md5_t md5[3];
+  int32_t md5_row;
+  //! \brief Set while a thread updates the MD5.
+  int32_t md5_busy;
+} picture_hash_t;
+
+picture_hash_t * kvz_picture_hash_alloc(int32_t width, int32_t height);
+void kvz_picture_hash_free(picture_hash_t *hash);
+
+void kvz_picture_hash_start(picture_hash_t *hash,
+                            enum kvz_hash type,
+                            const kvz_picture *pic,
+                            uint8_t bitdepth);
+
+void kvz_picture_hash_lcu_done(picture_hash_t *hash, int lcu_y);
+
+void kvz_picture_hash_digest(picture_hash_t *hash,
+                             unsigned char digest[3][SEI_HASH_MAX_LENGTH]);
+
+#endif // PICTURE_HASH_H_
@@ -30,6 +30,17 @@ static const int SMOOTHING_WINDOW = 40;
 static const double MIN_LAMBDA    = 0.1;
 static const double MAX_LAMBDA    = 10000;
 
+// Limits for scaling the picture bits and bpp with the lookahead costs.
+static const double MIN_COST_RATIO        = 0.75;
+static const double MAX_COST_RATIO        = 1.5;
+static const double MIN_COMPLEXITY_RATIO  = 0.25;
+static const double MAX_COMPLEXITY_RATIO  = 4.0;
+// Weight of the current frame in the running average of the complexity.
+static const double COMPLEXITY_SMOOTHING  = 0.1;
+// QP offset per doubling of the LCU intra cost with --lookahead-aq.
+static const double AQ_STRENGTH           = 2.0;
+static const int    AQ_MAX_DQP            = 6;
+
 /**
  * \brief Clip lambda value to a valid range.
  */
@@ -119,6 +130,10 @@ static uint64_t pic_header_bits(encoder_state_t * const state)
       bits += 456;
       break;
 
+    case KVZ_HASH_CRC:
+      bits += 120;
+      break;
+
     case KVZ_HASH_NONE:
       break;
   }
@@ -167,6 +182,79 @@ static double pic_allocate_bits(encoder_state_t * const state)
   return MAX(100, pic_target_bits);
 }
 
+/**
+ * \brief Adjust the bit allocation of the picture with the lookahead costs.
+ *
+ * A picture more complex than the following pictures gets more bits so that
+ * they are not spent before it. The R-lambda model was fitted to the
+ * previously coded pictures, so the target bpp is scaled by the complexity
+ * relative to them. The same scale is applied to the bpp when updating the
+ * model with the bits of the picture.
+ *
+ * \param state                the main encoder state
+ * \param[in,out] target_bits  target number of bits for the picture
+ * \param[in,out] target_bpp   target number of bits per pixel
+ */
+static void lookahead_adjust_bits(encoder_state_t * const state,
+                                  double *target_bits,
+                                  double *target_bpp)
+{
+  const lookahead_stats_t * const stats = &state->frame->lookahead;
+  const double prev_complexity =
+    state->previous_encoder_state->frame->rc_complexity;
+
+  state->frame->rc_bpp_scale = 1.0;
+
+  // The first frame has only intra costs while the rest use inter costs.
+  if (!stats->valid || state->frame->num == 0) {
+    state->frame->rc_complexity = prev_complexity;
+    return;
+  }
+
+  const double complexity =
+    (stats->cost + 1) / (double)state->encoder_control->in.pixels_per_pic;
+
+  if (stats->window_cost > 0 && state->frame->slicetype != KVZ_SLICE_I) {
+    const double ratio = CLIP(MIN_COST_RATIO, MAX_COST_RATIO, stats->cost / stats->window_cost);
+    *target_bits *= ratio;
+    *target_bpp  *= ratio;
+  }
+
+  if (prev_complexity > 0) {
+    // Intra pictures cost more than the inter costs suggest.
+    if (state->frame->slicetype != KVZ_SLICE_I) {
+      state->frame->rc_bpp_scale = CLIP(MIN_COMPLEXITY_RATIO, MAX_COMPLEXITY_RATIO,
+                                        prev_complexity / complexity);
+      *target_bpp *= state->frame->rc_bpp_scale;
+    }
+    state->frame->rc_complexity = exp((1 - COMPLEXITY_SMOOTHING) * log(prev_complexity) +
+                                      COMPLEXITY_SMOOTHING * log(complexity));
+  } else {
+    state->frame->rc_complexity = complexity;
+  }
+}
+
+/**
+ * \brief Compute the mean of log2 of the intra cost per pixel of the LCUs.
+ * \param state   the main encoder state
+ */
+static void lookahead_init_aq(encoder_state_t * const state)
+{
+  const encoder_control_t * const ctrl = state->encoder_control;
+  const lookahead_stats_t * const stats = &state->frame->lookahead;
+
+  double sum = 0.0;
+  for (int y = 0; y < ctrl->in.height_in_lcu; y++) {
+    for (int x = 0; x < ctrl->in.width_in_lcu; x++) {
+      const uint32_t pixels = MIN(LCU_WIDTH, ctrl->in.width  - LCU_WIDTH * x) *
+                              MIN(LCU_WIDTH, ctrl->in.height - LCU_WIDTH * y);
+      const uint32_t cost   = stats->lcu_intra_costs[x + y * ctrl->in.width_in_lcu];
+      sum += log2((cost + 1) / (double)pixels);
+    }
+  }
+  state->frame->aq_log_cost = sum / (ctrl->in.width_in_lcu * ctrl->in.height_in_lcu);
+}
+
 static int8_t lambda_to_qp(const double lambda)
 {
   const int8_t qp = 4.2005 * log(lambda) + 13.7223 + 0.5;
@@ -219,15 +307,20 @@ void kvz_set_picture_lambda_and_qp(encoder_state_t * const state)
 
     if (state->frame->num > ctrl->cfg.owf) {
       // At least one frame has been written.
-      update_parameters(state->stats_bitstream_length * 8,
+      // The bpp of the previous picture coded with this state is scaled
+      // like its target bpp was.
+      update_parameters(state->stats_bitstream_length * 8 * state->frame->rc_bpp_scale,
                         ctrl->in.pixels_per_pic,
                         state->frame->lambda,
                         &state->frame->rc_alpha,
                         &state->frame->rc_beta);
     }
 
-    const double pic_target_bits = pic_allocate_bits(state);
-    const double target_bpp = pic_target_bits / ctrl->in.pixels_per_pic;
+    double pic_target_bits = pic_allocate_bits(state);
+    double target_bpp = pic_target_bits / ctrl->in.pixels_per_pic;
+    if (ctrl->cfg.lookahead > 0) {
+      lookahead_adjust_bits(state, &pic_target_bits, &target_bpp);
+    }
     double lambda = state->frame->rc_alpha * pow(target_bpp, state->frame->rc_beta);
     lambda = clip_lambda(lambda);
 
@@ -247,6 +340,10 @@ void kvz_set_picture_lambda_and_qp(encoder_state_t * const state)
     }
 
     state->frame->lambda = qp_to_lamba(state, state->frame->QP);
+
+    if (ctrl->cfg.lookahead_aq && state->frame->lookahead.valid) {
+      lookahead_init_aq(state);
+    }
   }
 }
 
@@ -260,7 +357,8 @@ static double lcu_allocate_bits(encoder_state_t * const state,
                                 vector2d_t pos)
 {
   double lcu_weight;
-  if (state->frame->num > state->encoder_control->cfg.owf) {
+  if (state->frame->num > state->encoder_control->cfg.owf ||
+      state->frame->lookahead.valid) {
     lcu_weight = kvz_get_lcu_stats(state, pos.x, pos.y)->weight;
   } else {
     const uint32_t num_lcus = state->encoder_control->in.width_in_lcu *
@@ -334,6 +432,22 @@ void kvz_set_lcu_lambda_and_qp(encoder_state_t * const state,
     state->lambda_sqrt = sqrt(lambda);
     state->qp          = lambda_to_qp(lambda);
 
+  } else if (ctrl->cfg.lookahead_aq && state->frame->lookahead.valid) {
+    vector2d_t lcu = {
+      pos.x + state->tile->lcu_offset_x,
+      pos.y + state->tile->lcu_offset_y
+    };
+    const uint32_t pixels = MIN(LCU_WIDTH, ctrl->in.width  - LCU_WIDTH * lcu.x) *
+                            MIN(LCU_WIDTH, ctrl->in.height - LCU_WIDTH * lcu.y);
+    const uint32_t cost   = state->frame->lookahead.lcu_intra_costs[lcu.x + lcu.y * ctrl->in.width_in_lcu];
+    const double log_cost = log2((cost + 1) / (double)pixels);
+    // Flat LCUs get a lower QP and detailed ones a higher QP.
+    int dqp = (int)floor(AQ_STRENGTH * (log_cost - state->frame->aq_log_cost) + 0.5);
+    dqp = CLIP(-AQ_MAX_DQP, AQ_MAX_DQP, dqp);
+    state->qp = CLIP_TO_QP(state->frame->QP + dqp);
+    state->lambda = qp_to_lamba(state, state->qp);
+    state->lambda_sqrt = sqrt(state->lambda);
+
   } else {
     state->qp          = state->frame->QP;
     state->lambda      = state->frame->lambda;
@@ -170,10 +170,11 @@ static INLINE uint32_t get_coeff_cabac_cost(
   }
   if (!found) return 0;
 
-  // Take a copy of the CABAC so that we don't overwrite the contexts when
-  // counting the bits.
+  // Take a copy of the coefficient contexts so that we don't overwrite them
+  // when counting the bits. The other contexts are not used.
   cabac_data_t cabac_copy;
-  memcpy(&cabac_copy, &state->cabac, sizeof(cabac_copy));
+  kvz_cabac_copy_engine(&cabac_copy, &state->cabac);
+  kvz_cabac_copy_coeff_ctx(&cabac_copy, &state->cabac);
 
   // Clear bytes and bits and set mode to "count"
   cabac_copy.only_count = 1;
@@ -238,11 +239,10 @@ INLINE int32_t kvz_get_ic_rate(encoder_state_t * const state,
                     uint32_t c2_idx,
                     int8_t type)
 {
-  cabac_data_t * const cabac = &state->cabac;
+  const cabac_bits_t * const bits = &state->cabac_bits;
+  const int chroma = type != 0;
   int32_t rate = 1 << CTX_FRAC_BITS;
   uint32_t base_level  =  (c1_idx < C1FLAG_NUMBER)? (2 + (c2_idx < C2FLAG_NUMBER)) : 1;
-  cabac_ctx_t *base_one_ctx = (type == 0) ? &(cabac->ctx.cu_one_model_luma[0]) : &(cabac->ctx.cu_one_model_chroma[0]);
-  cabac_ctx_t *base_abs_ctx = (type == 0) ? &(cabac->ctx.cu_abs_model_luma[0]) : &(cabac->ctx.cu_abs_model_chroma[0]);
 
   if ( abs_level >= base_level ) {
     int32_t symbol     = abs_level - base_level;
@@ -259,18 +259,18 @@ INLINE int32_t kvz_get_ic_rate(encoder_state_t * const state,
       rate += (COEF_REMAIN_BIN_REDUCTION+length+1-abs_go_rice+length) * (1 << CTX_FRAC_BITS);
     }
     if (c1_idx < C1FLAG_NUMBER) {
-      rate += CTX_ENTROPY_BITS(&base_one_ctx[ctx_num_one],1);
+      rate += bits->one[chroma][ctx_num_one][1];
 
       if (c2_idx < C2FLAG_NUMBER) {
-        rate += CTX_ENTROPY_BITS(&base_abs_ctx[ctx_num_abs],1);
+        rate += bits->abs[chroma][ctx_num_abs][1];
       }
     }
   }
   else if( abs_level == 1 ) {
-    rate += CTX_ENTROPY_BITS(&base_one_ctx[ctx_num_one],0);
+    rate += bits->one[chroma][ctx_num_one][0];
   } else if( abs_level == 2 ) {
-    rate += CTX_ENTROPY_BITS(&base_one_ctx[ctx_num_one],1);
-    rate += CTX_ENTROPY_BITS(&base_abs_ctx[ctx_num_abs],0);
+    rate += bits->one[chroma][ctx_num_one][1];
+    rate += bits->abs[chroma][ctx_num_abs][0];
   }
 
   return rate;
@@ -300,15 +300,14 @@ INLINE uint32_t kvz_get_coded_level ( encoder_state_t * const state, double *cod
                            uint32_t c1_idx, uint32_t c2_idx,
                            int32_t q_bits,double temp, int8_t last, int8_t type)
 {
-  cabac_data_t * const cabac = &state->cabac;
+  const int32_t * const sig_bits = state->cabac_bits.sig[type != 0][ctx_num_sig];
   double cur_cost_sig   = 0;
   uint32_t best_abs_level = 0;
   int32_t abs_level;
   int32_t min_abs_level;
-  cabac_ctx_t* base_sig_model = type?(cabac->ctx.cu_sig_model_chroma):(cabac->ctx.cu_sig_model_luma);
 
   if( !last && max_abs_level < 3 ) {
-    *coded_cost_sig = state->lambda * CTX_ENTROPY_BITS(&base_sig_model[ctx_num_sig], 0);
+    *coded_cost_sig = state->lambda * sig_bits[0];
     *coded_cost     = *coded_cost0 + *coded_cost_sig;
     if (max_abs_level == 0) return best_abs_level;
   } else {
@@ -316,7 +315,7 @@ INLINE uint32_t kvz_get_coded_level ( encoder_state_t * const state, double *cod
   }
 
   if( !last ) {
-    cur_cost_sig = state->lambda * CTX_ENTROPY_BITS(&base_sig_model[ctx_num_sig], 1);
+    cur_cost_sig = state->lambda * sig_bits[1];
   }
 
   min_abs_level    = ( max_abs_level > 1 ? max_abs_level - 1 : 1 );
@@ -348,7 +347,7 @@ INLINE uint32_t kvz_get_coded_level ( encoder_state_t * const state, double *cod
 */
 static double get_rate_last(const encoder_state_t * const state,
                             const uint32_t  pos_x, const uint32_t pos_y,
-                            int32_t* last_x_bits, int32_t* last_y_bits)
+                            const int32_t* last_x_bits, const int32_t* last_y_bits)
 {
   uint32_t ctx_x   = g_group_idx[pos_x];
   uint32_t ctx_y   = g_group_idx[pos_y];
@@ -362,35 +361,66 @@ static double get_rate_last(const encoder_state_t * const state,
   return state->lambda * uiCost;
 }
 
-static void calc_last_bits(encoder_state_t * const state, int32_t width, int32_t height, int8_t type,
-                           int32_t* last_x_bits, int32_t* last_y_bits)
+/**
+ * \brief Calculate the cost of last_sig_coeff_x/y_prefix for each group.
+ *
+ * \param base_ctx  contexts of the prefix for luma or chroma
+ * \param width     width of the transform unit
+ * \param type      data type (0 == luma)
+ * \param last_bits returns the cost of each group
+ */
+static void calc_last_bits(const cabac_ctx_t *base_ctx, int32_t width, int8_t type,
+                           int32_t *last_bits)
 {
-  cabac_data_t * const cabac = &state->cabac;
-  int32_t bits_x = 0, bits_y = 0;
-  int32_t blk_size_offset_x, blk_size_offset_y, shiftX, shiftY;
+  int32_t bits = 0;
+  int32_t blk_size_offset = type ? 0 : (kvz_g_convert_to_bit[width] * 3 + ((kvz_g_convert_to_bit[width] + 1) >> 2));
+  int32_t shift = type ? kvz_g_convert_to_bit[width] : ((kvz_g_convert_to_bit[width] + 3) >> 2);
   int32_t ctx;
 
-  cabac_ctx_t *base_ctx_x = (type ? cabac->ctx.cu_ctx_last_x_chroma : cabac->ctx.cu_ctx_last_x_luma);
-  cabac_ctx_t *base_ctx_y = (type ? cabac->ctx.cu_ctx_last_y_chroma : cabac->ctx.cu_ctx_last_y_luma);
-
-  blk_size_offset_x = type ? 0: (kvz_g_convert_to_bit[ width ] *3 + ((kvz_g_convert_to_bit[ width ] +1)>>2));
-  blk_size_offset_y = type ? 0: (kvz_g_convert_to_bit[ height ]*3 + ((kvz_g_convert_to_bit[ height ]+1)>>2));
-  shiftX = type ? kvz_g_convert_to_bit[ width  ] :((kvz_g_convert_to_bit[ width  ]+3)>>2);
-  shiftY = type ? kvz_g_convert_to_bit[ height ] :((kvz_g_convert_to_bit[ height ]+3)>>2);
-
+  for (ctx = 0; ctx < g_group_idx[width - 1]; ctx++) {
+    int32_t ctx_offset = blk_size_offset + (ctx >> shift);
+    last_bits[ctx] = bits + CTX_ENTROPY_BITS(&base_ctx[ctx_offset], 0);
+    bits += CTX_ENTROPY_BITS(&base_ctx[ctx_offset], 1);
+  }
+  last_bits[ctx] = bits;
+}
 
-  for (ctx = 0; ctx < g_group_idx[ width - 1 ]; ctx++) {
-    int32_t ctx_offset = blk_size_offset_x + (ctx >>shiftX);
-    last_x_bits[ ctx ] = bits_x + CTX_ENTROPY_BITS(&base_ctx_x[ ctx_offset ],0);
-    bits_x += CTX_ENTROPY_BITS(&base_ctx_x[ ctx_offset ],1);
+static void calc_ctx_bits(const cabac_ctx_t *ctx, int num, int32_t (*bits)[2])
+{
+  for (int i = 0; i < num; i++) {
+    bits[i][0] = CTX_ENTROPY_BITS(&ctx[i], 0);
+    bits[i][1] = CTX_ENTROPY_BITS(&ctx[i], 1);
   }
-  last_x_bits[ctx] = bits_x;
-  for (ctx = 0; ctx < g_group_idx[ height - 1 ]; ctx++) {
-    int32_t ctx_offset = blk_size_offset_y + (ctx >>shiftY);
-    last_y_bits[ ctx ] = bits_y + CTX_ENTROPY_BITS(&base_ctx_y[ ctx_offset ],0);
-    bits_y +=  CTX_ENTROPY_BITS(&base_ctx_y[ ctx_offset ],1);
+}
+
+/**
+ * \brief Update state->cabac_bits from the contexts in state->cabac.
+ *
+ * Must be called before RDOQ is used in an LCU.
+ */
+void kvz_rdo_update_cabac_bits(encoder_state_t * const state)
+{
+  const cabac_data_t * const cabac = &state->cabac;
+  cabac_bits_t * const bits = &state->cabac_bits;
+
+  calc_ctx_bits(cabac->ctx.cu_sig_coeff_group_model, 4, bits->sig_coeff_group);
+  calc_ctx_bits(cabac->ctx.cu_sig_model_luma,       27, bits->sig[0]);
+  calc_ctx_bits(cabac->ctx.cu_sig_model_chroma,     15, bits->sig[1]);
+  calc_ctx_bits(cabac->ctx.cu_one_model_luma,       16, bits->one[0]);
+  calc_ctx_bits(cabac->ctx.cu_one_model_chroma,      8, bits->one[1]);
+  calc_ctx_bits(cabac->ctx.cu_abs_model_luma,        4, bits->abs[0]);
+  calc_ctx_bits(cabac->ctx.cu_abs_model_chroma,      2, bits->abs[1]);
+  calc_ctx_bits(cabac->ctx.qt_cbf_model_luma,        4, bits->qt_cbf[0]);
+  calc_ctx_bits(cabac->ctx.qt_cbf_model_chroma,      4, bits->qt_cbf[1]);
+  calc_ctx_bits(&cabac->ctx.cu_qt_root_cbf_model,    1, &bits->qt_root_cbf);
+
+  for (int log2_width = 2; log2_width <= 5; log2_width++) {
+    const int32_t width = 1 << log2_width;
+    calc_last_bits(cabac->ctx.cu_ctx_last_x_luma, width, 0, bits->last_x[0][log2_width - 2]);
+    calc_last_bits(cabac->ctx.cu_ctx_last_y_luma, width, 0, bits->last_y[0][log2_width - 2]);
+    calc_last_bits(cabac->ctx.cu_ctx_last_x_chroma, width, 2, bits->last_x[1][log2_width - 2]);
+    calc_last_bits(cabac->ctx.cu_ctx_last_y_chroma, width, 2, bits->last_y[1][log2_width - 2]);
   }
-  last_y_bits[ctx] = bits_y;
 }
 
 /**
@@ -548,7 +578,8 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
            int32_t height, int8_t type, int8_t scan_mode, int8_t block_type, int8_t tr_depth)
 {
   const encoder_control_t * const encoder = state->encoder_control;
-  cabac_data_t * const cabac = &state->cabac;
+  const cabac_bits_t * const bits = &state->cabac_bits;
+  const int chroma = type != 0;
   uint32_t log2_tr_size      = kvz_g_convert_to_bit[ width ] + 2;
   int32_t  transform_shift   = MAX_TR_DYNAMIC_RANGE - encoder->bitdepth - log2_tr_size;  // Represents scaling through forward transform
   uint16_t go_rice_param     = 0;
@@ -603,9 +634,7 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
     default: assert(0 && "There should be 1, 4, 16 or 64 coefficient groups");
   }
 
-  cabac_ctx_t *base_coeff_group_ctx = &(cabac->ctx.cu_sig_coeff_group_model[type]);
-  cabac_ctx_t *baseCtx              = (type == 0) ? &(cabac->ctx.cu_sig_model_luma[0]) : &(cabac->ctx.cu_sig_model_chroma[0]);
-  cabac_ctx_t *base_one_ctx = (type == 0) ? &(cabac->ctx.cu_one_model_luma[0]) : &(cabac->ctx.cu_one_model_chroma[0]);
+  const int32_t (*coeff_group_bits)[2] = &bits->sig_coeff_group[type];
 
   struct {
     double coded_level_and_dist;
@@ -646,8 +675,8 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
 
   for (; cg_scanpos >= 0; cg_scanpos--) cost_coeffgroup_sig[cg_scanpos] = 0;
 
-  int32_t last_x_bits[32], last_y_bits[32];
-  calc_last_bits(state, width, height, type, last_x_bits, last_y_bits);
+  const int32_t *last_x_bits = bits->last_x[chroma][log2_block_size - 2];
+  const int32_t *last_y_bits = bits->last_y[chroma][log2_block_size - 2];
 
   for (int32_t cg_scanpos = cg_last_scanpos; cg_scanpos >= 0; cg_scanpos--) {
     uint32_t cg_blkpos  = scan_cg[cg_scanpos];
@@ -689,8 +718,8 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
                                              level_double, max_abs_level, ctx_sig, one_ctx, abs_ctx, go_rice_param,
                                              c1_idx, c2_idx, q_bits, temp, 0, type );
         if (encoder->cfg.signhide_enable) {
-          int greater_than_zero = CTX_ENTROPY_BITS(&baseCtx[ctx_sig], 1);
-          int zero = CTX_ENTROPY_BITS(&baseCtx[ctx_sig], 0);
+          int greater_than_zero = bits->sig[chroma][ctx_sig][1];
+          int zero = bits->sig[chroma][ctx_sig][0];
           sh_rates.sig_coeff_inc[blkpos] = greater_than_zero - zero;
         }
       }
@@ -704,7 +733,7 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
           sh_rates.inc[blkpos] = rate_up - rate_now;
           sh_rates.dec[blkpos] = rate_down - rate_now;
         } else { // level == 0
-          sh_rates.inc[blkpos]   = CTX_ENTROPY_BITS(&base_one_ctx[one_ctx], 0);
+          sh_rates.inc[blkpos]   = bits->one[chroma][one_ctx][0];
         }
       }
       dest_coeff[blkpos] = (coeff_t)level;
@@ -759,7 +788,7 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
       if (sig_coeffgroup_flag[cg_blkpos] == 0) {
         uint32_t ctx_sig  = kvz_context_get_sig_coeff_group(sig_coeffgroup_flag, cg_pos_x,
                                                         cg_pos_y, width);
-        cost_coeffgroup_sig[cg_scanpos] = state->lambda *CTX_ENTROPY_BITS(&base_coeff_group_ctx[ctx_sig],0);
+        cost_coeffgroup_sig[cg_scanpos] = state->lambda * coeff_group_bits[ctx_sig][0];
         base_cost += cost_coeffgroup_sig[cg_scanpos]  - rd_stats.sig_cost;
       } else {
         if (cg_scanpos < cg_last_scanpos){
@@ -776,9 +805,9 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
           ctx_sig = kvz_context_get_sig_coeff_group(sig_coeffgroup_flag, cg_pos_x,
             cg_pos_y, width);
 
-          cost_coeffgroup_sig[cg_scanpos] = state->lambda * CTX_ENTROPY_BITS(&base_coeff_group_ctx[ctx_sig], 1);
+          cost_coeffgroup_sig[cg_scanpos] = state->lambda * coeff_group_bits[ctx_sig][1];
           base_cost += cost_coeffgroup_sig[cg_scanpos];
-          cost_zero_cg += state->lambda * CTX_ENTROPY_BITS(&base_coeff_group_ctx[ctx_sig], 0);
+          cost_zero_cg += state->lambda * coeff_group_bits[ctx_sig][0];
 
           // try to convert the current coeff group from non-zero to all-zero
           cost_zero_cg += rd_stats.uncoded_dist;          // distortion for resetting non-zero levels to zero levels
@@ -791,7 +820,7 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
             sig_coeffgroup_flag[cg_blkpos] = 0;
             base_cost = cost_zero_cg;
 
-            cost_coeffgroup_sig[cg_scanpos] = state->lambda * CTX_ENTROPY_BITS(&base_coeff_group_ctx[ctx_sig], 0);
+            cost_coeffgroup_sig[cg_scanpos] = state->lambda * coeff_group_bits[ctx_sig][0];
 
             // reset coeffs to 0 in this block
             for (int32_t scanpos_in_cg = cg_size - 1; scanpos_in_cg >= 0; scanpos_in_cg--) {
@@ -818,13 +847,12 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
   int32_t best_last_idx_p1 = 0;
 
   if( block_type != CU_INTRA && !type/* && pcCU->getTransformIdx( uiAbsPartIdx ) == 0*/ ) {
-    best_cost  = block_uncoded_cost +   state->lambda * CTX_ENTROPY_BITS(&(cabac->ctx.cu_qt_root_cbf_model),0);
-    base_cost +=   state->lambda * CTX_ENTROPY_BITS(&(cabac->ctx.cu_qt_root_cbf_model),1);
+    best_cost  = block_uncoded_cost +   state->lambda * bits->qt_root_cbf[0];
+    base_cost +=   state->lambda * bits->qt_root_cbf[1];
   } else {
-    cabac_ctx_t* base_cbf_model = type?(cabac->ctx.qt_cbf_model_chroma):(cabac->ctx.qt_cbf_model_luma);
     ctx_cbf    = ( type ? tr_depth : !tr_depth);
-    best_cost  = block_uncoded_cost +  state->lambda * CTX_ENTROPY_BITS(&base_cbf_model[ctx_cbf],0);
-    base_cost +=   state->lambda * CTX_ENTROPY_BITS(&base_cbf_model[ctx_cbf],1);
+    best_cost  = block_uncoded_cost +  state->lambda * bits->qt_cbf[chroma][ctx_cbf][0];
+    base_cost +=   state->lambda * bits->qt_cbf[chroma][ctx_cbf][1];
   }
 
   for ( int32_t cg_scanpos = cg_last_scanpos; cg_scanpos >= 0; cg_scanpos--) {
@@ -887,7 +915,9 @@ uint32_t kvz_get_mvd_coding_cost_cabac(const encoder_state_t *state,
                                        const int32_t mvd_hor,
                                        const int32_t mvd_ver)
 {
-  cabac_data_t cabac_copy = *cabac;
+  cabac_data_t cabac_copy;
+  kvz_cabac_copy_engine(&cabac_copy, cabac);
+  CABAC_COPY_CTX(&cabac_copy, cabac, cu_mvd_model);
   cabac_copy.only_count = 1;
 
   // It is safe to drop const here because cabac->only_count is set.
@@ -938,8 +968,13 @@ uint32_t kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
     }
   }
 
-  // Store cabac state and contexts
-  memcpy(&state_cabac_copy, &state->cabac, sizeof(cabac_data_t));
+  // Store cabac state and the contexts coded below
+  kvz_cabac_copy_engine(&state_cabac_copy, &state->cabac);
+  CABAC_COPY_CTX(&state_cabac_copy, &state->cabac, cu_merge_flag_ext_model);
+  CABAC_COPY_CTX(&state_cabac_copy, &state->cabac, cu_merge_idx_ext_model);
+  CABAC_COPY_CTX(&state_cabac_copy, &state->cabac, cu_ref_pic_model);
+  CABAC_COPY_CTX(&state_cabac_copy, &state->cabac, cu_mvd_model);
+  CABAC_COPY_CTX(&state_cabac_copy, &state->cabac, mvp_idx_model);
 
   // Clear bytes and bits and set mode to "count"
   state_cabac_copy.only_count = 1;
@@ -5,6 +5,7 @@
 
 #include "scaler.h"
 #include "scaler-avx2.h"
+#include "scaler-avx512.h"
 
 #include <math.h>
 #include <memory.h>
@@ -259,6 +260,7 @@ static void kvzScaling(yuv_buffer_t* in, yuv_buffer_t** out)
   scaling_parameter_t param = kvz_newScalingParameters(in_y_width, in_y_height, out_y_width, out_y_height, CHROMA_420, 1);
 
   *out = kvz_yuvScaling(in, &param, *out);
+  kvz_freeScalingParameters(&param);
 }
 
 static void kvzScaling_ver(yuv_buffer_t* in, yuv_buffer_t** out, int ver)
@@ -285,6 +287,7 @@ static void kvzScaling_ver(yuv_buffer_t* in, yuv_buffer_t** out, int ver)
   scaling_parameter_t param = kvz_newScalingParameters(in_y_width, in_y_height, out_y_width, out_y_height, CHROMA_420, 1);
 
   *out = kvz_yuvScaling_adapter(in, &param, *out, func);
+  kvz_freeScalingParameters(&param);
 }
 
 static void kvzBlockScaling(yuv_buffer_t* in, yuv_buffer_t** out)
@@ -313,6 +316,7 @@ static void kvzBlockScaling(yuv_buffer_t* in, yuv_buffer_t** out)
         block_width, block_height);
     }
   }
+  kvz_freeScalingParameters(&param);
 }
 
 static void kvzBlockStepScaling(yuv_buffer_t* in, yuv_buffer_t** out)
@@ -360,6 +364,7 @@ static void kvzBlockStepScaling(yuv_buffer_t* in, yuv_buffer_t** out)
   }
 
   kvz_deallocateYuvBuffer(tmp);
+  kvz_freeScalingParameters(&param);
 }
 
 static void kvzOpaqueBlockStepScaling(opaque_yuv_buffer_t* in, opaque_yuv_buffer_t** out, int tmp_depth)
@@ -394,6 +399,7 @@ static void kvzOpaqueBlockStepScaling(opaque_yuv_buffer_t* in, opaque_yuv_buffer
       break;
 
   default:
+    kvz_freeScalingParameters(&param);
     return;
     break;
   }
@@ -425,6 +431,7 @@ static void kvzOpaqueBlockStepScaling(opaque_yuv_buffer_t* in, opaque_yuv_buffer
 
   kvz_deallocateOpaqueYuvBuffer(tmp, 1);
   //kvz_deallocateYuvBuffer(tmp);
+  kvz_freeScalingParameters(&param);
 }
 
 static void kvzOpaqueBlockStepScalingAvx2(opaque_yuv_buffer_t* in, opaque_yuv_buffer_t** out, int tmp_depth)
@@ -459,6 +466,7 @@ static void kvzOpaqueBlockStepScalingAvx2(opaque_yuv_buffer_t* in, opaque_yuv_bu
         break;
 
       default:
+        kvz_freeScalingParameters(&param);
         return;
         break;
   }
@@ -490,6 +498,47 @@ static void kvzOpaqueBlockStepScalingAvx2(opaque_yuv_buffer_t* in, opaque_yuv_bu
 
   kvz_deallocateOpaqueYuvBuffer(tmp, 1);
   //kvz_deallocateYuvBuffer(tmp);
+  kvz_freeScalingParameters(&param);
+}
+
+//Block step scaling with the given resample function. Blocks are chosen so that block edges do not line up with the 16 pixel vectors.
+static void kvzOpaqueBlockStepScalingFunc(opaque_yuv_buffer_t* in, opaque_yuv_buffer_t* out, int tmp_depth, opaque_resample_block_step_func *const resample_func)
+{
+  int32_t in_y_width = in->y->width;
+  int32_t in_y_height = in->y->height;
+  int32_t out_y_width = out->y->width;
+  int32_t out_y_height = out->y->height;
+
+  //assumes 420
+  scaling_parameter_t param = kvz_newScalingParameters(in_y_width, in_y_height, out_y_width, out_y_height, CHROMA_420, 1);
+
+  const int block_width = 20;
+  const int block_height = 6;
+
+  opaque_yuv_buffer_t* tmp = kvz_newOpaqueYuvBuffer(NULL, NULL, NULL, out_y_width, in_y_height, out_y_width, CHROMA_420, tmp_depth);
+
+  //Horizontal
+  for (int block_y = 0; block_y < in_y_height; block_y += block_height) {
+    for (int block_x = 0; block_x < out_y_width; block_x += block_width) {
+      int bw = out_y_width - block_x < block_width ? out_y_width - block_x : block_width;
+      int bh = in_y_height - block_y < block_height ? in_y_height - block_y : block_height;
+
+      kvz_opaqueYuvBlockStepScaling_adapter(tmp, in, &param, block_x, block_y, bw, bh, 0, resample_func);
+    }
+  }
+
+  //Vertical
+  for (int block_y = 0; block_y < out_y_height; block_y += block_height) {
+    for (int block_x = 0; block_x < out_y_width; block_x += block_width) {
+      int bw = out_y_width - block_x < block_width ? out_y_width - block_x : block_width;
+      int bh = out_y_height - block_y < block_height ? out_y_height - block_y : block_height;
+
+      kvz_opaqueYuvBlockStepScaling_adapter(out, tmp, &param, block_x, block_y, bw, bh, 1, resample_func);
+    }
+  }
+
+  kvz_deallocateOpaqueYuvBuffer(tmp, 1);
+  kvz_freeScalingParameters(&param);
 }
 
 static void kvzScaling_avx2(yuv_buffer_t* in, yuv_buffer_t** out)
@@ -505,6 +554,7 @@ static void kvzScaling_avx2(yuv_buffer_t* in, yuv_buffer_t** out)
   scaling_parameter_t param = kvz_newScalingParameters(in_y_width, in_y_height, out_y_width, out_y_height, CHROMA_420, 1);
 
   *out = kvz_yuvScaling_adapter(in, &param, *out, kvz_default_resample_func);
+  kvz_freeScalingParameters(&param);
 }
 
 static void kvzBlockStepScaling_avx2(yuv_buffer_t* in, yuv_buffer_t** out, int ver)
@@ -567,6 +617,7 @@ static void kvzBlockStepScaling_avx2(yuv_buffer_t* in, yuv_buffer_t** out, int v
   }
 
   kvz_deallocateYuvBuffer(tmp);
+  kvz_freeScalingParameters(&param);
 }
 
 static void _kvzScaling(yuv_buffer_t* in, yuv_buffer_t** out)
@@ -582,6 +633,7 @@ static void _kvzScaling(yuv_buffer_t* in, yuv_buffer_t** out)
   scaling_parameter_t param = kvz_newScalingParameters(in_y_width, in_y_height, out_y_width, out_y_height, CHROMA_420, 1);
 
   *out = kvz_yuvScaling_(in, &param, *out);
+  kvz_freeScalingParameters(&param);
 }
 
 
@@ -1320,6 +1372,97 @@ static void opaque_validate_test_avx2()
   fclose(out_file4);
 }
 
+//Fill buffer with pseudo-random 8-bit values so that edges are as sharp as possible
+static void fill_random(opaque_pic_buffer_t *buffer, unsigned *seed)
+{
+  for (int i = 0; i < buffer->width * buffer->height; i++) {
+    *seed = *seed * 1103515245 + 12345;
+    unsigned val = (*seed >> 16) & 0xFF;
+
+    switch (buffer->depth)
+    {
+      case sizeof(char) :
+        ((unsigned char *)(buffer->data))[i] = (unsigned char)val;
+        break;
+
+      case sizeof(short) :
+        ((unsigned short *)(buffer->data))[i] = (unsigned short)val;
+        break;
+
+      case sizeof(int) :
+        ((unsigned int *)(buffer->data))[i] = val;
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+//Compare the AVX-512 block step resampling against the generic one for all supported depths
+static void opaque_validate_test_avx512()
+{
+  if (kvz_opaque_block_step_resample_func_avx512 == NULL) {
+    printf("AVX-512 resampling not compiled in.\n");
+    return;
+  }
+
+  //in width, in height, out width, out height
+  const int sizes[][4] = {
+    { 64, 32, 128, 64 },
+    { 64, 32, 96, 48 },
+    { 120, 72, 176, 88 },
+    { 128, 64, 64, 32 },
+    { 96, 48, 64, 32 },
+    { 176, 88, 120, 72 },
+  };
+  const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  const unsigned depths[3] = { sizeof(char), sizeof(short), sizeof(pic_data_t) };
+
+  unsigned seed = 1;
+  int num_tests = 0;
+  int num_fails = 0;
+
+  for (int s = 0; s < num_sizes; s++) {
+    const int in_width = sizes[s][0];
+    const int in_height = sizes[s][1];
+    const int out_width = sizes[s][2];
+    const int out_height = sizes[s][3];
+    const int is_downscaling = out_width < in_width;
+
+    for (int i = 0; i < 3; i++) {
+      opaque_yuv_buffer_t* in = kvz_newOpaqueYuvBuffer(NULL, NULL, NULL, in_width, in_height, in_width, CHROMA_420, depths[i]);
+      fill_random(in->y, &seed);
+      fill_random(in->u, &seed);
+      fill_random(in->v, &seed);
+
+      //16-bit intermediate buffers are not supported with the 12-tap downscaling filters
+      for (unsigned tmp_depth = is_downscaling ? sizeof(pic_data_t) : sizeof(short); tmp_depth <= sizeof(pic_data_t); tmp_depth += sizeof(short)) {
+        for (int o = 0; o < 3; o++) {
+          opaque_yuv_buffer_t* ref = kvz_newOpaqueYuvBuffer(NULL, NULL, NULL, out_width, out_height, out_width, CHROMA_420, depths[o]);
+          opaque_yuv_buffer_t* out = kvz_newOpaqueYuvBuffer(NULL, NULL, NULL, out_width, out_height, out_width, CHROMA_420, depths[o]);
+
+          kvzOpaqueBlockStepScalingFunc(in, ref, tmp_depth, kvz_opaque_block_step_resample_func);
+          kvzOpaqueBlockStepScalingFunc(in, out, tmp_depth, kvz_opaque_block_step_resample_func_avx512);
+
+          num_tests++;
+          if (opaque_yuvcmp(ref, out) == 0) {
+            num_fails++;
+            printf("%ix%i -> %ix%i differs. In depth %u, tmp depth %u, out depth %u\n", in_width, in_height, out_width, out_height, depths[i], tmp_depth, depths[o]);
+          }
+
+          kvz_deallocateOpaqueYuvBuffer(ref, 1);
+          kvz_deallocateOpaqueYuvBuffer(out, 1);
+        }
+      }
+
+      kvz_deallocateOpaqueYuvBuffer(in, 1);
+    }
+  }
+
+  printf("AVX-512 resampling: %i of %i tests differ from generic.\n", num_fails, num_tests);
+}
+
 static void opaque_validate_test()
 {
   int32_t in_width = 1280;//1920;
@@ -1493,6 +1636,7 @@ int main()
 {
   //vscaling();
   //validate_test3();
+  opaque_validate_test_avx512();
   opaque_validate_test_avx2();
   //int r = test_avx();
   //printf("%d", r);
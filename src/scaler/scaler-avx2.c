@@ -74,6 +74,31 @@
 
 #define VOID_INDEX(ptr,ind,depth) ((void *)(((uint8_t *)(ptr)) + (ind) * (depth)))
 
+//Get ref pos and phase of num (1 or 8) target samples starting at t_ind. If num is 1 the values are broadcast.
+//Values are loaded from the precalculated phase table if available
+static void avx2_get_ref_pos_phase_epi32(const scaling_phase_table_t *const table, const int t_ind, const int num, const __m256i scale, const __m256i add, const int shift, const __m256i delta, __m256i *const ref_pos, __m256i *const phase)
+{
+  if (table != NULL) {
+    if (num == 1) {
+      *ref_pos = _mm256_set1_epi32(table->ref_pos[t_ind]);
+      *phase = _mm256_set1_epi32(table->phase[t_ind]);
+    } else {
+      *ref_pos = _mm256_loadu_si256((const __m256i*)&table->ref_pos[t_ind]);
+      *phase = _mm256_loadu_si256((const __m256i*)&table->phase[t_ind]);
+    }
+    return;
+  }
+
+  const __m256i t_ind_epi32 = num == 1 ? _mm256_set1_epi32(t_ind) : _mm256_add_epi32(_mm256_set1_epi32(t_ind), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  const __m256i ref_pos_16_epi32 = avx2_calc_ref_pos_16_epi32(t_ind_epi32, scale, add, shift, delta);
+  *phase = avx2_get_phase_epi32(ref_pos_16_epi32);
+  *ref_pos = avx2_get_ref_pos_epi32(ref_pos_16_epi32);
+}
+
+//Get the phase table for a block. Vectorized loops may read up to 7 samples past the end of the block
+#define avx2_get_phase_table(param, is_luma, is_vertical, block_x, block_y, block_width, block_height) \
+  kvz_getScalingPhaseTable(param, is_luma, is_vertical, (is_vertical) ? (block_y) : (block_x), ((is_vertical) ? (block_y) + (block_height) : (block_x) + (block_width)) + 6)
+
 // Clip sum of add_val to each epi32 of lane
 static __m256i clip_add_avx2(const int add_val, __m256i lane, const int min, const int max)
 {
@@ -345,35 +370,9 @@ static void resample_avx2(const pic_buffer_t* const buffer, const scaling_parame
   int crop_width = src_width - param->right_offset; //- param->left_offset;
   int crop_height = src_height - param->bottom_offset; //- param->top_offset;
 
-  if (4 * crop_height > 15 * trgt_height)
-   ver_filter = 7;
-  else if (7 * crop_height > 20 * trgt_height)
-   ver_filter = 6;
-  else if (2 * crop_height > 5 * trgt_height)
-   ver_filter = 5;
-  else if (1 * crop_height > 2 * trgt_height)
-   ver_filter = 4;
-  else if (3 * crop_height > 5 * trgt_height)
-   ver_filter = 3;
-  else if (4 * crop_height > 5 * trgt_height)
-   ver_filter = 2;
-  else if (19 * crop_height > 20 * trgt_height)
-   ver_filter = 1;
-
-  if (4 * crop_width > 15 * trgt_width)
-   hor_filter = 7;
-  else if (7 * crop_width > 20 * trgt_width)
-   hor_filter = 6;
-  else if (2 * crop_width > 5 * trgt_width)
-   hor_filter = 5;
-  else if (1 * crop_width > 2 * trgt_width)
-   hor_filter = 4;
-  else if (3 * crop_width > 5 * trgt_width)
-   hor_filter = 3;
-  else if (4 * crop_width > 5 * trgt_width)
-   hor_filter = 2;
-  else if (19 * crop_width > 20 * trgt_width)
-   hor_filter = 1;
+  ver_filter = kvz_selectDownFilter(crop_height, trgt_height, param->down_filter);
+
+  hor_filter = kvz_selectDownFilter(crop_width, trgt_width, param->down_filter);
  }
 
  int shift_x = param->shift_x - 4;
@@ -588,20 +587,7 @@ static void resampleBlockStep_avx2(const pic_buffer_t* const src_buffer, const p
 
   if (!is_upscaling) {
     int crop_size = src_size - (is_vertical ? param->bottom_offset : param->right_offset); //- param->left_offset/top_offset;
-    if (4 * crop_size > 15 * trgt_size)
-      filter_phase = 7;
-    else if (7 * crop_size > 20 * trgt_size)
-      filter_phase = 6;
-    else if (2 * crop_size > 5 * trgt_size)
-      filter_phase = 5;
-    else if (1 * crop_size > 2 * trgt_size)
-      filter_phase = 4;
-    else if (3 * crop_size > 5 * trgt_size)
-      filter_phase = 3;
-    else if (4 * crop_size > 5 * trgt_size)
-      filter_phase = 2;
-    else if (19 * crop_size > 20 * trgt_size)
-      filter_phase = 1;
+    filter_phase = kvz_selectDownFilter(crop_size, trgt_size, param->down_filter);
   }
 
   const int shift = (is_vertical ? param->shift_y : param->shift_x) - 4;
@@ -635,6 +621,9 @@ static void resampleBlockStep_avx2(const pic_buffer_t* const src_buffer, const p
   //int* start;
   int min = 0;
 
+  //Use precalculated ref positions and phases if available
+  const scaling_phase_table_t *const table = kvz_getScalingPhaseTable(param, is_luma, is_vertical, is_vertical ? block_y : block_x, is_vertical ? block_y + block_height - 1 : block_x + block_width - 1);
+
   //Do resampling (vertical/horizontal) of the specified block into trgt_buffer using src_buffer
   for (int y = block_y; y < (block_y + block_height); y++) {
 
@@ -649,9 +638,15 @@ static void resampleBlockStep_avx2(const pic_buffer_t* const src_buffer, const p
       const int t_ind = is_vertical ? y : o_ind; //trgt_buffer row/col index for cur resampling dir
 
       //Calculate reference position in src pic
-      const int ref_pos_16 = (int)((unsigned int)(t_ind * scale + add) >> shift) - delta;
-      const int phase = ref_pos_16 & 15;
-      const int ref_pos = ref_pos_16 >> 4;
+      int phase, ref_pos;
+      if (table != NULL) {
+        phase = table->phase[t_ind];
+        ref_pos = table->ref_pos[t_ind];
+      } else {
+        const int ref_pos_16 = (int)((unsigned int)(t_ind * scale + add) >> shift) - delta;
+        phase = ref_pos_16 & 15;
+        ref_pos = ref_pos_16 >> 4;
+      }
 
       //Inner loop:
       //  if is_vertical -> loop over x (block width)
@@ -1542,20 +1537,7 @@ static void _mm256_storeu_n_epi8(uint8_t *dst, const __m256i src, const unsigned
 
   if (!is_upscaling) {
     int crop_size = src_size - (is_vertical ? param->bottom_offset : param->right_offset); //- param->left_offset/top_offset;
-    if (4 * crop_size > 15 * trgt_size)
-      filter_phase = 7;
-    else if (7 * crop_size > 20 * trgt_size)
-      filter_phase = 6;
-    else if (2 * crop_size > 5 * trgt_size)
-      filter_phase = 5;
-    else if (1 * crop_size > 2 * trgt_size)
-      filter_phase = 4;
-    else if (3 * crop_size > 5 * trgt_size)
-      filter_phase = 3;
-    else if (4 * crop_size > 5 * trgt_size)
-      filter_phase = 2;
-    else if (19 * crop_size > 20 * trgt_size)
-      filter_phase = 1;
+    filter_phase = kvz_selectDownFilter(crop_size, trgt_size, param->down_filter);
   }
 
   const int shift = (is_vertical ? param->shift_y : param->shift_x) - 4;
@@ -1750,20 +1732,7 @@ static void resampleBlockStep_avx2_v3(const pic_buffer_t* const src_buffer, cons
 
   if (!is_upscaling) {
     int crop_size = src_size - (is_vertical ? param->bottom_offset : param->right_offset); //- param->left_offset/top_offset;
-    if (4 * crop_size > 15 * trgt_size)
-      filter_phase = 7;
-    else if (7 * crop_size > 20 * trgt_size)
-      filter_phase = 6;
-    else if (2 * crop_size > 5 * trgt_size)
-      filter_phase = 5;
-    else if (1 * crop_size > 2 * trgt_size)
-      filter_phase = 4;
-    else if (3 * crop_size > 5 * trgt_size)
-      filter_phase = 3;
-    else if (4 * crop_size > 5 * trgt_size)
-      filter_phase = 2;
-    else if (19 * crop_size > 20 * trgt_size)
-      filter_phase = 1;
+    filter_phase = kvz_selectDownFilter(crop_size, trgt_size, param->down_filter);
   }
 
   const int shift = (is_vertical ? param->shift_y : param->shift_x) - 4;
@@ -2157,20 +2126,7 @@ static void resampleBlockStep_avx2_v4(const pic_buffer_t* const src_buffer, cons
 
   if (!is_upscaling) {
     int crop_size = src_size - (is_vertical ? param->bottom_offset : param->right_offset); //- param->left_offset/top_offset;
-    if (4 * crop_size > 15 * trgt_size)
-      filter_phase = 7;
-    else if (7 * crop_size > 20 * trgt_size)
-      filter_phase = 6;
-    else if (2 * crop_size > 5 * trgt_size)
-      filter_phase = 5;
-    else if (1 * crop_size > 2 * trgt_size)
-      filter_phase = 4;
-    else if (3 * crop_size > 5 * trgt_size)
-      filter_phase = 3;
-    else if (4 * crop_size > 5 * trgt_size)
-      filter_phase = 2;
-    else if (19 * crop_size > 20 * trgt_size)
-      filter_phase = 1;
+    filter_phase = kvz_selectDownFilter(crop_size, trgt_size, param->down_filter);
   }
 
   const int shift = (is_vertical ? param->shift_y : param->shift_x) - 4;
@@ -2222,6 +2178,9 @@ static void resampleBlockStep_avx2_v4(const pic_buffer_t* const src_buffer, cons
   const __m256i ref_pos_filt_offset = _mm256_set1_epi32((filter_size >> 1) - 1);
   const __m256i epi16_interleave_mask = _mm256_broadcastsi128_si256(_mm_set_epi16(0x0F0E, 0x0706, 0x0D0C, 0x0504, 0x0B0A, 0x0302, 0x0908, 0x0100));
   
+  //Use precalculated ref positions and phases if available
+  const scaling_phase_table_t *const table = avx2_get_phase_table(param, is_luma, is_vertical, block_x, block_y, block_width, block_height);
+
   __m256i temp_mem[12], temp_filter[12];
   __m256i data0[6], data1[6], filter0[6], filter1[6];
   
@@ -2242,10 +2201,7 @@ static void resampleBlockStep_avx2_v4(const pic_buffer_t* const src_buffer, cons
     //Calculate reference position in src pic (vertical resampling)
     if (is_vertical) {
 
-      const __m256i t_ind_epi32 = _mm256_set1_epi32(y);
-      const __m256i ref_pos_16_epi32 = avx2_calc_ref_pos_16_epi32(t_ind_epi32, scale_epi32, add_epi32, shift, delta_epi32);
-      phase_epi32 = avx2_get_phase_epi32(ref_pos_16_epi32);
-      ref_pos_epi32 = avx2_get_ref_pos_epi32(ref_pos_16_epi32);
+      avx2_get_ref_pos_phase_epi32(table, y, 1, scale_epi32, add_epi32, shift, delta_epi32, &ref_pos_epi32, &phase_epi32);
 
       //Calculate the first sample ind based on the ref pos
       ref_pos_epi32 = _mm256_sub_epi32(ref_pos_epi32, ref_pos_filt_offset);
@@ -2295,10 +2251,7 @@ static void resampleBlockStep_avx2_v4(const pic_buffer_t* const src_buffer, cons
       //Calculate reference position in src pic (vertical scaling)
       if (!is_vertical) {
         
-        const __m256i t_ind_epi32 = _mm256_add_epi32(_mm256_set1_epi32(x), seq);
-        const __m256i ref_pos_16_epi32 = avx2_calc_ref_pos_16_epi32(t_ind_epi32, scale_epi32, add_epi32, shift, delta_epi32);
-        phase_epi32 = avx2_get_phase_epi32(ref_pos_16_epi32);
-        ref_pos_epi32 = avx2_get_ref_pos_epi32(ref_pos_16_epi32);
+        avx2_get_ref_pos_phase_epi32(table, x, 8, scale_epi32, add_epi32, shift, delta_epi32, &ref_pos_epi32, &phase_epi32);
 
         //Calculate the first sample ind based on the ref pos
         ref_pos_epi32 = _mm256_sub_epi32(ref_pos_epi32, ref_pos_filt_offset);
@@ -2618,7 +2571,7 @@ static void resampleBlockStep_avx2_v4(const pic_buffer_t* const src_buffer, cons
 
 
 //Handle vertical resampling
-static void opaqueResampleBlockStep_avx2_vertical_16to8bit_filterSize_8_4(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int16_t *const filter, const int is_filter_size_8, const int shift, const int scale, const int add, const int delta, const int src_size, const int is_upscaling) {
+static void opaqueResampleBlockStep_avx2_vertical_16to8bit_filterSize_8_4(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int16_t *const filter, const int is_filter_size_8, const int shift, const int scale, const int add, const int delta, const scaling_phase_table_t *const table, const int src_size, const int is_upscaling) {
 
   //Calculate outer and inner step so as to maximize lane/register usage:
   //  The accumulation can be done for 8 pixels at the same time
@@ -2679,10 +2632,7 @@ static void opaqueResampleBlockStep_avx2_vertical_16to8bit_filterSize_8_4(const
     //Pre-calculate for 8 pos at a time
     if (loop_ind_outer == 0)
     {
-      const __m256i t_ind_epi32 = _mm256_add_epi32(_mm256_set1_epi32(y), seq);
-      const __m256i ref_pos_16_epi32 = avx2_calc_ref_pos_16_epi32(t_ind_epi32, scale_epi32, add_epi32, shift, delta_epi32);
-      phase_epi32 = avx2_get_phase_epi32(ref_pos_16_epi32);
-      ref_pos_epi32 = avx2_get_ref_pos_epi32(ref_pos_16_epi32);
+      avx2_get_ref_pos_phase_epi32(table, y, 8, scale_epi32, add_epi32, shift, delta_epi32, &ref_pos_epi32, &phase_epi32);
 
       //Calculate the first sample ind based on the ref pos
       ref_pos_epi32 = _mm256_sub_epi32(ref_pos_epi32, ref_pos_filt_offset);
@@ -2761,7 +2711,7 @@ static void opaqueResampleBlockStep_avx2_vertical_16to8bit_filterSize_8_4(const
 }
 
 //Handle vertical resampling
-static void opaqueResampleBlockStep_avx2_vertical(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int32_t *const filter, const int filter_size, const int shift, const int scale, const int add, const int delta, const int src_size, const int is_upscaling) {
+static void opaqueResampleBlockStep_avx2_vertical(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int32_t *const filter, const int filter_size, const int shift, const int scale, const int add, const int delta, const scaling_phase_table_t *const table, const int src_size, const int is_upscaling) {
   
   //Calculate outer and inner step so as to maximize lane/register usage:
   //  The accumulation can be done for 8 pixels at the same time
@@ -2814,10 +2764,7 @@ static void opaqueResampleBlockStep_avx2_vertical(const opaque_pic_buffer_t* con
     const unsigned *phase = (unsigned*)&phase_epi32;
 
     //Calculate reference position in src pic (vertical resampling)
-    const __m256i t_ind_epi32 = _mm256_set1_epi32(y);
-    const __m256i ref_pos_16_epi32 = avx2_calc_ref_pos_16_epi32(t_ind_epi32, scale_epi32, add_epi32, shift, delta_epi32);
-    phase_epi32 = avx2_get_phase_epi32(ref_pos_16_epi32);
-    ref_pos_epi32 = avx2_get_ref_pos_epi32(ref_pos_16_epi32);
+    avx2_get_ref_pos_phase_epi32(table, y, 1, scale_epi32, add_epi32, shift, delta_epi32, &ref_pos_epi32, &phase_epi32);
 
     //Calculate the first sample ind based on the ref pos
     ref_pos_epi32 = _mm256_sub_epi32(ref_pos_epi32, ref_pos_filt_offset);
@@ -3183,7 +3130,7 @@ static void data_load_8x4_8bit(const uint8_t *const src, const unsigned *const s
 }
 
 //Handle 8-bit input with filter size 8
-static void opaqueResampleBlocckStep_avx2_horizontal_8to16bit_filterSize_8_4(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int8_t *const filter, const int is_filter_size_8, const int shift, const int scale, const int add, const int delta, const int src_size)
+static void opaqueResampleBlocckStep_avx2_horizontal_8to16bit_filterSize_8_4(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int8_t *const filter, const int is_filter_size_8, const int shift, const int scale, const int add, const int delta, const scaling_phase_table_t *const table, const int src_size)
 {
   //Calculate outer and inner step so as to maximize lane/register usage:
   //  The accumulation can be done for 8 pixels at the same time
@@ -3195,8 +3142,6 @@ static void opaqueResampleBlocckStep_avx2_horizontal_8to16bit_filterSize_8_4(con
   const int y_bound = block_y + block_height;
   //const unsigned i_bound = (is_vertical && filter_size > 8) ? filter_size : 1;
 
-  const __m256i seq = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
-
   const __m256i scale_epi32 = _mm256_set1_epi32(scale);
   const __m256i add_epi32 = _mm256_set1_epi32(add);
   const __m256i delta_epi32 = _mm256_set1_epi32(delta);
@@ -3222,10 +3167,9 @@ static void opaqueResampleBlocckStep_avx2_horizontal_8to16bit_filterSize_8_4(con
       const unsigned loop_ind = ((x - block_x) >> t_step_power) % 2;
 
       //Calculate reference position in src pic (vertical scaling)
-      const __m256i t_ind_epi32 = _mm256_add_epi32(_mm256_set1_epi32(x), seq);
-      const __m256i ref_pos_16_epi32 = avx2_calc_ref_pos_16_epi32(t_ind_epi32, scale_epi32, add_epi32, shift, delta_epi32);
-      const __m256i phase_epi32 = avx2_get_phase_epi32(ref_pos_16_epi32);
-      const __m256i ref_pos_epi32 = _mm256_sub_epi32(avx2_get_ref_pos_epi32(ref_pos_16_epi32), ref_pos_filt_offset); //Calculate the first sample ind based on the ref pos
+      __m256i phase_epi32, ref_pos_epi32;
+      avx2_get_ref_pos_phase_epi32(table, x, 8, scale_epi32, add_epi32, shift, delta_epi32, &ref_pos_epi32, &phase_epi32);
+      ref_pos_epi32 = _mm256_sub_epi32(ref_pos_epi32, ref_pos_filt_offset); //Calculate the first sample ind based on the ref pos
 
       const unsigned *phase = (unsigned*)&phase_epi32;
 
@@ -3295,7 +3239,7 @@ static void opaqueResampleBlocckStep_avx2_horizontal_8to16bit_filterSize_8_4(con
 }
 
 //Handle horizontal resampling
-static void opaqueResampleBlockStep_avx2_horizontal(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int32_t *const filter, const int filter_size, const int shift, const int scale, const int add, const int delta, const int src_size)
+static void opaqueResampleBlockStep_avx2_horizontal(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int32_t *const filter, const int filter_size, const int shift, const int scale, const int add, const int delta, const scaling_phase_table_t *const table, const int src_size)
 {
   //Calculate outer and inner step so as to maximize lane/register usage:
   //  The accumulation can be done for 8 pixels at the same time
@@ -3343,10 +3287,7 @@ static void opaqueResampleBlockStep_avx2_horizontal(const opaque_pic_buffer_t* c
       const unsigned t_num = SCALER_CLIP(x_bound - x, 0, t_step);
 
       //Calculate reference position in src pic (vertical scaling)
-      const __m256i t_ind_epi32 = _mm256_add_epi32(_mm256_set1_epi32(x), seq);
-      const __m256i ref_pos_16_epi32 = avx2_calc_ref_pos_16_epi32(t_ind_epi32, scale_epi32, add_epi32, shift, delta_epi32);
-      phase_epi32 = avx2_get_phase_epi32(ref_pos_16_epi32);
-      ref_pos_epi32 = avx2_get_ref_pos_epi32(ref_pos_16_epi32);
+      avx2_get_ref_pos_phase_epi32(table, x, 8, scale_epi32, add_epi32, shift, delta_epi32, &ref_pos_epi32, &phase_epi32);
 
       //Calculate the first sample ind based on the ref pos
       ref_pos_epi32 = _mm256_sub_epi32(ref_pos_epi32, ref_pos_filt_offset);
@@ -3598,20 +3539,7 @@ static void opaqueResampleBlockStep_avx2_adapter(const opaque_pic_buffer_t* cons
 
   if (!is_upscaling) {
     int crop_size = src_size - (is_vertical ? param->bottom_offset : param->right_offset); //- param->left_offset/top_offset;
-    if (4 * crop_size > 15 * trgt_size)
-      filter_phase = 7;
-    else if (7 * crop_size > 20 * trgt_size)
-      filter_phase = 6;
-    else if (2 * crop_size > 5 * trgt_size)
-      filter_phase = 5;
-    else if (1 * crop_size > 2 * trgt_size)
-      filter_phase = 4;
-    else if (3 * crop_size > 5 * trgt_size)
-      filter_phase = 3;
-    else if (4 * crop_size > 5 * trgt_size)
-      filter_phase = 2;
-    else if (19 * crop_size > 20 * trgt_size)
-      filter_phase = 1;
+    filter_phase = kvz_selectDownFilter(crop_size, trgt_size, param->down_filter);
   }
 
   const int shift = (is_vertical ? param->shift_y : param->shift_x) - 4;
@@ -3619,6 +3547,9 @@ static void opaqueResampleBlockStep_avx2_adapter(const opaque_pic_buffer_t* cons
   const int add = is_vertical ? param->add_y : param->add_x;
   const int delta = is_vertical ? param->delta_y : param->delta_x;
 
+  //Use precalculated ref positions and phases if available
+  const scaling_phase_table_t *const table = avx2_get_phase_table(param, is_luma, is_vertical, block_x, block_y, block_width, block_height);
+
   //Set loop parameters based on the resampling dir
   const void *filter;
   const int filter_size = kvz_prepareFilterDepth(&filter, is_upscaling, is_luma, filter_phase, src_buffer->depth);
@@ -3631,23 +3562,23 @@ static void opaqueResampleBlockStep_avx2_adapter(const opaque_pic_buffer_t* cons
   if (is_vertical && ((src_buffer->depth == sizeof(uint16_t) && filter_size < 12) || src_buffer->depth == sizeof(pic_data_t))) {
     //Handle vertical resampling cases
     if (trgt_buffer->depth == sizeof(uint8_t) && src_buffer->depth == sizeof(uint16_t) && (filter_size == 8 || filter_size == 4) ) {
-      opaqueResampleBlockStep_avx2_vertical_16to8bit_filterSize_8_4(src_buffer, trgt_buffer, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (int16_t*)filter, filter_size == 8, shift, scale, add, delta, src_size, is_upscaling);
+      opaqueResampleBlockStep_avx2_vertical_16to8bit_filterSize_8_4(src_buffer, trgt_buffer, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (int16_t*)filter, filter_size == 8, shift, scale, add, delta, table, src_size, is_upscaling);
     }
     else
     {
       kvz_prepareFilterDepth(&filter, is_upscaling, is_luma, filter_phase, sizeof(int32_t));
-      opaqueResampleBlockStep_avx2_vertical(src_buffer, trgt_buffer, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (int32_t*)filter, filter_size, shift, scale, add, delta, src_size, is_upscaling);
+      opaqueResampleBlockStep_avx2_vertical(src_buffer, trgt_buffer, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (int32_t*)filter, filter_size, shift, scale, add, delta, table, src_size, is_upscaling);
     }
   } 
   else if (!is_vertical && (trgt_buffer->depth == sizeof(pic_data_t) || (trgt_buffer->depth == sizeof(uint16_t) && filter_size < 12))) {
     //Handle horizontal resampling cases
     if (src_buffer->depth == sizeof(uint8_t) && trgt_buffer->depth == sizeof(uint16_t) && (filter_size == 8 || filter_size == 4)) {
-      opaqueResampleBlocckStep_avx2_horizontal_8to16bit_filterSize_8_4(src_buffer, trgt_buffer, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (int8_t*)filter, filter_size == 8, shift, scale, add, delta, src_size);
+      opaqueResampleBlocckStep_avx2_horizontal_8to16bit_filterSize_8_4(src_buffer, trgt_buffer, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (int8_t*)filter, filter_size == 8, shift, scale, add, delta, table, src_size);
     }
     else
     {
       kvz_prepareFilterDepth(&filter, is_upscaling, is_luma, filter_phase, sizeof(int32_t));
-      opaqueResampleBlockStep_avx2_horizontal(src_buffer, trgt_buffer, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (int32_t*)filter, filter_size, shift, scale, add, delta, src_size);
+      opaqueResampleBlockStep_avx2_horizontal(src_buffer, trgt_buffer, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (int32_t*)filter, filter_size, shift, scale, add, delta, table, src_size);
     }
   } 
   else {
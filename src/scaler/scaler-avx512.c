@@ -0,0 +1,315 @@
+/*****************************************************************************
+* This file is part of Kvazaar HEVC encoder.
+*
+* Copyright (C) 2013-2015 Tampere University of Technology and others (see
+* COPYING file).
+*
+* Kvazaar is free software: you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 2.1 of the License, or (at your
+* option) any later version.
+*
+* Kvazaar is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include "scaler-avx512.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#include "scaler-util.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <assert.h>
+#include <immintrin.h>
+
+#define OPAQUE_RESAMPLE_BLOCK_STEP_FUNC_AVX512 opaqueResampleBlockStep_avx512_adapter
+#define DEFAULT_RESAMPLE_BLOCK_STEP_FUNC_AVX512 resampleBlockStep_avx512
+
+#define SELECT_LOW_4_BITS 0xF
+
+//Number of 32-bit lanes in a 512-bit vector aka how many target values are calculated in one loop
+#define T_STEP 16
+
+#define MAX_FILTER_SIZE 12
+
+//Define macros for avx512 ref pos calcs
+#define avx512_calc_ref_pos_16_epi32(ind, scale, add, shift, delta) _mm512_sub_epi32(_mm512_srli_epi32(_mm512_add_epi32(_mm512_mullo_epi32(ind, scale), add), shift), delta)
+#define avx512_get_phase_epi32(ref_pos_16) _mm512_and_si512(ref_pos_16, _mm512_set1_epi32(SELECT_LOW_4_BITS))
+#define avx512_get_ref_pos_epi32(ref_pos_16) _mm512_srai_epi32(ref_pos_16, 4)
+
+//Offsets may be negative so make sure the index is not converted to unsigned with depth
+#define VOID_INDEX(ptr,ind,depth) ((void *)(((uint8_t *)(ptr)) + (ptrdiff_t)(ind) * (depth)))
+
+//Mask for the first n (max 16) 32-bit lanes
+#define LANE_MASK(n) ((__mmask16)((1u << (n)) - 1))
+
+//Gather the samples at the given positions and widen them to 32-bits.
+//Samples narrower than 32-bits are gathered as 32-bit words. Positions in the last word of the row are moved back
+//so that nothing past the last sample (src_size - 1) gets read, and the wanted sample is shifted down instead.
+static __m512i gather_samples_epi32(const void *const src, const __m512i sample_pos, const __m512i last_word_pos, const unsigned depth)
+{
+  if (depth == sizeof(int32_t)) {
+    return _mm512_i32gather_epi32(sample_pos, src, sizeof(int32_t));
+  }
+
+  const __m512i word_pos = _mm512_min_epi32(sample_pos, last_word_pos);
+  const __m512i bit_shift = _mm512_slli_epi32(_mm512_sub_epi32(sample_pos, word_pos), depth == sizeof(int16_t) ? 4 : 3);
+  const __m512i sample_mask = _mm512_set1_epi32(depth == sizeof(int16_t) ? 0xFFFF : 0xFF);
+
+  __m512i words;
+  if (depth == sizeof(int16_t)) {
+    words = _mm512_i32gather_epi32(word_pos, src, sizeof(int16_t));
+  } else {
+    words = _mm512_i32gather_epi32(word_pos, src, sizeof(uint8_t));
+  }
+
+  return _mm512_and_si512(_mm512_srlv_epi32(words, bit_shift), sample_mask);
+}
+
+//Load n (max 16) consecutive samples and widen them to 32-bits. 16-bit samples are intermediate values and are sign extended.
+static __m512i load_samples_epi32(const void *const src, const __mmask16 mask, const unsigned depth)
+{
+  switch (depth)
+  {
+    case sizeof(int32_t):
+      return _mm512_maskz_loadu_epi32(mask, src);
+
+    case sizeof(int16_t):
+      return _mm512_cvtepi16_epi32(_mm512_castsi512_si256(_mm512_maskz_loadu_epi16((__mmask32)mask, src)));
+
+    case sizeof(uint8_t):
+      return _mm512_cvtepu8_epi32(_mm512_castsi512_si128(_mm512_maskz_loadu_epi8((__mmask64)mask, src)));
+
+    default:
+      //Not a supported depth
+      assert(0);
+      return _mm512_setzero_si512();
+  }
+}
+
+//Store the lanes selected by mask truncated to the given depth
+static void store_samples_epi32(void *const dst, const __m512i data, const __mmask16 mask, const unsigned depth)
+{
+  switch (depth)
+  {
+    case sizeof(int32_t):
+      _mm512_mask_storeu_epi32(dst, mask, data);
+      break;
+
+    case sizeof(int16_t):
+      _mm512_mask_cvtepi32_storeu_epi16(dst, mask, data);
+      break;
+
+    case sizeof(uint8_t):
+      _mm512_mask_cvtepi32_storeu_epi8(dst, mask, data);
+      break;
+
+    default:
+      //Not a supported depth
+      assert(0);
+      break;
+  }
+}
+
+//Horizontal step. Each lane calculates one target pixel, so sample positions and filter coeffs are gathered per lane.
+static void opaqueResampleBlockStep_avx512_horizontal(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_stride, const int trgt_stride, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int32_t *const filter, const int filter_size, const int shift, const int scale, const int add, const int delta, const scaling_phase_table_t *const table, const int src_size)
+{
+  const int x_bound = block_x + block_width;
+  const int y_bound = block_y + block_height;
+
+  const __m512i seq = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+  const __m512i scale_epi32 = _mm512_set1_epi32(scale);
+  const __m512i add_epi32 = _mm512_set1_epi32(add);
+  const __m512i delta_epi32 = _mm512_set1_epi32(delta);
+
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i max_src_ind = _mm512_set1_epi32(src_size - 1);
+  const __m512i ref_pos_filt_offset = _mm512_set1_epi32((filter_size >> 1) - 1);
+  const __m512i filter_size_epi32 = _mm512_set1_epi32(filter_size);
+
+  //Position of the last full 32-bit word in the src row
+  assert(src_size * src_buffer->depth >= sizeof(int32_t));
+  const __m512i last_word_pos = _mm512_set1_epi32(src_size - sizeof(int32_t) / src_buffer->depth);
+
+  for (int y = block_y; y < y_bound; y++) {
+
+    const void *src = VOID_INDEX(src_buffer->data, y * src_stride + src_offset, src_buffer->depth);
+    void *trgt_row = VOID_INDEX(trgt_buffer->data, y * trgt_stride + trgt_offset, trgt_buffer->depth);
+
+    //loop over x (target block width)
+    for (int x = block_x; x < x_bound; x += T_STEP) {
+
+      const __mmask16 t_mask = LANE_MASK(SCALER_MIN(x_bound - x, T_STEP));
+
+      //Calculate reference position in src pic or load it from the phase table
+      __m512i phase_epi32, ref_pos_epi32;
+      if (table != NULL) {
+        phase_epi32 = _mm512_maskz_loadu_epi32(t_mask, &table->phase[x]);
+        ref_pos_epi32 = _mm512_maskz_loadu_epi32(t_mask, &table->ref_pos[x]);
+      } else {
+        const __m512i t_ind_epi32 = _mm512_add_epi32(_mm512_set1_epi32(x), seq);
+        const __m512i ref_pos_16_epi32 = avx512_calc_ref_pos_16_epi32(t_ind_epi32, scale_epi32, add_epi32, shift, delta_epi32);
+        phase_epi32 = avx512_get_phase_epi32(ref_pos_16_epi32);
+        ref_pos_epi32 = avx512_get_ref_pos_epi32(ref_pos_16_epi32);
+      }
+      const __m512i filter_pos_epi32 = _mm512_mullo_epi32(phase_epi32, filter_size_epi32);
+
+      //Calculate the first sample ind based on the ref pos
+      ref_pos_epi32 = _mm512_sub_epi32(ref_pos_epi32, ref_pos_filt_offset);
+
+      __m512i filter_res_epi32 = zero;
+
+      for (int f_ind = 0; f_ind < filter_size; f_ind++) {
+        const __m512i f_ind_epi32 = _mm512_set1_epi32(f_ind);
+
+        //Need to make sure that sample position does not lie outside [0, src_size - 1]
+        const __m512i sample_pos_epi32 = _mm512_min_epi32(_mm512_max_epi32(_mm512_add_epi32(ref_pos_epi32, f_ind_epi32), zero), max_src_ind);
+
+        const __m512i data = gather_samples_epi32(src, sample_pos_epi32, last_word_pos, src_buffer->depth);
+        const __m512i coeff = _mm512_i32gather_epi32(_mm512_add_epi32(filter_pos_epi32, f_ind_epi32), filter, sizeof(int32_t));
+
+        filter_res_epi32 = _mm512_add_epi32(filter_res_epi32, _mm512_mullo_epi32(data, coeff));
+      }
+
+      //Write back the new values for the current pixels
+      store_samples_epi32(VOID_INDEX(trgt_row, x, trgt_buffer->depth), filter_res_epi32, t_mask, trgt_buffer->depth);
+    }
+  }
+}
+
+//Vertical step. All lanes share the same sample rows and filter coeffs, so samples can be loaded directly.
+static void opaqueResampleBlockStep_avx512_vertical(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_stride, const int trgt_stride, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const int32_t *const filter, const int filter_size, const int shift, const int scale, const int add, const int delta, const scaling_phase_table_t *const table, const int src_size, const int is_upscaling)
+{
+  const int x_bound = block_x + block_width;
+  const int y_bound = block_y + block_height;
+
+  const __m512i scale_round = _mm512_set1_epi32(is_upscaling ? 2048 : 8192); //Rounding constant for normalizing pixel values to the correct range
+  const int scale_shift = is_upscaling ? 12 : 14; //Amount of shift in the final pixel value normalization
+
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i max_val = _mm512_set1_epi32(255);
+
+  const void *src_rows[MAX_FILTER_SIZE];
+  __m512i coeffs[MAX_FILTER_SIZE];
+
+  for (int y = block_y; y < y_bound; y++) {
+
+    void *trgt_row = VOID_INDEX(trgt_buffer->data, y * trgt_stride + trgt_offset, trgt_buffer->depth);
+
+    //Calculate reference position in src pic or get it from the phase table
+    int phase, ref_pos;
+    if (table != NULL) {
+      phase = table->phase[y];
+      ref_pos = table->ref_pos[y] - (filter_size >> 1) + 1;
+    } else {
+      const int ref_pos_16 = (int)((unsigned int)(y * scale + add) >> shift) - delta;
+      phase = ref_pos_16 & SELECT_LOW_4_BITS;
+      ref_pos = (ref_pos_16 >> 4) - (filter_size >> 1) + 1;
+    }
+
+    //Pre-processing step
+    //  Select src rows and broadcast filter coeffs
+    for (int f_ind = 0; f_ind < filter_size; f_ind++) {
+      const int s_ind = SCALER_CLIP(ref_pos + f_ind, 0, src_size - 1);
+      src_rows[f_ind] = VOID_INDEX(src_buffer->data, s_ind * src_stride + src_offset, src_buffer->depth);
+      coeffs[f_ind] = _mm512_set1_epi32(getFilterCoeff(filter, filter_size, phase, f_ind));
+    }
+
+    //loop over x (target block width)
+    for (int x = block_x; x < x_bound; x += T_STEP) {
+
+      const __mmask16 t_mask = LANE_MASK(SCALER_MIN(x_bound - x, T_STEP));
+
+      __m512i filter_res_epi32 = zero;
+
+      for (int f_ind = 0; f_ind < filter_size; f_ind++) {
+        const __m512i data = load_samples_epi32(VOID_INDEX(src_rows[f_ind], x, src_buffer->depth), t_mask, src_buffer->depth);
+        filter_res_epi32 = _mm512_add_epi32(filter_res_epi32, _mm512_mullo_epi32(data, coeffs[f_ind]));
+      }
+
+      //Scale values in trgt buffer to the correct range
+      filter_res_epi32 = _mm512_srai_epi32(_mm512_add_epi32(filter_res_epi32, scale_round), scale_shift);
+      filter_res_epi32 = _mm512_min_epi32(_mm512_max_epi32(filter_res_epi32, zero), max_val);
+
+      //Write back the new values for the current pixels
+      store_samples_epi32(VOID_INDEX(trgt_row, x, trgt_buffer->depth), filter_res_epi32, t_mask, trgt_buffer->depth);
+    }
+  }
+}
+
+/**
+*  \brief Do resampling on opaque data buffers. Supported bit-depths:
+*     horizontal step: {8,16,32}-bit -> {16,32}-bit
+*     vertical step: {8,16,32}-bit -> {8,16,32}-bit
+*    Intermediate values are always accumulated in 32-bits, so all filter sizes are supported for every depth.
+*/
+static void opaqueResampleBlockStep_avx512_adapter(const opaque_pic_buffer_t* const src_buffer, const opaque_pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const scaling_parameter_t* const param, const int is_upscaling, const int is_luma, const int is_vertical)
+{
+  //TODO: Add cropping etc.
+
+  //Choose best filter to use when downsampling
+  int filter_phase = 0;
+
+  const int src_size = is_vertical ? param->src_height + param->src_padding_y : param->src_width + param->src_padding_x;
+  const int trgt_size = is_vertical ? param->rnd_trgt_height : param->rnd_trgt_width;
+
+  if (!is_upscaling) {
+    int crop_size = src_size - (is_vertical ? param->bottom_offset : param->right_offset); //- param->left_offset/top_offset;
+    filter_phase = kvz_selectDownFilter(crop_size, trgt_size, param->down_filter);
+  }
+
+  const int shift = (is_vertical ? param->shift_y : param->shift_x) - 4;
+  const int scale = is_vertical ? param->scale_y : param->scale_x;
+  const int add = is_vertical ? param->add_y : param->add_x;
+  const int delta = is_vertical ? param->delta_y : param->delta_x;
+
+  //Use precalculated ref positions and phases if available
+  const scaling_phase_table_t *const table = kvz_getScalingPhaseTable(param, is_luma, is_vertical, is_vertical ? block_y : block_x, is_vertical ? block_y + block_height - 1 : block_x + block_width - 1);
+
+  const void *filter;
+  const int filter_size = kvz_prepareFilterDepth(&filter, is_upscaling, is_luma, filter_phase, sizeof(int32_t));
+
+  //Only filter size of max 12 supported
+  assert(filter_size <= MAX_FILTER_SIZE);
+
+  //If depths match pic data type, the buffers are used like pic_buffer_t that has no separate stride
+  const int is_pic_buffer = src_buffer->depth == sizeof(pic_data_t) && trgt_buffer->depth == sizeof(pic_data_t);
+  const int src_stride = is_pic_buffer ? src_buffer->width : src_buffer->stride;
+  const int trgt_stride = is_pic_buffer ? trgt_buffer->width : trgt_buffer->stride;
+
+  if (is_vertical) {
+    opaqueResampleBlockStep_avx512_vertical(src_buffer, trgt_buffer, src_stride, trgt_stride, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (const int32_t*)filter, filter_size, shift, scale, add, delta, table, src_size, is_upscaling);
+  }
+  else if (trgt_buffer->depth >= sizeof(int16_t)) {
+    opaqueResampleBlockStep_avx512_horizontal(src_buffer, trgt_buffer, src_stride, trgt_stride, src_offset, trgt_offset, block_x, block_y, block_width, block_height, (const int32_t*)filter, filter_size, shift, scale, add, delta, table, src_size);
+  }
+  else {
+    //8-bit trgt buffer not supported in the horizontal step
+    assert(0);
+  }
+}
+
+static void resampleBlockStep_avx512(const pic_buffer_t* const src_buffer, const pic_buffer_t *const trgt_buffer, const int src_offset, const int trgt_offset, const int block_x, const int block_y, const int block_width, const int block_height, const scaling_parameter_t* const param, const int is_upscaling, const int is_luma, const int is_vertical)
+{
+  const opaque_pic_buffer_t src = { src_buffer->width, src_buffer->height, src_buffer->data, src_buffer->width, sizeof(pic_data_t) };
+  const opaque_pic_buffer_t trgt = { trgt_buffer->width, trgt_buffer->height, trgt_buffer->data, trgt_buffer->width, sizeof(pic_data_t) };
+
+  opaqueResampleBlockStep_avx512_adapter(&src, &trgt, src_offset, trgt_offset, block_x, block_y, block_width, block_height, param, is_upscaling, is_luma, is_vertical);
+}
+
+//Set the default resample function
+opaque_resample_block_step_func *const kvz_opaque_block_step_resample_func_avx512 = &OPAQUE_RESAMPLE_BLOCK_STEP_FUNC_AVX512;
+resample_block_step_func *const kvz_default_block_step_resample_func_avx512 = &DEFAULT_RESAMPLE_BLOCK_STEP_FUNC_AVX512;
+
+#else
+//Set the default resample function
+opaque_resample_block_step_func *const kvz_opaque_block_step_resample_func_avx512 = 0;
+resample_block_step_func *const kvz_default_block_step_resample_func_avx512 = 0;
+#endif //__AVX512F__ && __AVX512BW__
@@ -0,0 +1,28 @@
+#ifndef SCALER_AVX512_H_
+#define SCALER_AVX512_H_
+/*****************************************************************************
+* This file is part of Kvazaar HEVC encoder.
+*
+* Copyright (C) 2013-2015 Tampere University of Technology and others (see
+* COPYING file).
+*
+* Kvazaar is free software: you can redistribute it and/or modify it under
+* the terms of the GNU Lesser General Public License as published by the
+* Free Software Foundation; either version 2.1 of the License, or (at your
+* option) any later version.
+*
+* Kvazaar is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+* more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+#include "scaler.h"
+
+//Resampling functions using 512-bit vectors (AVX512F + AVX512BW). Set to 0 if not compiled in.
+extern opaque_resample_block_step_func *const kvz_opaque_block_step_resample_func_avx512;
+extern resample_block_step_func *const kvz_default_block_step_resample_func_avx512;
+
+#endif
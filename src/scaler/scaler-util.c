@@ -31,6 +31,31 @@ int kvz_clip_scaler(int val, int min, int max)
   return val;
 }
 
+//Helper function for choosing the downscaling (anti-alias) filter
+int kvz_selectDownFilter(int crop_size, int trgt_size, int down_filter)
+{
+  if (down_filter > 0) {
+    return SCALER_MIN(down_filter, (int)SCALER_NUM_DOWN_FILTERS) - 1;
+  }
+
+  if (4 * crop_size > 15 * trgt_size)
+    return 7;
+  else if (7 * crop_size > 20 * trgt_size)
+    return 6;
+  else if (2 * crop_size > 5 * trgt_size)
+    return 5;
+  else if (1 * crop_size > 2 * trgt_size)
+    return 4;
+  else if (3 * crop_size > 5 * trgt_size)
+    return 3;
+  else if (4 * crop_size > 5 * trgt_size)
+    return 2;
+  else if (19 * crop_size > 20 * trgt_size)
+    return 1;
+
+  return 0;
+}
+
 //Helper function for choosing the correct filter
 //Returns the size of the filter and the filter param is set to the correct filter
 int kvz_getFilter(const int** const filter, int is_upsampling, int is_luma, int phase, int filter_ind)
@@ -823,6 +823,13 @@ static const char chromaUpFilter1D_8bit[17 * 4] = {
   0, 0, 0, 0 //Padding for avx2
 };
 
+//Number of downscaling filters. Filters go from the sharpest to the smoothest.
+#define SCALER_NUM_DOWN_FILTERS (sizeof(downFilter) / sizeof(downFilter[0]))
+
+//Helper function for choosing the downscaling (anti-alias) filter
+//Returns the index of the filter in downFilter. The filter is chosen based on the scaling ratio
+//unless a filter is given with down_filter (index + 1, see scaling_parameter_t).
+int kvz_selectDownFilter(int crop_size, int trgt_size, int down_filter);
 
 //Helper function for choosing the correct filter
 //Returns the size of the filter and the filter param is set to the correct filter
@@ -118,7 +118,8 @@ opaque_pic_buffer_t * kvz_newOpaquePictureBuffer(void *const data, int width, in
     return NULL;
   }
   
-  if (data == NULL && alloc_depth != 0 ) {
+  //Chroma planes of CHROMA_400 are empty so nothing is allocated for them
+  if (data == NULL && alloc_depth != 0 && width * height > 0) {
     buffer->data = malloc(width * height * alloc_depth);
   } else {
     buffer->data = data;
@@ -653,35 +654,9 @@ static void _resample(const pic_buffer_t* const buffer, const scaling_parameter_
     int crop_width = src_width - param->right_offset; //- param->left_offset;
     int crop_height = src_height - param->bottom_offset; //- param->top_offset;
 
-    if (4 * crop_height > 15 * trgt_height)
-      ver_filter = 7;
-    else if (7 * crop_height > 20 * trgt_height)
-      ver_filter = 6;
-    else if (2 * crop_height > 5 * trgt_height)
-      ver_filter = 5;
-    else if (1 * crop_height > 2 * trgt_height)
-      ver_filter = 4;
-    else if (3 * crop_height > 5 * trgt_height)
-      ver_filter = 3;
-    else if (4 * crop_height > 5 * trgt_height)
-      ver_filter = 2;
-    else if (19 * crop_height > 20 * trgt_height)
-      ver_filter = 1;
-
-    if (4 * crop_width > 15 * trgt_width)
-      hor_filter = 7;
-    else if (7 * crop_width > 20 * trgt_width)
-      hor_filter = 6;
-    else if (2 * crop_width > 5 * trgt_width)
-      hor_filter = 5;
-    else if (1 * crop_width > 2 * trgt_width)
-      hor_filter = 4;
-    else if (3 * crop_width > 5 * trgt_width)
-      hor_filter = 3;
-    else if (4 * crop_width > 5 * trgt_width)
-      hor_filter = 2;
-    else if (19 * crop_width > 20 * trgt_width)
-      hor_filter = 1;
+    ver_filter = kvz_selectDownFilter(crop_height, trgt_height, param->down_filter);
+
+    hor_filter = kvz_selectDownFilter(crop_width, trgt_width, param->down_filter);
   }
 
   int shift_x = param->shift_x - 4;
@@ -767,35 +742,9 @@ static void resample(const pic_buffer_t* const buffer, const scaling_parameter_t
     int crop_width = src_width - param->right_offset; //- param->left_offset;
     int crop_height = src_height - param->bottom_offset; //- param->top_offset;
 
-    if (4 * crop_height > 15 * trgt_height)
-      ver_filter = 7;
-    else if (7 * crop_height > 20 * trgt_height)
-      ver_filter = 6;
-    else if (2 * crop_height > 5 * trgt_height)
-      ver_filter = 5;
-    else if (1 * crop_height > 2 * trgt_height)
-      ver_filter = 4;
-    else if (3 * crop_height > 5 * trgt_height)
-      ver_filter = 3;
-    else if (4 * crop_height > 5 * trgt_height)
-      ver_filter = 2;
-    else if (19 * crop_height > 20 * trgt_height)
-      ver_filter = 1;
-
-    if (4 * crop_width > 15 * trgt_width)
-      hor_filter = 7;
-    else if (7 * crop_width > 20 * trgt_width)
-      hor_filter = 6;
-    else if (2 * crop_width > 5 * trgt_width)
-      hor_filter = 5;
-    else if (1 * crop_width > 2 * trgt_width)
-      hor_filter = 4;
-    else if (3 * crop_width > 5 * trgt_width)
-      hor_filter = 3;
-    else if (4 * crop_width > 5 * trgt_width)
-      hor_filter = 2;
-    else if (19 * crop_width > 20 * trgt_width)
-      hor_filter = 1;
+    ver_filter = kvz_selectDownFilter(crop_height, trgt_height, param->down_filter);
+
+    hor_filter = kvz_selectDownFilter(crop_width, trgt_width, param->down_filter);
   }
 
   const int *filter_hor;
@@ -806,6 +755,10 @@ static void resample(const pic_buffer_t* const buffer, const scaling_parameter_t
   int shift_x = param->shift_x - 4;
   int shift_y = param->shift_y - 4;
 
+  //Use precalculated ref positions and phases if available
+  const scaling_phase_table_t *const table_hor = kvz_getScalingPhaseTable(param, is_luma, 0, 0, trgt_width - 1);
+  const scaling_phase_table_t *const table_ver = kvz_getScalingPhaseTable(param, is_luma, 1, 0, trgt_height - 1);
+
   pic_data_t* tmp_row = buffer->tmp_row;
 
   // Horizontal resampling
@@ -814,9 +767,15 @@ static void resample(const pic_buffer_t* const buffer, const scaling_parameter_t
 
     for (int j = 0; j < trgt_width; j++) {
       //Calculate reference position in src pic
-      int ref_pos_16 = (int)((unsigned int)(j * param->scale_x + param->add_x) >> shift_x) - param->delta_x;
-      int phase = ref_pos_16 & 15;
-      int ref_pos = ref_pos_16 >> 4;
+      int phase, ref_pos;
+      if (table_hor != NULL) {
+        phase = table_hor->phase[j];
+        ref_pos = table_hor->ref_pos[j];
+      } else {
+        int ref_pos_16 = (int)((unsigned int)(j * param->scale_x + param->add_x) >> shift_x) - param->delta_x;
+        phase = ref_pos_16 & 15;
+        ref_pos = ref_pos_16 >> 4;
+      }
 
       //Choose filter
       const int* filter;
@@ -842,9 +801,15 @@ static void resample(const pic_buffer_t* const buffer, const scaling_parameter_t
     pic_data_t* src_col = &buffer->data[i];
     for (int j = 0; j < trgt_height; j++) {
       //Calculate ref pos
-      int ref_pos_16 = (int)((unsigned int)(j * param->scale_y + param->add_y) >> shift_y) - param->delta_y;
-      int phase = ref_pos_16 & 15;
-      int ref_pos = ref_pos_16 >> 4;
+      int phase, ref_pos;
+      if (table_ver != NULL) {
+        phase = table_ver->phase[j];
+        ref_pos = table_ver->ref_pos[j];
+      } else {
+        int ref_pos_16 = (int)((unsigned int)(j * param->scale_y + param->add_y) >> shift_y) - param->delta_y;
+        phase = ref_pos_16 & 15;
+        ref_pos = ref_pos_16 >> 4;
+      }
 
       //Choose filter
       const int* filter;
@@ -884,20 +849,7 @@ static void resampleBlockStep(const pic_buffer_t* const src_buffer, const pic_bu
 
   if (!is_upscaling) {
     int crop_size = src_size - ( is_vertical ? param->bottom_offset : param->right_offset); //- param->left_offset/top_offset;
-    if (4 * crop_size > 15 * trgt_size)
-      filter_phase = 7;
-    else if (7 * crop_size > 20 * trgt_size)
-      filter_phase = 6;
-    else if (2 * crop_size > 5 * trgt_size)
-      filter_phase = 5;
-    else if (1 * crop_size > 2 * trgt_size)
-      filter_phase = 4;
-    else if (3 * crop_size > 5 * trgt_size)
-      filter_phase = 3;
-    else if (4 * crop_size > 5 * trgt_size)
-      filter_phase = 2;
-    else if (19 * crop_size > 20 * trgt_size)
-      filter_phase = 1;
+    filter_phase = kvz_selectDownFilter(crop_size, trgt_size, param->down_filter);
   }
 
   const int shift = (is_vertical ? param->shift_y : param->shift_x) - 4;
@@ -914,6 +866,9 @@ static void resampleBlockStep(const pic_buffer_t* const src_buffer, const pic_bu
   const int inner_bound = is_vertical ? block_x + block_width : filter_size;
   const int s_stride = is_vertical ? src_buffer->width : 1; //Multiplier to s_ind
 
+  //Use precalculated ref positions and phases if available
+  const scaling_phase_table_t *const table = kvz_getScalingPhaseTable(param, is_luma, is_vertical, is_vertical ? block_y : block_x, is_vertical ? block_y + block_height - 1 : block_x + block_width - 1);
+
   //Do resampling (vertical/horizontal) of the specified block into trgt_buffer using src_buffer
   for (int y = block_y; y < (block_y + block_height); y++) {
 
@@ -928,9 +883,15 @@ static void resampleBlockStep(const pic_buffer_t* const src_buffer, const pic_bu
       const int t_ind = is_vertical ? y : o_ind; //trgt_buffer row/col index for cur resampling dir
 
       //Calculate reference position in src pic
-      const int ref_pos_16 = (int)((unsigned int)(t_ind * scale + add) >> shift) - delta;
-      const int phase = ref_pos_16 & 15;
-      const int ref_pos = ref_pos_16 >> 4;
+      int phase, ref_pos;
+      if (table != NULL) {
+        phase = table->phase[t_ind];
+        ref_pos = table->ref_pos[t_ind];
+      } else {
+        const int ref_pos_16 = (int)((unsigned int)(t_ind * scale + add) >> shift) - delta;
+        phase = ref_pos_16 & 15;
+        ref_pos = ref_pos_16 >> 4;
+      }
       
       //Inner loop:
       //  if is_vertical -> loop over x (block width)
@@ -972,9 +933,15 @@ for (int y = block_y; y < (block_y + block_height); y++) {\
   tmp_trgt_type *tmp_trgt_row = &tmp_trgt_data[(y - block_y) * tmp_trgt_data_stride];\
   for (int o_ind = outer_init; o_ind < outer_bound; o_ind++) {\
     const int t_ind = is_vertical ? y : o_ind;\
-    const int ref_pos_16 = (int)((unsigned int)(t_ind * scale + add) >> shift) - delta;\
-    const int phase = ref_pos_16 & 15;\
-    const int ref_pos = ref_pos_16 >> 4;\
+    int phase, ref_pos;\
+    if (table != NULL) {\
+      phase = table->phase[t_ind];\
+      ref_pos = table->ref_pos[t_ind];\
+    } else {\
+      const int ref_pos_16 = (int)((unsigned int)(t_ind * scale + add) >> shift) - delta;\
+      phase = ref_pos_16 & 15;\
+      ref_pos = ref_pos_16 >> 4;\
+    }\
     for (int i_ind = inner_init; i_ind < inner_bound; i_ind++) {\
       const int f_ind = is_vertical ? o_ind : i_ind;\
       const int t_col = is_vertical ? i_ind : o_ind;\
@@ -1018,20 +985,7 @@ static void opaqueResampleBlockStep_adapter(const opaque_pic_buffer_t* const src
 
   if (!is_upscaling) {
     int crop_size = src_size - (is_vertical ? param->bottom_offset : param->right_offset); //- param->left_offset/top_offset;
-    if (4 * crop_size > 15 * trgt_size)
-      filter_phase = 7;
-    else if (7 * crop_size > 20 * trgt_size)
-      filter_phase = 6;
-    else if (2 * crop_size > 5 * trgt_size)
-      filter_phase = 5;
-    else if (1 * crop_size > 2 * trgt_size)
-      filter_phase = 4;
-    else if (3 * crop_size > 5 * trgt_size)
-      filter_phase = 3;
-    else if (4 * crop_size > 5 * trgt_size)
-      filter_phase = 2;
-    else if (19 * crop_size > 20 * trgt_size)
-      filter_phase = 1;
+    filter_phase = kvz_selectDownFilter(crop_size, trgt_size, param->down_filter);
   }
 
   const int shift = (is_vertical ? param->shift_y : param->shift_x) - 4;
@@ -1048,14 +1002,17 @@ static void opaqueResampleBlockStep_adapter(const opaque_pic_buffer_t* const src
   const int inner_bound = is_vertical ? block_x + block_width : filter_size;
   const int s_stride = is_vertical ? src_buffer->stride : 1; //Multiplier to s_ind
 
+  //Use precalculated ref positions and phases if available
+  const scaling_phase_table_t *const table = kvz_getScalingPhaseTable(param, is_luma, is_vertical, is_vertical ? block_y : block_x, is_vertical ? block_y + block_height - 1 : block_x + block_width - 1);
+
   
 
   if (is_vertical && src_buffer->depth >= sizeof(short)) {
 
-    //Set tmp target and trgt buffer the same by default
-    pic_data_t *tmp_trgt_data = (pic_data_t *)malloc(sizeof(pic_data_t) * block_width * block_height);
+    //Every row is accumulated in the same tmp row before it is written to the trgt buffer
+    pic_data_t *tmp_trgt_data = (pic_data_t *)malloc(sizeof(pic_data_t) * block_width);
     int tmp_trgt_data_stride = 0;
-    int tmp_trgt_offset = block_width;
+    int tmp_trgt_offset = 0;
 
     if (src_buffer->depth == sizeof(pic_data_t)) {
       //Handle 32-bit input buffer case
@@ -1073,18 +1030,18 @@ static void opaqueResampleBlockStep_adapter(const opaque_pic_buffer_t* const src
       }
     }
     else if (src_buffer->depth == sizeof(short) && filter_size < 12) {
-      //Handle 16-bit input buffer case
+      //Handle 16-bit input buffer case. Horizontal step results can be negative so read them as signed
       if (trgt_buffer->depth == sizeof(pic_data_t)) {
         //Handle 32-bit input buffer case
-        OPAQUE_RESAMPLE_BLOCK_STEP_TYPE_MACRO(unsigned short, pic_data_t, pic_data_t);
+        OPAQUE_RESAMPLE_BLOCK_STEP_TYPE_MACRO(short, pic_data_t, pic_data_t);
       }
       else if (trgt_buffer->depth == sizeof(short)) {
         //Handle 16-bit input buffer case
-        OPAQUE_RESAMPLE_BLOCK_STEP_TYPE_MACRO(unsigned short, unsigned short, pic_data_t);
+        OPAQUE_RESAMPLE_BLOCK_STEP_TYPE_MACRO(short, unsigned short, pic_data_t);
       } 
       else if (trgt_buffer->depth == sizeof(char)) {
         //Handle 8-bit output buffer case
-        OPAQUE_RESAMPLE_BLOCK_STEP_TYPE_MACRO(unsigned short, unsigned char, pic_data_t);
+        OPAQUE_RESAMPLE_BLOCK_STEP_TYPE_MACRO(short, unsigned char, pic_data_t);
       }
       else {
         //No valid handling for the given depth
@@ -1172,35 +1129,9 @@ static void resampleBlock( const pic_buffer_t* const src_buffer, const scaling_p
     int crop_width = src_width - param->right_offset; //- param->left_offset;
     int crop_height = src_height - param->bottom_offset; //- param->top_offset;
 
-    if (4 * crop_height > 15 * trgt_height)
-      ver_filter = 7;
-    else if (7 * crop_height > 20 * trgt_height)
-      ver_filter = 6;
-    else if (2 * crop_height > 5 * trgt_height)
-      ver_filter = 5;
-    else if (1 * crop_height > 2 * trgt_height)
-      ver_filter = 4;
-    else if (3 * crop_height > 5 * trgt_height)
-      ver_filter = 3;
-    else if (4 * crop_height > 5 * trgt_height)
-      ver_filter = 2;
-    else if (19 * crop_height > 20 * trgt_height)
-      ver_filter = 1;
-
-    if (4 * crop_width > 15 * trgt_width)
-      hor_filter = 7;
-    else if (7 * crop_width > 20 * trgt_width)
-      hor_filter = 6;
-    else if (2 * crop_width > 5 * trgt_width)
-      hor_filter = 5;
-    else if (1 * crop_width > 2 * trgt_width)
-      hor_filter = 4;
-    else if (3 * crop_width > 5 * trgt_width)
-      hor_filter = 3;
-    else if (4 * crop_width > 5 * trgt_width)
-      hor_filter = 2;
-    else if (19 * crop_width > 20 * trgt_width)
-      hor_filter = 1;
+    ver_filter = kvz_selectDownFilter(crop_height, trgt_height, param->down_filter);
+
+    hor_filter = kvz_selectDownFilter(crop_width, trgt_width, param->down_filter);
   }
 
   int shift_x = param->shift_x - 4;
@@ -1311,6 +1242,98 @@ static void calculateParameters(scaling_parameter_t* const param, const int w_fa
   param->is_calculated = 1;
 }
 
+//Fill a phase table of the given size using the given sample positional parameters
+static void initPhaseTable(scaling_phase_table_t *const table, int *const data, const int size, const int scale, const int add, const int shift, const int delta)
+{
+  table->size = size;
+  table->scale = scale;
+  table->add = add;
+  table->shift = shift;
+  table->delta = delta;
+  table->ref_pos = data;
+  table->phase = data + size;
+
+  for (int t_ind = 0; t_ind < size; t_ind++) {
+    const int ref_pos_16 = (int)((unsigned int)(t_ind * scale + add) >> (shift - 4)) - delta;
+    table->ref_pos[t_ind] = ref_pos_16 >> 4;
+    table->phase[t_ind] = ref_pos_16 & 15;
+  }
+}
+
+//Allocate and fill phase tables for luma and chroma in both directions. Tables and data are allocated as one block.
+static scaling_phase_table_t* newPhaseTables(const scaling_parameter_t *const param)
+{
+  //Chroma parameters are calculated the same way as in the scaling functions
+  scaling_parameter_t chroma_param = *param;
+  int w_factor = 0;
+  int h_factor = 0;
+  if (param->chroma == CHROMA_420) {
+    w_factor = -1;
+    h_factor = -1;
+  }
+  else if (param->chroma == CHROMA_422) {
+    w_factor = -1;
+  }
+  chroma_param.is_calculated = 0;
+  calculateParameters(&chroma_param, w_factor, h_factor, 1);
+
+  //Leave room for target padding and blocks that extend past the rounded target size
+  const scaling_parameter_t *const params[2] = { param, &chroma_param };
+  int sizes[4];
+  int total_size = 0;
+  for (int i = 0; i < 2; i++) {
+    sizes[i * 2] = params[i]->rnd_trgt_width + SCALER_BUFFER_PADDING;
+    sizes[i * 2 + 1] = params[i]->rnd_trgt_height + SCALER_BUFFER_PADDING;
+    total_size += (sizes[i * 2] + sizes[i * 2 + 1]) << 1;
+  }
+
+  scaling_phase_table_t *tables = (scaling_phase_table_t *)malloc(sizeof(scaling_phase_table_t) * 4 + sizeof(int) * total_size);
+  if (tables == NULL) {
+    fprintf(stderr, "Could not allocate scaling phase tables.\n");
+    return NULL;
+  }
+
+  int *data = (int *)(tables + 4);
+  for (int i = 0; i < 2; i++) {
+    const scaling_parameter_t *const cur = params[i];
+    initPhaseTable(&tables[i * 2], data, sizes[i * 2], cur->scale_x, cur->add_x, cur->shift_x, cur->delta_x);
+    data += sizes[i * 2] << 1;
+    initPhaseTable(&tables[i * 2 + 1], data, sizes[i * 2 + 1], cur->scale_y, cur->add_y, cur->shift_y, cur->delta_y);
+    data += sizes[i * 2 + 1] << 1;
+  }
+
+  return tables;
+}
+
+void kvz_freeScalingParameters(scaling_parameter_t *const param)
+{
+  if (param == NULL) {
+    return;
+  }
+  free(param->phase_tables);
+  param->phase_tables = NULL;
+}
+
+const scaling_phase_table_t* kvz_getScalingPhaseTable(const scaling_parameter_t *const param, const int is_luma, const int is_vertical, const int t_first, const int t_last)
+{
+  if (param->phase_tables == NULL) {
+    return NULL;
+  }
+
+  const scaling_phase_table_t *const table = &param->phase_tables[(is_luma ? 0 : 2) + (is_vertical ? 1 : 0)];
+
+  //Only use the table if it was calculated with the same parameters and covers the range
+  if (table->scale != (is_vertical ? param->scale_y : param->scale_x)
+    || table->add != (is_vertical ? param->add_y : param->add_x)
+    || table->shift != (is_vertical ? param->shift_y : param->shift_x)
+    || table->delta != (is_vertical ? param->delta_y : param->delta_x)
+    || t_first < 0 || t_last >= table->size) {
+    return NULL;
+  }
+
+  return table;
+}
+
 //TODO: Get rid of is_upsampling param?
 scaling_parameter_t kvz_newScalingParameters(int src_width, int src_height, int trgt_width, int trgt_height, chroma_format_t chroma, int is_upsampling)
 {
@@ -1344,6 +1367,9 @@ scaling_parameter_t kvz_newScalingParameters(int src_width, int src_height, int
   //Pre-Calculate other parameters
   calculateParameters(&param, 0, 0, 0);
 
+  //Pre-Calculate ref positions and phases used by the resampling functions
+  param.phase_tables = newPhaseTables(&param);
+
   return param;
 }
 
@@ -1811,6 +1837,16 @@ static void blockScalingSrcRange( int range[2], const int scale, const int add,
 
 }
 
+//Check if the chroma planes of buffer are smaller than the given luma size. There are no planes to check for CHROMA_400.
+static int chroma_smaller(const yuv_buffer_t *const buffer, const chroma_format_t chroma, const int width, const int height, const int w_factor, const int h_factor)
+{
+  if (chroma == CHROMA_400) {
+    return 0;
+  }
+  return buffer->u->width < SCALER_SHIFT(width, w_factor) || buffer->u->height < SCALER_SHIFT(height, h_factor)
+    || buffer->v->width < SCALER_SHIFT(width, w_factor) || buffer->v->height < SCALER_SHIFT(height, h_factor);
+}
+
 //Do validity checks and calculate offset parameters and scaling dir if needed
 static int blockStepScalingChecks( const yuv_buffer_t *const dst, const yuv_buffer_t *const src, const scaling_parameter_t *const base_param, const int block_x, const int block_y, const int block_width, const int block_height, const int is_vertical, int *dst_offset_luma, int *dst_offset_chroma, int *src_offset_luma, int *src_offset_chroma, int *scaling_dir, int *w_factor_out, int *h_factor_out)
 {
@@ -1864,7 +1900,7 @@ static int blockStepScalingChecks( const yuv_buffer_t *const dst, const yuv_buff
   // if src is the size of the specified src, the src buffer is accessed in the area specified by kvz_blockScaling*Range.
   width_bound = is_vertical ? param.trgt_width : param.src_width + param.src_padding_x;
   height_bound = param.src_height + param.src_padding_y;
-  if (src == NULL || src->y->width < width_bound || src->y->height < height_bound || src->u->width < SCALER_SHIFT(width_bound, w_factor) || src->u->height < SCALER_SHIFT(height_bound, w_factor) || src->v->width < SCALER_SHIFT(width_bound, w_factor) || src->v->height < SCALER_SHIFT(height_bound, w_factor)) {
+  if (src == NULL || src->y->width < width_bound || src->y->height < height_bound || chroma_smaller(src, param.chroma, width_bound, height_bound, w_factor, h_factor)) {
 
     //Get src range needed for scaling
     int range[4];
@@ -1875,8 +1911,7 @@ static int blockStepScalingChecks( const yuv_buffer_t *const dst, const yuv_buff
 
     //Check that src is large enough to hold the block
     if (src == NULL || src->y->width < width_bound || src->y->height < height_bound
-      || src->u->width < SCALER_SHIFT(width_bound, w_factor) || src->u->height < SCALER_SHIFT(height_bound, h_factor)
-      || src->v->width < SCALER_SHIFT(width_bound, w_factor) || src->v->height < SCALER_SHIFT(height_bound, h_factor)) {
+      || chroma_smaller(src, param.chroma, width_bound, height_bound, w_factor, h_factor)) {
       fprintf(stderr, "Source buffer smaller than specified in the scaling parameters.\n");
       return 0;
     }
@@ -1891,13 +1926,11 @@ static int blockStepScalingChecks( const yuv_buffer_t *const dst, const yuv_buff
   width_bound = param.trgt_width;
   height_bound = is_vertical ? param.trgt_height : param.src_height + param.src_padding_y;
   if (dst == NULL || dst->y->width < width_bound || dst->y->height < height_bound
-    || dst->u->width < SCALER_SHIFT(width_bound, w_factor) || dst->u->height < SCALER_SHIFT(height_bound, h_factor)
-    || dst->v->width < SCALER_SHIFT(width_bound, w_factor) || dst->v->height < SCALER_SHIFT(height_bound, h_factor)) {
+    || chroma_smaller(dst, param.chroma, width_bound, height_bound, w_factor, h_factor)) {
 
     //Check that dst is large enough to hold the block
     if (dst == NULL || dst->y->width < block_width || dst->y->height < block_height
-      || dst->u->width < SCALER_SHIFT(block_width, w_factor) || dst->u->height < SCALER_SHIFT(block_height, h_factor)
-      || dst->v->width < SCALER_SHIFT(block_width, w_factor) || dst->v->height < SCALER_SHIFT(block_height, h_factor)) {
+      || chroma_smaller(dst, param.chroma, block_width, block_height, w_factor, h_factor)) {
       fprintf(stderr, "Destination buffer not large enough to hold block\n");
       return 0;
     }
@@ -34,6 +34,24 @@ typedef enum
   CHROMA_444 = 3
 } chroma_format_t;
 
+/**
+* \brief Precalculated reference positions and filter phases for one resampling direction.
+*        Replaces the per-sample ref_pos/phase calculation in the resampling loops.
+*/
+typedef struct
+{
+  int size; //Number of target samples covered by the table
+
+  //Sample positional parameters the table was calculated with
+  int scale;
+  int add;
+  int shift;
+  int delta;
+
+  int *ref_pos; //Integer reference position in the src for each target sample
+  int *phase; //Filter phase (0-15) for each target sample
+} scaling_phase_table_t;
+
 //TODO: Move to .c?
 //TODO: Add offsets/cropping
 typedef struct
@@ -82,10 +100,19 @@ typedef struct
 
   int is_calculated; //Flag that tells that parameters have been calculated. Needs to be set to false manually if values are changed
 
+  //Downscaling (anti-alias) filter. 0 chooses the filter based on the scaling ratio,
+  //1 to 8 use a fixed filter going from the sharpest to the smoothest one.
+  int down_filter;
+
+  //Phase tables for [is_chroma][is_vertical] built by kvz_newScalingParameters. Shared by copies of the parameters.
+  //Use kvz_getScalingPhaseTable to access and kvz_freeScalingParameters to free. NULL if not available.
+  scaling_phase_table_t *phase_tables;
+
 } scaling_parameter_t;
 
 /*==========================================================================*/
 
+#define SCALER_MAX_FILTER_SIZE 12 //Number of taps in the longest resampling filter (downscaling).
 #define SCALER_BUFFER_PADDING 32 //Define padding added to picture buffers. Keeps avx2 optimizations from accessing bad memory.
 
 /*===========================Scaling parameter utility functions=================================*/
@@ -96,6 +123,7 @@ chroma_format_t kvz_getChromaFormat(int luma_width, int luma_height, int chroma_
 
 /**
 * \brief Function for getting initial scaling parameters given src and trgt size parameters.
+*        Also allocates the phase tables, which need to be freed with kvz_freeScalingParameters.
 */
 //TODO: Get rid of is_upsampling (it just toggles rounded width stuff that propably should not be used)
 scaling_parameter_t kvz_newScalingParameters(int src_width, int src_height, int trgt_width, int trgt_height, chroma_format_t chroma, int is_upsampling);
@@ -103,6 +131,17 @@ scaling_parameter_t kvz_newScalingParameters(int src_width, int src_height, int
 * \brief Experimental. Function for getting initial scaling parameters given src and trgt size parameters.
 */
 scaling_parameter_t kvz_newScalingParameters_(int src_width, int src_height, int trgt_width, int trgt_height, chroma_format_t chroma);
+
+/**
+* \brief Free the phase tables allocated by kvz_newScalingParameters. Copies of param must not be used for scaling afterwards.
+*/
+void kvz_freeScalingParameters(scaling_parameter_t *const param);
+
+/**
+* \brief Return the precalculated phase table matching param for the given direction or NULL if the table
+*        can not be used (parameters differ or the target range [t_first, t_last] is not covered).
+*/
+const scaling_phase_table_t* kvz_getScalingPhaseTable(const scaling_parameter_t *const param, const int is_luma, const int is_vertical, const int t_first, const int t_last);
 /*=============================================================================================*/
 
 
@@ -105,17 +105,64 @@ static void work_tree_copy_up(int x_local, int y_local, int depth, lcu_t *work_t
 
 
 /**
- * Copy all non-reference CU data from current level to all lower levels.
+ * Copy the CU info and pixels on the bottom and right edges of a CU.
+ */
+static INLINE void copy_cu_edges(int x_local, int y_local, int width, lcu_t *from, lcu_t *to)
+{
+  const int last = width - 1;
+
+  for (int i = 0; i < width; i += SCU_WIDTH) {
+    *LCU_GET_CU_AT_PX(to, x_local + i, y_local + last) = *LCU_GET_CU_AT_PX(from, x_local + i, y_local + last);
+    *LCU_GET_CU_AT_PX(to, x_local + last, y_local + i) = *LCU_GET_CU_AT_PX(from, x_local + last, y_local + i);
+  }
+
+  const int luma_row = x_local + (y_local + last) * LCU_WIDTH;
+  const int luma_col = x_local + last + y_local * LCU_WIDTH;
+  kvz_pixels_blit(&from->rec.y[luma_row], &to->rec.y[luma_row], width, 1, LCU_WIDTH, LCU_WIDTH);
+  kvz_pixels_blit(&from->rec.y[luma_col], &to->rec.y[luma_col], 1, width, LCU_WIDTH, LCU_WIDTH);
+
+  if (from->rec.chroma_format != KVZ_CSP_400) {
+    const int width_c = width / 2;
+    const int chroma_row = (x_local / 2) + (y_local / 2 + width_c - 1) * LCU_WIDTH_C;
+    const int chroma_col = (x_local / 2 + width_c - 1) + (y_local / 2) * LCU_WIDTH_C;
+    kvz_pixels_blit(&from->rec.u[chroma_row], &to->rec.u[chroma_row], width_c, 1, LCU_WIDTH_C, LCU_WIDTH_C);
+    kvz_pixels_blit(&from->rec.u[chroma_col], &to->rec.u[chroma_col], 1, width_c, LCU_WIDTH_C, LCU_WIDTH_C);
+    kvz_pixels_blit(&from->rec.v[chroma_row], &to->rec.v[chroma_row], width_c, 1, LCU_WIDTH_C, LCU_WIDTH_C);
+    kvz_pixels_blit(&from->rec.v[chroma_col], &to->rec.v[chroma_col], 1, width_c, LCU_WIDTH_C, LCU_WIDTH_C);
+  }
+}
+
+/**
+ * Copy the non-reference CU data needed by adjacent CUs from current level
+ * to all lower levels.
+ *
+ * A region of a lower level is only read after this CU has been decided
+ * when it is used as a neighbour of a later CU, so only the bottom and right
+ * edges are copied. The interior gets overwritten before it is read again.
  */
 static void work_tree_copy_down(int x_local, int y_local, int depth, lcu_t *work_tree)
 {
   const int width = LCU_WIDTH >> depth;
   for (int i = depth + 1; i <= MAX_PU_DEPTH; i++) {
-    copy_cu_info  (x_local, y_local, width, &work_tree[depth], &work_tree[i]);
-    copy_cu_pixels(x_local, y_local, width, &work_tree[depth], &work_tree[i]);
+    copy_cu_edges(x_local, y_local, width, &work_tree[depth], &work_tree[i]);
   }
 }
 
+/**
+ * Initialize a lower level of the work tree from the top level.
+ *
+ * Reconstruction and coefficients are written by the search before they
+ * are read, so only the reference data and CU info are copied.
+ */
+static void work_tree_init_depth(const lcu_t *from, lcu_t *to)
+{
+  to->top_ref = from->top_ref;
+  to->left_ref = from->left_ref;
+  to->ref = from->ref;
+  to->rec.chroma_format = from->rec.chroma_format;
+  memcpy(to->cu, from->cu, sizeof(to->cu));
+}
+
 void kvz_lcu_fill_trdepth(lcu_t *lcu, int x_px, int y_px, int depth, int tr_depth)
 {
   const int x_local = SUB_SCU(x_px);
@@ -435,6 +482,78 @@ static uint8_t get_ctx_cu_split_model(const lcu_t *lcu, int x, int y, int depth)
   return condA + condL;
 }
 
+// ***********************************************
+// Modified for SHVC.
+
+/**
+ * \brief Summary of the co-located CUs of the inter layer reference.
+ */
+typedef struct {
+  int8_t min_depth; //!< \brief Smallest co-located depth mapped to the current layer
+  int8_t max_depth; //!< \brief Largest co-located depth mapped to the current layer
+  bool all_inter;   //!< \brief All co-located CUs are inter
+  bool all_skipped; //!< \brief All co-located CUs are skipped
+} ilr_cu_info_t;
+
+/**
+ * \brief Return the cu array of the inter layer reference, or NULL if
+ *        ilr fast decision is not used.
+ */
+static const cu_array_t* get_ilr_cu_array(const encoder_state_t * const state)
+{
+  if (!state->encoder_control->cfg.ilr_fast_decision) {
+    return NULL;
+  }
+
+  const image_list_t * const ref = state->frame->ref;
+  for (unsigned i = 0; i < ref->used_size; ++i) {
+    if (ref->image_info[i].is_long_term && ref->image_info[i].layer_id < state->encoder_control->layer.layer_id) {
+      return ref->cu_arrays[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * \brief Gather the co-located CU info of the CU at (x, y) from the cu array
+ *        of the inter layer reference.
+ *
+ * The ilr cu array holds the co-located depth mapped to the current layer
+ * and the skip flag, set when the cu array is upsampled.
+ *
+ * \return 1 if any co-located CU was found, 0 otherwise
+ */
+static int get_ilr_cu_info(const encoder_state_t * const state, const cu_array_t * const ilr_cua, int x, int y, int cu_width, ilr_cu_info_t *info)
+{
+  const videoframe_t * const frame = state->tile->frame;
+  const int x_end = MIN(x + cu_width, frame->width);
+  const int y_end = MIN(y + cu_width, frame->height);
+
+  info->min_depth = MAX_DEPTH;
+  info->max_depth = 0;
+  info->all_inter = true;
+  info->all_skipped = true;
+
+  int found = 0;
+  for (int y_px = y; y_px < y_end; y_px += SCU_WIDTH) {
+    for (int x_px = x; x_px < x_end; x_px += SCU_WIDTH) {
+      const int ilr_x = state->tile->offset_x + x_px;
+      const int ilr_y = state->tile->offset_y + y_px;
+      if (ilr_x >= ilr_cua->width || ilr_y >= ilr_cua->height) continue;
+
+      const cu_info_t *col = kvz_cu_array_at_const(ilr_cua, ilr_x, ilr_y);
+      info->min_depth = MIN(info->min_depth, col->depth);
+      info->max_depth = MAX(info->max_depth, col->depth);
+      info->all_inter &= col->type == CU_INTER;
+      info->all_skipped &= col->type == CU_INTER && col->skipped;
+      found = 1;
+    }
+  }
+
+  return found;
+}
+// ***********************************************
+
 /**
  * Search every mode from 0 to MAX_PU_DEPTH and return cost of best mode.
  * - The recursion is started at depth 0 and goes in Z-order to MAX_PU_DEPTH.
@@ -444,8 +563,11 @@ static uint8_t get_ctx_cu_split_model(const lcu_t *lcu, int x, int y, int depth)
  *   relevant levels whenever a decision is made whether to split or not.
  * - All the final data for the LCU gets eventually copied to depth 0, which
  *   will be the final output of the recursion.
+ * - If ilr_cua is given, only depths close to the co-located depths of the
+ *   inter layer reference are searched, and intra, SMP and AMP are skipped
+ *   where the co-located CUs are all inter with the same depth.
  */
-static double search_cu(encoder_state_t * const state, int x, int y, int depth, lcu_t *work_tree)
+static double search_cu(encoder_state_t * const state, int x, int y, int depth, lcu_t *work_tree, const cu_array_t * const ilr_cua)
 {
   const encoder_control_t* ctrl = state->encoder_control;
   const videoframe_t * const frame = state->tile->frame;
@@ -466,6 +588,20 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
     return 0;
   }
 
+  // Modified for SHVC.
+  ilr_cu_info_t ilr_info;
+  const bool use_ilr_info = ilr_cua != NULL && get_ilr_cu_info(state, ilr_cua, x, y, cu_width, &ilr_info);
+  // The co-located CUs are much smaller, so only try the split, as long as
+  // the next depth can be searched.
+  const bool ilr_skip_depth =
+    use_ilr_info && depth < ilr_info.min_depth - 1 && depth < MAX_DEPTH &&
+    (WITHIN(depth + 1, ctrl->cfg.pu_depth_intra.min, ctrl->cfg.pu_depth_intra.max) ||
+     (state->frame->slicetype != KVZ_SLICE_I &&
+      WITHIN(depth + 1, ctrl->cfg.pu_depth_inter.min, ctrl->cfg.pu_depth_inter.max)));
+  // The co-located CUs are all inter with the same depth, so intra, SMP
+  // and AMP are unlikely to win.
+  const bool ilr_stable = use_ilr_info && ilr_info.all_inter && ilr_info.min_depth == ilr_info.max_depth;
+
   cur_cu = LCU_GET_CU_AT_PX(lcu, x_local, y_local);
   // Assign correct depth
   cur_cu->depth = depth > MAX_DEPTH ? MAX_DEPTH : depth;
@@ -477,7 +613,8 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
   // If the CU is completely inside the frame at this depth, search for
   // prediction modes at this depth.
   if (x + cu_width <= frame->width &&
-      y + cu_width <= frame->height)
+      y + cu_width <= frame->height &&
+      !ilr_skip_depth)
   {
     int cu_width_inter_min = LCU_WIDTH >> ctrl->cfg.pu_depth_inter.max;
     bool can_use_inter =
@@ -506,7 +643,7 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
         cur_cu->type = CU_INTER;
       }
 
-      if (!(ctrl->cfg.early_skip && cur_cu->skipped)) {
+      if (!(ctrl->cfg.early_skip && cur_cu->skipped) && !ilr_stable) {
         // Try SMP and AMP partitioning.
         static const part_mode_t mp_modes[] = {
           // SMP
@@ -541,7 +678,8 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
     bool skip_intra = (state->encoder_control->cfg.rdo == 0
                       && cur_cu->type != CU_NOTSET
                       && cost / (cu_width * cu_width) < INTRA_THRESHOLD)
-                      || (ctrl->cfg.early_skip && cur_cu->skipped);
+                      || (ctrl->cfg.early_skip && cur_cu->skipped)
+                      || (ilr_stable && cur_cu->type != CU_NOTSET);
 
     int32_t cu_width_intra_min = LCU_WIDTH >> ctrl->cfg.pu_depth_intra.max;
     bool can_use_intra =
@@ -681,6 +819,14 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
     (state->frame->slicetype != KVZ_SLICE_I &&
       depth < ctrl->cfg.pu_depth_inter.max);
 
+  // Modified for SHVC.
+  // Don't split further than the co-located CUs, or at all if they are all
+  // skipped.
+  if (use_ilr_info && cur_cu->type != CU_NOTSET &&
+      (depth > ilr_info.max_depth || (ilr_info.all_skipped && depth >= ilr_info.max_depth))) {
+    can_split_cu = false;
+  }
+
   // Recursively split all the way to max search depth.
   if (can_split_cu) {
     int half_cu = cu_width / 2;
@@ -708,10 +854,10 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
     // It is ok to interrupt the search as soon as it is known that
     // the split costs at least as much as not splitting.
     if (cur_cu->type == CU_NOTSET || cbf || state->encoder_control->cfg.cu_split_termination == KVZ_CU_SPLIT_TERMINATION_OFF) {
-      if (split_cost < cost) split_cost += search_cu(state, x,           y,           depth + 1, work_tree);
-      if (split_cost < cost) split_cost += search_cu(state, x + half_cu, y,           depth + 1, work_tree);
-      if (split_cost < cost) split_cost += search_cu(state, x,           y + half_cu, depth + 1, work_tree);
-      if (split_cost < cost) split_cost += search_cu(state, x + half_cu, y + half_cu, depth + 1, work_tree);
+      if (split_cost < cost) split_cost += search_cu(state, x,           y,           depth + 1, work_tree, ilr_cua);
+      if (split_cost < cost) split_cost += search_cu(state, x + half_cu, y,           depth + 1, work_tree, ilr_cua);
+      if (split_cost < cost) split_cost += search_cu(state, x,           y + half_cu, depth + 1, work_tree, ilr_cua);
+      if (split_cost < cost) split_cost += search_cu(state, x + half_cu, y + half_cu, depth + 1, work_tree, ilr_cua);
     } else {
       split_cost = INT_MAX;
     }
@@ -927,18 +1073,24 @@ void kvz_search_lcu(encoder_state_t * const state, const int x, const int y, con
   assert(x % LCU_WIDTH == 0);
   assert(y % LCU_WIDTH == 0);
 
-  // Initialize the same starting state to every depth. The search process
+  // The contexts stay the same during the search, so the bit costs RDOQ
+  // uses are computed only once per LCU.
+  if (state->encoder_control->cfg.rdoq_enable) {
+    kvz_rdo_update_cabac_bits(state);
+  }
+
+  // Initialize the same reference state to every depth. The search process
   // will use these as temporary storage for predictions before making
   // a decision on which to use, and they get updated during the search
   // process.
   lcu_t work_tree[MAX_PU_DEPTH + 1];
   init_lcu_t(state, x, y, &work_tree[0], hor_buf, ver_buf);
   for (int depth = 1; depth <= MAX_PU_DEPTH; ++depth) {
-    work_tree[depth] = work_tree[0];
+    work_tree_init_depth(&work_tree[0], &work_tree[depth]);
   }
 
   // Start search from depth 0.
-  double cost = search_cu(state, x, y, 0, work_tree);
+  double cost = search_cu(state, x, y, 0, work_tree, get_ilr_cu_array(state));
 
   // Save squared cost for rate control.
   kvz_get_lcu_stats(state, x / LCU_WIDTH, y / LCU_WIDTH)->weight = cost * cost;
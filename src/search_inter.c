@@ -33,9 +33,27 @@
 #include "search.h"
 #include "strategies/strategies-ipol.h"
 #include "strategies/strategies-picture.h"
+#include "subpel_planes.h"
 #include "transform.h"
 #include "videoframe.h"
 
+// Modified for SHVC.
+// Search range of TZ and max steps of hexagon and diamond search when the
+// search starts from the scaled base layer mv.
+#define ILR_MV_SEARCH_RANGE 16
+#define ILR_MV_MAX_STEPS 4
+
+// Number of integer motion vectors whose SADs are calculated together.
+#define MV_BATCH_SIZE 16
+
+// Range of the full search on the coarsest pyramid level, in pixels of
+// that level.
+#define PYRAMID_SEARCH_RANGE 16
+// Search range of TZ and max steps of hexagon and diamond search when the
+// search starts from the coarse mv.
+#define PYRAMID_MV_SEARCH_RANGE 16
+#define PYRAMID_MV_MAX_STEPS 4
+
 typedef struct {
   encoder_state_t *state;
 
@@ -85,6 +103,21 @@ typedef struct {
    */
   optimized_sad_func_ptr_t optimized_sad;
 
+  // ***********************************************
+  // Modified for SHVC.
+  /**
+   * \brief Scaled base layer mv co-located with the PU. Used as an extra
+   *        starting point and to narrow the integer search.
+   */
+  vector2d_t ilr_mv;
+  bool has_ilr_mv;
+  // ***********************************************
+
+  /**
+   * \brief Whether the search starts from the mv of the coarse search.
+   */
+  bool has_pyramid_mv;
+
 } inter_search_info_t;
 
 
@@ -188,6 +221,41 @@ static INLINE bool intmv_within_tile(const inter_search_info_t *info, int x, int
 }
 
 
+/**
+ * \brief Add the motion vector cost to the SAD of an integer motion vector.
+ *
+ * Updates info->best_mv, info->best_cost and info->best_bitcost to the new
+ * motion vector if it yields a lower cost than the current one.
+ *
+ * \return true if info->best_mv was changed, false otherwise
+ */
+static bool update_mv_cost(inter_search_info_t *info, int x, int y, uint32_t cost)
+{
+  if (cost >= info->best_cost) return false;
+
+  uint32_t bitcost = 0;
+  cost += info->mvd_cost_func(
+      info->state,
+      x, y, 2,
+      info->mv_cand,
+      info->merge_cand,
+      info->num_merge_cand,
+      info->ref_idx,
+      &bitcost
+  );
+
+  if (cost >= info->best_cost) return false;
+
+  // Set to motion vector in quarter pixel precision.
+  info->best_mv.x = x * 4;
+  info->best_mv.y = y * 4;
+  info->best_cost = cost;
+  info->best_bitcost = bitcost;
+
+  return true;
+}
+
+
 /**
  * \brief Calculate cost for an integer motion vector.
  *
@@ -203,7 +271,6 @@ static bool check_mv_cost(inter_search_info_t *info, int x, int y)
 {
   if (!intmv_within_tile(info, x, y)) return false;
 
-  uint32_t bitcost = 0;
   uint32_t cost = kvz_image_calc_sad(
       info->pic,
       info->ref,
@@ -216,27 +283,63 @@ static bool check_mv_cost(inter_search_info_t *info, int x, int y)
       info->optimized_sad
   );
 
-  if (cost >= info->best_cost) return false;
+  return update_mv_cost(info, x, y, cost);
+}
 
-  cost += info->mvd_cost_func(
-      info->state,
-      x, y, 2,
-      info->mv_cand,
-      info->merge_cand,
-      info->num_merge_cand,
-      info->ref_idx,
-      &bitcost
-  );
 
-  if (cost >= info->best_cost) return false;
+/**
+ * \brief Calculate cost for several integer motion vectors.
+ *
+ * Same as calling check_mv_cost for each of the motion vectors in order,
+ * but the SADs are calculated together so that the block is only loaded
+ * once for a batch of motion vectors.
+ *
+ * \return index of the last motion vector that changed info->best_mv, or
+ *         -1 if none of them did
+ */
+static int check_mv_cost_multi(inter_search_info_t *info, const vector2d_t *mvs, int num_mvs)
+{
+  int best_index = -1;
 
-  // Set to motion vector in quarter pixel precision.
-  info->best_mv.x = x * 4;
-  info->best_mv.y = y * 4;
-  info->best_cost = cost;
-  info->best_bitcost = bitcost;
+  for (int start = 0; start < num_mvs; start += MV_BATCH_SIZE) {
+    const int end = MIN(start + MV_BATCH_SIZE, num_mvs);
+    int index[MV_BATCH_SIZE];
+    int ref_x[MV_BATCH_SIZE];
+    int ref_y[MV_BATCH_SIZE];
+    unsigned costs[MV_BATCH_SIZE];
+    int num = 0;
+
+    for (int i = start; i < end; ++i) {
+      if (!intmv_within_tile(info, mvs[i].x, mvs[i].y)) continue;
+
+      index[num] = i;
+      ref_x[num] = info->state->tile->offset_x + info->origin.x + mvs[i].x;
+      ref_y[num] = info->state->tile->offset_y + info->origin.y + mvs[i].y;
+      num++;
+    }
 
-  return true;
+    kvz_image_calc_sad_multi(
+        info->pic,
+        info->ref,
+        info->origin.x,
+        info->origin.y,
+        ref_x,
+        ref_y,
+        num,
+        info->width,
+        info->height,
+        info->optimized_sad,
+        costs
+    );
+
+    for (int i = 0; i < num; ++i) {
+      if (update_mv_cost(info, mvs[index[i]].x, mvs[index[i]].y, costs[i])) {
+        best_index = index[i];
+      }
+    }
+  }
+
+  return best_index;
 }
 
 
@@ -289,8 +392,11 @@ static bool mv_in_merge(const inter_search_info_t *info, vector2d_t mv)
  */
 static void select_starting_point(inter_search_info_t *info, vector2d_t extra_mv)
 {
+  vector2d_t mvs[3 + MRG_MAX_NUM_CANDS];
+  int num_mvs = 0;
+
   // Check the 0-vector, so we can ignore all 0-vectors in the merge cand list.
-  check_mv_cost(info, 0, 0);
+  mvs[num_mvs++] = (vector2d_t){ 0, 0 };
 
   // Change to integer precision.
   extra_mv.x >>= 2;
@@ -298,7 +404,18 @@ static void select_starting_point(inter_search_info_t *info, vector2d_t extra_mv
 
   // Check mv_in if it's not one of the merge candidates.
   if ((extra_mv.x != 0 || extra_mv.y != 0) && !mv_in_merge(info, extra_mv)) {
-    check_mv_cost(info, extra_mv.x, extra_mv.y);
+    mvs[num_mvs++] = extra_mv;
+  }
+
+  // Modified for SHVC.
+  // Check the scaled base layer mv if it's not one of the other candidates.
+  if (info->has_ilr_mv) {
+    const vector2d_t ilr_mv = { (info->ilr_mv.x + 2) >> 2, (info->ilr_mv.y + 2) >> 2 };
+    if ((ilr_mv.x != 0 || ilr_mv.y != 0) &&
+        (ilr_mv.x != extra_mv.x || ilr_mv.y != extra_mv.y) &&
+        !mv_in_merge(info, ilr_mv)) {
+      mvs[num_mvs++] = ilr_mv;
+    }
   }
 
   // Go through candidates
@@ -310,8 +427,10 @@ static void select_starting_point(inter_search_info_t *info, vector2d_t extra_mv
 
     if (x == 0 && y == 0) continue;
 
-    check_mv_cost(info, x, y);
+    mvs[num_mvs++] = (vector2d_t){ x, y };
   }
+
+  check_mv_cost_multi(info, mvs, num_mvs);
 }
 
 
@@ -442,16 +561,15 @@ static bool early_terminate(inter_search_info_t *info)
       threshold = info->best_cost;
     }
 
-    int best_index = 6;
+    vector2d_t mvs[4];
     for (int i = first_index; i <= last_index; i++) {
-      int x = mv.x + small_hexbs[i].x;
-      int y = mv.y + small_hexbs[i].y;
-
-      if (check_mv_cost(info, x, y)) {
-        best_index = i;
-      }
+      mvs[i - first_index].x = mv.x + small_hexbs[i].x;
+      mvs[i - first_index].y = mv.y + small_hexbs[i].y;
     }
 
+    int best_index = check_mv_cost_multi(info, mvs, last_index - first_index + 1);
+    best_index = best_index >= 0 ? first_index + best_index : 6;
+
     // Adjust the movement vector
     mv.x += small_hexbs[best_index].x;
     mv.y += small_hexbs[best_index].y;
@@ -568,16 +686,13 @@ void kvz_tz_pattern_search(inter_search_info_t *info,
   }
 
   // Compute SAD values for all chosen points.
-  int best_index = -1;
+  vector2d_t mvs[8];
   for (int i = 0; i < n_points; i++) {
     vector2d_t offset = pattern[pattern_type][i];
-    int x = mv.x + offset.x;
-    int y = mv.y + offset.y;
-
-    if (check_mv_cost(info, x, y)) {
-      best_index = i;
-    }
+    mvs[i].x = mv.x + offset.x;
+    mvs[i].y = mv.y + offset.y;
   }
+  int best_index = check_mv_cost_multi(info, mvs, n_points);
 
   if (best_index >= 0) {
     *best_dist = iDist;
@@ -591,19 +706,32 @@ void kvz_tz_raster_search(inter_search_info_t *info,
 {
   const vector2d_t mv = { info->best_mv.x >> 2, info->best_mv.y >> 2 };
 
+  vector2d_t mvs[MV_BATCH_SIZE];
+  int num_mvs = 0;
+
   //compute SAD values for every point in the iRaster downsampled version of the current search area
   for (int y = iSearchRange; y >= -iSearchRange; y -= iRaster) {
     for (int x = -iSearchRange; x <= iSearchRange; x += iRaster) {
-      check_mv_cost(info, mv.x + x, mv.y + y);
+      mvs[num_mvs].x = mv.x + x;
+      mvs[num_mvs].y = mv.y + y;
+      if (++num_mvs == MV_BATCH_SIZE) {
+        check_mv_cost_multi(info, mvs, num_mvs);
+        num_mvs = 0;
+      }
     }
   }
+  check_mv_cost_multi(info, mvs, num_mvs);
 }
 
 
 static void tz_search(inter_search_info_t *info, vector2d_t extra_mv)
 {
   //TZ parameters
-  const int iSearchRange = 96;  // search range for each stage
+  int iSearchRange = 96;  // search range for each stage
+  // Modified for SHVC. Use a smaller range around the scaled base layer mv.
+  if (info->has_ilr_mv) iSearchRange = ILR_MV_SEARCH_RANGE;
+  // Also around the mv of the coarse search.
+  if (info->has_pyramid_mv) iSearchRange = PYRAMID_MV_SEARCH_RANGE;
   const int iRaster = 5;  // search distance limit and downsampling factor for step 3
   const unsigned step2_type = 0;  // search patterns for steps 2 and 4
   const unsigned step4_type = 0;
@@ -637,7 +765,7 @@ static void tz_search(inter_search_info_t *info, vector2d_t extra_mv)
     if (rounds_without_improvement >= 3) break;
   }
 
-  if (start.x != 0 || start.y != 0) {
+  if ((start.x != 0 || start.y != 0) && !info->has_ilr_mv && !info->has_pyramid_mv) {
     // repeat step 2 starting from the zero MV
     start.x = 0;
     start.y = 0;
@@ -722,6 +850,14 @@ static void hexagon_search(inter_search_info_t *info, vector2d_t extra_mv, uint3
 
   info->best_cost = UINT32_MAX;
 
+  // Modified for SHVC. Only refine around the scaled base layer mv.
+  if (info->has_ilr_mv) {
+    steps = MIN(steps, ILR_MV_MAX_STEPS);
+  }
+  if (info->has_pyramid_mv) {
+    steps = MIN(steps, PYRAMID_MV_MAX_STEPS);
+  }
+
   // Select starting point from among merge candidates. These should
   // include both mv_cand vectors and (0, 0).
   select_starting_point(info, extra_mv);
@@ -738,11 +874,16 @@ static void hexagon_search(inter_search_info_t *info, vector2d_t extra_mv, uint3
   // Current best index, either to merge_cands, large_hexbs or small_hexbs.
   int best_index = 0;
 
+  vector2d_t mvs[8];
+
   // Search the initial 7 points of the hexagon.
   for (int i = 1; i < 7; ++i) {
-    if (check_mv_cost(info, mv.x + large_hexbs[i].x, mv.y + large_hexbs[i].y)) {
-      best_index = i;
-    }
+    mvs[i - 1].x = mv.x + large_hexbs[i].x;
+    mvs[i - 1].y = mv.y + large_hexbs[i].y;
+  }
+  const int index = check_mv_cost_multi(info, mvs, 6);
+  if (index >= 0) {
+    best_index = 1 + index;
   }
 
   // Iteratively search the 3 new points around the best match, until the best
@@ -769,9 +910,12 @@ static void hexagon_search(inter_search_info_t *info, vector2d_t extra_mv, uint3
     // Iterate through the next 3 points.
     for (int i = 0; i < 3; ++i) {
       vector2d_t offset = large_hexbs[start + i];
-      if (check_mv_cost(info, mv.x + offset.x, mv.y + offset.y)) {
-        best_index = start + i;
-      }
+      mvs[i].x = mv.x + offset.x;
+      mvs[i].y = mv.y + offset.y;
+    }
+    const int step_index = check_mv_cost_multi(info, mvs, 3);
+    if (step_index >= 0) {
+      best_index = start + step_index;
     }
   }
 
@@ -781,8 +925,10 @@ static void hexagon_search(inter_search_info_t *info, vector2d_t extra_mv, uint3
 
   // Do the final step of the search with a small pattern.
   for (int i = 1; i < 9; ++i) {
-    check_mv_cost(info, mv.x + small_hexbs[i].x, mv.y + small_hexbs[i].y);
+    mvs[i - 1].x = mv.x + small_hexbs[i].x;
+    mvs[i - 1].y = mv.y + small_hexbs[i].y;
   }
+  check_mv_cost_multi(info, mvs, 8);
 }
 
 /**
@@ -822,6 +968,14 @@ static void diamond_search(inter_search_info_t *info, vector2d_t extra_mv, uint3
 
   info->best_cost = UINT32_MAX;
 
+  // Modified for SHVC. Only refine around the scaled base layer mv.
+  if (info->has_ilr_mv) {
+    steps = MIN(steps, ILR_MV_MAX_STEPS);
+  }
+  if (info->has_pyramid_mv) {
+    steps = MIN(steps, PYRAMID_MV_MAX_STEPS);
+  }
+
   // Select starting point from among merge candidates. These should
   // include both mv_cand vectors and (0, 0).
   select_starting_point(info, extra_mv);
@@ -839,11 +993,17 @@ static void diamond_search(inter_search_info_t *info, vector2d_t extra_mv, uint3
   // current best index
   enum diapos best_index = DIA_CENTER;
 
+  vector2d_t mvs[5];
+  int mv_index[5];
+
   // initial search of the points of the diamond
   for (int i = 0; i < 5; ++i) {
-    if (check_mv_cost(info, mv.x + diamond[i].x, mv.y + diamond[i].y)) {
-      best_index = i;
-    }
+    mvs[i].x = mv.x + diamond[i].x;
+    mvs[i].y = mv.y + diamond[i].y;
+  }
+  const int index = check_mv_cost_multi(info, mvs, 5);
+  if (index >= 0) {
+    best_index = index;
   }
 
   if (best_index == DIA_CENTER) {
@@ -867,14 +1027,20 @@ static void diamond_search(inter_search_info_t *info, vector2d_t extra_mv, uint3
     if (steps > 0) steps -= 1;
 
     // search the points of the diamond
+    int num_mvs = 0;
     for (int i = 0; i < 4; ++i) {
       // this is where we came from so it's checked already
       if (i == from_dir) continue;
 
-      if (check_mv_cost(info, mv.x + diamond[i].x, mv.y + diamond[i].y)) {
-        best_index = i;
-        better_found = 1;
-      }
+      mvs[num_mvs].x = mv.x + diamond[i].x;
+      mvs[num_mvs].y = mv.y + diamond[i].y;
+      mv_index[num_mvs] = i;
+      num_mvs++;
+    }
+    const int step_index = check_mv_cost_multi(info, mvs, num_mvs);
+    if (step_index >= 0) {
+      best_index = mv_index[step_index];
+      better_found = 1;
     }
 
     if (better_found) {
@@ -895,10 +1061,18 @@ static void search_mv_full(inter_search_info_t *info,
                            int32_t search_range,
                            vector2d_t extra_mv)
 {
+  vector2d_t mvs[MV_BATCH_SIZE];
+  int num_mvs = 0;
+
   // Search around the 0-vector.
   for (int y = -search_range; y <= search_range; y++) {
     for (int x = -search_range; x <= search_range; x++) {
-      check_mv_cost(info, x, y);
+      mvs[num_mvs].x = x;
+      mvs[num_mvs].y = y;
+      if (++num_mvs == MV_BATCH_SIZE) {
+        check_mv_cost_multi(info, mvs, num_mvs);
+        num_mvs = 0;
+      }
     }
   }
 
@@ -910,7 +1084,12 @@ static void search_mv_full(inter_search_info_t *info,
   if (!mv_in_merge(info, extra_mv)) {
     for (int y = -search_range; y <= search_range; y++) {
       for (int x = -search_range; x <= search_range; x++) {
-        check_mv_cost(info, extra_mv.x + x, extra_mv.y + y);
+        mvs[num_mvs].x = extra_mv.x + x;
+        mvs[num_mvs].y = extra_mv.y + y;
+        if (++num_mvs == MV_BATCH_SIZE) {
+          check_mv_cost_multi(info, mvs, num_mvs);
+          num_mvs = 0;
+        }
       }
     }
   }
@@ -957,10 +1136,16 @@ static void search_mv_full(inter_search_info_t *info,
         }
         if (already_tested) continue;
 
-        check_mv_cost(info, x, y);
+        mvs[num_mvs].x = x;
+        mvs[num_mvs].y = y;
+        if (++num_mvs == MV_BATCH_SIZE) {
+          check_mv_cost_multi(info, mvs, num_mvs);
+          num_mvs = 0;
+        }
       }
     }
   }
+  check_mv_cost_multi(info, mvs, num_mvs);
 }
 
 
@@ -1037,6 +1222,22 @@ static void search_frac(inter_search_info_t *info)
                                   &bitcosts[0]);
   best_cost = costs[0];
   best_bitcost = bitcosts[0];
+
+  // All the fractional positions are within one pixel of the integer mv, so
+  // they can be read from the interpolated planes of the reference if the
+  // pixels around the mv are available.
+  const vector2d_t frame_orig = {
+    orig.x + state->tile->offset_x,
+    orig.y + state->tile->offset_y,
+  };
+  const subpel_planes_t *planes = NULL;
+  if (kvz_subpel_planes_ready(state, ref,
+                              frame_orig.x, frame_orig.y,
+                              frame_orig.x + mv.x - 1, frame_orig.y + mv.y - 1,
+                              width + 1, height + 1))
+  {
+    planes = ref->subpel_planes;
+  }
   
   //Set mv to half-pixel precision
   mv.x *= 2;
@@ -1055,33 +1256,49 @@ static void search_frac(inter_search_info_t *info)
 
     const int mv_shift = (step < 2) ? 1 : 0;
 
-    filter_steps[step](state->encoder_control,
-      src.orig_topleft,
-      src.stride,
-      internal_width,
-      internal_height,
-      filtered,
-      intermediate,
-      fme_level,
-      hor_first_cols,
-      sample_off_x,
-      sample_off_y);
-          
     const vector2d_t *pattern[4] = { &square[i], &square[i + 1], &square[i + 2], &square[i + 3] };
 
+    const kvz_pixel *filtered_pos[4] = { 0 };
+    int filtered_stride = LCU_WIDTH;
+
+    if (planes) {
+      for (int j = 0; j < 4; j++) {
+        const int16_t frac_mv[2] = {
+          (mv.x + pattern[j]->x) * (1 << mv_shift),
+          (mv.y + pattern[j]->y) * (1 << mv_shift),
+        };
+        filtered_pos[j] = kvz_subpel_planes_block(planes,
+                                                  frame_orig.x + (frac_mv[0] >> 2),
+                                                  frame_orig.y + (frac_mv[1] >> 2),
+                                                  frac_mv);
+      }
+      filtered_stride = planes->stride;
+    } else {
+      filter_steps[step](state->encoder_control,
+        src.orig_topleft,
+        src.stride,
+        internal_width,
+        internal_height,
+        filtered,
+        intermediate,
+        fme_level,
+        hor_first_cols,
+        sample_off_x,
+        sample_off_y);
+
+      filtered_pos[0] = &filtered[0][0];
+      filtered_pos[1] = &filtered[1][0];
+      filtered_pos[2] = &filtered[2][0];
+      filtered_pos[3] = &filtered[3][0];
+    }
+
     int8_t within_tile[4];
     for (int j = 0; j < 4; j++) {
       within_tile[j] =
         fracmv_within_tile(info, (mv.x + pattern[j]->x) * (1 << mv_shift), (mv.y + pattern[j]->y) * (1 << mv_shift));
     };
 
-    kvz_pixel *filtered_pos[4] = { 0 };
-    filtered_pos[0] = &filtered[0][0];
-    filtered_pos[1] = &filtered[1][0];
-    filtered_pos[2] = &filtered[2][0];
-    filtered_pos[3] = &filtered[3][0];
-
-    kvz_satd_any_size_quad(width, height, (const kvz_pixel **)filtered_pos, LCU_WIDTH, tmp_pic, tmp_stride, 4, costs, within_tile);
+    kvz_satd_any_size_quad(width, height, filtered_pos, filtered_stride, tmp_pic, tmp_stride, 4, costs, within_tile);
 
     for (int j = 0; j < 4; j++) {
       if (within_tile[j]) {
@@ -1136,6 +1353,243 @@ static void search_frac(inter_search_info_t *info)
 }
 
 
+// ***********************************************
+// Modified for SHVC.
+
+/**
+ * \brief Get the scaled base layer mv co-located with the PU.
+ *
+ * Uses the motion field upsampled for TMVP into the cu array of the inter
+ * layer reference. Only mvs pointing to a base layer picture with the same
+ * POC as the current reference are used.
+ *
+ * \param info    search info
+ * \param mv_out  the mv in quarter-pel precision
+ *
+ * \return true if a mv was found
+ */
+static bool get_ilr_mv(const inter_search_info_t *info, vector2d_t *mv_out)
+{
+  const encoder_state_t *state = info->state;
+  const image_list_t *ref = state->frame->ref;
+
+  for (unsigned ilr_idx = 0; ilr_idx < ref->used_size; ++ilr_idx) {
+    if (!ref->image_info[ilr_idx].is_long_term ||
+        ref->image_info[ilr_idx].layer_id >= state->encoder_control->layer.layer_id) {
+      continue;
+    }
+
+    const cu_array_t *ilr_cua = ref->cu_arrays[ilr_idx];
+    const int mid_x = state->tile->offset_x + info->origin.x + (info->width >> 1);
+    const int mid_y = state->tile->offset_y + info->origin.y + (info->height >> 1);
+    if (mid_x >= ilr_cua->width || mid_y >= ilr_cua->height) return false;
+
+    const cu_info_t *col = kvz_cu_array_at_const(ilr_cua, mid_x, mid_y);
+    if (col->type != CU_INTER) return false;
+
+    for (int list = 0; list < 2; ++list) {
+      if (!(col->inter.mv_dir & (list + 1))) continue;
+
+      const int col_ref = ref->ref_LXs[ilr_idx][list][col->inter.mv_ref[list]];
+      if (ref->images[ilr_idx]->picture_info[col_ref].is_long_term ||
+          ref->images[ilr_idx]->ref_pocs[col_ref] != ref->pocs[info->ref_idx]) {
+        continue;
+      }
+
+      mv_out->x = col->inter.mv[list][0];
+      mv_out->y = col->inter.mv[list][1];
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+// ***********************************************
+
+
+/**
+ * \brief Check mvs of a block on a pyramid level.
+ *
+ * \param block_info  search info of the block at full resolution, only used
+ *                    for the mv constraints
+ * \param shift       log2 of the downscaling factor of the level
+ * \param x           left edge of the block on the level
+ * \param y           top edge of the block on the level
+ * \param mvs         mvs in pixels of the level
+ * \param best_mv     best mv so far, updated
+ * \param best_cost   cost of best_mv, updated
+ */
+static void check_pyramid_mvs(const inter_search_info_t *block_info,
+                              int shift,
+                              int x, int y,
+                              const vector2d_t *mvs,
+                              int num_mvs,
+                              vector2d_t *best_mv,
+                              uint32_t *best_cost)
+{
+  const kvz_picture *pic = block_info->state->frame->me_pyramid[shift - 1];
+  const kvz_picture *ref = block_info->ref->me_pyramid[shift - 1];
+  const int width = block_info->width >> shift;
+  const int height = block_info->height >> shift;
+  const optimized_sad_func_ptr_t optimized_sad = kvz_get_optimized_sad(width);
+
+  for (int start = 0; start < num_mvs; start += MV_BATCH_SIZE) {
+    const int end = MIN(start + MV_BATCH_SIZE, num_mvs);
+    int index[MV_BATCH_SIZE];
+    int ref_x[MV_BATCH_SIZE];
+    int ref_y[MV_BATCH_SIZE];
+    unsigned costs[MV_BATCH_SIZE];
+    int num = 0;
+
+    for (int i = start; i < end; ++i) {
+      // Also keeps the search within the rows of the reference that are
+      // ready when encoding frames in parallel.
+      if (!intmv_within_tile(block_info, mvs[i].x * (1 << shift), mvs[i].y * (1 << shift))) continue;
+
+      index[num] = i;
+      ref_x[num] = x + mvs[i].x;
+      ref_y[num] = y + mvs[i].y;
+      num++;
+    }
+
+    kvz_image_calc_sad_multi(pic, ref, x, y, ref_x, ref_y, num,
+                             width, height, optimized_sad, costs);
+
+    for (int i = 0; i < num; ++i) {
+      const vector2d_t mv = mvs[index[i]];
+      // Prefer short mvs in flat areas.
+      const uint32_t cost = costs[i] + abs(mv.x) + abs(mv.y);
+      if (cost < *best_cost) {
+        *best_cost = cost;
+        *best_mv = mv;
+      }
+    }
+  }
+}
+
+
+/**
+ * \brief Search a block of the LCU on the pyramid levels.
+ *
+ * Searches every other mv within PYRAMID_SEARCH_RANGE on the coarsest level
+ * and refines the result by one pixel on each level.
+ *
+ * \param info    search info of the PU
+ * \param x       left edge of the block relative to the tile
+ * \param y       top edge of the block relative to the tile
+ * \param mv_out  full resolution integer mv
+ *
+ * \return true if a mv was found
+ */
+static bool search_pyramid_block(const inter_search_info_t *info, int x, int y, vector2d_t *mv_out)
+{
+  const encoder_state_t *state = info->state;
+  const int levels = state->encoder_control->cfg.me_pyramid;
+
+  const inter_search_info_t block_info = {
+    .state = info->state,
+    .pic = info->pic,
+    .ref = info->ref,
+    .ref_idx = info->ref_idx,
+    .origin = { x, y },
+    .width = MIN(ME_PYRAMID_BLOCK_SIZE, state->tile->frame->width - x),
+    .height = MIN(ME_PYRAMID_BLOCK_SIZE, state->tile->frame->height - y),
+  };
+  const int frame_x = state->tile->offset_x + x;
+  const int frame_y = state->tile->offset_y + y;
+
+  vector2d_t mvs[2 * PYRAMID_SEARCH_RANGE + 1];
+  vector2d_t best_mv = { 0, 0 };
+  uint32_t best_cost = UINT32_MAX;
+
+  // Every other mv on the coarsest level, the best one is refined below.
+  int shift = levels;
+  for (int mv_y = -PYRAMID_SEARCH_RANGE; mv_y <= PYRAMID_SEARCH_RANGE; mv_y += 2) {
+    int num_mvs = 0;
+    for (int mv_x = -PYRAMID_SEARCH_RANGE; mv_x <= PYRAMID_SEARCH_RANGE; mv_x += 2) {
+      mvs[num_mvs++] = (vector2d_t){ mv_x, mv_y };
+    }
+    check_pyramid_mvs(&block_info, shift, frame_x >> shift, frame_y >> shift,
+                      mvs, num_mvs, &best_mv, &best_cost);
+  }
+  // The motion is probably longer than the range if the best mv is on its
+  // border, so don't narrow the search around it.
+  if (best_cost == UINT32_MAX ||
+      abs(best_mv.x) == PYRAMID_SEARCH_RANGE ||
+      abs(best_mv.y) == PYRAMID_SEARCH_RANGE) {
+    return false;
+  }
+
+  // Refine by one pixel on each level, starting from the coarsest one.
+  vector2d_t center = best_mv;
+  for (; shift > 0; shift--) {
+    int num_mvs = 0;
+    for (int mv_y = -1; mv_y <= 1; ++mv_y) {
+      for (int mv_x = -1; mv_x <= 1; ++mv_x) {
+        mvs[num_mvs++] = (vector2d_t){ center.x + mv_x, center.y + mv_y };
+      }
+    }
+    best_mv = center;
+    best_cost = UINT32_MAX;
+    check_pyramid_mvs(&block_info, shift, frame_x >> shift, frame_y >> shift,
+                      mvs, num_mvs, &best_mv, &best_cost);
+    center = (vector2d_t){ best_mv.x * 2, best_mv.y * 2 };
+  }
+
+  *mv_out = center;
+  return true;
+}
+
+
+/**
+ * \brief Get the mv of the coarse motion search for the PU.
+ *
+ * The LCU is split into blocks of ME_PYRAMID_BLOCK_SIZE which are searched
+ * on the downscaled source pictures when they are first needed for each
+ * reference. The PU uses the mv of the block containing its center.
+ *
+ * \param info    search info
+ * \param mv_out  the mv in quarter-pel precision
+ *
+ * \return true if a mv was found
+ */
+static bool get_pyramid_mv(const inter_search_info_t *info, vector2d_t *mv_out)
+{
+  const encoder_state_t *state = info->state;
+  const int levels = state->encoder_control->cfg.me_pyramid;
+  me_pyramid_mvs_t *const pyramid_mvs = state->me_pyramid_mvs;
+
+  if (levels == 0 || pyramid_mvs == NULL) return false;
+
+  // Inter layer references have no pyramid.
+  for (int i = 0; i < levels; ++i) {
+    if (state->frame->me_pyramid[i] == NULL || info->ref->me_pyramid[i] == NULL) return false;
+  }
+
+  // Tiles start at LCU boundaries so the LCU can be found from the origin.
+  const int lcu_x = info->origin.x & ~(LCU_WIDTH - 1);
+  const int lcu_y = info->origin.y & ~(LCU_WIDTH - 1);
+  const int blocks_per_row = LCU_WIDTH / ME_PYRAMID_BLOCK_SIZE;
+  const int block_x = MIN((info->origin.x - lcu_x + info->width / 2) / ME_PYRAMID_BLOCK_SIZE, blocks_per_row - 1);
+  const int block_y = MIN((info->origin.y - lcu_y + info->height / 2) / ME_PYRAMID_BLOCK_SIZE, blocks_per_row - 1);
+  const int block = block_y * blocks_per_row + block_x;
+
+  if (!pyramid_mvs->searched[info->ref_idx][block]) {
+    pyramid_mvs->searched[info->ref_idx][block] = true;
+    pyramid_mvs->found[info->ref_idx][block] = search_pyramid_block(
+        info,
+        lcu_x + block_x * ME_PYRAMID_BLOCK_SIZE,
+        lcu_y + block_y * ME_PYRAMID_BLOCK_SIZE,
+        &pyramid_mvs->mv[info->ref_idx][block]);
+  }
+  if (!pyramid_mvs->found[info->ref_idx][block]) return false;
+
+  mv_out->x = pyramid_mvs->mv[info->ref_idx][block].x * 4;
+  mv_out->y = pyramid_mvs->mv[info->ref_idx][block].y * 4;
+  return true;
+}
+
+
 /**
  * \brief Perform inter search for a single reference frame.
  */
@@ -1220,6 +1674,13 @@ static void search_pu_inter_ref(inter_search_info_t *info,
     }
   }
 
+  // Modified for SHVC.
+  info->has_ilr_mv = cfg->ilr_mv_start &&
+                     !is_ILR && get_ilr_mv(info, &info->ilr_mv);
+
+  // Start from the mv of the coarse search instead of the previous frame.
+  info->has_pyramid_mv = !is_ILR && !info->has_ilr_mv && get_pyramid_mv(info, &mv);
+
   info->best_cost = UINT32_MAX;
   
   // Skip search for ILR
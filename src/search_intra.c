@@ -61,66 +61,29 @@ static INLINE uint8_t select_best_mode_index(const int8_t *modes, const double *
 
 
 /**
- * \brief Calculate quality of the reconstruction.
+ * \brief Calculate quality of the reconstruction for a group of predictions.
  *
- * \param pred  Predicted pixels in continous memory.
+ * \param preds  Predicted pixels of each mode in continous memory.
  * \param orig_block  Orignal (target) pixels in continous memory.
- * \param satd_func  SATD function for this block size.
+ * \param num_modes  Number of predictions in param preds.
+ * \param satd_multi_func  SATD function for a group of blocks of this size.
  * \param sad_func  SAD function this block size.
  * \param width  Pixel width of the block.
- *
- * \return  Estimated RD cost of the reconstruction and signaling the
- *     coefficients of the residual.
+ * \param[out] costs_out  Estimated RD cost of each prediction.
  */
-static double get_cost(encoder_state_t * const state, 
-                       kvz_pixel *pred, kvz_pixel *orig_block,
-                       cost_pixel_nxn_func *satd_func,
-                       cost_pixel_nxn_func *sad_func,
-                       int width)
+static void get_cost_multi(encoder_state_t * const state, 
+                           const pred_buffer preds, const kvz_pixel *orig_block,
+                           unsigned num_modes,
+                           cost_pixel_nxn_multi_func *satd_multi_func,
+                           cost_pixel_nxn_func *sad_func,
+                           int width, double *costs_out)
 {
-  double satd_cost = satd_func(pred, orig_block);
-  if (TRSKIP_RATIO != 0 && width == 4 && state->encoder_control->cfg.trskip_enable) {
-    // If the mode looks better with SAD than SATD it might be a good
-    // candidate for transform skip. How much better SAD has to be is
-    // controlled by TRSKIP_RATIO.
-
-    // Add the offset bit costs of signaling 'luma and chroma use trskip',
-    // versus signaling 'luma and chroma don't use trskip' to the SAD cost.
-    const cabac_ctx_t *ctx = &state->cabac.ctx.transform_skip_model_luma;
-    double trskip_bits = CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0);
-
-    if (state->encoder_control->chroma_format != KVZ_CSP_400) {
-      ctx = &state->cabac.ctx.transform_skip_model_chroma;
-      trskip_bits += 2.0 * (CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0));
-    }
-
-    double sad_cost = TRSKIP_RATIO * sad_func(pred, orig_block) + state->lambda_sqrt * trskip_bits;
-    if (sad_cost < satd_cost) {
-      return sad_cost;
-    }
+  assert(num_modes <= 35);
+  unsigned satd_costs[35];
+  satd_multi_func(preds, orig_block, num_modes, satd_costs);
+  for (unsigned i = 0; i < num_modes; ++i) {
+    costs_out[i] = (double)satd_costs[i];
   }
-  return satd_cost;
-}
-
-
-/**
- * \brief Calculate quality of the reconstruction.
- *
- * \param a  bc
- *
- * \return  
- */
-static void get_cost_dual(encoder_state_t * const state, 
-                       const pred_buffer preds, const kvz_pixel *orig_block,
-                       cost_pixel_nxn_multi_func *satd_twin_func,
-                       cost_pixel_nxn_multi_func *sad_twin_func,
-                       int width, double *costs_out)
-{
-  #define PARALLEL_BLKS 2
-  unsigned satd_costs[PARALLEL_BLKS] = { 0 };
-  satd_twin_func(preds, orig_block, PARALLEL_BLKS, satd_costs);
-  costs_out[0] = (double)satd_costs[0];
-  costs_out[1] = (double)satd_costs[1];
 
   if (TRSKIP_RATIO != 0 && width == 4 && state->encoder_control->cfg.trskip_enable) {
     // If the mode looks better with SAD than SATD it might be a good
@@ -137,18 +100,13 @@ static void get_cost_dual(encoder_state_t * const state,
       trskip_bits += 2.0 * (CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0));
     }
 
-    unsigned unsigned_sad_costs[PARALLEL_BLKS] = { 0 };
-    double sad_costs[PARALLEL_BLKS] = { 0 };
-    sad_twin_func(preds, orig_block, PARALLEL_BLKS, unsigned_sad_costs);
-    for (int i = 0; i < PARALLEL_BLKS; ++i) {
-      sad_costs[i] = TRSKIP_RATIO * (double)unsigned_sad_costs[i] + state->lambda_sqrt * trskip_bits;
-      if (sad_costs[i] < (double)satd_costs[i]) {
-        costs_out[i] = sad_costs[i];
+    for (unsigned i = 0; i < num_modes; ++i) {
+      double sad_cost = TRSKIP_RATIO * sad_func(preds[i], orig_block) + state->lambda_sqrt * trskip_bits;
+      if (sad_cost < costs_out[i]) {
+        costs_out[i] = sad_cost;
       }
     }
   }
-
-  #undef PARALLEL_BLKS
 }
 
 /**
@@ -384,13 +342,12 @@ static int8_t search_intra_rough(encoder_state_t * const state,
                                  int log2_width, int8_t *intra_preds,
                                  int8_t modes[35], double costs[35])
 {
-  #define PARALLEL_BLKS 2 // TODO: use 4 for AVX-512 in the future?
+  // Number of modes predicted into one buffer and costed with one call.
+  #define PARALLEL_BLKS 8
   assert(log2_width >= 2 && log2_width <= 5);
   int_fast8_t width = 1 << log2_width;
-  cost_pixel_nxn_func *satd_func = kvz_pixels_get_satd_func(width);
   cost_pixel_nxn_func *sad_func = kvz_pixels_get_sad_func(width);
-  cost_pixel_nxn_multi_func *satd_dual_func = kvz_pixels_get_satd_dual_func(width);
-  cost_pixel_nxn_multi_func *sad_dual_func = kvz_pixels_get_sad_dual_func(width);
+  cost_pixel_nxn_multi_func *satd_multi_func = kvz_pixels_get_satd_multi_func(width);
 
   const kvz_config *cfg = &state->encoder_control->cfg;
   const bool filter_boundary = !(cfg->lossless && cfg->implicit_rdpcm);
@@ -423,24 +380,23 @@ static int8_t search_intra_rough(encoder_state_t * const state,
   // the recursive search.
   for (int mode = 2; mode <= 34; mode += PARALLEL_BLKS * offset) {
     
-    double costs_out[PARALLEL_BLKS] = { 0 };
-    for (int i = 0; i < PARALLEL_BLKS; ++i) {
-      if (mode + i * offset <= 34) {
-        kvz_intra_predict(refs, log2_width, mode + i * offset, COLOR_Y, preds[i], filter_boundary);
-      }
+    int8_t test_modes[PARALLEL_BLKS];
+    int num_modes = 0;
+    for (int i = 0; i < PARALLEL_BLKS && mode + i * offset <= 34; ++i) {
+      test_modes[num_modes] = mode + i * offset;
+      ++num_modes;
     }
-    
-    //TODO: add generic version of get cost  multi
-    get_cost_dual(state, preds, orig_block, satd_dual_func, sad_dual_func, width, costs_out);
-
-    for (int i = 0; i < PARALLEL_BLKS; ++i) {
-      if (mode + i * offset <= 34) {
-        costs[modes_selected] = costs_out[i];
-        modes[modes_selected] = mode + i * offset;
-        min_cost = MIN(min_cost, costs[modes_selected]);
-        max_cost = MAX(max_cost, costs[modes_selected]);
-        ++modes_selected;
-      }
+    kvz_intra_predict_multi(refs, log2_width, test_modes, num_modes, preds, filter_boundary);
+
+    double costs_out[PARALLEL_BLKS] = { 0 };
+    get_cost_multi(state, preds, orig_block, num_modes, satd_multi_func, sad_func, width, costs_out);
+
+    for (int i = 0; i < num_modes; ++i) {
+      costs[modes_selected] = costs_out[i];
+      modes[modes_selected] = mode + i * offset;
+      min_cost = MIN(min_cost, costs[modes_selected]);
+      max_cost = MAX(max_cost, costs[modes_selected]);
+      ++modes_selected;
     }
   }
 
@@ -455,39 +411,38 @@ static int8_t search_intra_rough(encoder_state_t * const state,
       offset >>= 1;
 
       int8_t center_node = best_mode;
-      int8_t test_modes[] = { center_node - offset, center_node + offset };
-
-      double costs_out[PARALLEL_BLKS] = { 0 };
-      char mode_in_range = 0;
+      int8_t candidates[] = { center_node - offset, center_node + offset };
+      int8_t test_modes[2];
+      int num_modes = 0;
+
+      for (int i = 0; i < 2; ++i) {
+        if (candidates[i] >= 2 && candidates[i] <= 34) {
+          test_modes[num_modes] = candidates[i];
+          ++num_modes;
+        }
+      }
 
-      for (int i = 0; i < PARALLEL_BLKS; ++i) mode_in_range |= (test_modes[i] >= 2 && test_modes[i] <= 34);
+      if (num_modes > 0) {
+        kvz_intra_predict_multi(refs, log2_width, test_modes, num_modes, preds, filter_boundary);
 
-      if (mode_in_range) {
-        for (int i = 0; i < PARALLEL_BLKS; ++i) {
-          if (test_modes[i] >= 2 && test_modes[i] <= 34) {
-            kvz_intra_predict(refs, log2_width, test_modes[i], COLOR_Y, preds[i], filter_boundary);
-          }
-        }
+        double costs_out[2] = { 0 };
+        get_cost_multi(state, preds, orig_block, num_modes, satd_multi_func, sad_func, width, costs_out);
 
-        //TODO: add generic version of get cost multi
-        get_cost_dual(state, preds, orig_block, satd_dual_func, sad_dual_func, width, costs_out);
-
-        for (int i = 0; i < PARALLEL_BLKS; ++i) {
-          if (test_modes[i] >= 2 && test_modes[i] <= 34) {
-            costs[modes_selected] = costs_out[i];
-            modes[modes_selected] = test_modes[i];
-            if (costs[modes_selected] < best_cost) {
-              best_cost = costs[modes_selected];
-              best_mode = modes[modes_selected];
-            }
-            ++modes_selected;
+        for (int i = 0; i < num_modes; ++i) {
+          costs[modes_selected] = costs_out[i];
+          modes[modes_selected] = test_modes[i];
+          if (costs[modes_selected] < best_cost) {
+            best_cost = costs[modes_selected];
+            best_mode = modes[modes_selected];
           }
+          ++modes_selected;
         }
       }
     }
   }
 
   int8_t add_modes[5] = {intra_preds[0], intra_preds[1], intra_preds[2], 0, 1};
+  const int8_t first_added = modes_selected;
 
   // Add DC, planar and missing predicted modes.
   for (int8_t pred_i = 0; pred_i < 5; ++pred_i) {
@@ -502,13 +457,17 @@ static int8_t search_intra_rough(encoder_state_t * const state,
     }
 
     if (!has_mode) {
-      kvz_intra_predict(refs, log2_width, mode, COLOR_Y, preds[0], filter_boundary);
-      costs[modes_selected] = get_cost(state, preds[0], orig_block, satd_func, sad_func, width);
       modes[modes_selected] = mode;
       ++modes_selected;
     }
   }
 
+  const int num_added = modes_selected - first_added;
+  if (num_added > 0) {
+    kvz_intra_predict_multi(refs, log2_width, &modes[first_added], num_added, preds, filter_boundary);
+    get_cost_multi(state, preds, orig_block, num_added, satd_multi_func, sad_func, width, &costs[first_added]);
+  }
+
   // Add prediction mode coding cost as the last thing. We don't want this
   // affecting the halving search.
   int lambda_cost = (int)(state->lambda_sqrt + 0.5);
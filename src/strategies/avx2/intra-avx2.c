@@ -454,6 +454,242 @@ static void kvz_angular_pred_avx2(
 }
 
 
+/**
+ * \brief Load the reference of an angular mode into a register.
+ *
+ * For modes with a negative sample displacement, byte k of the result is
+ * ref_main[k - width] in the terms of kvz_angular_pred_avx2, with the
+ * negative indices projected from the side reference. For the other modes
+ * byte k is ref_main[k]. The blocks never read outside these 16 bytes,
+ * except with a zero weight.
+ *
+ * \param width         Block width, 4 or 8.
+ * \param sample_disp   Sample displacement per row.
+ * \param inv_abs_sample_disp  Inverse of the sample displacement.
+ * \param in_ref_main   Pointer to -1 index of the main reference.
+ * \param in_ref_side   Pointer to -1 index of the side reference.
+ */
+static INLINE __m128i load_ref_avx2(int width, int sample_disp, int inv_abs_sample_disp,
+                                    const kvz_pixel *in_ref_main, const kvz_pixel *in_ref_side)
+{
+  if (sample_disp >= 0) {
+    return _mm_loadu_si128((const __m128i*)(in_ref_main + 1));
+  }
+
+  // Index -1 is at byte width - 1.
+  __m128i ref_main = _mm_loadu_si128((const __m128i*)in_ref_main);
+  ref_main = width == 4 ? _mm_slli_si128(ref_main, 3) : _mm_slli_si128(ref_main, 7);
+
+  // Byte k below width - 1 takes
+  // ref_side[((128 + (width - 1 - k) * inv_abs_sample_disp) >> 8) - 1].
+  // Indices below the most negative one are never read.
+  __m128i steps = _mm_sub_epi16(_mm_set1_epi16(width - 1), _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+  __m128i side_index = _mm_mullo_epi16(steps, _mm_set1_epi16(inv_abs_sample_disp));
+  side_index = _mm_srai_epi16(_mm_add_epi16(side_index, _mm_set1_epi16(128)), 8);
+  side_index = _mm_packs_epi16(side_index, _mm_setzero_si128());
+  __m128i from_main = _mm_cmpgt_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                     _mm_set1_epi8(width - 2));
+  side_index = _mm_or_si128(side_index, from_main);
+
+  __m128i ref_side = _mm_loadu_si128((const __m128i*)in_ref_side);
+  return _mm_or_si128(ref_main, _mm_shuffle_epi8(ref_side, side_index));
+}
+
+ /**
+ * \brief Integer offsets and weights of the rows of an angular mode.
+ * \param sample_disp   Sample displacement per row.
+ * \param ref_offset    Byte of load_ref_avx2 result holding ref_main[0].
+ * \param weights       Returns the weights of the pixel pairs of each row.
+ * \return              Byte of load_ref_avx2 result of the first pixel of
+ *                      each row.
+ */
+static INLINE __m128i row_offsets_avx2(int sample_disp, int ref_offset, __m128i *weights)
+{
+  __m128i delta_pos = _mm_mullo_epi16(_mm_setr_epi16(1, 2, 3, 4, 5, 6, 7, 8), _mm_set1_epi16(sample_disp));
+  __m128i delta_fract = _mm_and_si128(delta_pos, _mm_set1_epi16(31));
+  *weights = _mm_or_si128(_mm_slli_epi16(delta_fract, 8),
+                          _mm_sub_epi16(_mm_set1_epi16(32), delta_fract));
+  __m128i offsets = _mm_add_epi16(_mm_srai_epi16(delta_pos, 5), _mm_set1_epi16(ref_offset));
+  return _mm_packs_epi16(offsets, offsets);
+}
+
+ /**
+ * \brief Generate angular predictions for several 4x4 blocks.
+ *
+ * Each pixel is a weighted pair of reference pixels. The pairs of the whole
+ * block are gathered with one shuffle, which also transposes the horizontal
+ * modes.
+ */
+static void angular_pred_multi_4x4_avx2(
+  const int8_t *const intra_modes,
+  const int num_modes,
+  const kvz_pixel *const in_ref_above,
+  const kvz_pixel *const in_ref_left,
+  kvz_pixel *const *const dst)
+{
+  static const int8_t modedisp2sampledisp[9] = { 0, 2, 5, 9, 13, 17, 21, 26, 32 };
+  static const int16_t modedisp2invsampledisp[9] = { 0, 4096, 1638, 910, 630, 482, 390, 315, 256 }; // (256 * 32) / sampledisp
+
+  // Rows 0 and 1 are in the low lane and rows 2 and 3 in the high lane.
+  // Vertical modes take the offset and weight of the output row, and
+  // horizontal modes those of the output column.
+  const __m256i ver_offset_shuf = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                   2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i ver_pair_index = _mm256_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 0, 1, 1, 2, 2, 3, 3, 4,
+                                                  0, 1, 1, 2, 2, 3, 3, 4, 0, 1, 1, 2, 2, 3, 3, 4);
+  const __m256i ver_weight_shuf = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 2, 3,
+                                                   4, 5, 4, 5, 4, 5, 4, 5, 6, 7, 6, 7, 6, 7, 6, 7);
+  const __m256i hor_offset_shuf = _mm256_setr_epi8(0, 0, 1, 1, 2, 2, 3, 3, 0, 0, 1, 1, 2, 2, 3, 3,
+                                                   0, 0, 1, 1, 2, 2, 3, 3, 0, 0, 1, 1, 2, 2, 3, 3);
+  const __m256i hor_pair_index = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 1, 2, 1, 2, 1, 2, 1, 2,
+                                                  2, 3, 2, 3, 2, 3, 2, 3, 3, 4, 3, 4, 3, 4, 3, 4);
+  const __m256i hor_weight_shuf = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7,
+                                                   0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7);
+
+  for (int i = 0; i < num_modes; ++i) {
+    const int_fast8_t intra_mode = intra_modes[i];
+    assert(intra_mode >= 2 && intra_mode <= 34);
+
+    const bool vertical_mode = intra_mode >= 18;
+    const int_fast8_t mode_disp = vertical_mode ? intra_mode - 26 : 10 - intra_mode;
+    const int_fast8_t sample_disp = (mode_disp < 0 ? -1 : 1) * modedisp2sampledisp[abs(mode_disp)];
+
+    const __m128i ref = load_ref_avx2(4, sample_disp, modedisp2invsampledisp[abs(mode_disp)],
+                                      vertical_mode ? in_ref_above : in_ref_left,
+                                      vertical_mode ? in_ref_left : in_ref_above);
+    __m128i weights;
+    const __m128i offsets = row_offsets_avx2(sample_disp, sample_disp < 0 ? 4 : 0, &weights);
+
+    __m256i offsets_256 = _mm256_broadcastsi128_si256(offsets);
+    __m256i weights_256 = _mm256_broadcastsi128_si256(weights);
+    __m256i pair_index;
+    if (vertical_mode) {
+      pair_index = _mm256_add_epi8(_mm256_shuffle_epi8(offsets_256, ver_offset_shuf), ver_pair_index);
+      weights_256 = _mm256_shuffle_epi8(weights_256, ver_weight_shuf);
+    } else {
+      pair_index = _mm256_add_epi8(_mm256_shuffle_epi8(offsets_256, hor_offset_shuf), hor_pair_index);
+      weights_256 = _mm256_shuffle_epi8(weights_256, hor_weight_shuf);
+    }
+
+    __m256i pairs = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(ref), pair_index);
+    __m256i pred = _mm256_maddubs_epi16(pairs, weights_256);
+    pred = _mm256_srli_epi16(_mm256_add_epi16(pred, _mm256_set1_epi16(16)), 5);
+    pred = _mm256_packus_epi16(pred, pred);
+    pred = _mm256_permute4x64_epi64(pred, _MM_SHUFFLE(2, 0, 2, 0));
+    _mm_storeu_si128((__m128i*)dst[i], _mm256_castsi256_si128(pred));
+  }
+}
+
+ /**
+ * \brief Generate angular predictions for several 8x8 blocks.
+ *
+ * Same as angular_pred_multi_4x4_avx2, but each register of pairs covers
+ * two rows.
+ */
+static void angular_pred_multi_8x8_avx2(
+  const int8_t *const intra_modes,
+  const int num_modes,
+  const kvz_pixel *const in_ref_above,
+  const kvz_pixel *const in_ref_left,
+  kvz_pixel *const *const dst)
+{
+  static const int8_t modedisp2sampledisp[9] = { 0, 2, 5, 9, 13, 17, 21, 26, 32 };
+  static const int16_t modedisp2invsampledisp[9] = { 0, 4096, 1638, 910, 630, 482, 390, 315, 256 }; // (256 * 32) / sampledisp
+
+  // Register j holds row 2 * j in the low lane and row 2 * j + 1 in the
+  // high lane. The shuffles and indices are for j = 0.
+  const __m256i ver_offset_shuf = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1);
+  const __m256i ver_pair_index = _mm256_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8,
+                                                  0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8);
+  const __m256i ver_weight_shuf = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1,
+                                                   2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3);
+  const __m256i hor_offset_shuf = _mm256_setr_epi8(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                                   0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7);
+  const __m256i hor_pair_index = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1,
+                                                  1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2);
+
+  for (int i = 0; i < num_modes; ++i) {
+    const int_fast8_t intra_mode = intra_modes[i];
+    assert(intra_mode >= 2 && intra_mode <= 34);
+
+    const bool vertical_mode = intra_mode >= 18;
+    const int_fast8_t mode_disp = vertical_mode ? intra_mode - 26 : 10 - intra_mode;
+    const int_fast8_t sample_disp = (mode_disp < 0 ? -1 : 1) * modedisp2sampledisp[abs(mode_disp)];
+
+    const __m256i ref = _mm256_broadcastsi128_si256(
+      load_ref_avx2(8, sample_disp, modedisp2invsampledisp[abs(mode_disp)],
+                    vertical_mode ? in_ref_above : in_ref_left,
+                    vertical_mode ? in_ref_left : in_ref_above));
+    __m128i weights;
+    const __m128i offsets = row_offsets_avx2(sample_disp, sample_disp < 0 ? 8 : 0, &weights);
+
+    const __m256i offsets_256 = _mm256_broadcastsi128_si256(offsets);
+    const __m256i weights_256 = _mm256_broadcastsi128_si256(weights);
+    const __m256i hor_pairs = _mm256_add_epi8(_mm256_shuffle_epi8(offsets_256, hor_offset_shuf), hor_pair_index);
+
+    __m256i rows[4];
+    for (int j = 0; j < 4; ++j) {
+      __m256i pair_index;
+      __m256i row_weights;
+      if (vertical_mode) {
+        __m256i offset_shuf = _mm256_add_epi8(ver_offset_shuf, _mm256_set1_epi8(2 * j));
+        pair_index = _mm256_add_epi8(_mm256_shuffle_epi8(offsets_256, offset_shuf), ver_pair_index);
+        __m256i weight_shuf = _mm256_add_epi8(ver_weight_shuf, _mm256_set1_epi8(4 * j));
+        row_weights = _mm256_shuffle_epi8(weights_256, weight_shuf);
+      } else {
+        pair_index = _mm256_add_epi8(hor_pairs, _mm256_set1_epi8(2 * j));
+        row_weights = weights_256;
+      }
+
+      __m256i pred = _mm256_maddubs_epi16(_mm256_shuffle_epi8(ref, pair_index), row_weights);
+      rows[j] = _mm256_srli_epi16(_mm256_add_epi16(pred, _mm256_set1_epi16(16)), 5);
+    }
+
+    // Packing interleaves the lanes, so rows 0, 2, 1, 3 are reordered.
+    __m256i rows_0_3 = _mm256_permute4x64_epi64(_mm256_packus_epi16(rows[0], rows[1]), _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i rows_4_7 = _mm256_permute4x64_epi64(_mm256_packus_epi16(rows[2], rows[3]), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i*)dst[i], rows_0_3);
+    _mm256_storeu_si256((__m256i*)(dst[i] + 32), rows_4_7);
+  }
+}
+
+/**
+ * \brief Generate angular predictions for several modes.
+ * \param log2_width    Log2 of width, range 2..5.
+ * \param intra_modes   Angular modes in range 2..34.
+ * \param num_modes     Number of modes in intra_modes.
+ * \param in_ref_above  Pointer to -1 index of above reference, length=width*2+1.
+ * \param in_ref_left   Pointer to -1 index of left reference, length=width*2+1.
+ * \param dst           Buffers of size width*width for each mode.
+ */
+static void kvz_angular_pred_multi_avx2(
+  const int_fast8_t log2_width,
+  const int8_t *const intra_modes,
+  const int num_modes,
+  const kvz_pixel *const in_ref_above,
+  const kvz_pixel *const in_ref_left,
+  kvz_pixel *const *const dst)
+{
+  assert(log2_width >= 2 && log2_width <= 5);
+
+  switch (log2_width) {
+    case 2:
+      angular_pred_multi_4x4_avx2(intra_modes, num_modes, in_ref_above, in_ref_left, dst);
+      break;
+    case 3:
+      angular_pred_multi_8x8_avx2(intra_modes, num_modes, in_ref_above, in_ref_left, dst);
+      break;
+    default:
+      // The rows of larger blocks already fill the registers.
+      for (int i = 0; i < num_modes; ++i) {
+        kvz_angular_pred_avx2(log2_width, intra_modes[i], in_ref_above, in_ref_left, dst[i]);
+      }
+      break;
+  }
+}
+
+
 /**
  * \brief Generate planar prediction.
  * \param log2_width    Log2 of width, range 2..5.
@@ -522,6 +758,7 @@ int kvz_strategy_register_intra_avx2(void* opaque, uint8_t bitdepth)
 #if COMPILE_INTEL_AVX2 && defined X86_64
   if (bitdepth == 8) {
     success &= kvz_strategyselector_register(opaque, "angular_pred", "avx2", 40, &kvz_angular_pred_avx2);
+    success &= kvz_strategyselector_register(opaque, "angular_pred_multi", "avx2", 40, &kvz_angular_pred_multi_avx2);
     success &= kvz_strategyselector_register(opaque, "intra_pred_planar", "avx2", 40, &kvz_intra_pred_planar_avx2);
   }
 #endif //COMPILE_INTEL_AVX2 && defined X86_64
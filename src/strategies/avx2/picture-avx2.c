@@ -75,6 +75,172 @@ uint32_t kvz_reg_sad_avx2(const kvz_pixel * const data1, const kvz_pixel * const
     return reg_sad_arbitrary(data1, data2, width, height, stride1, stride2);
 }
 
+static INLINE uint32_t hsum_sad_avx2(const __m256i sads)
+{
+  __m128i sum_1 = _mm_add_epi64(_mm256_castsi256_si128(sads), _mm256_extracti128_si256(sads, 1));
+  __m128i sum_2 = _mm_shuffle_epi32(sum_1, _MM_SHUFFLE(1, 0, 3, 2));
+  return _mm_cvtsi128_si32(_mm_add_epi64(sum_1, sum_2));
+}
+
+static INLINE uint32_t hsum_sad_sse(const __m128i sads)
+{
+  return _mm_cvtsi128_si32(_mm_add_epi64(sads, _mm_shuffle_epi32(sads, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+
+// Load two 8 pixel rows into one vector.
+static INLINE __m128i load_w8_x2(const kvz_pixel *data, const unsigned stride)
+{
+  return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)data),
+                            _mm_loadl_epi64((const __m128i *)(data + stride)));
+}
+
+// Load two 16 pixel rows into one vector.
+static INLINE __m256i load_w16_x2(const kvz_pixel *data, const unsigned stride)
+{
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)data)),
+                                 _mm_loadu_si128((const __m128i *)(data + stride)), 1);
+}
+
+/**
+ * \brief Calculate SAD of an 8 pixel wide block against 4 blocks.
+ */
+static void reg_sad_multi_w8_x4(const kvz_pixel * const data1, const kvz_pixel * const *const data2,
+                                const int height, const unsigned stride1, const unsigned stride2,
+                                uint32_t sads[4])
+{
+  __m128i inc0 = _mm_setzero_si128();
+  __m128i inc1 = _mm_setzero_si128();
+  __m128i inc2 = _mm_setzero_si128();
+  __m128i inc3 = _mm_setzero_si128();
+  int y;
+
+  for (y = 0; y + 1 < height; y += 2) {
+    const __m128i a = load_w8_x2(data1 + y * stride1, stride1);
+    inc0 = _mm_add_epi64(inc0, _mm_sad_epu8(a, load_w8_x2(data2[0] + y * stride2, stride2)));
+    inc1 = _mm_add_epi64(inc1, _mm_sad_epu8(a, load_w8_x2(data2[1] + y * stride2, stride2)));
+    inc2 = _mm_add_epi64(inc2, _mm_sad_epu8(a, load_w8_x2(data2[2] + y * stride2, stride2)));
+    inc3 = _mm_add_epi64(inc3, _mm_sad_epu8(a, load_w8_x2(data2[3] + y * stride2, stride2)));
+  }
+  if (y < height) {
+    const __m128i a = _mm_loadl_epi64((const __m128i *)(data1 + y * stride1));
+    inc0 = _mm_add_epi64(inc0, _mm_sad_epu8(a, _mm_loadl_epi64((const __m128i *)(data2[0] + y * stride2))));
+    inc1 = _mm_add_epi64(inc1, _mm_sad_epu8(a, _mm_loadl_epi64((const __m128i *)(data2[1] + y * stride2))));
+    inc2 = _mm_add_epi64(inc2, _mm_sad_epu8(a, _mm_loadl_epi64((const __m128i *)(data2[2] + y * stride2))));
+    inc3 = _mm_add_epi64(inc3, _mm_sad_epu8(a, _mm_loadl_epi64((const __m128i *)(data2[3] + y * stride2))));
+  }
+
+  sads[0] = hsum_sad_sse(inc0);
+  sads[1] = hsum_sad_sse(inc1);
+  sads[2] = hsum_sad_sse(inc2);
+  sads[3] = hsum_sad_sse(inc3);
+}
+
+/**
+ * \brief Calculate SAD of a 16 pixel wide block against 4 blocks.
+ */
+static void reg_sad_multi_w16_x4(const kvz_pixel * const data1, const kvz_pixel * const *const data2,
+                                 const int height, const unsigned stride1, const unsigned stride2,
+                                 uint32_t sads[4])
+{
+  __m256i inc0 = _mm256_setzero_si256();
+  __m256i inc1 = _mm256_setzero_si256();
+  __m256i inc2 = _mm256_setzero_si256();
+  __m256i inc3 = _mm256_setzero_si256();
+  int y;
+
+  for (y = 0; y + 1 < height; y += 2) {
+    const __m256i a = load_w16_x2(data1 + y * stride1, stride1);
+    inc0 = _mm256_add_epi64(inc0, _mm256_sad_epu8(a, load_w16_x2(data2[0] + y * stride2, stride2)));
+    inc1 = _mm256_add_epi64(inc1, _mm256_sad_epu8(a, load_w16_x2(data2[1] + y * stride2, stride2)));
+    inc2 = _mm256_add_epi64(inc2, _mm256_sad_epu8(a, load_w16_x2(data2[2] + y * stride2, stride2)));
+    inc3 = _mm256_add_epi64(inc3, _mm256_sad_epu8(a, load_w16_x2(data2[3] + y * stride2, stride2)));
+  }
+
+  sads[0] = hsum_sad_avx2(inc0);
+  sads[1] = hsum_sad_avx2(inc1);
+  sads[2] = hsum_sad_avx2(inc2);
+  sads[3] = hsum_sad_avx2(inc3);
+
+  if (y < height) {
+    const __m128i a = _mm_loadu_si128((const __m128i *)(data1 + y * stride1));
+    sads[0] += hsum_sad_sse(_mm_sad_epu8(a, _mm_loadu_si128((const __m128i *)(data2[0] + y * stride2))));
+    sads[1] += hsum_sad_sse(_mm_sad_epu8(a, _mm_loadu_si128((const __m128i *)(data2[1] + y * stride2))));
+    sads[2] += hsum_sad_sse(_mm_sad_epu8(a, _mm_loadu_si128((const __m128i *)(data2[2] + y * stride2))));
+    sads[3] += hsum_sad_sse(_mm_sad_epu8(a, _mm_loadu_si128((const __m128i *)(data2[3] + y * stride2))));
+  }
+}
+
+/**
+ * \brief Calculate SAD of a block with width divisible by 32 against 4 blocks.
+ */
+static void reg_sad_multi_w32n_x4(const kvz_pixel * const data1, const kvz_pixel * const *const data2,
+                                  const int width, const int height,
+                                  const unsigned stride1, const unsigned stride2,
+                                  uint32_t sads[4])
+{
+  __m256i inc0 = _mm256_setzero_si256();
+  __m256i inc1 = _mm256_setzero_si256();
+  __m256i inc2 = _mm256_setzero_si256();
+  __m256i inc3 = _mm256_setzero_si256();
+
+  for (int y = 0; y < height; ++y) {
+    const kvz_pixel *row1 = data1 + y * stride1;
+    const int offset2 = y * stride2;
+    for (int x = 0; x < width; x += 32) {
+      const __m256i a = _mm256_loadu_si256((const __m256i *)(row1 + x));
+      inc0 = _mm256_add_epi64(inc0, _mm256_sad_epu8(a, _mm256_loadu_si256((const __m256i *)(data2[0] + offset2 + x))));
+      inc1 = _mm256_add_epi64(inc1, _mm256_sad_epu8(a, _mm256_loadu_si256((const __m256i *)(data2[1] + offset2 + x))));
+      inc2 = _mm256_add_epi64(inc2, _mm256_sad_epu8(a, _mm256_loadu_si256((const __m256i *)(data2[2] + offset2 + x))));
+      inc3 = _mm256_add_epi64(inc3, _mm256_sad_epu8(a, _mm256_loadu_si256((const __m256i *)(data2[3] + offset2 + x))));
+    }
+  }
+
+  sads[0] = hsum_sad_avx2(inc0);
+  sads[1] = hsum_sad_avx2(inc1);
+  sads[2] = hsum_sad_avx2(inc2);
+  sads[3] = hsum_sad_avx2(inc3);
+}
+
+/**
+ * \brief Calculate SAD between one block and several other blocks.
+ *
+ * The blocks are processed four at a time so that every row of data1 is
+ * only loaded once for all of them. Widths without a batched kernel are
+ * done one block at a time.
+ */
+static void reg_sad_multi_avx2(const kvz_pixel * const data1, const kvz_pixel * const *const data2,
+                               const int num_blocks, const int width, const int height,
+                               const unsigned stride1, const unsigned stride2, unsigned *costs_out)
+{
+  if (width != 8 && width != 16 && width % 32 != 0) {
+    for (int i = 0; i < num_blocks; ++i) {
+      costs_out[i] = kvz_reg_sad_avx2(data1, data2[i], width, height, stride1, stride2);
+    }
+    return;
+  }
+
+  for (int i = 0; i < num_blocks; i += 4) {
+    // Fill the last group by repeating the last block.
+    const kvz_pixel *blocks[4];
+    for (int k = 0; k < 4; ++k) {
+      blocks[k] = data2[MIN(i + k, num_blocks - 1)];
+    }
+
+    uint32_t sads[4];
+    if (width == 8) {
+      reg_sad_multi_w8_x4(data1, blocks, height, stride1, stride2, sads);
+    } else if (width == 16) {
+      reg_sad_multi_w16_x4(data1, blocks, height, stride1, stride2, sads);
+    } else {
+      reg_sad_multi_w32n_x4(data1, blocks, width, height, stride1, stride2, sads);
+    }
+
+    for (int k = 0; k < 4 && i + k < num_blocks; ++k) {
+      costs_out[i + k] = sads[k];
+    }
+  }
+}
+
 /**
 * \brief Calculate SAD for 8x8 bytes in continuous memory.
 */
@@ -614,6 +780,56 @@ SATD_NXN_DUAL_AVX2(16)
 SATD_NXN_DUAL_AVX2(32)
 SATD_NXN_DUAL_AVX2(64)
 
+static void satd_8bit_4x4_multi_avx2(
+  const pred_buffer preds, const kvz_pixel * const orig, unsigned num_modes, unsigned *satds_out)
+{
+  unsigned i = 0;
+  for (; i + 1 < num_modes; i += 2) {
+    satd_8bit_4x4_dual_avx2(preds + i, orig, 2, satds_out + i);
+  }
+  if (i < num_modes) {
+    satds_out[i] = satd_4x4_8bit_avx2(orig, preds[i]);
+  }
+}
+
+// Function macro for defining hadamard calculating functions for any number
+// of fixed size blocks. Blocks are processed in pairs with the dual 8x8
+// hadamard function.
+#define SATD_NXN_MULTI_AVX2(n) \
+static void satd_8bit_ ## n ## x ## n ## _multi_avx2( \
+  const pred_buffer preds, const kvz_pixel * const orig, unsigned num_modes, unsigned *satds_out) \
+{ \
+  unsigned i = 0; \
+  for (; i + 1 < num_modes; i += 2) { \
+    unsigned sum0 = 0; \
+    unsigned sum1 = 0; \
+    satds_out[i] = 0; \
+    satds_out[i + 1] = 0; \
+    for (unsigned y = 0; y < (n); y += 8) { \
+      unsigned row = y * (n); \
+      for (unsigned x = 0; x < (n); x += 8) { \
+        kvz_satd_8bit_8x8_general_dual_avx2(&preds[i][row + x], (n), &preds[i + 1][row + x], (n), \
+                                            &orig[row + x], (n), &sum0, &sum1); \
+        satds_out[i] += sum0; \
+        satds_out[i + 1] += sum1; \
+      } \
+    } \
+  } \
+  if (i < num_modes) { \
+    satds_out[i] = 0; \
+    for (unsigned y = 0; y < (n); y += 8) { \
+      unsigned row = y * (n); \
+      for (unsigned x = 0; x < (n); x += 8) { \
+        satds_out[i] += satd_8x8_subblock_8bit_avx2(&preds[i][row + x], (n), &orig[row + x], (n)); \
+      } \
+    } \
+  } \
+}
+
+SATD_NXN_MULTI_AVX2(8)
+SATD_NXN_MULTI_AVX2(16)
+SATD_NXN_MULTI_AVX2(32)
+
 #define SATD_ANY_SIZE_MULTI_AVX2(suffix, num_parallel_blocks) \
   static cost_pixel_any_size_multi_func satd_any_size_## suffix; \
   static void satd_any_size_ ## suffix ( \
@@ -1344,6 +1560,7 @@ int kvz_strategy_register_picture_avx2(void* opaque, uint8_t bitdepth)
   if (bitdepth == 8){
 
     success &= kvz_strategyselector_register(opaque, "reg_sad", "avx2", 40, &kvz_reg_sad_avx2);
+    success &= kvz_strategyselector_register(opaque, "reg_sad_multi", "avx2", 40, &reg_sad_multi_avx2);
     success &= kvz_strategyselector_register(opaque, "sad_8x8", "avx2", 40, &sad_8bit_8x8_avx2);
     success &= kvz_strategyselector_register(opaque, "sad_16x16", "avx2", 40, &sad_8bit_16x16_avx2);
     success &= kvz_strategyselector_register(opaque, "sad_32x32", "avx2", 40, &sad_8bit_32x32_avx2);
@@ -1360,6 +1577,10 @@ int kvz_strategy_register_picture_avx2(void* opaque, uint8_t bitdepth)
     success &= kvz_strategyselector_register(opaque, "satd_16x16_dual", "avx2", 40, &satd_8bit_16x16_dual_avx2);
     success &= kvz_strategyselector_register(opaque, "satd_32x32_dual", "avx2", 40, &satd_8bit_32x32_dual_avx2);
     success &= kvz_strategyselector_register(opaque, "satd_64x64_dual", "avx2", 40, &satd_8bit_64x64_dual_avx2);
+    success &= kvz_strategyselector_register(opaque, "satd_4x4_multi", "avx2", 40, &satd_8bit_4x4_multi_avx2);
+    success &= kvz_strategyselector_register(opaque, "satd_8x8_multi", "avx2", 40, &satd_8bit_8x8_multi_avx2);
+    success &= kvz_strategyselector_register(opaque, "satd_16x16_multi", "avx2", 40, &satd_8bit_16x16_multi_avx2);
+    success &= kvz_strategyselector_register(opaque, "satd_32x32_multi", "avx2", 40, &satd_8bit_32x32_multi_avx2);
     success &= kvz_strategyselector_register(opaque, "satd_any_size", "avx2", 40, &satd_any_size_8bit_avx2);
     success &= kvz_strategyselector_register(opaque, "satd_any_size_quad", "avx2", 40, &satd_any_size_quad_avx2);
 
@@ -143,6 +143,29 @@ static void kvz_angular_pred_generic(
 }
 
 
+/**
+ * \brief Generate angular predictions for several modes.
+ * \param log2_width    Log2 of width, range 2..5.
+ * \param intra_modes   Angular modes in range 2..34.
+ * \param num_modes     Number of modes in intra_modes.
+ * \param in_ref_above  Pointer to -1 index of above reference, length=width*2+1.
+ * \param in_ref_left   Pointer to -1 index of left reference, length=width*2+1.
+ * \param dst           Buffers of size width*width for each mode.
+ */
+static void kvz_angular_pred_multi_generic(
+  const int_fast8_t log2_width,
+  const int8_t *const intra_modes,
+  const int num_modes,
+  const kvz_pixel *const in_ref_above,
+  const kvz_pixel *const in_ref_left,
+  kvz_pixel *const *const dst)
+{
+  for (int i = 0; i < num_modes; ++i) {
+    kvz_angular_pred_generic(log2_width, intra_modes[i], in_ref_above, in_ref_left, dst[i]);
+  }
+}
+
+
 /**
  * \brief Generate planar prediction.
  * \param log2_width    Log2 of width, range 2..5.
@@ -193,6 +216,7 @@ int kvz_strategy_register_intra_generic(void* opaque, uint8_t bitdepth)
   bool success = true;
 
   success &= kvz_strategyselector_register(opaque, "angular_pred", "generic", 0, &kvz_angular_pred_generic);
+  success &= kvz_strategyselector_register(opaque, "angular_pred_multi", "generic", 0, &kvz_angular_pred_multi_generic);
   success &= kvz_strategyselector_register(opaque, "intra_pred_planar", "generic", 0, &kvz_intra_pred_planar_generic);
 
   return success;
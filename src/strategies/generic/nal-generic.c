@@ -26,6 +26,15 @@
 #include "strategyselector.h"
 
 
+// Checksum masks x ^ y of the low bytes of the coordinates, indexed by
+// y * 256 + x. Filled when the functions are registered, because the
+// checksums are calculated from several threads.
+static union {
+  uint8_t u8[256 * 256];
+  uint32_t u32[64 * 256];
+  uint64_t u64[32 * 256];
+} ckmap;
+
 static void array_md5_generic(const kvz_pixel* data,
                               const int height, const int width,
                               const int stride,
@@ -42,7 +51,7 @@ static void array_md5_generic(const kvz_pixel* data,
   kvz_md5_final(checksum_out, &md5_ctx);
 }
 
-static void array_checksum_generic(const kvz_pixel* data,
+static void array_checksum_generic(const kvz_pixel* data, const int y_offset,
                                    const int height, const int width,
                                    const int stride,
                                    unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth) {
@@ -52,8 +61,9 @@ static void array_checksum_generic(const kvz_pixel* data,
   assert(SEI_HASH_MAX_LENGTH >= 4);
   
   for (y = 0; y < height; ++y) {
+    const int py = y_offset + y;
     for (x = 0; x < width; ++x) {
-      const uint8_t mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
+      const uint8_t mask = (uint8_t)((x & 0xff) ^ (py & 0xff) ^ (x >> 8) ^ (py >> 8));
       checksum += (data[(y * stride) + x] & 0xff) ^ mask;
 #if KVZ_BIT_DEPTH > 8
       checksum += ((data[(y * stride) + x] >> 8) & 0xff) ^ mask;
@@ -68,43 +78,31 @@ static void array_checksum_generic(const kvz_pixel* data,
   checksum_out[3] = (checksum) & 0xff;
 }
 
-static void array_checksum_generic4(const kvz_pixel* data,
+static void array_checksum_generic4(const kvz_pixel* data, const int y_offset,
                                    const int height, const int width,
                                    const int stride,
                                    unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth) {
   uint32_t checksum = 0;
   int y, x, xp;
-  
-  static uint8_t ckmap_initialized = 0;
-  static uint32_t ckmap[64*256];
 
   //TODO: add 10-bit support
   if(bitdepth != 8) {
-    array_checksum_generic(data, height, width, stride,checksum_out, bitdepth);
+    array_checksum_generic(data, y_offset, height, width, stride, checksum_out, bitdepth);
     return;
   }
-  if (!ckmap_initialized) {
-    uint8_t * const ckmap_uint8 = (uint8_t*)&ckmap;
-    int x, y;
-    for (y = 0; y < 256; ++y) {
-      for (x = 0; x < 256; ++x) {
-        ckmap_uint8[y*256+x] = x^y;
-      }
-    }
-    ckmap_initialized = 1;
-  }
 
   assert(SEI_HASH_MAX_LENGTH >= 4);
 
   for (y = 0; y < height; ++y) {
+    const int py = y_offset + y;
     for (xp = 0; xp < width/4; ++xp) {
       const int x = xp * 4;
-      const uint32_t mask = ckmap[(xp&63)+64*(y&255)] ^ (((x >> 8) ^ (y >> 8)) * 0x1010101);
+      const uint32_t mask = ckmap.u32[(xp&63)+64*(py&255)] ^ (((x >> 8) ^ (py >> 8)) * 0x1010101);
       const uint32_t cksumbytes = (*((uint32_t*)(&data[(y * stride) + x]))) ^ mask;
       checksum += ((cksumbytes >> 24) & 0xff) + ((cksumbytes >> 16) & 0xff) + ((cksumbytes >> 8) & 0xff) + (cksumbytes & 0xff);
     }
     for (x = xp*4; x < width; ++x) {
-      uint8_t mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
+      uint8_t mask = (uint8_t)((x & 0xff) ^ (py & 0xff) ^ (x >> 8) ^ (py >> 8));
       checksum += (data[(y * stride) + x] & 0xff) ^ mask;
     }
   }
@@ -116,43 +114,31 @@ static void array_checksum_generic4(const kvz_pixel* data,
   checksum_out[3] = (checksum) & 0xff;
 }
 
-static void array_checksum_generic8(const kvz_pixel* data,
+static void array_checksum_generic8(const kvz_pixel* data, const int y_offset,
                                    const int height, const int width,
                                    const int stride,
                                    unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth) {
   uint32_t checksum = 0;
   int y, x, xp;
-  
-  static uint8_t ckmap_initialized = 0;
-  static uint64_t ckmap[32*256];
-  
+
   //TODO: add 10-bit support
   if(bitdepth != 8) {
-    array_checksum_generic(data, height, width, stride,checksum_out, bitdepth);
+    array_checksum_generic(data, y_offset, height, width, stride, checksum_out, bitdepth);
     return;
   }
-  if (!ckmap_initialized) {
-    uint8_t * const ckmap_uint8 = (uint8_t*)&ckmap;
-    int x, y;
-    for (y = 0; y < 256; ++y) {
-      for (x = 0; x < 256; ++x) {
-        ckmap_uint8[y*256+x] = x^y;
-      }
-    }
-    ckmap_initialized = 1;
-  }
 
   assert(SEI_HASH_MAX_LENGTH >= 4);
 
   for (y = 0; y < height; ++y) {
+    const int py = y_offset + y;
     for (xp = 0; xp < width/8; ++xp) {
       const int x = xp * 8;
-      const uint64_t mask = ckmap[(xp&31)+32*(y&255)] ^ ((uint64_t)((x >> 8) ^ (y >> 8)) * 0x101010101010101);
+      const uint64_t mask = ckmap.u64[(xp&31)+32*(py&255)] ^ ((uint64_t)((x >> 8) ^ (py >> 8)) * 0x101010101010101);
       const uint64_t cksumbytes = (*((uint64_t*)(&data[(y * stride) + x]))) ^ mask;
       checksum += ((cksumbytes >> 56) & 0xff) + ((cksumbytes >> 48) & 0xff) + ((cksumbytes >> 40) & 0xff) + ((cksumbytes >> 32) & 0xff) + ((cksumbytes >> 24) & 0xff) + ((cksumbytes >> 16) & 0xff) + ((cksumbytes >> 8) & 0xff) + (cksumbytes & 0xff);
     }
     for (x = xp*8; x < width; ++x) {
-      uint8_t mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
+      uint8_t mask = (uint8_t)((x & 0xff) ^ (py & 0xff) ^ (x >> 8) ^ (py >> 8));
       checksum += (data[(y * stride) + x] & 0xff) ^ mask;
     }
   }
@@ -167,6 +153,12 @@ static void array_checksum_generic8(const kvz_pixel* data,
 int kvz_strategy_register_nal_generic(void* opaque, uint8_t bitdepth) {
   bool success = true;
 
+  for (int y = 0; y < 256; ++y) {
+    for (int x = 0; x < 256; ++x) {
+      ckmap.u8[y * 256 + x] = x ^ y;
+    }
+  }
+
   success &= kvz_strategyselector_register(opaque, "array_md5", "generic", 0, &array_md5_generic);
   success &= kvz_strategyselector_register(opaque, "array_checksum", "generic", 0, &array_checksum_generic);
   success &= kvz_strategyselector_register(opaque, "array_checksum", "generic4", 1, &array_checksum_generic4);
@@ -98,6 +98,23 @@ static unsigned reg_sad_generic(const kvz_pixel * const data1, const kvz_pixel *
   return sad;
 }
 
+/**
+ * \brief Calculate SAD between one block and several other blocks.
+ *
+ * \param data1       Starting point of the first picture.
+ * \param data2       Starting points of the blocks in the second picture.
+ * \param num_blocks  Number of blocks in data2.
+ * \param costs_out   SAD of each block in data2.
+ */
+static void reg_sad_multi_generic(const kvz_pixel * const data1, const kvz_pixel * const * const data2,
+                                  const int num_blocks, const int width, const int height,
+                                  const unsigned stride1, const unsigned stride2, unsigned *costs_out)
+{
+  for (int i = 0; i < num_blocks; ++i) {
+    costs_out[i] = reg_sad_generic(data1, data2[i], width, height, stride1, stride2);
+  }
+}
+
 /**
  * \brief  Transform differences between two 4x4 blocks.
  * From HM 13.0
@@ -389,6 +406,39 @@ SATD_DUAL_NXN(16, kvz_pixel)
 SATD_DUAL_NXN(32, kvz_pixel)
 SATD_DUAL_NXN(64, kvz_pixel)
 
+// Declare these functions to make sure the signature of the macro matches.
+static cost_pixel_nxn_multi_func satd_4x4_multi_generic;
+static cost_pixel_nxn_multi_func satd_8x8_multi_generic;
+static cost_pixel_nxn_multi_func satd_16x16_multi_generic;
+static cost_pixel_nxn_multi_func satd_32x32_multi_generic;
+
+#define SATD_MULTI_NXN(n, pixel_type) \
+static void satd_ ## n ## x ## n ## _multi_generic( \
+  const pred_buffer preds, const pixel_type * const orig, unsigned num_modes, unsigned *costs_out) \
+{ \
+  for (unsigned i = 0; i < num_modes; ++i) { \
+    unsigned sum = 0; \
+    for (unsigned y = 0; y < (n); y += 8) { \
+      unsigned row = y * (n); \
+      for (unsigned x = 0; x < (n); x += 8) { \
+        sum += satd_8x8_subblock_generic(&preds[i][row + x], (n), &orig[row + x], (n)); \
+      } \
+    } \
+    costs_out[i] = sum >> (KVZ_BIT_DEPTH - 8); \
+  } \
+}
+
+static void satd_4x4_multi_generic(const pred_buffer preds, const kvz_pixel * const orig, unsigned num_modes, unsigned *costs_out)
+{
+  for (unsigned i = 0; i < num_modes; ++i) {
+    costs_out[i] = satd_4x4_generic(orig, preds[i]);
+  }
+}
+
+SATD_MULTI_NXN(8, kvz_pixel)
+SATD_MULTI_NXN(16, kvz_pixel)
+SATD_MULTI_NXN(32, kvz_pixel)
+
 #define SATD_ANY_SIZE_MULTI_GENERIC(suffix, num_parallel_blocks) \
   static cost_pixel_any_size_multi_func satd_any_size_## suffix; \
   static void satd_any_size_ ## suffix ( \
@@ -680,6 +730,7 @@ int kvz_strategy_register_picture_generic(void* opaque, uint8_t bitdepth)
   bool success = true;
 
   success &= kvz_strategyselector_register(opaque, "reg_sad", "generic", 0, &reg_sad_generic);
+  success &= kvz_strategyselector_register(opaque, "reg_sad_multi", "generic", 0, &reg_sad_multi_generic);
 
   success &= kvz_strategyselector_register(opaque, "sad_4x4", "generic", 0, &sad_4x4_generic);
   success &= kvz_strategyselector_register(opaque, "sad_8x8", "generic", 0, &sad_8x8_generic);
@@ -704,6 +755,11 @@ int kvz_strategy_register_picture_generic(void* opaque, uint8_t bitdepth)
   success &= kvz_strategyselector_register(opaque, "satd_16x16_dual", "generic", 0, &satd_16x16_dual_generic);
   success &= kvz_strategyselector_register(opaque, "satd_32x32_dual", "generic", 0, &satd_32x32_dual_generic);
   success &= kvz_strategyselector_register(opaque, "satd_64x64_dual", "generic", 0, &satd_64x64_dual_generic);
+
+  success &= kvz_strategyselector_register(opaque, "satd_4x4_multi", "generic", 0, &satd_4x4_multi_generic);
+  success &= kvz_strategyselector_register(opaque, "satd_8x8_multi", "generic", 0, &satd_8x8_multi_generic);
+  success &= kvz_strategyselector_register(opaque, "satd_16x16_multi", "generic", 0, &satd_16x16_multi_generic);
+  success &= kvz_strategyselector_register(opaque, "satd_32x32_multi", "generic", 0, &satd_32x32_multi_generic);
   success &= kvz_strategyselector_register(opaque, "satd_any_size", "generic", 0, &satd_any_size_generic);
   success &= kvz_strategyselector_register(opaque, "satd_any_size_quad", "generic", 0, &satd_any_size_quad_generic);
 
@@ -27,6 +27,7 @@
 
 // Define function pointers.
 angular_pred_func *kvz_angular_pred;
+angular_pred_multi_func *kvz_angular_pred_multi;
 intra_pred_planar_func *kvz_intra_pred_planar;
 
 int kvz_strategy_register_intra(void* opaque, uint8_t bitdepth) {
@@ -37,6 +37,18 @@ typedef void (angular_pred_func)(
   const kvz_pixel *const in_ref_left,
   kvz_pixel *const dst);
 
+/**
+ * Angular prediction of several modes from the same reference. Mode
+ * intra_modes[i] is written to dst[i].
+ */
+typedef void (angular_pred_multi_func)(
+  const int_fast8_t log2_width,
+  const int8_t *const intra_modes,
+  const int num_modes,
+  const kvz_pixel *const in_ref_above,
+  const kvz_pixel *const in_ref_left,
+  kvz_pixel *const *const dst);
+
 typedef void (intra_pred_planar_func)(
   const int_fast8_t log2_width,
   const kvz_pixel *const ref_top,
@@ -45,6 +57,7 @@ typedef void (intra_pred_planar_func)(
 
 // Declare function pointers.
 extern angular_pred_func * kvz_angular_pred;
+extern angular_pred_multi_func * kvz_angular_pred_multi;
 extern intra_pred_planar_func * kvz_intra_pred_planar;
 
 int kvz_strategy_register_intra(void* opaque, uint8_t bitdepth);
@@ -52,6 +65,7 @@ int kvz_strategy_register_intra(void* opaque, uint8_t bitdepth);
 
 #define STRATEGIES_INTRA_EXPORTS \
   {"angular_pred", (void**) &kvz_angular_pred}, \
+  {"angular_pred_multi", (void**) &kvz_angular_pred_multi}, \
   {"intra_pred_planar", (void**) &kvz_intra_pred_planar}, \
 
 
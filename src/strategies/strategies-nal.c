@@ -23,7 +23,7 @@
 #include "strategies/generic/nal-generic.h"
 
 
-void (*kvz_array_checksum)(const kvz_pixel* data,
+void (*kvz_array_checksum)(const kvz_pixel* data, const int y_offset,
                        const int height, const int width,
                        const int stride,
                        unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth);
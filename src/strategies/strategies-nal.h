@@ -35,16 +35,21 @@
 /**
  * \brief Calculate checksum for one color of the picture.
  * \param data Beginning of the pixel data for the picture.
+ * \param y_offset Row of the picture that data points to.
  * \param height Height of the picture.
  * \param width Width of the picture.
  * \param stride Width of one row in the pixel array.
  */
-typedef void (*array_checksum_func)(const kvz_pixel* data,
+typedef void (*array_checksum_func)(const kvz_pixel* data, const int y_offset,
                                     const int height, const int width,
                                     const int stride,
                                     unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth);
+typedef void (*array_md5_func)(const kvz_pixel* data,
+                               const int height, const int width,
+                               const int stride,
+                               unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth);
 extern array_checksum_func kvz_array_checksum;
-extern array_checksum_func kvz_array_md5;
+extern array_md5_func kvz_array_md5;
 
 
 int kvz_strategy_register_nal(void* opaque, uint8_t bitdepth);
@@ -31,6 +31,7 @@
 
 // Define function pointers.
 reg_sad_func * kvz_reg_sad = 0;
+reg_sad_multi_func * kvz_reg_sad_multi = 0;
 
 cost_pixel_nxn_func * kvz_sad_4x4 = 0;
 cost_pixel_nxn_func * kvz_sad_8x8 = 0;
@@ -56,6 +57,11 @@ cost_pixel_nxn_multi_func * kvz_satd_16x16_dual = 0;
 cost_pixel_nxn_multi_func * kvz_satd_32x32_dual = 0;
 cost_pixel_nxn_multi_func * kvz_satd_64x64_dual = 0;
 
+cost_pixel_nxn_multi_func * kvz_satd_4x4_multi = 0;
+cost_pixel_nxn_multi_func * kvz_satd_8x8_multi = 0;
+cost_pixel_nxn_multi_func * kvz_satd_16x16_multi = 0;
+cost_pixel_nxn_multi_func * kvz_satd_32x32_multi = 0;
+
 cost_pixel_any_size_func * kvz_satd_any_size = 0;
 cost_pixel_any_size_multi_func * kvz_satd_any_size_quad = 0;
 
@@ -194,3 +200,27 @@ cost_pixel_nxn_multi_func * kvz_pixels_get_sad_dual_func(unsigned n)
     return NULL;
   }
 }
+
+
+/**
+* \brief  Get a function that calculates SATDs for any number of NxN blocks.
+*
+* \param n  Width of the region for which SATD is calculated.
+*
+* \returns  Pointer to cost_pixel_nxn_multi_func.
+*/
+cost_pixel_nxn_multi_func * kvz_pixels_get_satd_multi_func(unsigned n)
+{
+  switch (n) {
+  case 4:
+    return kvz_satd_4x4_multi;
+  case 8:
+    return kvz_satd_8x8_multi;
+  case 16:
+    return kvz_satd_16x16_multi;
+  case 32:
+    return kvz_satd_32x32_multi;
+  default:
+    return NULL;
+  }
+}
@@ -103,6 +103,9 @@ static unsigned satd_ ## n ## x ## n ## _ ## suffix ( \
 typedef unsigned(reg_sad_func)(const kvz_pixel *const data1, const kvz_pixel *const data2,
   const int width, const int height,
   const unsigned stride1, const unsigned stride2);
+typedef void (reg_sad_multi_func)(const kvz_pixel *const data1, const kvz_pixel *const *const data2,
+  const int num_blocks, const int width, const int height,
+  const unsigned stride1, const unsigned stride2, unsigned *costs_out);
 typedef unsigned (cost_pixel_nxn_func)(const kvz_pixel *block1, const kvz_pixel *block2);
 typedef unsigned (cost_pixel_any_size_func)(
     int width, int height,
@@ -140,6 +143,7 @@ typedef void (inter_recon_bipred_func)(const int hi_prec_luma_rec0,
 
 // Declare function pointers.
 extern reg_sad_func * kvz_reg_sad;
+extern reg_sad_multi_func * kvz_reg_sad_multi;
 
 extern cost_pixel_nxn_func * kvz_sad_4x4;
 extern cost_pixel_nxn_func * kvz_sad_8x8;
@@ -166,6 +170,11 @@ extern cost_pixel_nxn_multi_func * kvz_satd_16x16_dual;
 extern cost_pixel_nxn_multi_func * kvz_satd_32x32_dual;
 extern cost_pixel_nxn_multi_func * kvz_satd_64x64_dual;
 
+extern cost_pixel_nxn_multi_func * kvz_satd_4x4_multi;
+extern cost_pixel_nxn_multi_func * kvz_satd_8x8_multi;
+extern cost_pixel_nxn_multi_func * kvz_satd_16x16_multi;
+extern cost_pixel_nxn_multi_func * kvz_satd_32x32_multi;
+
 extern cost_pixel_any_size_multi_func *kvz_satd_any_size_quad;
 
 extern pixels_calc_ssd_func *kvz_pixels_calc_ssd;
@@ -181,9 +190,11 @@ cost_pixel_nxn_func * kvz_pixels_get_satd_func(unsigned n);
 cost_pixel_nxn_func * kvz_pixels_get_sad_func(unsigned n);
 cost_pixel_nxn_multi_func * kvz_pixels_get_satd_dual_func(unsigned n);
 cost_pixel_nxn_multi_func * kvz_pixels_get_sad_dual_func(unsigned n);
+cost_pixel_nxn_multi_func * kvz_pixels_get_satd_multi_func(unsigned n);
 
 #define STRATEGIES_PICTURE_EXPORTS \
   {"reg_sad", (void**) &kvz_reg_sad}, \
+  {"reg_sad_multi", (void**) &kvz_reg_sad_multi}, \
   {"sad_4x4", (void**) &kvz_sad_4x4}, \
   {"sad_8x8", (void**) &kvz_sad_8x8}, \
   {"sad_16x16", (void**) &kvz_sad_16x16}, \
@@ -205,6 +216,10 @@ cost_pixel_nxn_multi_func * kvz_pixels_get_sad_dual_func(unsigned n);
   {"satd_16x16_dual", (void**) &kvz_satd_16x16_dual}, \
   {"satd_32x32_dual", (void**) &kvz_satd_32x32_dual}, \
   {"satd_64x64_dual", (void**) &kvz_satd_64x64_dual}, \
+  {"satd_4x4_multi", (void**) &kvz_satd_4x4_multi}, \
+  {"satd_8x8_multi", (void**) &kvz_satd_8x8_multi}, \
+  {"satd_16x16_multi", (void**) &kvz_satd_16x16_multi}, \
+  {"satd_32x32_multi", (void**) &kvz_satd_32x32_multi}, \
   {"satd_any_size_quad", (void**) &kvz_satd_any_size_quad}, \
   {"pixels_calc_ssd", (void**) &kvz_pixels_calc_ssd}, \
   {"inter_recon_bipred", (void**) &kvz_inter_recon_bipred_blend}, \
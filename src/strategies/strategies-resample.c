@@ -22,6 +22,7 @@
 
 #include "strategies/generic/resample-generic.h"
 #include "strategies/avx2/resample-avx2.h"
+#include "strategies/avx512/resample-avx512.h"
 #include "strategyselector.h"
 
 
@@ -37,6 +38,9 @@ int kvz_strategy_register_resample(void * opaque)
   if(kvz_g_hardware_flags.intel_flags.avx2) {
     success &= kvz_strategy_register_resample_avx2(opaque);
   }
+  if(kvz_g_hardware_flags.intel_flags.avx512) {
+    success &= kvz_strategy_register_resample_avx512(opaque);
+  }
 
   return success;
 }
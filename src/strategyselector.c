@@ -122,6 +122,10 @@ int kvz_strategyselector_init(int32_t cpuid, uint8_t bitdepth) {
 		  fprintf(stderr, "avx2(%d) ", kvz_g_strategies_available.intel_flags.avx2);
 		  strategies_available = true;
 	  }
+	  if (kvz_g_strategies_available.intel_flags.avx512 != 0){
+		  fprintf(stderr, "avx512(%d) ", kvz_g_strategies_available.intel_flags.avx512);
+		  strategies_available = true;
+	  }
 	  if (kvz_g_strategies_available.intel_flags.mmx != 0) {
 		  fprintf(stderr, "mmx(%d) ", kvz_g_strategies_available.intel_flags.mmx);
 		  strategies_available = true;
@@ -175,6 +179,10 @@ int kvz_strategyselector_init(int32_t cpuid, uint8_t bitdepth) {
 		  fprintf(stderr, "avx2(%d) ", kvz_g_strategies_in_use.intel_flags.avx2);
 		  strategies_in_use = true;
 	  }
+	  if (kvz_g_strategies_in_use.intel_flags.avx512 != 0){
+		  fprintf(stderr, "avx512(%d) ", kvz_g_strategies_in_use.intel_flags.avx512);
+		  strategies_in_use = true;
+	  }
 	  if (kvz_g_strategies_in_use.intel_flags.mmx != 0) {
 		  fprintf(stderr, "mmx(%d) ", kvz_g_strategies_in_use.intel_flags.mmx);
 		  strategies_in_use = true;
@@ -250,6 +258,7 @@ int kvz_strategyselector_register(void * const opaque, const char * const type,
   if (strcmp(strategy_name, "avx") == 0) kvz_g_strategies_available.intel_flags.avx++;
   if (strcmp(strategy_name, "x86_asm_avx") == 0) kvz_g_strategies_available.intel_flags.avx++;
   if (strcmp(strategy_name, "avx2") == 0) kvz_g_strategies_available.intel_flags.avx2++;
+  if (strcmp(strategy_name, "avx512") == 0) kvz_g_strategies_available.intel_flags.avx512++;
   if (strcmp(strategy_name, "mmx") == 0) kvz_g_strategies_available.intel_flags.mmx++;
   if (strcmp(strategy_name, "sse") == 0) kvz_g_strategies_available.intel_flags.sse++;
   if (strcmp(strategy_name, "sse2") == 0) kvz_g_strategies_available.intel_flags.sse2++;
@@ -322,6 +331,7 @@ static void* strategyselector_choose_for(const strategy_list_t * const strategie
   if (strcmp(strategies->strategies[max_priority_i].strategy_name, "avx") == 0) kvz_g_strategies_in_use.intel_flags.avx++;
   if (strcmp(strategies->strategies[max_priority_i].strategy_name, "x86_asm_avx") == 0) kvz_g_strategies_in_use.intel_flags.avx++;
   if (strcmp(strategies->strategies[max_priority_i].strategy_name, "avx2") == 0) kvz_g_strategies_in_use.intel_flags.avx2++;
+  if (strcmp(strategies->strategies[max_priority_i].strategy_name, "avx512") == 0) kvz_g_strategies_in_use.intel_flags.avx512++;
   if (strcmp(strategies->strategies[max_priority_i].strategy_name, "mmx") == 0) kvz_g_strategies_in_use.intel_flags.mmx++;
   if (strcmp(strategies->strategies[max_priority_i].strategy_name, "sse") == 0) kvz_g_strategies_in_use.intel_flags.sse++;
   if (strcmp(strategies->strategies[max_priority_i].strategy_name, "sse2") == 0) kvz_g_strategies_in_use.intel_flags.sse2++;
@@ -468,10 +478,15 @@ static void set_hardware_flags(int32_t cpuid) {
     };
     enum {
       CPUID7_EBX_AVX2 = 1 << 5,
+      CPUID7_EBX_AVX512F = 1 << 16,
+      CPUID7_EBX_AVX512BW = 1 << 30,
     };
     enum {
       XGETBV_XCR0_XMM = 1 << 1,
       XGETBV_XCR0_YMM = 1 << 2,
+      XGETBV_XCR0_OPMASK = 1 << 5,
+      XGETBV_XCR0_ZMM_HI256 = 1 << 6,
+      XGETBV_XCR0_HI16_ZMM = 1 << 7,
     };
 
     // Dig CPU features with cpuid
@@ -526,6 +541,13 @@ static void set_hardware_flags(int32_t cpuid) {
         cpuid_t cpuid7 = { 0, 0, 0, 0 };
         get_cpuid(7, 0, &cpuid7);
         if (cpuid7.ebx & CPUID7_EBX_AVX2)  kvz_g_hardware_flags.intel_flags.avx2 = 1;
+
+        // The OS also needs to save the opmask and upper ZMM registers.
+        const uint64_t zmm_state = XGETBV_XCR0_OPMASK | XGETBV_XCR0_ZMM_HI256 | XGETBV_XCR0_HI16_ZMM;
+        bool avx512_support = (cpuid7.ebx & CPUID7_EBX_AVX512F) && (cpuid7.ebx & CPUID7_EBX_AVX512BW);
+        if (avx512_support && (xcr0 & zmm_state) == zmm_state) {
+          kvz_g_hardware_flags.intel_flags.avx512 = 1;
+        }
       }
     }
   }
@@ -557,6 +579,9 @@ static void set_hardware_flags(int32_t cpuid) {
 #endif
 #if COMPILE_INTEL_AVX2
   fprintf(stderr, " AVX2");
+#endif
+#if COMPILE_INTEL_AVX512
+  fprintf(stderr, " AVX512");
 #endif
   fprintf(stderr, "\nDetected: INTEL, flags:");
   if (kvz_g_hardware_flags.intel_flags.mmx) fprintf(stderr, " MMX");
@@ -568,6 +593,7 @@ static void set_hardware_flags(int32_t cpuid) {
   if (kvz_g_hardware_flags.intel_flags.sse42) fprintf(stderr, " SSE42");
   if (kvz_g_hardware_flags.intel_flags.avx) fprintf(stderr, " AVX");
   if (kvz_g_hardware_flags.intel_flags.avx2) fprintf(stderr, " AVX2");
+  if (kvz_g_hardware_flags.intel_flags.avx512) fprintf(stderr, " AVX512");
   fprintf(stderr, "\n");
 #endif //COMPILE_INTEL
 
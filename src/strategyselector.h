@@ -63,6 +63,7 @@ typedef struct {
     int sse42;
     int avx;
     int avx2;
+    int avx512;
 
     bool hyper_threading;
   } intel_flags;
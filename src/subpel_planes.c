@@ -0,0 +1,328 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (C) 2013-2015 Tampere University of Technology and others (see
+ * COPYING file).
+ *
+ * Kvazaar is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * Kvazaar is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+#include "subpel_planes.h"
+
+#include <stdlib.h>
+
+#include "encoderstate.h"
+#include "strategies/strategies-ipol.h"
+#include "threads.h"
+
+
+//! Size of the blocks the planes are interpolated in.
+#define SUBPEL_PLANES_BLOCK LCU_WIDTH
+
+extern const int8_t kvz_g_luma_filter[4][8];
+
+enum {
+  LCU_EMPTY = 0,
+  LCU_FILLING = 1,
+  LCU_READY = 2,
+};
+
+
+/**
+ * \brief Allocate planes for a picture.
+ *
+ * Only the memory is allocated. The planes are filled when used.
+ *
+ * \return planes or NULL on failure
+ */
+subpel_planes_t * kvz_subpel_planes_alloc(int32_t width, int32_t height, uint8_t layer_id)
+{
+  subpel_planes_t *planes = calloc(1, sizeof(subpel_planes_t));
+  if (!planes) return NULL;
+
+  planes->width = width;
+  planes->height = height;
+  planes->width_in_lcu = CEILDIV(width, LCU_WIDTH);
+  planes->height_in_lcu = CEILDIV(height, LCU_WIDTH);
+  planes->layer_id = layer_id;
+  planes->stride = width + 2 * SUBPEL_PLANES_PADDING;
+
+  const size_t plane_size = (size_t)planes->stride * (height + 2 * SUBPEL_PLANES_PADDING);
+  planes->buffer = MALLOC(kvz_pixel, 15 * plane_size);
+  planes->lcu_state = calloc(planes->width_in_lcu * planes->height_in_lcu, sizeof(int32_t));
+  if (!planes->buffer || !planes->lcu_state) {
+    kvz_subpel_planes_free(planes);
+    return NULL;
+  }
+
+  for (int i = 0; i < 15; ++i) {
+    planes->planes[i] = planes->buffer + i * plane_size +
+                        SUBPEL_PLANES_PADDING * planes->stride + SUBPEL_PLANES_PADDING;
+  }
+
+  return planes;
+}
+
+void kvz_subpel_planes_free(subpel_planes_t *planes)
+{
+  if (!planes) return;
+
+  FREE_POINTER(planes->buffer);
+  FREE_POINTER(planes->lcu_state);
+  free(planes);
+}
+
+/**
+ * \brief Mark every LCU of the planes empty, so that they are filled again
+ *        when the picture has been reconstructed anew.
+ */
+void kvz_subpel_planes_reset(subpel_planes_t *planes)
+{
+  const int num_lcus = planes->width_in_lcu * planes->height_in_lcu;
+  for (int i = 0; i < num_lcus; ++i) {
+    KVZ_ATOMIC_STORE(&planes->lcu_state[i], LCU_EMPTY);
+  }
+}
+
+/**
+ * \brief Check whether the pixels an LCU of the planes is interpolated from
+ *        are final.
+ *
+ * Uses the same rules as the inter search when frames are encoded in
+ * parallel: the current LCU may only read reference LCUs it depends on.
+ *
+ * \param pu_lcu_x  x of the LCU being searched, in LCUs
+ * \param pu_lcu_y  y of the LCU being searched, in LCUs
+ * \param lcu_x     x of the LCU of the planes, in LCUs
+ * \param lcu_y     y of the LCU of the planes, in LCUs
+ */
+static bool lcu_is_final(const encoder_state_t *state,
+                         const subpel_planes_t *planes,
+                         int pu_lcu_x, int pu_lcu_y,
+                         int lcu_x, int lcu_y)
+{
+  const encoder_control_t *ctrl = state->encoder_control;
+
+  if (!ctrl->cfg.owf || !ctrl->cfg.wpp) {
+    // Otherwise references are done before the frame is started.
+    return true;
+  }
+
+  int margin = KVZ_LUMA_FILTER_TAPS / 2;
+  if (ctrl->cfg.sao_type) {
+    margin += SAO_DELAY_PX;
+  } else if (ctrl->cfg.deblock_enable) {
+    margin += DEBLOCK_DELAY_PX;
+  }
+
+  // LCU containing the last pixel read. The pixels on the right and bottom
+  // edges of the picture are finished by the LCUs on the edges.
+  const int right = MIN((lcu_x + 1) * LCU_WIDTH, planes->width);
+  const int bottom = MIN((lcu_y + 1) * LCU_WIDTH, planes->height);
+  const int last_x = MIN((right + margin) / LCU_WIDTH, planes->width_in_lcu - 1);
+  const int last_y = MIN((bottom + margin) / LCU_WIDTH, planes->height_in_lcu - 1);
+
+  const int dx = last_x - pu_lcu_x;
+  const int dy = last_y - pu_lcu_y;
+  return dy <= ctrl->max_inter_ref_lcu.down &&
+         dx + dy <= ctrl->max_inter_ref_lcu.down + ctrl->max_inter_ref_lcu.right;
+}
+
+static INLINE int32_t eight_tap(const int8_t *fir, const kvz_pixel *src, int step)
+{
+  return fir[0] * src[0]        + fir[1] * src[step]     +
+         fir[2] * src[2 * step] + fir[3] * src[3 * step] +
+         fir[4] * src[4 * step] + fir[5] * src[5 * step] +
+         fir[6] * src[6 * step] + fir[7] * src[7 * step];
+}
+
+static INLINE int32_t eight_tap_16bit(const int8_t *fir, const int16_t *src, int step)
+{
+  return fir[0] * src[0]        + fir[1] * src[step]     +
+         fir[2] * src[2 * step] + fir[3] * src[3 * step] +
+         fir[4] * src[4 * step] + fir[5] * src[5 * step] +
+         fir[6] * src[6 * step] + fir[7] * src[7 * step];
+}
+
+/**
+ * \brief Interpolate a block of all 15 planes.
+ *
+ * Same arithmetic as kvz_sample_quarterpel_luma, but the horizontally
+ * filtered rows are shared by the planes with the same horizontal fraction
+ * and the planes with only one fractional component are filtered once.
+ *
+ * \param src     top-left pixel of the block, with KVZ_LUMA_FILTER_OFFSET
+ *                pixels above and to the left and 4 below and to the right
+ * \param x       x of the block in the picture
+ * \param y       y of the block in the picture
+ */
+static void fill_block(subpel_planes_t *planes,
+                       const kvz_pixel *src, int src_stride,
+                       int x, int y,
+                       int width, int height)
+{
+  const int shift1 = KVZ_BIT_DEPTH - 8;
+  const int shift2 = 6;
+  const int wp_shift1 = 14 - KVZ_BIT_DEPTH;
+  const int wp_offset1 = 1 << (wp_shift1 - 1);
+
+  const int stride = planes->stride;
+  const int offset = y * stride + x;
+
+  // Horizontally filtered rows from KVZ_LUMA_FILTER_OFFSET rows above the
+  // block for each horizontal fraction.
+  ALIGNED(64) int16_t hor[3][KVZ_EXT_BLOCK_W_LUMA * SUBPEL_PLANES_BLOCK];
+
+  for (int frac_x = 1; frac_x < 4; ++frac_x) {
+    const int8_t *const fir = kvz_g_luma_filter[frac_x];
+    int16_t *const hor_frac = hor[frac_x - 1];
+
+    for (int i = 0; i < height + KVZ_EXT_PADDING_LUMA; ++i) {
+      const kvz_pixel *const row = &src[(i - KVZ_LUMA_FILTER_OFFSET) * src_stride - KVZ_LUMA_FILTER_OFFSET];
+      for (int j = 0; j < width; ++j) {
+        hor_frac[i * SUBPEL_PLANES_BLOCK + j] = eight_tap(fir, &row[j], 1) >> shift1;
+      }
+    }
+
+    kvz_pixel *const dst = planes->planes[frac_x - 1] + offset;
+    for (int i = 0; i < height; ++i) {
+      const int16_t *const row = &hor_frac[(i + KVZ_LUMA_FILTER_OFFSET) * SUBPEL_PLANES_BLOCK];
+      for (int j = 0; j < width; ++j) {
+        dst[i * stride + j] = CLIP_TO_PIXEL((row[j] + wp_offset1) >> wp_shift1);
+      }
+    }
+  }
+
+  for (int frac_y = 1; frac_y < 4; ++frac_y) {
+    const int8_t *const fir = kvz_g_luma_filter[frac_y];
+
+    kvz_pixel *const dst = planes->planes[frac_y * 4 - 1] + offset;
+    for (int i = 0; i < height; ++i) {
+      const kvz_pixel *const col = &src[(i - KVZ_LUMA_FILTER_OFFSET) * src_stride];
+      for (int j = 0; j < width; ++j) {
+        const int32_t sample = eight_tap(fir, &col[j], src_stride) >> shift1;
+        dst[i * stride + j] = CLIP_TO_PIXEL((sample + wp_offset1) >> wp_shift1);
+      }
+    }
+
+    for (int frac_x = 1; frac_x < 4; ++frac_x) {
+      const int16_t *const hor_frac = hor[frac_x - 1];
+
+      kvz_pixel *const dst_diag = planes->planes[frac_y * 4 + frac_x - 1] + offset;
+      for (int i = 0; i < height; ++i) {
+        for (int j = 0; j < width; ++j) {
+          const int32_t sample = eight_tap_16bit(fir, &hor_frac[i * SUBPEL_PLANES_BLOCK + j], SUBPEL_PLANES_BLOCK) >> shift2;
+          dst_diag[i * stride + j] = CLIP_TO_PIXEL((sample + wp_offset1) >> wp_shift1);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * \brief Interpolate an LCU of the planes.
+ *
+ * The LCUs on the edges of the picture also fill the padding next to them.
+ */
+static void fill_lcu(subpel_planes_t *planes,
+                     const kvz_picture *ref,
+                     int lcu_x, int lcu_y)
+{
+  const int left = lcu_x == 0 ? -SUBPEL_PLANES_PADDING : lcu_x * LCU_WIDTH;
+  const int top = lcu_y == 0 ? -SUBPEL_PLANES_PADDING : lcu_y * LCU_WIDTH;
+  const int right = lcu_x == planes->width_in_lcu - 1 ?
+                    planes->width + SUBPEL_PLANES_PADDING : (lcu_x + 1) * LCU_WIDTH;
+  const int bottom = lcu_y == planes->height_in_lcu - 1 ?
+                     planes->height + SUBPEL_PLANES_PADDING : (lcu_y + 1) * LCU_WIDTH;
+
+  for (int y = top; y < bottom; y += SUBPEL_PLANES_BLOCK) {
+    for (int x = left; x < right; x += SUBPEL_PLANES_BLOCK) {
+      const int width = MIN(SUBPEL_PLANES_BLOCK, right - x);
+      const int height = MIN(SUBPEL_PLANES_BLOCK, bottom - y);
+
+      kvz_extended_block src = { 0, 0, 0, 0 };
+      kvz_get_extended_block(x, y, 0, 0, 0, 0,
+                             ref->y, ref->width, ref->height,
+                             KVZ_LUMA_FILTER_TAPS,
+                             width, height,
+                             &src);
+
+      fill_block(planes, src.orig_topleft, src.stride, x, y, width, height);
+
+      if (src.malloc_used) free(src.buffer);
+    }
+  }
+}
+
+/**
+ * \brief Make sure a block of the planes of a reference can be used.
+ *
+ * Fills the LCUs of the planes covering the block if they are still empty
+ * and their pixels are final. If another thread is filling one of them,
+ * the caller should interpolate the block itself instead of waiting.
+ *
+ * \param state   encoder state
+ * \param ref     reference picture
+ * \param pu_x    x of the PU being searched in the picture, in pixels
+ * \param pu_y    y of the PU being searched in the picture, in pixels
+ * \param x       x of the block in the picture, in pixels
+ * \param y       y of the block in the picture, in pixels
+ * \param width   width of the block
+ * \param height  height of the block
+ *
+ * \return true if the block can be read from the planes
+ */
+bool kvz_subpel_planes_ready(const encoder_state_t *state,
+                             const kvz_picture *ref,
+                             int pu_x, int pu_y,
+                             int x, int y,
+                             int width, int height)
+{
+  subpel_planes_t *const planes = ref->subpel_planes;
+
+  // The planes of the other layers are filled in a different order.
+  if (!planes || planes->layer_id != state->encoder_control->layer.layer_id) {
+    return false;
+  }
+
+  if (x < -SUBPEL_PLANES_PADDING || x + width > planes->width + SUBPEL_PLANES_PADDING ||
+      y < -SUBPEL_PLANES_PADDING || y + height > planes->height + SUBPEL_PLANES_PADDING)
+  {
+    return false;
+  }
+
+  const int first_x = CLIP(0, planes->width_in_lcu - 1, x / LCU_WIDTH);
+  const int first_y = CLIP(0, planes->height_in_lcu - 1, y / LCU_WIDTH);
+  const int last_x = CLIP(0, planes->width_in_lcu - 1, (x + width - 1) / LCU_WIDTH);
+  const int last_y = CLIP(0, planes->height_in_lcu - 1, (y + height - 1) / LCU_WIDTH);
+
+  for (int lcu_y = first_y; lcu_y <= last_y; ++lcu_y) {
+    for (int lcu_x = first_x; lcu_x <= last_x; ++lcu_x) {
+      int32_t *const lcu_state = &planes->lcu_state[lcu_x + lcu_y * planes->width_in_lcu];
+
+      if (KVZ_ATOMIC_LOAD(lcu_state) == LCU_READY) continue;
+
+      if (!lcu_is_final(state, planes, pu_x / LCU_WIDTH, pu_y / LCU_WIDTH, lcu_x, lcu_y) ||
+          !KVZ_ATOMIC_CAS(lcu_state, LCU_EMPTY, LCU_FILLING))
+      {
+        return false;
+      }
+
+      fill_lcu(planes, ref, lcu_x, lcu_y);
+      KVZ_ATOMIC_STORE(lcu_state, LCU_READY);
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,94 @@
+#ifndef SUBPEL_PLANES_H_
+#define SUBPEL_PLANES_H_
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (C) 2013-2015 Tampere University of Technology and others (see
+ * COPYING file).
+ *
+ * Kvazaar is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at your
+ * option) any later version.
+ *
+ * Kvazaar is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+/**
+ * \ingroup Reconstruction
+ * \file
+ * Luma of a reference picture interpolated to every quarter pixel position.
+ *
+ * The planes are filled one LCU at a time the first time a block of the LCU
+ * is needed and the reconstructed pixels the LCU is interpolated from are
+ * final. Blocks of the planes are equal to the output of
+ * kvz_sample_quarterpel_luma, so using them does not change the result.
+ */
+
+#include "global.h" // IWYU pragma: keep
+#include "kvazaar.h"
+
+
+// Forward declaration.
+struct encoder_state_t;
+
+//! \brief Number of pixels the planes extend outside the picture.
+#define SUBPEL_PLANES_PADDING 32
+
+typedef struct subpel_planes_t {
+  //! \brief Planes indexed by frac_y * 4 + frac_x - 1, pointing to pixel (0, 0).
+  kvz_pixel *planes[15];
+
+  kvz_pixel *buffer;
+  int32_t stride;
+
+  //! \brief Size of the picture.
+  int32_t width;
+  int32_t height;
+
+  int32_t width_in_lcu;
+  int32_t height_in_lcu;
+
+  //! \brief Layer encoding the picture.
+  uint8_t layer_id;
+
+  //! \brief State of each LCU in raster order, 0: empty, 1: being filled, 2: ready.
+  int32_t *lcu_state;
+} subpel_planes_t;
+
+subpel_planes_t * kvz_subpel_planes_alloc(int32_t width, int32_t height, uint8_t layer_id);
+void kvz_subpel_planes_free(subpel_planes_t *planes);
+void kvz_subpel_planes_reset(subpel_planes_t *planes);
+
+bool kvz_subpel_planes_ready(const struct encoder_state_t *state,
+                             const kvz_picture *ref,
+                             int pu_x, int pu_y,
+                             int x, int y,
+                             int width, int height);
+
+/**
+ * \brief Get a pointer to a block of the planes.
+ *
+ * The block must have been checked with kvz_subpel_planes_ready.
+ *
+ * \param planes  planes of the reference
+ * \param x       x of the top-left pixel in the picture, in pixels
+ * \param y       y of the top-left pixel in the picture, in pixels
+ * \param mv      fractional part of the motion vector in quarter pixels
+ */
+static INLINE const kvz_pixel * kvz_subpel_planes_block(const subpel_planes_t *planes,
+                                                       int x, int y,
+                                                       const int16_t mv[2])
+{
+  const int index = (mv[1] & 3) * 4 + (mv[0] & 3) - 1;
+  assert(index >= 0);
+  return planes->planes[index] + y * planes->stride + x;
+}
+
+#endif // SUBPEL_PLANES_H_
@@ -23,6 +23,7 @@
 
 #include <errno.h> // ETIMEDOUT
 #include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,20 +34,62 @@
 /**
  * \file
  *
- * Lock acquisition order:
+ * Locking:
  *
- * 1. When locking a job and its dependency, the dependecy must be locked
- * first and then the job depending on it.
+ * 1. threadqueue_job_t.lock protects the rdepends array and the transition
+ * to THREADQUEUE_JOB_STATE_DONE. No other lock is taken while holding it.
  *
- * 2. When locking a job and the thread queue, the thread queue must be
- * locked first and then the job.
- *
- * 3. When accessing threadqueue_job_t.next, the thread queue must be
+ * 2. When accessing threadqueue_job_t.next, the thread queue must be
  * locked.
+ *
+ * 3. threadqueue_job_t.ndepends is only modified with atomic operations.
+ * It holds one extra dependency from job creation until the job is
+ * submitted. The thread that decrements it to zero makes the job ready.
+ *
+ * Scheduling:
+ *
+ * Each worker thread owns a bounded work-stealing deque (Chase-Lev). When
+ * a job completes, the jobs that became ready are pushed to the bottom of
+ * the deque of the worker that completed it and the same worker pops them
+ * from the bottom. Idle workers steal from the top of the other deques.
+ * Jobs submitted from outside the workers go to the global FIFO
+ * (threadqueue->first), which is protected by threadqueue->lock. The same
+ * lock is only taken by workers when they run out of work, or when there
+ * are sleeping workers to wake up.
+ *
+ * There is a separate set of deques and a separate FIFO for each job
+ * priority. A worker looks for work in all the queues of the highest
+ * priority before moving on to the next one.
+ *
+ * Tracing:
+ *
+ * When enabled with kvz_threadqueue_trace_start, each worker records the
+ * jobs it runs and the dependencies they release to its own event buffer.
+ * Events from other threads go to a shared buffer protected by
+ * threadqueue->trace_lock. Full buffers are written to the log file in the
+ * format read by tools/plot-threadqueue-log.py.
  */
 
 #define THREADQUEUE_LIST_REALLOC_SIZE 32
 
+/**
+ * \brief Number of jobs that fit in a worker deque. Must be a power of two.
+ *
+ * If a deque is full, jobs overflow to the global queue.
+ */
+#define THREADQUEUE_DEQUE_SIZE 1024
+
+/**
+ * \brief Number of events buffered by each thread before writing them to
+ * the trace log.
+ */
+#define THREADQUEUE_TRACE_BUFFER_SIZE 4096
+
+/**
+ * \brief Maximum length of a job description in the trace log.
+ */
+#define THREADQUEUE_TRACE_DESCRIPTION_SIZE 96
+
 #define PTHREAD_COND_SIGNAL(c) \
   if (pthread_cond_signal((c)) != 0) { \
     fprintf(stderr, "pthread_cond_signal(%s=%p) failed!\n", #c, c); \
@@ -119,8 +162,11 @@ struct threadqueue_job_t {
 
   /**
    * \brief Number of dependencies that have not been completed yet.
+   *
+   * Includes one extra dependency that is released when the job is
+   * submitted.
    */
-  int ndepends;
+  volatile int32_t ndepends;
 
   /**
    * \brief Reverse dependencies.
@@ -145,6 +191,11 @@ struct threadqueue_job_t {
    */
   int refcount;
 
+  /**
+   * \brief Priority of the job. Selects the queues the job goes to.
+   */
+  threadqueue_job_priority priority;
+
   /**
    * \brief Pointer to the function to execute.
    */
@@ -160,9 +211,99 @@ struct threadqueue_job_t {
    */
   struct threadqueue_job_t *next;
 
+  /**
+   * \brief Identifier of the job in the trace log.
+   */
+  int32_t trace_id;
+
+  /**
+   * \brief Time when the job was submitted. Only set when tracing.
+   */
+  KVZ_CLOCK_T trace_enqueue;
+
+  /**
+   * \brief Description of the job in the trace log.
+   */
+  char trace_description[THREADQUEUE_TRACE_DESCRIPTION_SIZE];
+
 };
 
 
+typedef enum {
+  THREADQUEUE_TRACE_EVENT_JOB,
+  THREADQUEUE_TRACE_EVENT_DEP,
+} threadqueue_trace_event_type;
+
+
+typedef struct {
+  threadqueue_trace_event_type type;
+
+  /**
+   * \brief Job, or the dependency in a dependency event
+   */
+  int32_t id;
+
+  /**
+   * \brief Job depending on id in a dependency event
+   */
+  int32_t rdepend_id;
+
+  int worker_id;
+
+  /**
+   * \brief Enqueue, start, stop and dequeue times of a job
+   */
+  KVZ_CLOCK_T times[4];
+
+  char description[THREADQUEUE_TRACE_DESCRIPTION_SIZE];
+} threadqueue_trace_event_t;
+
+
+typedef struct {
+  threadqueue_trace_event_t *events;
+  int count;
+} threadqueue_trace_buffer_t;
+
+
+/**
+ * \brief Work-stealing deque owned by a single worker.
+ *
+ * Only the owner pushes and pops at the bottom. Other workers steal from
+ * the top.
+ */
+typedef struct {
+  volatile int64_t top;
+  volatile int64_t bottom;
+  threadqueue_job_t *jobs[THREADQUEUE_DEQUE_SIZE];
+} threadqueue_deque_t;
+
+
+typedef struct {
+  threadqueue_queue_t *threadqueue;
+
+  /**
+   * \brief Index of the worker in threadqueue->workers.
+   */
+  int id;
+
+  /**
+   * \brief Deques for each job priority
+   */
+  threadqueue_deque_t deques[THREADQUEUE_JOB_PRIORITY_COUNT];
+
+  /**
+   * \brief Events recorded by this worker when tracing
+   */
+  threadqueue_trace_buffer_t trace;
+
+  /**
+   * \brief Start and stop times of the thread
+   */
+  KVZ_CLOCK_T trace_thread_start;
+  KVZ_CLOCK_T trace_thread_stop;
+} threadqueue_worker_t;
+
+
 struct threadqueue_queue_t {
   pthread_mutex_t lock;
 
@@ -185,6 +326,11 @@ struct threadqueue_queue_t {
    */
   pthread_t *threads;
 
+  /**
+   * \brief Per-thread state, including the work-stealing deques
+   */
+  threadqueue_worker_t *workers;
+
   /**
    * \brief Number of threads spawned
    */
@@ -195,28 +341,128 @@ struct threadqueue_queue_t {
    */
   int thread_running_count;
 
+  /**
+   * \brief Number of threads waiting for job_available
+   */
+  volatile int32_t thread_idle_count;
+
+  /**
+   * \brief Number of ready jobs in the deques and the global queue
+   */
+  volatile int32_t ready_count;
+
   /**
    * \brief If true, threads should stop ASAP.
    */
-  bool stop;
+  volatile bool stop;
+
+  /**
+   * \brief Pointers to the first ready job of each priority
+   */
+  threadqueue_job_t *first[THREADQUEUE_JOB_PRIORITY_COUNT];
+
+  /**
+   * \brief Pointers to the last ready job of each priority
+   */
+  threadqueue_job_t *last[THREADQUEUE_JOB_PRIORITY_COUNT];
+
+  /**
+   * \brief Trace log file, or NULL if tracing is disabled
+   */
+  FILE *trace_file;
 
   /**
-   * \brief Pointer to the first ready job
+   * \brief Protects trace_file and trace_shared
    */
-  threadqueue_job_t *first;
+  pthread_mutex_t trace_lock;
 
   /**
-   * \brief Pointer to the last ready job
+   * \brief Events recorded by threads other than the workers
    */
-  threadqueue_job_t *last;
+  threadqueue_trace_buffer_t trace_shared;
 };
 
 
+/**
+ * \brief Counter for assigning trace identifiers to jobs
+ */
+static int32_t threadqueue_job_count = 0;
+
+
+/**
+ * \brief Write the events in a trace buffer to the log and empty it.
+ *
+ * The caller must have locked threadqueue->trace_lock.
+ */
+static void threadqueue_trace_write(threadqueue_queue_t *threadqueue,
+                                    threadqueue_trace_buffer_t *buffer)
+{
+  for (int i = 0; i < buffer->count; ++i) {
+    const threadqueue_trace_event_t *event = &buffer->events[i];
+    if (event->type == THREADQUEUE_TRACE_EVENT_DEP) {
+      fprintf(threadqueue->trace_file, "%d->%d\n", event->id, event->rdepend_id);
+    } else {
+      fprintf(threadqueue->trace_file, "%d\t%d\t%lf\t+%lf\t+%lf\t+%lf\t%s\n",
+              event->id,
+              event->worker_id,
+              KVZ_CLOCK_T_AS_DOUBLE(event->times[0]),
+              KVZ_CLOCK_T_DIFF(event->times[0], event->times[1]),
+              KVZ_CLOCK_T_DIFF(event->times[1], event->times[2]),
+              KVZ_CLOCK_T_DIFF(event->times[2], event->times[3]),
+              event->description[0] ? event->description : "type=job");
+    }
+  }
+  buffer->count = 0;
+}
+
+
+/**
+ * \brief Reserve space for an event in a trace buffer.
+ *
+ * Writes the buffer to the log if it is full. If shared is set, the caller
+ * must have locked threadqueue->trace_lock.
+ */
+static threadqueue_trace_event_t * threadqueue_trace_event(threadqueue_queue_t *threadqueue,
+                                                           threadqueue_trace_buffer_t *buffer,
+                                                           bool shared)
+{
+  if (buffer->count == THREADQUEUE_TRACE_BUFFER_SIZE) {
+    if (!shared) pthread_mutex_lock(&threadqueue->trace_lock);
+    threadqueue_trace_write(threadqueue, buffer);
+    if (!shared) pthread_mutex_unlock(&threadqueue->trace_lock);
+  }
+  return &buffer->events[buffer->count++];
+}
+
+
+/**
+ * \brief Record a completed job to a trace buffer.
+ */
+static void threadqueue_trace_job(threadqueue_queue_t *threadqueue,
+                                  threadqueue_trace_buffer_t *buffer,
+                                  bool shared,
+                                  const threadqueue_job_t *job,
+                                  int worker_id,
+                                  const KVZ_CLOCK_T *start,
+                                  const KVZ_CLOCK_T *stop)
+{
+  threadqueue_trace_event_t *event = threadqueue_trace_event(threadqueue, buffer, shared);
+  event->type = THREADQUEUE_TRACE_EVENT_JOB;
+  event->id = job->trace_id;
+  event->worker_id = worker_id;
+  event->times[0] = job->trace_enqueue;
+  event->times[1] = *start;
+  event->times[2] = *stop;
+  KVZ_GET_TIME(&event->times[3]);
+  memcpy(event->description, job->trace_description, sizeof(event->description));
+}
+
+
 /**
  * \brief Add a job to the queue of jobs ready to run.
  *
- * The caller must have locked the thread queue and the job. This function
- * takes the ownership of the job.
+ * The caller must have locked the thread queue. This function takes the
+ * ownership of the job.
  */
 static void threadqueue_push_job(threadqueue_queue_t * threadqueue,
                                  threadqueue_job_t *job)
@@ -224,113 +470,315 @@ static void threadqueue_push_job(threadqueue_queue_t * threadqueue,
   assert(job->ndepends == 0);
   job->state = THREADQUEUE_JOB_STATE_READY;
 
-  if (threadqueue->first == NULL) {
-    threadqueue->first = job;
+  const int lane = job->priority;
+  if (threadqueue->first[lane] == NULL) {
+    threadqueue->first[lane] = job;
   } else {
-    threadqueue->last->next = job;
+    threadqueue->last[lane]->next = job;
   }
 
-  threadqueue->last = job;
+  threadqueue->last[lane] = job;
   job->next = NULL;
+  KVZ_ATOMIC_INC(&threadqueue->ready_count);
 }
 
 
 /**
- * \brief Retrieve a job from the queue of jobs ready to run.
+ * \brief Retrieve a job of the given priority from the queue of jobs ready
+ * to run.
  *
  * The caller must have locked the thread queue. The calling function
  * receives the ownership of the job.
  */
-static threadqueue_job_t * threadqueue_pop_job(threadqueue_queue_t * threadqueue)
+static threadqueue_job_t * threadqueue_pop_job(threadqueue_queue_t * threadqueue,
+                                               int lane)
 {
-  assert(threadqueue->first != NULL);
+  assert(threadqueue->first[lane] != NULL);
 
-  threadqueue_job_t *job = threadqueue->first;
-  threadqueue->first = job->next;
+  threadqueue_job_t *job = threadqueue->first[lane];
+  threadqueue->first[lane] = job->next;
   job->next = NULL;
 
-  if (threadqueue->first == NULL) {
-    threadqueue->last = NULL;
+  if (threadqueue->first[lane] == NULL) {
+    threadqueue->last[lane] = NULL;
   }
 
+  KVZ_ATOMIC_DEC(&threadqueue->ready_count);
   return job;
 }
 
 
 /**
- * \brief Function executed by worker threads.
+ * \brief Push a job to the bottom of a deque.
+ *
+ * Must only be called by the thread owning the deque.
+ *
+ * \return 1 on success, 0 if the deque is full
  */
-static void* threadqueue_worker(void* threadqueue_opaque)
+static int threadqueue_deque_push(threadqueue_deque_t *deque,
+                                  threadqueue_job_t *job)
 {
-  threadqueue_queue_t * const threadqueue = (threadqueue_queue_t *) threadqueue_opaque;
+  const int64_t bottom = deque->bottom;
+  const int64_t top = KVZ_ATOMIC_LOAD(&deque->top);
+  if (bottom - top >= THREADQUEUE_DEQUE_SIZE) {
+    return 0;
+  }
 
-  PTHREAD_LOCK(&threadqueue->lock);
+  deque->jobs[bottom & (THREADQUEUE_DEQUE_SIZE - 1)] = job;
+  KVZ_ATOMIC_STORE(&deque->bottom, bottom + 1);
+  return 1;
+}
 
-  for (;;) {
-    while (!threadqueue->stop && threadqueue->first == NULL) {
-      // Wait until there is something to do in the queue.
-      PTHREAD_COND_WAIT(&threadqueue->job_available, &threadqueue->lock);
+
+/**
+ * \brief Pop a job from the bottom of a deque.
+ *
+ * Must only be called by the thread owning the deque.
+ *
+ * \return the job, or NULL if the deque is empty
+ */
+static threadqueue_job_t * threadqueue_deque_pop(threadqueue_deque_t *deque)
+{
+  const int64_t bottom = deque->bottom - 1;
+  deque->bottom = bottom;
+  // The store to bottom must be visible before top is read, or a thief
+  // could take the same job.
+  KVZ_ATOMIC_FENCE();
+  const int64_t top = deque->top;
+
+  if (top > bottom) {
+    // Empty.
+    deque->bottom = bottom + 1;
+    return NULL;
+  }
+
+  threadqueue_job_t *job = deque->jobs[bottom & (THREADQUEUE_DEQUE_SIZE - 1)];
+  if (top == bottom) {
+    // Last job in the deque. Race against thieves for it.
+    if (!KVZ_ATOMIC_CAS64(&deque->top, top, top + 1)) {
+      job = NULL;
+    }
+    deque->bottom = bottom + 1;
+  }
+  return job;
+}
+
+
+/**
+ * \brief Steal a job from the top of a deque.
+ *
+ * \return the job, or NULL if the deque is empty or another thread got
+ *         the job first
+ */
+static threadqueue_job_t * threadqueue_deque_steal(threadqueue_deque_t *deque)
+{
+  const int64_t top = KVZ_ATOMIC_LOAD(&deque->top);
+  KVZ_ATOMIC_FENCE();
+  const int64_t bottom = KVZ_ATOMIC_LOAD(&deque->bottom);
+
+  if (top >= bottom) {
+    return NULL;
+  }
+
+  threadqueue_job_t *job = deque->jobs[top & (THREADQUEUE_DEQUE_SIZE - 1)];
+  if (!KVZ_ATOMIC_CAS64(&deque->top, top, top + 1)) {
+    return NULL;
+  }
+  return job;
+}
+
+
+/**
+ * \brief Get a ready job for a worker without blocking.
+ *
+ * For each priority, starting from the highest, tries the deque of the
+ * worker first, then the deques of the other workers and finally the
+ * global queue. The calling function receives the ownership of the job.
+ *
+ * \return the job, or NULL if no job was found
+ */
+static threadqueue_job_t * threadqueue_find_job(threadqueue_worker_t *worker)
+{
+  threadqueue_queue_t * const threadqueue = worker->threadqueue;
+
+  for (int lane = THREADQUEUE_JOB_PRIORITY_COUNT - 1; lane >= 0; --lane) {
+    threadqueue_job_t *job = threadqueue_deque_pop(&worker->deques[lane]);
+
+    for (int i = 1; !job && i < threadqueue->thread_count; ++i) {
+      const int victim = (worker->id + i) % threadqueue->thread_count;
+      job = threadqueue_deque_steal(&threadqueue->workers[victim].deques[lane]);
+    }
+
+    if (job) {
+      KVZ_ATOMIC_DEC(&threadqueue->ready_count);
+      return job;
+    }
+
+    if (threadqueue->first[lane] != NULL) {
+      PTHREAD_LOCK(&threadqueue->lock);
+      if (threadqueue->first[lane] != NULL) {
+        job = threadqueue_pop_job(threadqueue, lane);
+      }
+      PTHREAD_UNLOCK(&threadqueue->lock);
+      if (job) {
+        return job;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+
+/**
+ * \brief Make jobs that have become ready available to the workers.
+ *
+ * The jobs are pushed to the deque of the worker so that it will continue
+ * with them. Other workers are woken up to steal the rest. This function
+ * takes the ownership of the jobs.
+ *
+ * \return 1 on success, 0 on failure
+ */
+static int threadqueue_push_ready_jobs(threadqueue_worker_t *worker,
+                                       threadqueue_job_t **jobs,
+                                       int num_jobs)
+{
+  threadqueue_queue_t * const threadqueue = worker->threadqueue;
+  bool overflow = false;
+
+  // Push in reverse order so that the owner pops the jobs in the order
+  // they were given and thieves take the ones at the end.
+  for (int i = num_jobs - 1; i >= 0; --i) {
+    // Count the job before it becomes visible so that no worker goes to
+    // sleep while it is in the deque.
+    KVZ_ATOMIC_INC(&threadqueue->ready_count);
+    if (!threadqueue_deque_push(&worker->deques[jobs[i]->priority], jobs[i])) {
+      KVZ_ATOMIC_DEC(&threadqueue->ready_count);
+      PTHREAD_LOCK(&threadqueue->lock);
+      threadqueue_push_job(threadqueue, jobs[i]);
+      PTHREAD_UNLOCK(&threadqueue->lock);
+      overflow = true;
     }
+  }
 
-    if (threadqueue->stop) {
+  // The current thread will process one of the new jobs so we wake up
+  // one thread less than the number of new jobs.
+  const int32_t idle = KVZ_ATOMIC_LOAD(&threadqueue->thread_idle_count);
+  const int num_wakeups = MIN(idle, overflow ? num_jobs : num_jobs - 1);
+  if (num_wakeups > 0) {
+    PTHREAD_LOCK(&threadqueue->lock);
+    for (int i = 0; i < num_wakeups; i++) {
+      PTHREAD_COND_SIGNAL(&threadqueue->job_available);
+    }
+    PTHREAD_UNLOCK(&threadqueue->lock);
+  }
+
+  return 1;
+}
+
+
+/**
+ * \brief Function executed by worker threads.
+ */
+static void* threadqueue_worker(void* worker_opaque)
+{
+  threadqueue_worker_t * const worker = (threadqueue_worker_t *) worker_opaque;
+  threadqueue_queue_t * const threadqueue = worker->threadqueue;
+
+  KVZ_GET_TIME(&worker->trace_thread_start);
+
+  for (;;) {
+    if (KVZ_ATOMIC_LOAD(&threadqueue->stop)) {
       break;
     }
 
-    // Get a job and remove it from the queue.
-    threadqueue_job_t *job = threadqueue_pop_job(threadqueue);
+    threadqueue_job_t *job = threadqueue_find_job(worker);
+
+    if (job == NULL) {
+      PTHREAD_LOCK(&threadqueue->lock);
+      // Announce that we are about to sleep before checking for jobs.
+      // Threads making jobs ready check thread_idle_count after counting
+      // the jobs, so either they see us or we see their jobs.
+      KVZ_ATOMIC_INC(&threadqueue->thread_idle_count);
+      while (!threadqueue->stop && KVZ_ATOMIC_LOAD(&threadqueue->ready_count) <= 0) {
+        // Wait until there is something to do in the queue.
+        PTHREAD_COND_WAIT(&threadqueue->job_available, &threadqueue->lock);
+      }
+      KVZ_ATOMIC_DEC(&threadqueue->thread_idle_count);
+      PTHREAD_UNLOCK(&threadqueue->lock);
+      continue;
+    }
 
-    PTHREAD_LOCK(&job->lock);
     assert(job->state == THREADQUEUE_JOB_STATE_READY);
     job->state = THREADQUEUE_JOB_STATE_RUNNING;
-    PTHREAD_UNLOCK(&job->lock);
-    PTHREAD_UNLOCK(&threadqueue->lock);
+
+    // Tracing is started after the threads, so check it for every job.
+    const bool trace = KVZ_ATOMIC_LOAD(&threadqueue->trace_file) != NULL;
+    KVZ_CLOCK_T start, stop;
+    if (trace) KVZ_GET_TIME(&start);
 
     job->fptr(job->arg);
 
-    PTHREAD_LOCK(&threadqueue->lock);
+    if (trace) KVZ_GET_TIME(&stop);
+
+    // Take the reverse dependencies. No dependencies can be added to a job
+    // that is done, so the array can be used after unlocking the job.
     PTHREAD_LOCK(&job->lock);
     assert(job->state == THREADQUEUE_JOB_STATE_RUNNING);
     job->state = THREADQUEUE_JOB_STATE_DONE;
 
+    threadqueue_job_t **rdepends = job->rdepends;
+    const int rdepends_count = job->rdepends_count;
+    job->rdepends = NULL;
+    job->rdepends_count = 0;
+    job->rdepends_size = 0;
+
     PTHREAD_COND_SIGNAL(&threadqueue->job_done);
+    PTHREAD_UNLOCK(&job->lock);
 
     // Go through all the jobs that depend on this one, decreasing their
-    // ndepends. Count how many jobs can now start executing so we know how
-    // many threads to wake up.
+    // ndepends. The jobs that can now start executing are collected to the
+    // beginning of rdepends.
     int num_new_jobs = 0;
-    for (int i = 0; i < job->rdepends_count; ++i) {
-      threadqueue_job_t * const depjob = job->rdepends[i];
-      // The dependency (job) is locked before the job depending on it.
-      // This must be the same order as in kvz_threadqueue_job_dep_add.
-      PTHREAD_LOCK(&depjob->lock);
-
-      assert(depjob->state == THREADQUEUE_JOB_STATE_WAITING ||
-             depjob->state == THREADQUEUE_JOB_STATE_PAUSED);
-      assert(depjob->ndepends > 0);
-      depjob->ndepends--;
-
-      if (depjob->ndepends == 0 && depjob->state == THREADQUEUE_JOB_STATE_WAITING) {
-        // Move the job to ready jobs.
-        threadqueue_push_job(threadqueue, kvz_threadqueue_copy_ref(depjob));
-        num_new_jobs++;
+    for (int i = 0; i < rdepends_count; ++i) {
+      threadqueue_job_t *depjob = rdepends[i];
+      rdepends[i] = NULL;
+
+      if (trace) {
+        threadqueue_trace_event_t *event = threadqueue_trace_event(threadqueue, &worker->trace, false);
+        event->type = THREADQUEUE_TRACE_EVENT_DEP;
+        event->id = job->trace_id;
+        event->rdepend_id = depjob->trace_id;
       }
 
-      // Clear this reference to the job.
-      PTHREAD_UNLOCK(&depjob->lock);
-      kvz_threadqueue_free_job(&job->rdepends[i]);
+      const int32_t ndepends = KVZ_ATOMIC_DEC(&depjob->ndepends);
+      assert(ndepends >= 0);
+      if (ndepends == 0) {
+        // Keep the reference for the queue.
+        assert(depjob->state == THREADQUEUE_JOB_STATE_WAITING);
+        depjob->state = THREADQUEUE_JOB_STATE_READY;
+        rdepends[num_new_jobs++] = depjob;
+      } else {
+        // Clear this reference to the job.
+        kvz_threadqueue_free_job(&depjob);
+      }
     }
-    job->rdepends_count = 0;
 
-    PTHREAD_UNLOCK(&job->lock);
-    kvz_threadqueue_free_job(&job);
+    if (num_new_jobs > 0) {
+      threadqueue_push_ready_jobs(worker, rdepends, num_new_jobs);
+    }
+    FREE_POINTER(rdepends);
 
-    // The current thread will process one of the new jobs so we wake up
-    // one threads less than the the number of new jobs.
-    for (int i = 0; i < num_new_jobs - 1; i++) {
-      pthread_cond_signal(&threadqueue->job_available);
+    if (trace) {
+      threadqueue_trace_job(threadqueue, &worker->trace, false, job, worker->id, &start, &stop);
     }
+
+    kvz_threadqueue_free_job(&job);
   }
 
+  KVZ_GET_TIME(&worker->trace_thread_stop);
+
+  PTHREAD_LOCK(&threadqueue->lock);
   threadqueue->thread_running_count--;
   PTHREAD_UNLOCK(&threadqueue->lock);
   return NULL;
@@ -348,6 +796,12 @@ threadqueue_queue_t * kvz_threadqueue_init(int thread_count)
   if (!threadqueue) {
     goto failed;
   }
+  threadqueue->threads = NULL;
+  threadqueue->workers = NULL;
+  threadqueue->thread_count = 0;
+  threadqueue->trace_file = NULL;
+  threadqueue->trace_shared.events = NULL;
+  threadqueue->trace_shared.count = 0;
 
   if (pthread_mutex_init(&threadqueue->lock, NULL) != 0) {
     fprintf(stderr, "pthread_mutex_init failed!\n");
@@ -364,27 +818,55 @@ threadqueue_queue_t * kvz_threadqueue_init(int thread_count)
     goto failed;
   }
 
+  if (pthread_mutex_init(&threadqueue->trace_lock, NULL) != 0) {
+    fprintf(stderr, "pthread_mutex_init failed!\n");
+    goto failed;
+  }
+
   threadqueue->threads = MALLOC(pthread_t, thread_count);
   if (!threadqueue->threads) {
     fprintf(stderr, "Could not malloc threadqueue->threads!\n");
     goto failed;
   }
+  threadqueue->workers = MALLOC(threadqueue_worker_t, thread_count);
+  if (!threadqueue->workers) {
+    fprintf(stderr, "Could not malloc threadqueue->workers!\n");
+    goto failed;
+  }
+  for (int i = 0; i < thread_count; i++) {
+    threadqueue->workers[i].threadqueue  = threadqueue;
+    threadqueue->workers[i].id           = i;
+    threadqueue->workers[i].trace.events = NULL;
+    threadqueue->workers[i].trace.count  = 0;
+    for (int lane = 0; lane < THREADQUEUE_JOB_PRIORITY_COUNT; lane++) {
+      threadqueue->workers[i].deques[lane].top    = 0;
+      threadqueue->workers[i].deques[lane].bottom = 0;
+    }
+  }
   threadqueue->thread_count = 0;
   threadqueue->thread_running_count = 0;
+  threadqueue->thread_idle_count = 0;
+  threadqueue->ready_count = 0;
 
   threadqueue->stop = false;
 
-  threadqueue->first              = NULL;
-  threadqueue->last               = NULL;
+  for (int lane = 0; lane < THREADQUEUE_JOB_PRIORITY_COUNT; lane++) {
+    threadqueue->first[lane] = NULL;
+    threadqueue->last[lane]  = NULL;
+  }
 
   // Lock the queue before creating threads, to ensure they all have correct information.
   PTHREAD_LOCK(&threadqueue->lock);
+  // Workers steal from thread_count deques, so it must be set before any
+  // of them start.
+  threadqueue->thread_count = thread_count;
   for (int i = 0; i < thread_count; i++) {
-    if (pthread_create(&threadqueue->threads[i], NULL, threadqueue_worker, threadqueue) != 0) {
+    if (pthread_create(&threadqueue->threads[i], NULL, threadqueue_worker, &threadqueue->workers[i]) != 0) {
         fprintf(stderr, "pthread_create failed!\n");
+        threadqueue->thread_count = i;
+        PTHREAD_UNLOCK(&threadqueue->lock);
         goto failed;
     }
-    threadqueue->thread_count++;
     threadqueue->thread_running_count++;
   }
   PTHREAD_UNLOCK(&threadqueue->lock);
@@ -419,36 +901,89 @@ threadqueue_job_t * kvz_threadqueue_job_create(void (*fptr)(void *arg), void *ar
   }
 
   job->state = THREADQUEUE_JOB_STATE_PAUSED;
-  job->ndepends       = 0;
+  job->ndepends       = 1;
   job->rdepends       = NULL;
   job->rdepends_count = 0;
   job->rdepends_size  = 0;
   job->refcount       = 1;
+  job->priority       = THREADQUEUE_JOB_PRIORITY_NORMAL;
   job->fptr           = fptr;
   job->arg            = arg;
+  job->trace_id       = KVZ_ATOMIC_INC(&threadqueue_job_count);
+  job->trace_description[0] = '\0';
 
   return job;
 }
 
 
+/**
+ * \brief Set the description of a job in the trace log.
+ *
+ * The description should be a comma-separated list of key=value pairs,
+ * e.g. "type=lcu,layer=0,position_x=1,position_y=2". Does nothing unless
+ * tracing has been started.
+ */
+void kvz_threadqueue_job_describe(const threadqueue_queue_t *threadqueue,
+                                  threadqueue_job_t *job,
+                                  const char *format, ...)
+{
+  if (threadqueue->trace_file == NULL) return;
+
+  va_list args;
+  va_start(args, format);
+  vsnprintf(job->trace_description, sizeof(job->trace_description), format, args);
+  va_end(args);
+}
+
+
+/**
+ * \brief Set the scheduling priority of a job.
+ *
+ * Must be called before the job is submitted.
+ */
+void kvz_threadqueue_job_set_priority(threadqueue_job_t *job, threadqueue_job_priority priority)
+{
+  assert(job->state == THREADQUEUE_JOB_STATE_PAUSED);
+  assert(priority >= 0 && priority < THREADQUEUE_JOB_PRIORITY_COUNT);
+  job->priority = priority;
+}
+
+
 int kvz_threadqueue_submit(threadqueue_queue_t * const threadqueue, threadqueue_job_t *job)
 {
-  PTHREAD_LOCK(&threadqueue->lock);
-  PTHREAD_LOCK(&job->lock);
   assert(job->state == THREADQUEUE_JOB_STATE_PAUSED);
 
+  const bool trace = threadqueue->trace_file != NULL;
+  if (trace) KVZ_GET_TIME(&job->trace_enqueue);
+
   if (threadqueue->thread_count == 0) {
     // When not using threads, run the job immediately.
     job->fptr(job->arg);
+    KVZ_CLOCK_T stop;
+    if (trace) KVZ_GET_TIME(&stop);
+
+    PTHREAD_LOCK(&job->lock);
     job->state = THREADQUEUE_JOB_STATE_DONE;
-  } else if (job->ndepends == 0) {
+    PTHREAD_UNLOCK(&job->lock);
+
+    if (trace) {
+      PTHREAD_LOCK(&threadqueue->trace_lock);
+      threadqueue_trace_job(threadqueue, &threadqueue->trace_shared, true,
+                            job, 0, &job->trace_enqueue, &stop);
+      PTHREAD_UNLOCK(&threadqueue->trace_lock);
+    }
+    return 1;
+  }
+
+  job->state = THREADQUEUE_JOB_STATE_WAITING;
+
+  // Release the dependency held since the job was created.
+  if (KVZ_ATOMIC_DEC(&job->ndepends) == 0) {
+    PTHREAD_LOCK(&threadqueue->lock);
     threadqueue_push_job(threadqueue, kvz_threadqueue_copy_ref(job));
-    pthread_cond_signal(&threadqueue->job_available);
-  } else {
-    job->state = THREADQUEUE_JOB_STATE_WAITING;
+    PTHREAD_COND_SIGNAL(&threadqueue->job_available);
+    PTHREAD_UNLOCK(&threadqueue->lock);
   }
-  PTHREAD_UNLOCK(&job->lock);
-  PTHREAD_UNLOCK(&threadqueue->lock);
 
   return 1;
 }
@@ -465,8 +1000,6 @@ int kvz_threadqueue_submit(threadqueue_queue_t * const threadqueue, threadqueue_
  */
 int kvz_threadqueue_job_dep_add(threadqueue_job_t *job, threadqueue_job_t *dependency)
 {
-  // Lock the dependency first and then the job depending on it.
-  // This must be the same order as in threadqueue_worker.
   PTHREAD_LOCK(&dependency->lock);
 
   if (dependency->state == THREADQUEUE_JOB_STATE_DONE) {
@@ -475,9 +1008,17 @@ int kvz_threadqueue_job_dep_add(threadqueue_job_t *job, threadqueue_job_t *depen
     return 1;
   }
 
-  PTHREAD_LOCK(&job->lock);
-  job->ndepends++;
-  PTHREAD_UNLOCK(&job->lock);
+  // Only count the dependency if the job is not ready yet. Once ndepends
+  // has reached zero, the job may already be running and the dependency
+  // can no longer be honoured.
+  int32_t ndepends;
+  do {
+    ndepends = KVZ_ATOMIC_LOAD(&job->ndepends);
+    if (ndepends == 0) {
+      PTHREAD_UNLOCK(&dependency->lock);
+      return 1;
+    }
+  } while (!KVZ_ATOMIC_CAS(&job->ndepends, ndepends, ndepends + 1));
 
   // Add the reverse dependency
   if (dependency->rdepends_count >= dependency->rdepends_size) {
@@ -593,6 +1134,76 @@ int kvz_threadqueue_stop(threadqueue_queue_t * const threadqueue)
 }
 
 
+/**
+ * \brief Start writing a trace of the executed jobs to a file.
+ *
+ * Must be called before any jobs are submitted. The log is completed when
+ * the queue is freed.
+ *
+ * \return 1 on success, 0 on failure
+ */
+int kvz_threadqueue_trace_start(threadqueue_queue_t * const threadqueue, const char *filename)
+{
+  assert(threadqueue->trace_file == NULL);
+
+  for (int i = 0; i < threadqueue->thread_count; i++) {
+    threadqueue->workers[i].trace.events = MALLOC(threadqueue_trace_event_t, THREADQUEUE_TRACE_BUFFER_SIZE);
+    if (!threadqueue->workers[i].trace.events) {
+      fprintf(stderr, "Could not malloc threadqueue trace buffer!\n");
+      return 0;
+    }
+  }
+  threadqueue->trace_shared.events = MALLOC(threadqueue_trace_event_t, THREADQUEUE_TRACE_BUFFER_SIZE);
+  if (!threadqueue->trace_shared.events) {
+    fprintf(stderr, "Could not malloc threadqueue trace buffer!\n");
+    return 0;
+  }
+
+  FILE *file = fopen(filename, "w");
+  if (!file) {
+    fprintf(stderr, "Could not open threadqueue log file %s!\n", filename);
+    return 0;
+  }
+  KVZ_ATOMIC_STORE(&threadqueue->trace_file, file);
+
+  return 1;
+}
+
+
+/**
+ * \brief Write the remaining trace events and close the trace log.
+ *
+ * The threads must have been stopped.
+ */
+static void threadqueue_trace_stop(threadqueue_queue_t * const threadqueue)
+{
+  if (threadqueue->trace_file != NULL) {
+    for (int i = 0; i < threadqueue->thread_count; i++) {
+      const threadqueue_worker_t *worker = &threadqueue->workers[i];
+      threadqueue_trace_write(threadqueue, &threadqueue->workers[i].trace);
+      fprintf(threadqueue->trace_file, "\t%d\t-\t%lf\t+%lf\t-\tthread\n",
+              worker->id,
+              KVZ_CLOCK_T_AS_DOUBLE(worker->trace_thread_start),
+              KVZ_CLOCK_T_DIFF(worker->trace_thread_start, worker->trace_thread_stop));
+    }
+    threadqueue_trace_write(threadqueue, &threadqueue->trace_shared);
+
+    // The plotting script resolves the dependencies on a flush.
+    KVZ_CLOCK_T now;
+    KVZ_GET_TIME(&now);
+    fprintf(threadqueue->trace_file, "\t\t-\t-\t%lf\t-\tFLUSH\n", KVZ_CLOCK_T_AS_DOUBLE(now));
+
+    fclose(threadqueue->trace_file);
+    threadqueue->trace_file = NULL;
+  }
+
+  for (int i = 0; i < threadqueue->thread_count; i++) {
+    FREE_POINTER(threadqueue->workers[i].trace.events);
+  }
+  FREE_POINTER(threadqueue->trace_shared.events);
+}
+
+
 /**
  * \brief Stop all threads and free allocated resources.
  *
@@ -605,14 +1216,26 @@ void kvz_threadqueue_free(threadqueue_queue_t *threadqueue)
   kvz_threadqueue_stop(threadqueue);
 
   // Free all jobs.
-  while (threadqueue->first) {
-    threadqueue_job_t *next = threadqueue->first->next;
-    kvz_threadqueue_free_job(&threadqueue->first);
-    threadqueue->first = next;
+  for (int lane = 0; lane < THREADQUEUE_JOB_PRIORITY_COUNT; lane++) {
+    while (threadqueue->first[lane]) {
+      threadqueue_job_t *next = threadqueue->first[lane]->next;
+      kvz_threadqueue_free_job(&threadqueue->first[lane]);
+      threadqueue->first[lane] = next;
+    }
+    threadqueue->last[lane] = NULL;
+
+    for (int i = 0; i < threadqueue->thread_count; i++) {
+      threadqueue_job_t *job;
+      while ((job = threadqueue_deque_pop(&threadqueue->workers[i].deques[lane])) != NULL) {
+        kvz_threadqueue_free_job(&job);
+      }
+    }
   }
-  threadqueue->last = NULL;
+
+  threadqueue_trace_stop(threadqueue);
 
   FREE_POINTER(threadqueue->threads);
+  FREE_POINTER(threadqueue->workers);
   threadqueue->thread_count = 0;
 
   if (pthread_mutex_destroy(&threadqueue->lock) != 0) {
@@ -627,5 +1250,9 @@ void kvz_threadqueue_free(threadqueue_queue_t *threadqueue)
     fprintf(stderr, "pthread_cond_destroy failed!\n");
   }
 
+  if (pthread_mutex_destroy(&threadqueue->trace_lock) != 0) {
+    fprintf(stderr, "pthread_mutex_destroy failed!\n");
+  }
+
   FREE_POINTER(threadqueue);
 }
@@ -33,9 +33,24 @@
 typedef struct threadqueue_job_t threadqueue_job_t;
 typedef struct threadqueue_queue_t threadqueue_queue_t;
 
+/**
+ * \brief Scheduling priority of a job.
+ *
+ * Ready jobs of a higher priority are always started before ready jobs of
+ * a lower priority. Within a priority, a worker prefers the jobs it made
+ * ready itself.
+ */
+typedef enum {
+  THREADQUEUE_JOB_PRIORITY_NORMAL = 0,
+  THREADQUEUE_JOB_PRIORITY_HIGH   = 1,
+  THREADQUEUE_JOB_PRIORITY_COUNT
+} threadqueue_job_priority;
+
 threadqueue_queue_t * kvz_threadqueue_init(int thread_count);
 
 threadqueue_job_t * kvz_threadqueue_job_create(void (*fptr)(void *arg), void *arg);
+void kvz_threadqueue_job_set_priority(threadqueue_job_t *job, threadqueue_job_priority priority);
+void kvz_threadqueue_job_describe(const threadqueue_queue_t *threadqueue, threadqueue_job_t *job, const char *format, ...);
 int kvz_threadqueue_submit(threadqueue_queue_t * threadqueue, threadqueue_job_t *job);
 
 int kvz_threadqueue_job_dep_add(threadqueue_job_t *job, threadqueue_job_t *dependency);
@@ -46,6 +61,7 @@ void kvz_threadqueue_free_job(threadqueue_job_t **job_ptr);
 
 int kvz_threadqueue_waitfor(threadqueue_queue_t * threadqueue, threadqueue_job_t * job);
 int kvz_threadqueue_stop(threadqueue_queue_t * threadqueue);
+int kvz_threadqueue_trace_start(threadqueue_queue_t * threadqueue, const char *filename);
 void kvz_threadqueue_free(threadqueue_queue_t * threadqueue);
 
 #endif // THREADQUEUE_H_
@@ -56,6 +56,13 @@
 #define KVZ_ATOMIC_INC(ptr)                     __sync_add_and_fetch((volatile int32_t*)ptr, 1)
 #define KVZ_ATOMIC_DEC(ptr)                     __sync_add_and_fetch((volatile int32_t*)ptr, -1)
 
+// Helpers for the lock-free parts of the thread queue.
+#define KVZ_ATOMIC_LOAD(ptr)                    __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define KVZ_ATOMIC_STORE(ptr, val)              __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define KVZ_ATOMIC_CAS(ptr, expected, desired)  __sync_bool_compare_and_swap((volatile int32_t*)(ptr), (expected), (desired))
+#define KVZ_ATOMIC_CAS64(ptr, expected, desired) __sync_bool_compare_and_swap((volatile int64_t*)(ptr), (expected), (desired))
+#define KVZ_ATOMIC_FENCE()                      __sync_synchronize()
+
 #else //__GNUC__
 //TODO: we assume !GCC => Windows... this may be bad
 #include <windows.h> // IWYU pragma: export
@@ -70,6 +77,14 @@
 #define KVZ_ATOMIC_INC(ptr)                     InterlockedIncrement((volatile LONG*)ptr)
 #define KVZ_ATOMIC_DEC(ptr)                     InterlockedDecrement((volatile LONG*)ptr)
 
+// Aligned loads and stores are atomic on x86. The barriers keep the
+// compiler and the CPU from reordering them.
+#define KVZ_ATOMIC_LOAD(ptr)                    (MemoryBarrier(), *(ptr))
+#define KVZ_ATOMIC_STORE(ptr, val)              { MemoryBarrier(); *(ptr) = (val); }
+#define KVZ_ATOMIC_CAS(ptr, expected, desired)  (InterlockedCompareExchange((volatile LONG*)(ptr), (desired), (expected)) == (expected))
+#define KVZ_ATOMIC_CAS64(ptr, expected, desired) (InterlockedCompareExchange64((volatile LONG64*)(ptr), (desired), (expected)) == (expected))
+#define KVZ_ATOMIC_FENCE()                      MemoryBarrier()
+
 #endif //__GNUC__
 
 #ifdef __APPLE__
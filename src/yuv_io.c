@@ -25,6 +25,12 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "yuv_io.h"
 
 static void fill_after_frame(unsigned height, unsigned array_width,
@@ -68,25 +74,38 @@ static int read_and_fill_frame_data(FILE *file,
 }
 
 
-static void swap_16b_buffer_bytes(kvz_pixel* input, int size)
-{
-  for (int i = 0; i < size; ++i) {
-    input[i] = ((input[i] & 0xff) << 8) + ((input[i] & 0xff00) >> 8);
-  }
-}
-
-
-static void shift_to_bitdepth(kvz_pixel* input, int size, int from_bitdepth, int to_bitdepth)
+/**
+ * \brief Convert samples read from a file to the output bit depth.
+ *
+ * Byte swapping, discarding the bits above from_bitdepth and shifting to
+ * to_bitdepth are done in a single pass over the samples.
+ */
+static void convert_to_bitdepth(kvz_pixel *input,
+                                unsigned size,
+                                unsigned from_bitdepth,
+                                unsigned to_bitdepth,
+                                bool swap_bytes)
 {
-  int shift = to_bitdepth - from_bitdepth;
-  kvz_pixel bitdepth_mask = (1 << from_bitdepth) - 1;
-
-  for (int i = 0; i < size; ++i) {
-    // Shifting by a negative number is undefined.
-    if (shift > 0) {
-      input[i] = (input[i] & bitdepth_mask) << shift;
-    } else {
-      input[i] = (input[i] & bitdepth_mask) >> shift;
+  const kvz_pixel bitdepth_mask = (1 << from_bitdepth) - 1;
+  // Shifting by a negative number is undefined.
+  const int left_shift = MAX(0, (int)to_bitdepth - (int)from_bitdepth);
+  const int right_shift = MAX(0, (int)from_bitdepth - (int)to_bitdepth);
+
+  if (swap_bytes) {
+    for (unsigned i = 0; i < size; ++i) {
+      const kvz_pixel swapped = (input[i] << 8) | (input[i] >> 8);
+      input[i] = ((swapped & bitdepth_mask) << left_shift) >> right_shift;
+    }
+  } else if (right_shift > 0) {
+    for (unsigned i = 0; i < size; ++i) {
+      input[i] = (input[i] & bitdepth_mask) >> right_shift;
+    }
+  } else {
+    // Compilers vectorize a variable shift with lanes wider than kvz_pixel,
+    // but a multiplication with lanes of kvz_pixel.
+    const kvz_pixel scale = 1 << left_shift;
+    for (unsigned i = 0; i < size; ++i) {
+      input[i] = (input[i] & bitdepth_mask) * scale;
     }
   }
 }
@@ -99,22 +118,24 @@ static void shift_to_bitdepth_and_spread(kvz_pixel *input,
                                          int to_bitdepth)
 {
   assert(sizeof(kvz_pixel) > 1);
-  int shift = to_bitdepth - from_bitdepth;
+  assert(to_bitdepth >= from_bitdepth);
+  const kvz_pixel scale = 1 << (to_bitdepth - from_bitdepth);
   unsigned char *byte_buf = (unsigned char *)input;
   kvz_pixel bitdepth_mask = (1 << from_bitdepth) - 1;
   
-  // Starting from the back of the 1-byte samples, copy each sample to it's
-  // place in the 2-byte per sample array, overwriting the bytes that have
-  // already been copied in the process.
-  // Even though the two pointers are aliased, this should work because the
-  // future values read through byte_buf poiner never change as a result of
-  // writing through input pointer.
-  for (int i = size - 1; i >= 0; --i) {
-    // Shifting by a negative number is undefined.
-    if (shift > 0) {
-      input[i] = (byte_buf[i] & bitdepth_mask) << shift;
-    } else {
-      input[i] = (byte_buf[i] & bitdepth_mask) >> shift;
+  // Starting from the back of the 1-byte samples, copy each block of samples
+  // to it's place in the 2-byte per sample array, overwriting the bytes that
+  // have already been copied in the process. Each block goes through a
+  // temporary buffer, so that the loop converting it has no aliasing and can
+  // be vectorized. The samples not yet converted are never overwritten,
+  // because they are before the destination of the current block.
+  unsigned char block[64];
+  for (int start = size; start > 0; ) {
+    const int count = MIN(start, (int)sizeof(block));
+    start -= count;
+    memcpy(block, &byte_buf[start], count);
+    for (int i = 0; i < count; ++i) {
+      input[start + i] = (block[i] & bitdepth_mask) * scale;
     }
   }
 }
@@ -133,15 +154,6 @@ static bool machine_is_big_endian()
 }
 
 
-static void mask_to_bitdepth(kvz_pixel *buf, unsigned length, unsigned bitdepth)
-{
-  kvz_pixel bitdepth_mask = (1 << bitdepth) - 1;
-  for (int i = 0; i < length; ++i) {
-    buf[i] = buf[i] & bitdepth_mask;
-  }
-}
-
-
 static int yuv_io_read_plane(
     FILE* file,
     unsigned in_width, unsigned in_height, unsigned in_bitdepth,
@@ -166,22 +178,16 @@ static int yuv_io_read_plane(
     fill_after_frame(in_height, out_width, out_height, out_buf);
   }
 
-  if (in_bitdepth > 8) {
-    // Assume little endian input.
-    if (machine_is_big_endian()) {
-      swap_16b_buffer_bytes(out_buf, out_length);
-    }
-  }
+  // Assume little endian input.
+  const bool swap_bytes = in_bitdepth > 8 && machine_is_big_endian();
 
   // Shift the data to the correct bitdepth.
   // Ignore any bits larger than in_bitdepth to guarantee ouput data will be
   // in the correct range.
   if (in_bitdepth <= 8 && out_bitdepth > 8) {
     shift_to_bitdepth_and_spread(out_buf, out_length, in_bitdepth, out_bitdepth);
-  } else if (in_bitdepth != out_bitdepth) {
-    shift_to_bitdepth(out_buf, out_length, in_bitdepth, out_bitdepth);
-  } else if (in_bitdepth % 8 != 0) {
-    mask_to_bitdepth(out_buf, out_length, out_bitdepth);
+  } else if (swap_bytes || in_bitdepth != out_bitdepth || in_bitdepth % 8 != 0) {
+    convert_to_bitdepth(out_buf, out_length, in_bitdepth, out_bitdepth, swap_bytes);
   }
 
   return 1;
@@ -277,6 +283,117 @@ int yuv_io_seek(FILE* file, unsigned frames,
 }
 
 
+/**
+ * \brief Map an input file to memory.
+ *
+ * The mapping is private, so the mapped data can be modified without
+ * affecting the file.
+ *
+ * \param file          the input file
+ * \param map           returns the mapping
+ *
+ * \return              1 on success, 0 if the file could not be mapped
+ */
+int yuv_io_map(FILE* file, yuv_io_map_t *map)
+{
+  map->data = NULL;
+  map->size = 0;
+
+#ifndef _WIN32
+  struct stat st;
+  if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode) ||
+      st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX) {
+    return 0;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fileno(file), 0);
+  if (data == MAP_FAILED) return 0;
+
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  map->data = data;
+  map->size = st.st_size;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+
+/**
+ * \brief Unmap an input file mapped with yuv_io_map.
+ */
+void yuv_io_unmap(yuv_io_map_t *map)
+{
+#ifndef _WIN32
+  if (map->data) {
+    munmap(map->data, map->size);
+  }
+#endif
+  map->data = NULL;
+  map->size = 0;
+}
+
+
+/**
+ * \brief Get the next frame of a mapped file without reading it.
+ *
+ * Works only if the frame can be used as is, i.e. the bit depths are equal,
+ * samples are whole bytes of the size of kvz_pixel in native byte order and
+ * there are at least KVZ_PICTURE_PADDING bytes of the file before and after
+ * the frame. The position of the file is moved past the frame.
+ *
+ * \param map           mapping of the file
+ * \param file          the input file
+ * \param width         width of the input video in pixels
+ * \param height        height of the input video in pixels
+ * \param chroma_format chroma format of the input video
+ *
+ * \return              pointer to the frame data, or NULL if the frame has
+ *                      to be read with yuv_io_read
+ */
+kvz_pixel * yuv_io_map_frame(const yuv_io_map_t *map, FILE* file,
+                             unsigned width, unsigned height,
+                             unsigned from_bitdepth, unsigned to_bitdepth,
+                             enum kvz_chroma_format chroma_format)
+{
+  if (!map->data ||
+      from_bitdepth != to_bitdepth ||
+      from_bitdepth % 8 != 0 ||
+      from_bitdepth / 8 != sizeof(kvz_pixel) ||
+      (sizeof(kvz_pixel) > 1 && machine_is_big_endian()) ||
+      (chroma_format != KVZ_CSP_400 && chroma_format != KVZ_CSP_420)) {
+    return NULL;
+  }
+
+  int64_t frame_bytes = (int64_t)width * height * sizeof(kvz_pixel);
+  if (chroma_format == KVZ_CSP_420) {
+    frame_bytes += frame_bytes / 2;
+  }
+
+#ifndef _WIN32
+  const int64_t pos = ftello(file);
+  if (pos < KVZ_PICTURE_PADDING ||
+      pos % sizeof(kvz_pixel) != 0 ||
+      pos + frame_bytes + KVZ_PICTURE_PADDING > map->size ||
+      fseeko(file, frame_bytes, SEEK_CUR) != 0) {
+    return NULL;
+  }
+
+  // Start reading the pages in before the encoder needs them.
+  const int64_t page_size = sysconf(_SC_PAGESIZE);
+  const int64_t page_start = pos - pos % page_size;
+  madvise(map->data + page_start, pos + frame_bytes - page_start,
+          MADV_WILLNEED);
+
+  return (kvz_pixel *)(map->data + pos);
+#else
+  return NULL;
+#endif
+}
+
+
 /**
  * \brief Write a single frame to a file.
  *
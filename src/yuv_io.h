@@ -39,6 +39,20 @@ int yuv_io_read(FILE* file,
 int yuv_io_seek(FILE* file, unsigned frames,
                 unsigned input_width, unsigned input_height);
 
+typedef struct yuv_io_map_t {
+  uint8_t *data;
+  int64_t size;
+} yuv_io_map_t;
+
+int yuv_io_map(FILE* file, yuv_io_map_t *map);
+
+void yuv_io_unmap(yuv_io_map_t *map);
+
+kvz_pixel * yuv_io_map_frame(const yuv_io_map_t *map, FILE* file,
+                             unsigned width, unsigned height,
+                             unsigned from_bitdepth, unsigned to_bitdepth,
+                             enum kvz_chroma_format chroma_format);
+
 int yuv_io_write(FILE* file,
                 const kvz_picture *img,
                 unsigned output_width, unsigned output_height);
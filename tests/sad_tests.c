@@ -320,6 +320,45 @@ TEST test_reg_sad_overflow(void)
 }
 
 
+TEST test_reg_sad_multi(void)
+{
+  static const int offsets[][2] = {
+    { 0, 0 }, { 1, 0 }, { 0, 1 }, { 3, 2 }, { 2, 5 }, { 7, 3 }, { 4, 4 }
+  };
+  const int num_blocks = sizeof(offsets) / sizeof(offsets[0]);
+  unsigned width = sad_test_env.width;
+  unsigned height = sad_test_env.height;
+  unsigned stride = 64;
+
+  const kvz_pixel *blocks[sizeof(offsets) / sizeof(offsets[0])];
+  unsigned results[sizeof(offsets) / sizeof(offsets[0])];
+  for (int i = 0; i < num_blocks; ++i) {
+    int x = MIN(offsets[i][0], 64 - (int)width);
+    int y = MIN(offsets[i][1], 64 - (int)height);
+    blocks[i] = &g_big_ref->y[y * stride + x];
+  }
+
+  sprintf(sad_test_env.msg, "%s(%ux%u):%s",
+          sad_test_env.strategy->type,
+          width,
+          height,
+          sad_test_env.strategy->strategy_name);
+
+  reg_sad_multi_func *tested_func = sad_test_env.tested_func;
+  // Check every number of blocks to cover the partially filled batches.
+  for (int num = 1; num <= num_blocks; ++num) {
+    tested_func(g_big_pic->y, blocks, num, width, height, stride, stride, results);
+    for (int i = 0; i < num; ++i) {
+      if (results[i] != simple_sad(g_big_pic->y, blocks[i], stride, width, height)) {
+        FAILm(sad_test_env.msg);
+      }
+    }
+  }
+
+  PASSm(sad_test_env.msg);
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 // TEST FIXTURES
 SUITE(sad_tests)
@@ -385,6 +424,31 @@ SUITE(sad_tests)
       RUN_TEST(test_reg_sad_overflow);
     }
   }
-  
+
+  for (volatile unsigned i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "reg_sad_multi") != 0) {
+      continue;
+    }
+
+    static const struct dimension {
+      int width;
+      int height;
+    } tested_dims[] = {
+      {64, 64}, {32, 32}, {16, 16}, {8, 8},
+      {64, 32}, {32, 64}, {32, 16}, {16, 32}, {16, 8}, {8, 16}, {8, 4}, {4, 8},
+      {48, 16}, {16, 48}, {24, 16}, {16, 24}, {12, 4}, {4, 12}, {16, 12}, {8, 12},
+      {64, 16}, {16, 4}, {8, 2}, {32, 3}, {16, 5}, {8, 3}
+    };
+
+    sad_test_env.tested_func = strategies.strategies[i].fptr;
+    sad_test_env.strategy = &strategies.strategies[i];
+    int num_dim_tests = sizeof(tested_dims) / sizeof(tested_dims[0]);
+    for (volatile int dim_test = 0; dim_test < num_dim_tests; ++dim_test) {
+      sad_test_env.width = tested_dims[dim_test].width;
+      sad_test_env.height = tested_dims[dim_test].height;
+      RUN_TEST(test_reg_sad_multi);
+    }
+  }
+
   tear_down_tests();
 }
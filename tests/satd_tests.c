@@ -38,6 +38,7 @@ static kvz_pixel * satd_bufs[NUM_TESTS][7][2];
 static struct {
   int log_width; // for selecting dim from satd_bufs
   cost_pixel_nxn_func * tested_func;
+  cost_pixel_nxn_multi_func * tested_multi_func;
 } satd_test_env;
 
 
@@ -159,6 +160,32 @@ TEST satd_test_gradient(void)
   PASS();
 }
 
+TEST satd_test_multi(void)
+{
+  const int satd_gradient_results[4] = {3140,9004,20481,67262};
+
+  const int test = 2;
+  const int size = 1 << (satd_test_env.log_width * 2);
+
+  kvz_pixel * orig = satd_bufs[test][satd_test_env.log_width][1];
+
+  // Alternate between a block differing from orig and orig itself. An odd
+  // number of blocks leaves a partial group for the SIMD versions.
+  kvz_pixel preds[7][32 * 32];
+  for (int i = 0; i < 7; ++i) {
+    memcpy(preds[i], satd_bufs[test][satd_test_env.log_width][i % 2], size * sizeof(kvz_pixel));
+  }
+
+  unsigned results[7];
+  satd_test_env.tested_multi_func(preds, orig, 7, results);
+
+  for (int i = 0; i < 7; ++i) {
+    ASSERT_EQ(results[i], i % 2 ? 0 : satd_gradient_results[satd_test_env.log_width - 2]);
+  }
+
+  PASS();
+}
+
 //////////////////////////////////////////////////////////////////////////
 // TEST FIXTURES
 SUITE(satd_tests)
@@ -185,6 +212,14 @@ SUITE(satd_tests)
     else if (strcmp(type, "satd_64x64") == 0) {
       satd_test_env.log_width = 6;
     }
+    else if (strncmp(type, "satd_", 5) == 0 && strstr(type, "_multi")) {
+      satd_test_env.log_width = strstr(type, "_4x4") ? 2 :
+                                strstr(type, "_8x8") ? 3 :
+                                strstr(type, "_16x16") ? 4 : 5;
+      satd_test_env.tested_multi_func = strategies.strategies[i].fptr;
+      RUN_TEST(satd_test_multi);
+      continue;
+    }
     else {
       continue;
     }
@@ -13,6 +13,7 @@ valgrind_test 264x130 10 $common_args --gop=8 -p1 --owf=4
 valgrind_test 264x130 10 $common_args --gop=lp-g4d3t1 -p5 --owf=4
 valgrind_test 264x130 10 $common_args --gop=8 -p8 --owf=4 --no-open-gop
 valgrind_test 264x130 30 $common_args --gop=8 -p16 --owf=16
+valgrind_test 264x130 20 $common_args --gop=8 -p16 --owf=4 --lookahead=4 --scene-cut
 # Do more extensive tests in a private gitlab CI runner
 if [ ! -z ${GITLAB_CI+x} ];then valgrind_test 264x130 20 $common_args --gop=8 -p8 --owf=0 --no-open-gop; fi
 if [ ! -z ${GITLAB_CI+x} ];then valgrind_test 264x130 40 $common_args --gop=8 -p32 --owf=4 --no-open-gop; fi
@@ -12,6 +12,8 @@ valgrind_test 264x130 10 $common_args -r1 --owf=1 --threads=0 --no-wpp
 valgrind_test 264x130 10 $common_args -r1 --owf=0 --threads=0 --no-wpp
 valgrind_test 264x130 10 $common_args -r2 --owf=1 --threads=2 --wpp
 valgrind_test 264x130 10 $common_args -r2 --owf=0 --threads=2 --no-wpp
+valgrind_test 264x130 10 $common_args -r2 --owf=1 --threads=2 --wpp --me-pyramid=2
+valgrind_test 264x130 10 $common_args -r2 --owf=1 --threads=2 --wpp --subme=4 --subpel-cache
 valgrind_test 264x130 10 $common_args -r2 --owf=1 --threads=2 --tiles-height-split=u2 --no-wpp
 valgrind_test 264x130 10 $common_args -r2 --owf=0 --threads=2 --tiles-height-split=u2 --no-wpp
 valgrind_test 512x512  3 $common_args -r2 --owf=1 --threads=2 --tiles=2x2 --no-wpp
@@ -14,3 +14,17 @@ valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=256x132 -q30 -r3 --
 #   Test without threads
 valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=256x132 -q30 -r3 --gop=0 --layer --preset=ultrafast -q28 -r0 --ilr=1 --gop=0 --threads=0 --owf=0
 valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=256x132 -q30 -r3 --gop=0 --layer --preset=ultrafast -q28 -r2 --ilr=1 --gop=0 --threads=0 --owf=0
+
+#   Test lossless base layer with interpolated reference planes
+valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=256x132 -r1 --gop=0 --lossless --subme=4 --subpel-cache --layer --preset=ultrafast -r1 --ilr=1 --gop=0 --threads=0 --owf=0
+
+#   Test cascaded downscaling
+valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=128x66 -q30 -r3 --gop=0 --cascade-scaling --downscaling-filter=3 --layer --preset=ultrafast --layer-res=256x132 -q28 -r2 --ilr=1 --gop=0
+
+#   Test ilr guided fast decision
+valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=256x132 -q30 -r3 --gop=0 --layer --preset=ultrafast -q28 -r2 --ilr=1 --gop=0 --ilr-fast-decision
+valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=256x132 -q30 -r3 --gop=0 --pu-depth-inter=3-3 --pu-depth-intra=3-3 --layer --preset=ultrafast -q28 -r2 --ilr=1 --gop=0 --pu-depth-inter=0-0 --pu-depth-intra=0-0 --ilr-fast-decision
+
+#   Test starting the motion search from the base layer mvs
+valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=256x132 -q30 -r3 --gop=0 --layer --preset=ultrafast -q28 -r2 --ilr=1 --gop=0 --me=hexbs --ilr-mv-start
+valgrind_test 512x264 20 --preset=ultrafast -p12 --layer-res=256x132 -q30 -r3 --gop=0 --layer --preset=ultrafast -q28 -r2 --ilr=1 --gop=0 --me=tz --ilr-mv-start
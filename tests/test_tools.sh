@@ -1,6 +1,6 @@
 #!/bin/sh
 
-# Test RDOQ, SAO, deblock and signhide and subme.
+# Test RDOQ, SAO, deblock, signhide, subme, picture hashes and mapped input.
 
 set -eu
 . "${0%/*}/util.sh"
@@ -10,3 +10,8 @@ common_args='264x130 10 -p0 -r1 --threads=2 --wpp --owf=1 --rd=0'
 valgrind_test $common_args --no-rdoq --no-deblock --no-sao --no-signhide --subme=1 --pu-depth-intra=2-3
 valgrind_test $common_args --no-rdoq --no-signhide --subme=0
 valgrind_test $common_args --rdoq --no-deblock --no-sao --subme=0
+valgrind_test $common_args --hash=md5
+valgrind_test 264x130 10 -p0 -r1 --threads=2 --tiles=2x2 --owf=1 --hash=crc
+# The height is a multiple of 8 so that the frames are used from the mapping.
+valgrind_test 264x136 10 -p0 -r1 --threads=2 --wpp --owf=1 --rd=0 --mmap-input
+valgrind_test 264x136 10 -p0 -r1 --threads=2 --wpp --owf=1 --rd=0 --mmap-input --lossless
@@ -28,6 +28,8 @@ extern SUITE(intra_sad_tests);
 extern SUITE(satd_tests);
 extern SUITE(speed_tests);
 extern SUITE(dct_tests);
+extern SUITE(work_tree_tests);
+extern SUITE(work_tree_speed_tests);
 #endif //KVZ_BIT_DEPTH == 8
 
 extern SUITE(coeff_sum_tests);
@@ -44,11 +46,13 @@ int main(int argc, char **argv)
   RUN_SUITE(intra_sad_tests);
   RUN_SUITE(satd_tests);
   RUN_SUITE(dct_tests);
+  RUN_SUITE(work_tree_tests);
 
   if (greatest_info.suite_filter &&
       greatest_name_match("speed", greatest_info.suite_filter))
   {
     RUN_SUITE(speed_tests);
+    RUN_SUITE(work_tree_speed_tests);
   }
 #else
   printf("10-bit tests are not yet supported\n");
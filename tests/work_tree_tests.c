@@ -0,0 +1,206 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (C) 2013-2015 Tampere University of Technology and others (see
+ * COPYING file).
+ *
+ * Kvazaar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1 as
+ * published by the Free Software Foundation.
+ *
+ * Kvazaar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Kvazaar.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+#include "src/search.c"
+#include "src/threads.h"
+
+#include <string.h>
+
+#include "greatest/greatest.h"
+
+// Time used for the per-CTU benchmark, in seconds.
+#define TIME_PER_TEST 1.0
+
+// Decisions of the emulated search, i.e. what ends up in the frame.
+static struct {
+  kvz_pixel y[LCU_LUMA_SIZE];
+  kvz_pixel u[LCU_CHROMA_SIZE];
+  int8_t depth[LCU_CU_WIDTH * LCU_CU_WIDTH];
+} decided;
+
+static char msg[1024];
+
+
+//////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+
+static kvz_pixel block_value(int x, int y, int depth)
+{
+  return (kvz_pixel)((x / 4) + (y / 4) * 16 + depth * 37);
+}
+
+static int should_split(unsigned seed, int x, int y, int depth)
+{
+  return depth < MAX_PU_DEPTH && ((seed + x * 7 + y * 13 + depth * 5) / 4) % 3 != 0;
+}
+
+static void init_work_tree(lcu_t *work_tree, int poison)
+{
+  FILL(work_tree[0], 0);
+  work_tree[0].rec.chroma_format = KVZ_CSP_420;
+  work_tree[0].ref.chroma_format = KVZ_CSP_420;
+  for (int depth = 1; depth <= MAX_PU_DEPTH; ++depth) {
+    if (poison) {
+      // Make sure nothing depends on the parts that are not copied.
+      memset(&work_tree[depth].rec, 0xAA, sizeof(work_tree[depth].rec));
+      memset(&work_tree[depth].coeff, 0xAA, sizeof(work_tree[depth].coeff));
+    }
+    work_tree_init_depth(&work_tree[0], &work_tree[depth]);
+  }
+}
+
+/**
+ * Check that the left and top neighbours of a CU at this level match the
+ * decisions made so far.
+ */
+static int neighbours_match(const lcu_t *lcu, int x, int y, int width)
+{
+  for (int i = 0; i < width; ++i) {
+    if (x > 0 && lcu->rec.y[(y + i) * LCU_WIDTH + x - 1] != decided.y[(y + i) * LCU_WIDTH + x - 1]) return 0;
+    if (y > 0 && lcu->rec.y[(y - 1) * LCU_WIDTH + x + i] != decided.y[(y - 1) * LCU_WIDTH + x + i]) return 0;
+  }
+  for (int i = 0; i < width / 2; ++i) {
+    const int left = (y / 2 + i) * LCU_WIDTH_C + x / 2 - 1;
+    const int top = (y / 2 - 1) * LCU_WIDTH_C + x / 2 + i;
+    if (x > 0 && lcu->rec.u[left] != decided.u[left]) return 0;
+    if (y > 0 && lcu->rec.u[top] != decided.u[top]) return 0;
+  }
+  for (int i = 0; i < width; i += SCU_WIDTH) {
+    if (x > 0 && LCU_GET_CU_AT_PX(lcu, x - 1, y + i)->depth != decided.depth[((y + i) / 4) * LCU_CU_WIDTH + (x - 1) / 4]) return 0;
+    if (y > 0 && LCU_GET_CU_AT_PX(lcu, x + i, y - 1)->depth != decided.depth[((y - 1) / 4) * LCU_CU_WIDTH + (x + i) / 4]) return 0;
+  }
+  return 1;
+}
+
+/**
+ * Emulate search_cu: write a prediction for the whole CU at this level,
+ * recurse and then copy the result up or down like the real search does.
+ *
+ * \return  number of CUs whose neighbours did not match the decisions
+ */
+static int emulate_search(lcu_t *work_tree, unsigned seed, int x, int y, int depth, int check)
+{
+  lcu_t *const lcu = &work_tree[depth];
+  const int width = LCU_WIDTH >> depth;
+  const kvz_pixel value = block_value(x, y, depth);
+  int errors = 0;
+
+  if (check && !neighbours_match(lcu, x, y, width)) {
+    errors++;
+  }
+
+  for (int i = 0; i < width; ++i) {
+    memset(&lcu->rec.y[(y + i) * LCU_WIDTH + x], value, width);
+  }
+  for (int i = 0; i < width / 2; ++i) {
+    memset(&lcu->rec.u[(y / 2 + i) * LCU_WIDTH_C + x / 2], value, width / 2);
+    memset(&lcu->rec.v[(y / 2 + i) * LCU_WIDTH_C + x / 2], value, width / 2);
+  }
+  for (int j = 0; j < width; j += SCU_WIDTH) {
+    for (int i = 0; i < width; i += SCU_WIDTH) {
+      LCU_GET_CU_AT_PX(lcu, x + i, y + j)->depth = depth > MAX_DEPTH ? MAX_DEPTH : depth;
+    }
+  }
+
+  if (should_split(seed, x, y, depth)) {
+    const int half = width / 2;
+    errors += emulate_search(work_tree, seed, x,        y,        depth + 1, check);
+    errors += emulate_search(work_tree, seed, x + half, y,        depth + 1, check);
+    errors += emulate_search(work_tree, seed, x,        y + half, depth + 1, check);
+    errors += emulate_search(work_tree, seed, x + half, y + half, depth + 1, check);
+    work_tree_copy_up(x, y, depth, work_tree);
+  } else {
+    if (check) {
+      for (int i = 0; i < width; ++i) {
+        memset(&decided.y[(y + i) * LCU_WIDTH + x], value, width);
+      }
+      for (int i = 0; i < width / 2; ++i) {
+        memset(&decided.u[(y / 2 + i) * LCU_WIDTH_C + x / 2], value, width / 2);
+      }
+      for (int j = 0; j < width; j += SCU_WIDTH) {
+        for (int i = 0; i < width; i += SCU_WIDTH) {
+          decided.depth[((y + j) / 4) * LCU_CU_WIDTH + (x + i) / 4] = depth > MAX_DEPTH ? MAX_DEPTH : depth;
+        }
+      }
+    }
+    if (depth > 0) {
+      work_tree_copy_down(x, y, depth, work_tree);
+    }
+  }
+
+  return errors;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// TESTS
+
+TEST work_tree_neighbours(void)
+{
+  static lcu_t work_tree[MAX_PU_DEPTH + 1];
+
+  for (unsigned seed = 0; seed < 64; ++seed) {
+    init_work_tree(work_tree, 1);
+    ASSERT_EQ(0, emulate_search(work_tree, seed, 0, 0, 0, 1));
+
+    // Everything decided must have been propagated to depth 0.
+    ASSERT_EQ(0, memcmp(work_tree[0].rec.y, decided.y, sizeof(decided.y)));
+    ASSERT_EQ(0, memcmp(work_tree[0].rec.u, decided.u, sizeof(decided.u)));
+    for (int i = 0; i < LCU_CU_WIDTH * LCU_CU_WIDTH; ++i) {
+      ASSERT_EQ(decided.depth[i], LCU_GET_CU_AT_PX(&work_tree[0], (i % LCU_CU_WIDTH) * 4, (i / LCU_CU_WIDTH) * 4)->depth);
+    }
+  }
+
+  PASS();
+}
+
+TEST work_tree_speed(void)
+{
+  static lcu_t work_tree[MAX_PU_DEPTH + 1];
+  uint64_t ctu_cnt = 0;
+  KVZ_CLOCK_T clock_now;
+  KVZ_GET_TIME(&clock_now);
+  double test_end = KVZ_CLOCK_T_AS_DOUBLE(clock_now) + TIME_PER_TEST;
+
+  // Loop until time allocated for test has passed.
+  while (test_end > KVZ_CLOCK_T_AS_DOUBLE(clock_now)) {
+    init_work_tree(work_tree, 0);
+    emulate_search(work_tree, (unsigned)ctu_cnt, 0, 0, 0, 0);
+    ++ctu_cnt;
+    KVZ_GET_TIME(&clock_now);
+  }
+
+  double test_time = TIME_PER_TEST + KVZ_CLOCK_T_AS_DOUBLE(clock_now) - test_end;
+  sprintf(msg, "%.3f us per CTU", test_time * 1000000.0 / ctu_cnt);
+  PASSm(msg);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// TEST FIXTURES
+
+SUITE(work_tree_tests)
+{
+  RUN_TEST(work_tree_neighbours);
+}
+
+SUITE(work_tree_speed_tests)
+{
+  RUN_TEST(work_tree_speed);
+}